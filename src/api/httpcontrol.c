@@ -23,6 +23,7 @@
 #include <limits.h>
 
 #include "networking/http_server.h"
+#include "networking/net.h"
 #include "event.h"
 #include "image/image.h"
 #include "misc/str.h"
@@ -95,6 +96,14 @@ diag_html(http_connection_t *hc, htsbuf_queue_t *out)
     htsbuf_qprintf(out,
 		   APPNAME"-%d.log (Last modified %s ago): <a href=\"/api/logfile/%d\">View</a> | <a href=\"/api/logfile/%d?mode=download\">Download</a>| <a href=\"/api/logfile/%d?mode=pastebin\">Pastebin</a><br>", i, timestr, i, i, i);
   }
+
+  net_resolver_stats_t nrs;
+  net_resolver_get_stats(&nrs);
+  htsbuf_qprintf(out,
+                 "<p>DNS cache: %d entries, %d hits, %d negative hits, "
+                 "%d misses, %d lookups joined one in flight</p>",
+                 nrs.entries, nrs.hits, nrs.negative_hits,
+                 nrs.misses, nrs.joined);
 }
 
 /**
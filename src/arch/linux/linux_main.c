@@ -55,6 +55,7 @@ gdk_release(void)
 }
 
 static int running;
+static int have_display;
 extern const linux_ui_t ui_glw, ui_gu;
 static const linux_ui_t *ui_wanted = &ui_glw, *ui_current;
 
@@ -77,6 +78,9 @@ arch_stop_req(void)
 static void
 switch_ui(void)
 {
+  if(!have_display)
+    return;
+
   if(ui_current == &ui_glw)
     ui_wanted = &ui_gu;
   else
@@ -154,7 +158,8 @@ main(int argc, char **argv)
 
   gdk_threads_init();
   gdk_threads_enter();
-  gtk_init(&argc, &argv);
+  // Benchmarks and the headless GLW frontend can run without a display
+  have_display = gtk_init_check(&argc, &argv);
 
   parse_opts(argc, argv);
 
@@ -162,7 +167,7 @@ main(int argc, char **argv)
 
   main_init();
 
-  if(gconf.ui && !strcmp(gconf.ui, "gu"))
+  if(gconf.ui && !strcmp(gconf.ui, "gu") && have_display)
     ui_wanted = &ui_gu;
 
   glibcourier = glib_courier_create(g_main_context_default());
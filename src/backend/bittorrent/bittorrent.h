@@ -313,6 +313,7 @@ typedef struct torrent_piece {
   uint8_t tp_disk_fail     : 1;
   uint8_t tp_load_req      : 1;
   uint8_t tp_loadfail      : 1;
+  uint8_t tp_hashing       : 1;
 
   struct torrent_fh_list tp_active_fh;
 
@@ -555,6 +556,8 @@ void torrent_receive_block(torrent_block_t *tb, const void *buf,
 
 void torrent_hash_wakeup(void);
 
+int torrent_hash_max_threads(void);
+
 int torrent_parse_infodict(torrent_t *to, struct htsmsg *info,
                            char *errbuf, size_t errlen);
 
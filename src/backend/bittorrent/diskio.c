@@ -751,3 +751,197 @@ torrent_diskio_load_infofile_from_hash(const uint8_t *req_hash)
   fa_close(fh);
   return NULL;
 }
+
+
+/**
+ * Benchmark
+ *
+ * Verify the pieces stored in a torrent cache file (given in
+ * BT_HASH_BENCH_FILE) against the hashes in its metainfo. First with
+ * the generic SHA-1 code on a single thread (as the hasher used to),
+ * then with sha1_digest() on one thread and on as many threads as the
+ * hasher pool is allowed to use.
+ */
+#define BTHASH_MAX_BYTES (512 * 1024 * 1024)
+
+typedef struct bthash_bench {
+  hts_mutex_t bhb_mutex;
+  uint8_t **bhb_pieces;
+  const uint8_t **bhb_hashes;
+  int bhb_num_pieces;
+  int bhb_piece_length;
+  int bhb_next;
+  int bhb_ok;
+} bthash_bench_t;
+
+
+static void *
+bthash_bench_thread(void *aux)
+{
+  bthash_bench_t *bhb = aux;
+  uint8_t digest[20];
+
+  hts_mutex_lock(&bhb->bhb_mutex);
+  while(bhb->bhb_next < bhb->bhb_num_pieces) {
+    const int i = bhb->bhb_next++;
+    hts_mutex_unlock(&bhb->bhb_mutex);
+    sha1_digest(bhb->bhb_pieces[i], bhb->bhb_piece_length, digest);
+    const int ok = !memcmp(digest, bhb->bhb_hashes[i], 20);
+    hts_mutex_lock(&bhb->bhb_mutex);
+    bhb->bhb_ok += ok;
+  }
+  hts_mutex_unlock(&bhb->bhb_mutex);
+  return NULL;
+}
+
+
+static int64_t
+bthash_bench_run(bthash_bench_t *bhb, int threads)
+{
+  hts_thread_t tids[threads];
+
+  bhb->bhb_next = 0;
+  bhb->bhb_ok = 0;
+
+  const int64_t ts = arch_get_ts();
+  for(int i = 0; i < threads; i++)
+    hts_thread_create_joinable("bthashbench", &tids[i], bthash_bench_thread,
+                               bhb, THREAD_PRIO_BGTASK);
+  for(int i = 0; i < threads; i++)
+    hts_thread_join(&tids[i]);
+  return arch_get_ts() - ts;
+}
+
+
+static int
+bthash_bench_mbps(const bthash_bench_t *bhb, int64_t us)
+{
+  return (int64_t)bhb->bhb_num_pieces * bhb->bhb_piece_length / MAX(us, 1);
+}
+
+
+static void
+bthash_bench(void)
+{
+  char errbuf[256];
+  const char *path = getenv("BT_HASH_BENCH_FILE");
+
+  if(path == NULL) {
+    printf("bt-hash: Set BT_HASH_BENCH_FILE to a torrent cache file (.tc)\n");
+    return;
+  }
+
+  fa_handle_t *fh = fa_open(path, errbuf, sizeof(errbuf));
+  if(fh == NULL) {
+    printf("bt-hash: Unable to open %s -- %s\n", path, errbuf);
+    return;
+  }
+
+  uint8_t tmp[8];
+  if(fa_read(fh, tmp, sizeof(tmp)) != sizeof(tmp) ||
+     rd32_be(tmp) != 'bt02' || rd32_be(tmp + 4) > 1024 * 1024) {
+    printf("bt-hash: %s is not a torrent cache file\n", path);
+    fa_close(fh);
+    return;
+  }
+
+  const int bencodesize = rd32_be(tmp + 4);
+  buf_t *b = buf_create(bencodesize);
+  htsmsg_t *doc = NULL;
+
+  if(fa_read(fh, buf_str(b), bencodesize) == bencodesize)
+    doc = bencode_deserialize(buf_cstr(b), buf_cstr(b) + buf_size(b),
+                              errbuf, sizeof(errbuf), NULL, NULL, NULL);
+  buf_release(b);
+
+  htsmsg_t *info = doc != NULL ? htsmsg_get_map(doc, "info") : NULL;
+  const void *hashes;
+  size_t hashes_size;
+
+  if(info == NULL || htsmsg_get_bin(info, "pieces", &hashes, &hashes_size)) {
+    printf("bt-hash: No metainfo in %s\n", path);
+    if(doc != NULL)
+      htsmsg_release(doc);
+    fa_close(fh);
+    return;
+  }
+
+  bthash_bench_t bhb = {0};
+  hts_mutex_init(&bhb.bhb_mutex);
+  bhb.bhb_piece_length = htsmsg_get_u32_or_default(info, "piece length", 0);
+
+  const int num_pieces = hashes_size / 20;
+  const int max_pieces = BTHASH_MAX_BYTES / MAX(bhb.bhb_piece_length, 1);
+  const int64_t store_offset = 8 + bencodesize + num_pieces * 4;
+  uint32_t *map = malloc(num_pieces * 4);
+
+  bhb.bhb_pieces = calloc(num_pieces, sizeof(uint8_t *));
+  bhb.bhb_hashes = calloc(num_pieces, sizeof(uint8_t *));
+
+  if(bhb.bhb_piece_length > 0 &&
+     fa_read(fh, map, num_pieces * 4) == num_pieces * 4) {
+
+    // The last piece is usually shorter, its length is not in the map
+    for(int i = 0; i < num_pieces - 1 && bhb.bhb_num_pieces < max_pieces;
+        i++) {
+      const uint32_t location = rd32_be((const uint8_t *)&map[i]);
+      if(location >= num_pieces)
+        continue;
+
+      uint8_t *data = malloc(bhb.bhb_piece_length);
+      if(fa_seek(fh, store_offset + (int64_t)location * bhb.bhb_piece_length,
+                 SEEK_SET) < 0 ||
+         fa_read(fh, data, bhb.bhb_piece_length) != bhb.bhb_piece_length) {
+        free(data);
+        continue;
+      }
+      bhb.bhb_pieces[bhb.bhb_num_pieces] = data;
+      bhb.bhb_hashes[bhb.bhb_num_pieces] = (const uint8_t *)hashes + i * 20;
+      bhb.bhb_num_pieces++;
+    }
+  }
+  free(map);
+  fa_close(fh);
+
+  if(bhb.bhb_num_pieces == 0) {
+    printf("bt-hash: No pieces stored in %s\n", path);
+  } else {
+    uint8_t digest[20];
+    int ok = 0;
+
+    int64_t ts = arch_get_ts();
+    for(int i = 0; i < bhb.bhb_num_pieces; i++) {
+      sha1_decl(shactx);
+      sha1_init(shactx);
+      sha1_update(shactx, bhb.bhb_pieces[i], bhb.bhb_piece_length);
+      sha1_final(shactx, digest);
+      ok += !memcmp(digest, bhb.bhb_hashes[i], 20);
+    }
+    ts = arch_get_ts() - ts;
+
+    printf("bt-hash: %d pieces of %d kB, %d OK\n",
+           bhb.bhb_num_pieces, bhb.bhb_piece_length / 1024, ok);
+    printf("bt-hash: generic SHA-1, 1 thread   %5d MB/s\n",
+           bthash_bench_mbps(&bhb, ts));
+
+    ts = bthash_bench_run(&bhb, 1);
+    printf("bt-hash: sha1_digest%s, 1 thread   %5d MB/s\n",
+           sha1_digest_accelerated() ? " (SHA-NI)" : "",
+           bthash_bench_mbps(&bhb, ts));
+
+    const int threads = torrent_hash_max_threads();
+    ts = bthash_bench_run(&bhb, threads);
+    printf("bt-hash: sha1_digest%s, %d threads %5d MB/s, %d OK\n",
+           sha1_digest_accelerated() ? " (SHA-NI)" : "", threads,
+           bthash_bench_mbps(&bhb, ts), bhb.bhb_ok);
+  }
+
+  for(int i = 0; i < bhb.bhb_num_pieces; i++)
+    free(bhb.bhb_pieces[i]);
+  free(bhb.bhb_pieces);
+  free(bhb.bhb_hashes);
+  htsmsg_release(doc);
+  hts_mutex_destroy(&bhb.bhb_mutex);
+}
+
+BENCHMARK("bt-hash", bthash_bench);
@@ -36,6 +36,8 @@
 
 #define TORRENT_REQ_SIZE 16384
 
+#define TORRENT_HASH_MAX_THREADS 8
+
 //----------------------------------------------------------------
 
 static asyncio_timer_t torrent_periodic_timer;
@@ -45,7 +47,8 @@ struct torrent_list torrents;
 static int torrent_pendings_signal;
 static int torrent_boot_periodic_signal;
 static int torrent_metainfo_signal;
-static int torrent_hash_thread_running;
+static int torrent_hash_threads;      // Hasher threads running
+static int torrent_hash_threads_idle; // ... of which waiting for work
 
 hts_cond_t torrent_piece_hash_needed_cond;
 hts_cond_t torrent_piece_io_needed_cond;
@@ -1663,26 +1666,25 @@ static void
 torrent_piece_verify_hash(torrent_t *to, torrent_piece_t *tp)
 {
   uint8_t digest[20];
-  sha1_decl(shactx);
 
   torrent_retain(to);
   tp->tp_refcount++;
+  tp->tp_hashing = 1;
 
   hts_mutex_unlock(&bittorrent_mutex);
   int64_t ts = arch_get_ts();
-  sha1_init(shactx);
-  sha1_update(shactx, tp->tp_data, tp->tp_piece_length);
-  sha1_final(shactx, digest);
+  sha1_digest(tp->tp_data, tp->tp_piece_length, digest);
   ts = arch_get_ts() - ts;
   hts_mutex_lock(&bittorrent_mutex);
 
+  tp->tp_hashing = 0;
   tp->tp_hash_computed = 1;
 
 
   const uint8_t *piecehash = to->to_piece_hashes + tp->tp_index * 20;
   tp->tp_hash_ok = !memcmp(piecehash, digest, 20);
-  torrent_trace(to, "Hash check on piece %d %s",
-                tp->tp_index, tp->tp_hash_ok ? "OK" : "FAIL");
+  torrent_trace(to, "Hash check on piece %d %s (%d us)",
+                tp->tp_index, tp->tp_hash_ok ? "OK" : "FAIL", (int)ts);
 
   if(tp->tp_hash_ok) {
     to->to_new_valid_piece = 1;
@@ -1706,6 +1708,37 @@ torrent_piece_verify_hash(torrent_t *to, torrent_piece_t *tp)
 }
 
 
+/**
+ * Find a complete piece that no hasher has picked up yet
+ */
+static torrent_piece_t *
+torrent_hash_find_work(torrent_t **top)
+{
+  torrent_t *to;
+  torrent_piece_t *tp;
+
+  LIST_FOREACH(to, &torrents, to_link) {
+    TAILQ_FOREACH(tp, &to->to_active_pieces, tp_link) {
+      if(tp->tp_complete && !tp->tp_hash_computed && !tp->tp_hashing) {
+        *top = to;
+        return tp;
+      }
+    }
+  }
+  return NULL;
+}
+
+
+/**
+ * Hasher threads are started on demand, up to one per CPU core
+ */
+int
+torrent_hash_max_threads(void)
+{
+  return MAX(1, MIN(gconf.concurrency, TORRENT_HASH_MAX_THREADS));
+}
+
+
 /**
  *
  */
@@ -1713,33 +1746,34 @@ static void *
 bt_hash_thread(void *aux)
 {
   torrent_t *to;
+  torrent_piece_t *tp;
+  int timeout = 0;
 
   hts_mutex_lock(&bittorrent_mutex);
 
   while(1) {
 
-  restart:
-
-    LIST_FOREACH(to, &torrents, to_link) {
-      torrent_piece_t *tp;
-      TAILQ_FOREACH(tp, &to->to_active_pieces, tp_link) {
-	if(tp->tp_complete && !tp->tp_hash_computed) {
-	  torrent_piece_verify_hash(to, tp);
-          /**
-           * 'to' may be invalid here because we have unlocked so restart
-           * from begining
-           */
-	  goto restart;
-	}
-      }
+    tp = torrent_hash_find_work(&to);
+    if(tp != NULL) {
+      /**
+       * 'to' may be invalid after this because we unlock, so we
+       * always search from the beginning again
+       */
+      torrent_piece_verify_hash(to, tp);
+      timeout = 0;
+      continue;
     }
 
-    if(hts_cond_wait_timeout(&torrent_piece_hash_needed_cond,
-			     &bittorrent_mutex, 60000))
+    if(timeout)
       break;
+
+    torrent_hash_threads_idle++;
+    timeout = hts_cond_wait_timeout(&torrent_piece_hash_needed_cond,
+                                    &bittorrent_mutex, 60000);
+    torrent_hash_threads_idle--;
   }
 
-  torrent_hash_thread_running = 0;
+  torrent_hash_threads--;
   hts_mutex_unlock(&bittorrent_mutex);
   return NULL;
 }
@@ -1751,8 +1785,9 @@ bt_hash_thread(void *aux)
 void
 torrent_hash_wakeup(void)
 {
-  if(!torrent_hash_thread_running) {
-    torrent_hash_thread_running = 1;
+  if(torrent_hash_threads_idle == 0 &&
+     torrent_hash_threads < torrent_hash_max_threads()) {
+    torrent_hash_threads++;
     hts_thread_create_detached("bthasher", bt_hash_thread, NULL,
 			       THREAD_PRIO_BGTASK);
   }
@@ -343,6 +343,7 @@ hls_bad_variant(hls_variant_t *hv, hls_error_t err)
   usleep(100000);
   hd->hd_req = hls_demuxer_select_variant(hd, now, 0);
   hd->hd_last_switch = now;
+  hls_prefetch_drop(hd, hd->hd_req);
 }
 
 
@@ -607,6 +608,16 @@ hls_segment_open(hls_segment_t *hs)
   hs->hs_open_time = arch_get_ts();
   hs->hs_blocked_counter = h->h_blocked;
 
+  hs->hs_prefetch_bw = 0;
+
+  buf_t *b = hls_prefetch_take(hd, hs, &hs->hs_prefetch_bw);
+  if(b != NULL) {
+    fh = memfile_make_buf(b);
+    buf_release(b);
+    HLS_TRACE(h, "Using prefetched %s (sequence %d)", hs->hs_url, hs->hs_seq);
+    goto opened;
+  }
+
   foe.foe_open_timeout = 3000;
   foe.foe_cancellable = hd->hd_cancellable;
 
@@ -638,6 +649,7 @@ hls_segment_open(hls_segment_t *hs)
   if(hs->hs_byte_size != -1 && hs->hs_byte_offset != -1)
     fh = fa_slice_open(fh, hs->hs_byte_offset, hs->hs_byte_size);
 
+ opened:
   hs->hs_size = fa_fsize(fh);
 
   switch(hs->hs_crypto) {
@@ -663,6 +675,8 @@ hls_segment_open(hls_segment_t *hs)
   hs->hs_fh = fh;
   HLS_TRACE(h, "Opened %s (sequence %d) ranges:[%d + %d] OK",
             hs->hs_url, hs->hs_seq, hs->hs_byte_offset, hs->hs_byte_size);
+
+  hls_prefetch_schedule(hd, hs);
   return 0;
 }
 
@@ -679,35 +693,20 @@ hls_segment_close(hls_segment_t *hs)
   hls_demuxer_t *hd = hs->hs_variant->hv_demuxer;
   hls_t *h = hd->hd_hls;
 
-  if(hs->hs_blocked_counter == h->h_blocked) {
+  if(hs->hs_size > 0 &&
+     (hs->hs_prefetch_bw || hs->hs_blocked_counter == h->h_blocked)) {
     int64_t ts = arch_get_ts() - hs->hs_open_time;
+    if(hs->hs_prefetch_bw)
+      ts = 8000000LL * hs->hs_size / hs->hs_prefetch_bw;
+
     if(ts > 1000) {
-      int64_t bw = 8000000LL * hs->hs_size / ts;
-      bw = MIN(100000000, bw);
-
-
-      int low_buffer = h->h_mp->mp_buffer_delay < 5000000;
-      const char *delta;
-      if(hd->hd_bw == 0) {
-        hd->hd_bw = bw;
-        delta = "Initial";
-      } else if(bw < hd->hd_bw) {
-        delta = "Decrease";
-        if(low_buffer)
-          hd->hd_bw = (hd->hd_bw + bw) / 2;
-        else
-          hd->hd_bw = (hd->hd_bw * 7 + bw) / 8;
-      } else {
-        delta = "Increase";
-        hd->hd_bw = (hd->hd_bw + bw) / 2;
-      }
+      hls_abr_sample(&hd->hd_abr, hs->hs_size, ts);
+      hd->hd_bw = hls_abr_estimate(&hd->hd_abr);
       HLS_TRACE(h, "Estimated bandwidth updated %d bps "
                 "(most recent segment %d bps) "
-                "buffer: %ds (%s) delta: %s\n",
-                hd->hd_bw, (int)bw,
-                (int)(h->h_mp->mp_buffer_delay / 1000000),
-                low_buffer ? "Low" : "OK",
-                delta);
+                "buffer: %ds\n",
+                hd->hd_bw, (int)(8000000LL * hs->hs_size / ts),
+                (int)(h->h_mp->mp_buffer_delay / 1000000));
       hd->hd_bw_updated = 1;
     }
   }
@@ -1082,6 +1081,68 @@ demuxer_select_variant_random(hls_demuxer_t *hd)
   return hv;
 }
 
+/**
+ * Let the bitrate controller pick among the variants that work best
+ */
+static hls_variant_t *
+demuxer_select_variant_abr(hls_demuxer_t *hd, int64_t now)
+{
+  const hls_t *h = hd->hd_hls;
+  hls_variant_t *hv;
+  int lcc = INT32_MAX;
+  int num = 0;
+
+  TAILQ_FOREACH(hv, &hd->hd_variants, hv_link) {
+    if(hv->hv_audio_only)
+      continue;
+    if(hv->hv_corrupt_timer < now - HLS_CORRUPTION_MEASURE_PERIOD)
+      hv->hv_corruptions_last_period = 0;
+
+    lcc = MIN(lcc, hv->hv_corrupt_counter);
+    num++;
+  }
+
+  if(num == 0)
+    return NULL;
+
+  hls_variant_t *candidates[num];
+  int bitrates[num];
+  int current = -1;
+  int n = 0;
+
+  // Variants are sorted on descending bitrate, controller wants ascending
+  TAILQ_FOREACH_REVERSE(hv, &hd->hd_variants, hls_variant_queue, hv_link) {
+    if(hv->hv_audio_only)
+      continue;
+    if(hv->hv_corruptions_last_period >= 3)
+      continue;
+    if(hv->hv_corrupt_counter != lcc)
+      continue;
+
+    if(hv == hd->hd_current)
+      current = n;
+    candidates[n] = hv;
+    bitrates[n] = hv->hv_bitrate;
+    n++;
+  }
+
+  if(n == 0)
+    return demuxer_select_variant_simple(hd, now, hd->hd_bw);
+
+  const hls_variant_t *cur = hd->hd_current;
+  int64_t segment_duration = cur->hv_target_duration * 1000000LL;
+  if(cur->hv_current_seg != NULL && cur->hv_current_seg->hs_duration)
+    segment_duration = cur->hv_current_seg->hs_duration;
+  if(segment_duration == 0)
+    segment_duration = 10000000;
+
+  const int i = hls_abr_select(&hd->hd_abr, bitrates, n, current,
+                               h->h_mp->mp_buffer_delay, segment_duration,
+                               now);
+  return candidates[i];
+}
+
+
 /**
  *
  */
@@ -1118,24 +1179,22 @@ hls_check_bw_switch(hls_demuxer_t *hd)
     return;
 
   hd->hd_bw_updated = 0;
-  hls_variant_t *hv = hls_demuxer_select_variant(hd, now, hd->hd_bw);
+  hls_variant_t *hv = demuxer_select_variant_abr(hd, now);
 
   if(hv == NULL || hv == hd->hd_current)
     return;
 
-
-  if(hv->hv_bitrate > hd->hd_current->hv_bitrate) {
-    // Stepping up, only do it if we have more than 10s worth of buffer
-    if(mp->mp_buffer_delay < 10000000) {
-      hd->hd_last_switch = now;
-      return;
-    }
-  }
-
+  HLS_TRACE(h, "%s: Bitrate %d -> %d, estimated bandwidth %d bps, "
+            "buffer: %ds", hd->hd_type, hd->hd_current->hv_bitrate,
+            hv->hv_bitrate, hd->hd_bw,
+            (int)(mp->mp_buffer_delay / 1000000));
 
   hd->hd_last_switch = now;
   hd->hd_req = hv;
 
+  // Whatever was prefetched from the old variant is of no use now
+  hls_prefetch_drop(hd, hv);
+
   hls_free_mbp(mp, &hd->hd_mb);
 }
 
@@ -1497,6 +1556,7 @@ hls_demuxer_get_audio(hls_t *h)
     }
 
     hd->hd_current = hv;
+    hls_prefetch_drop(hd, hv);
 
     hls_free_mbp(h->h_mp, &hd->hd_mb);
   }
@@ -1512,6 +1572,8 @@ static void
 hls_demuxer_seek(media_pipe_t *mp, hls_demuxer_t *hd, int64_t pos)
 {
   hd->hd_seek_to_segment = pos;
+  hls_prefetch_drop(hd, NULL);
+  hls_abr_restart(&hd->hd_abr);
 
   if(hd->hd_current != NULL && hd->hd_current->hv_demuxer_flush)
     hd->hd_current->hv_demuxer_flush(hd->hd_current);
@@ -1922,7 +1984,7 @@ hls_get_audio_track(hls_t *h, int pid, const char *mux_id, const char *language,
 /**
  *
  */
-static void
+void
 hls_free_audio_tracks(hls_t *h)
 {
   hls_audio_track_t *hat;
@@ -2144,6 +2206,7 @@ hls_demuxer_init(hls_demuxer_t *hd, hls_t *h, const char *type)
   hd->hd_seek_to_segment = PTS_UNSET;
   hd->hd_last_dts = PTS_UNSET;
   hd->hd_cancellable = cancellable_create();
+  hls_abr_init(&hd->hd_abr);
 }
 
 
@@ -2153,6 +2216,7 @@ hls_demuxer_init(hls_demuxer_t *hd, hls_t *h, const char *type)
 static void
 hls_demuxer_close(media_pipe_t *mp, hls_demuxer_t *hd)
 {
+  hls_prefetch_stop(hd);
   variants_destroy(&hd->hd_variants);
   if(hd->hd_audio_codec != NULL)
     media_codec_deref(hd->hd_audio_codec);
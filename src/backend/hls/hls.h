@@ -84,6 +84,7 @@ typedef struct hls_segment {
 
   int64_t hs_open_time;
   int hs_blocked_counter;
+  int hs_prefetch_bw;  // Measured by the prefetcher, 0 if fetched directly
 
 } hls_segment_t;
 
@@ -174,6 +175,22 @@ typedef struct hls_variant {
 } hls_variant_t;
 
 
+/**
+ * Adaptive bitrate controller, see hls_abr.c
+ */
+typedef struct hls_abr {
+  double ha_fast;          // Throughput EWMAs in bps
+  double ha_slow;
+  double ha_fast_weight;   // Total weight, for zero bias correction
+  double ha_slow_weight;
+  int ha_samples;
+  int ha_steady;           // Buffer has been filled at least once
+  int64_t ha_last_switch;
+  int ha_down_bitrate;     // Bitrate we last switched down from
+  int64_t ha_down_time;
+} hls_abr_t;
+
+
 /**
  *
  */
@@ -184,6 +201,7 @@ typedef struct hls_demuxer {
   hls_variant_t *hd_current;
   hls_variant_t *hd_req;
 
+  hls_abr_t hd_abr;
   int hd_bw;
   int hd_bw_updated;
   int64_t hd_download_counter_reset_at;
@@ -200,6 +218,8 @@ typedef struct hls_demuxer {
 
   cancellable_t *hd_cancellable;
 
+  struct hls_prefetch *hd_prefetch;
+
   struct hls *hd_hls;
 
   // When set, nothing seems to be working, bail out
@@ -296,8 +316,35 @@ int hls_get_audio_track(hls_t *h, int pid, const char *name,
 
 hls_segment_t *hv_find_segment_by_seq(hls_variant_t *hv, int seq);
 
+void hls_free_audio_tracks(hls_t *h);
+
 void hls_bad_variant(hls_variant_t *hv, hls_error_t err);
 
+// Adaptive bitrate
+
+void hls_abr_init(hls_abr_t *ha);
+
+void hls_abr_restart(hls_abr_t *ha);
+
+void hls_abr_sample(hls_abr_t *ha, int64_t bytes, int64_t duration);
+
+int hls_abr_estimate(const hls_abr_t *ha);
+
+int hls_abr_select(hls_abr_t *ha, const int *bitrates, int num, int current,
+                   int64_t buffer_delay, int64_t segment_duration,
+                   int64_t now);
+
+// Segment prefetcher
+
+void hls_prefetch_schedule(hls_demuxer_t *hd, const hls_segment_t *hs);
+
+buf_t *hls_prefetch_take(hls_demuxer_t *hd, const hls_segment_t *hs,
+                         int *bwp);
+
+void hls_prefetch_drop(hls_demuxer_t *hd, const hls_variant_t *keep);
+
+void hls_prefetch_stop(hls_demuxer_t *hd);
+
 // TS demuxer
 
 media_buf_t *hls_ts_demuxer_read(hls_demuxer_t *hd);
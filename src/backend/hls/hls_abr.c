@@ -0,0 +1,597 @@
+/*
+ *  Copyright (C) 2007-2015 Lonelycoder AB
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  This program is also available under a commercial proprietary license.
+ *  For more information, contact andreas@lonelycoder.com
+ */
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "main.h"
+#include "media/media.h"
+#include "backend/backend.h"
+#include "fileaccess/fileaccess.h"
+#include "misc/minmax.h"
+#include "hls.h"
+
+/**
+ * Adaptive bitrate controller
+ *
+ * Throughput is estimated from segment downloads with two exponentially
+ * weighted moving averages, each sample weighted by how long the
+ * download took. The fast one reacts to drops quickly and the slow one
+ * keeps a single lucky segment from pushing the estimate up. The lower
+ * of the two is used.
+ *
+ * The variant is picked as the highest bitrate that fits within a
+ * fraction of the estimate. The fraction depends on how much media is
+ * buffered, the less there is the more margin is kept.
+ *
+ * To avoid flapping between two variants the current one is kept as
+ * long as the buffer is healthy and the estimate covers its bitrate,
+ * even if it would not have been picked from scratch. Switching up also
+ * requires some time to have passed since the last switch. Until the
+ * buffer has been filled once (startup) that time is shorter so playback
+ * can start at a low bitrate and ramp up quickly.
+ */
+
+#define HLS_ABR_FAST_HALFLIFE 2.0   // In seconds of download time
+#define HLS_ABR_SLOW_HALFLIFE 5.0
+#define HLS_ABR_MIN_SAMPLE    16000 // Smaller downloads say little about bw
+
+#define HLS_ABR_PANIC_BUFFER  (2  * 1000000)
+#define HLS_ABR_LOW_BUFFER    (5  * 1000000)
+#define HLS_ABR_STEADY_BUFFER (10 * 1000000)
+#define HLS_ABR_HIGH_BUFFER   (20 * 1000000)
+
+#define HLS_ABR_STARTUP_HOLD  (2 * 1000000)
+#define HLS_ABR_UP_HOLD       (5 * 1000000)
+#define HLS_ABR_RETRY_HOLD    (20 * 1000000)
+
+
+/**
+ *
+ */
+void
+hls_abr_init(hls_abr_t *ha)
+{
+  memset(ha, 0, sizeof(hls_abr_t));
+  ha->ha_last_switch = INT64_MIN / 2;
+  ha->ha_down_time = INT64_MIN / 2;
+}
+
+
+/**
+ * Called when the buffer has been flushed (seek). The throughput
+ * estimate still holds but the controller is back in startup until the
+ * buffer has been filled again, otherwise an empty buffer would look
+ * like a stall and make it panic
+ */
+void
+hls_abr_restart(hls_abr_t *ha)
+{
+  ha->ha_steady = 0;
+  ha->ha_last_switch = INT64_MIN / 2;
+}
+
+
+/**
+ *
+ */
+static void
+ewma_add(double *estimate, double *total, double halflife,
+         double weight, double value)
+{
+  const double alpha = exp(log(0.5) / halflife);
+  const double a = pow(alpha, weight);
+  *estimate = value * (1 - a) + a * *estimate;
+  *total += weight;
+}
+
+
+/**
+ *
+ */
+static double
+ewma_get(double estimate, double total, double halflife)
+{
+  const double alpha = exp(log(0.5) / halflife);
+  return estimate / (1 - pow(alpha, total));
+}
+
+
+/**
+ * Add a download of 'bytes' that took 'duration' µs
+ */
+void
+hls_abr_sample(hls_abr_t *ha, int64_t bytes, int64_t duration)
+{
+  if(bytes < HLS_ABR_MIN_SAMPLE || duration <= 0)
+    return;
+
+  const double bw = 8000000.0 * bytes / duration;
+  const double weight = duration / 1000000.0;
+
+  ewma_add(&ha->ha_fast, &ha->ha_fast_weight, HLS_ABR_FAST_HALFLIFE,
+           weight, bw);
+  ewma_add(&ha->ha_slow, &ha->ha_slow_weight, HLS_ABR_SLOW_HALFLIFE,
+           weight, bw);
+  ha->ha_samples++;
+}
+
+
+/**
+ * Estimated throughput in bps, 0 if unknown
+ */
+int
+hls_abr_estimate(const hls_abr_t *ha)
+{
+  if(ha->ha_samples == 0)
+    return 0;
+
+  const double fast = ewma_get(ha->ha_fast, ha->ha_fast_weight,
+                               HLS_ABR_FAST_HALFLIFE);
+  const double slow = ewma_get(ha->ha_slow, ha->ha_slow_weight,
+                               HLS_ABR_SLOW_HALFLIFE);
+  return MIN(MIN(fast, slow), 1000000000.0);
+}
+
+
+/**
+ * Time in µs to fetch a segment of a variant
+ */
+static int64_t
+fetch_time(int bitrate, int64_t segment_duration, int64_t bw)
+{
+  return bitrate * segment_duration / bw;
+}
+
+
+/**
+ * Return index of the variant to use. 'bitrates' must be sorted in
+ * ascending order. 'current' is the index of the variant in use or -1
+ * if it is not among the candidates
+ */
+int
+hls_abr_select(hls_abr_t *ha, const int *bitrates, int num, int current,
+               int64_t buffer_delay, int64_t segment_duration, int64_t now)
+{
+  int target = 0;
+
+  if(num == 0)
+    return -1;
+
+  const int64_t bw_short = hls_abr_estimate(ha);
+  if(bw_short == 0)
+    return current >= 0 ? current : 0;
+
+  const int64_t bw_long = MIN(ewma_get(ha->ha_slow, ha->ha_slow_weight,
+                                       HLS_ABR_SLOW_HALFLIFE), 1000000000.0);
+
+  if(buffer_delay >= HLS_ABR_STEADY_BUFFER)
+    ha->ha_steady = 1;
+
+  const int panic = ha->ha_steady && buffer_delay < HLS_ABR_PANIC_BUFFER;
+  const int low = buffer_delay < HLS_ABR_LOW_BUFFER;
+
+  // With lots of media buffered short dips don't matter
+  int64_t bw = bw_short;
+  int safety;   // in percent
+  if(panic) {
+    safety = 50;
+  } else if(low) {
+    safety = 70;
+  } else if(buffer_delay < HLS_ABR_HIGH_BUFFER) {
+    safety = 85;
+  } else {
+    safety = 95;
+    bw = bw_long;
+  }
+
+  for(int i = 1; i < num; i++)
+    if(bitrates[i] * 100LL <= bw * safety)
+      target = i;
+
+  if(current < 0)
+    goto out;
+
+  if(target < current) {
+
+    if(panic)
+      goto out;
+
+    // Stay as long as the long term average covers the bitrate and the
+    // next segment can be fetched at the current rate before the buffer
+    // runs low
+    const int64_t t = fetch_time(bitrates[current], segment_duration,
+                                 bw_short);
+    if(bitrates[current] <= bw_long &&
+       buffer_delay - t >= HLS_ABR_LOW_BUFFER)
+      return current;
+
+    // Don't go further down than needed
+    for(int i = current - 1; i > target; i--) {
+      const int64_t t = fetch_time(bitrates[i], segment_duration, bw_short);
+      if(bitrates[i] <= bw_long && buffer_delay - t >= HLS_ABR_LOW_BUFFER) {
+        target = i;
+        break;
+      }
+    }
+
+  } else if(target > current) {
+
+    const int64_t hold = ha->ha_steady ?
+      HLS_ABR_UP_HOLD : HLS_ABR_STARTUP_HOLD;
+
+    if(now < ha->ha_last_switch + hold)
+      return current;
+
+    // Don't go back to a bitrate we recently couldn't keep up with
+    if(now < ha->ha_down_time + HLS_ABR_RETRY_HOLD) {
+      while(target > current && bitrates[target] >= ha->ha_down_bitrate)
+        target--;
+      if(target == current)
+        return current;
+    }
+
+    if(ha->ha_steady && low)
+      return current;
+
+    // Don't bet a thin buffer on more than one step at a time
+    if(low)
+      target = current + 1;
+
+  } else {
+    return current;
+  }
+
+ out:
+  if(current >= 0 && target < current) {
+    ha->ha_down_bitrate = bitrates[current];
+    ha->ha_down_time = now;
+  }
+  ha->ha_last_switch = now;
+  return target;
+}
+
+
+/**
+ * Simulator
+ *
+ * Replays bandwidth traces against the controller and against the
+ * variant selection used before it (smoothed last segment bitrate,
+ * stepping up only with 10s of buffer). A trace is a list of
+ * (milliseconds, kbps) steps and is looped if playback outlasts it.
+ * Further traces can be given in a file named by HLS_ABR_TRACE with
+ * one "milliseconds kbps" pair per line.
+ *
+ * The player fetches segments back to back until it has 30 seconds
+ * buffered. Playback starts, and resumes after a stall, once one
+ * segment is buffered.
+ */
+#define ABRSIM_SEGMENT   4000000
+#define ABRSIM_MEDIA     (600 * 1000000LL)
+#define ABRSIM_MAXBUF    (30 * 1000000LL)
+#define ABRSIM_RTT       50000
+#define ABRSIM_INITIAL   1
+
+static const int abrsim_ladder[] = {
+  400000, 800000, 1500000, 3000000, 5000000, 8000000
+};
+
+#define ABRSIM_VARIANTS (sizeof(abrsim_ladder) / sizeof(abrsim_ladder[0]))
+
+typedef struct abrsim_step {
+  int ms;
+  int kbps;
+} abrsim_step_t;
+
+typedef struct abrsim_trace {
+  const char *name;
+  abrsim_step_t *steps;
+  int num;
+} abrsim_trace_t;
+
+typedef struct abrsim_result {
+  int64_t startup;
+  int64_t rebuffer;
+  int stalls;
+  int switches;
+  int64_t bits;
+  int segments;
+} abrsim_result_t;
+
+
+/**
+ * Position in trace
+ */
+typedef struct abrsim_link {
+  const abrsim_trace_t *t;
+  int idx;
+  int64_t left;   // µs left of current step
+} abrsim_link_t;
+
+
+/**
+ * Returns time in µs to transfer 'bytes' starting at current position
+ */
+static int64_t
+abrsim_transfer(abrsim_link_t *l, int64_t bytes)
+{
+  int64_t elapsed = ABRSIM_RTT;
+  double bits = bytes * 8.0;
+
+  l->left -= ABRSIM_RTT;
+  while(l->left <= 0) {
+    l->idx = (l->idx + 1) % l->t->num;
+    l->left += l->t->steps[l->idx].ms * 1000LL;
+  }
+
+  while(bits > 0) {
+    const double bps = l->t->steps[l->idx].kbps * 1000.0;
+    const double can = bps * l->left / 1000000.0;
+    if(can >= bits) {
+      const int64_t d = bits * 1000000.0 / bps;
+      l->left -= d;
+      elapsed += d;
+      break;
+    }
+    bits -= can;
+    elapsed += l->left;
+    l->idx = (l->idx + 1) % l->t->num;
+    l->left = l->t->steps[l->idx].ms * 1000LL;
+  }
+  return elapsed;
+}
+
+
+/**
+ * Let time pass without transferring anything
+ */
+static void
+abrsim_idle(abrsim_link_t *l, int64_t d)
+{
+  l->left -= d;
+  while(l->left <= 0) {
+    l->idx = (l->idx + 1) % l->t->num;
+    l->left += l->t->steps[l->idx].ms * 1000LL;
+  }
+}
+
+
+/**
+ * Selection as done before the controller was added
+ */
+typedef struct abrsim_legacy {
+  int bw;
+  int64_t last_switch;
+} abrsim_legacy_t;
+
+static int
+abrsim_legacy_select(abrsim_legacy_t *al, int64_t bytes, int64_t duration,
+                     int current, int64_t buffer, int64_t now)
+{
+  int64_t bw = MIN(100000000, 8000000LL * bytes / duration);
+
+  if(al->bw == 0)
+    al->bw = bw;
+  else if(bw < al->bw && buffer < 5000000)
+    al->bw = (al->bw + bw) / 2;
+  else if(bw < al->bw)
+    al->bw = (al->bw * 7 + bw) / 8;
+  else
+    al->bw = (al->bw + bw) / 2;
+
+  if(al->last_switch + 1000000 > now)
+    return current;
+
+  int sel = 0;
+  for(int i = ABRSIM_VARIANTS - 1; i >= 0; i--) {
+    if(abrsim_ladder[i] < al->bw) {
+      sel = i;
+      break;
+    }
+  }
+
+  if(sel > current && buffer < 10000000) {
+    al->last_switch = now;
+    return current;
+  }
+  if(sel != current)
+    al->last_switch = now;
+  return sel;
+}
+
+
+/**
+ *
+ */
+static void
+abrsim_run(const abrsim_trace_t *t, int legacy, abrsim_result_t *r)
+{
+  abrsim_link_t l = {t, 0, t->steps[0].ms * 1000LL};
+  abrsim_legacy_t al = {0};
+  hls_abr_t ha;
+  int64_t now = 0;
+  int64_t buffer = 0;
+  int64_t fetched = 0;
+  int playing = 0;
+  int cur = ABRSIM_INITIAL;
+
+  hls_abr_init(&ha);
+  memset(r, 0, sizeof(abrsim_result_t));
+
+  while(fetched < ABRSIM_MEDIA) {
+
+    if(buffer > ABRSIM_MAXBUF - ABRSIM_SEGMENT) {
+      const int64_t wait = buffer - (ABRSIM_MAXBUF - ABRSIM_SEGMENT);
+      abrsim_idle(&l, wait);
+      now += wait;
+      buffer -= wait;
+    }
+
+    const int64_t bytes = (int64_t)abrsim_ladder[cur] * ABRSIM_SEGMENT / 8000000;
+    const int64_t d = abrsim_transfer(&l, bytes);
+
+    now += d;
+    if(playing) {
+      if(buffer < d) {
+        r->rebuffer += d - buffer;
+        r->stalls++;
+        buffer = 0;
+        playing = 0;
+      } else {
+        buffer -= d;
+      }
+    }
+
+    buffer += ABRSIM_SEGMENT;
+    fetched += ABRSIM_SEGMENT;
+    r->bits += bytes * 8;
+    r->segments++;
+
+    if(!playing) {
+      if(r->startup == 0)
+        r->startup = now;
+      playing = 1;
+    }
+
+    int next;
+    if(legacy) {
+      next = abrsim_legacy_select(&al, bytes, d, cur, buffer, now);
+    } else {
+      hls_abr_sample(&ha, bytes, d);
+      next = hls_abr_select(&ha, abrsim_ladder, ABRSIM_VARIANTS, cur,
+                            buffer, ABRSIM_SEGMENT, now);
+    }
+    if(next != cur)
+      r->switches++;
+    cur = next;
+  }
+}
+
+
+/**
+ *
+ */
+static void
+abrsim_report(const abrsim_trace_t *t)
+{
+  abrsim_result_t r;
+  int64_t ms = 0, kbits = 0;
+
+  for(int i = 0; i < t->num; i++) {
+    ms += t->steps[i].ms;
+    kbits += (int64_t)t->steps[i].ms * t->steps[i].kbps;
+  }
+  printf("hls-abr: %s, average %d kbps\n", t->name, (int)(kbits / ms));
+
+  for(int legacy = 1; legacy >= 0; legacy--) {
+    abrsim_run(t, legacy, &r);
+    printf("hls-abr:   %-10s avg %5d kbps  startup %5d ms  "
+           "rebuffer %6d ms (%d stalls)  %d switches\n",
+           legacy ? "legacy" : "controller",
+           (int)(r.bits * 1000 / ABRSIM_MEDIA),
+           (int)(r.startup / 1000),
+           (int)(r.rebuffer / 1000), r.stalls, r.switches);
+  }
+}
+
+
+/**
+ *
+ */
+static int
+abrsim_load(abrsim_trace_t *t, const char *path)
+{
+  FILE *fp = fopen(path, "r");
+  int ms, kbps;
+
+  if(fp == NULL)
+    return -1;
+
+  t->name = "file";
+  t->steps = NULL;
+  t->num = 0;
+
+  while(fscanf(fp, "%d %d", &ms, &kbps) == 2) {
+    if(ms <= 0 || kbps <= 0)
+      continue;
+    t->steps = realloc(t->steps, sizeof(abrsim_step_t) * (t->num + 1));
+    t->steps[t->num].ms = ms;
+    t->steps[t->num].kbps = kbps;
+    t->num++;
+  }
+  fclose(fp);
+  return t->num ? 0 : -1;
+}
+
+
+/**
+ *
+ */
+static void
+abrsim(void)
+{
+  static abrsim_step_t steady[] = {{1000, 6000}};
+  static abrsim_step_t stepdown[] = {{60000, 9000}, {60000, 1800},
+                                     {60000, 4000}};
+  static abrsim_step_t spiky[] = {{2000, 12000}, {3000, 900}};
+  static abrsim_step_t mobile[200];
+  unsigned int seed = 1;
+  int kbps = 3000;
+
+  // Random walk, roughly like a moving 4G connection
+  for(int i = 0; i < 200; i++) {
+    kbps += (int)(rand_r(&seed) % 2001) - 1000;
+    kbps = MAX(300, MIN(kbps, 9000));
+    if(rand_r(&seed) % 20 == 0)
+      kbps = 300 + rand_r(&seed) % 600;  // Handover or tunnel
+    mobile[i].ms = 1000;
+    mobile[i].kbps = kbps;
+  }
+
+  const abrsim_trace_t traces[] = {
+    {"steady", steady, 1},
+    {"stepdown", stepdown, 3},
+    {"spiky", spiky, 2},
+    {"mobile", mobile, 200},
+  };
+
+  printf("hls-abr: %d s of media in %d s segments, ladder",
+         (int)(ABRSIM_MEDIA / 1000000), ABRSIM_SEGMENT / 1000000);
+  for(int i = 0; i < ABRSIM_VARIANTS; i++)
+    printf(" %d", abrsim_ladder[i] / 1000);
+  printf(" kbps\n");
+
+  for(int i = 0; i < sizeof(traces) / sizeof(traces[0]); i++)
+    abrsim_report(&traces[i]);
+
+  const char *path = getenv("HLS_ABR_TRACE");
+  if(path != NULL) {
+    abrsim_trace_t t;
+    if(abrsim_load(&t, path)) {
+      printf("hls-abr: Unable to load trace from %s\n", path);
+    } else {
+      abrsim_report(&t);
+      free(t.steps);
+    }
+  }
+}
+
+BENCHMARK("hls-abr", abrsim);
@@ -0,0 +1,653 @@
+/*
+ *  Copyright (C) 2007-2015 Lonelycoder AB
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  This program is also available under a commercial proprietary license.
+ *  For more information, contact andreas@lonelycoder.com
+ */
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "main.h"
+#include "media/media.h"
+#include "backend/backend.h"
+#include "fileaccess/fileaccess.h"
+#include "misc/minmax.h"
+#if ENABLE_BENCHMARKS
+#include "networking/http_bench_server.h"
+#endif
+#include "hls.h"
+
+/**
+ * Segment prefetcher
+ *
+ * Once the demuxer has opened a segment, the next few segments of the
+ * same variant are downloaded into memory by a couple of worker
+ * threads. hls_segment_open() picks them up from here instead of
+ * going to the network, so the round trip for each new segment is no
+ * longer paid while the demuxer waits.
+ *
+ * Segments are kept as they come off the wire. Decryption is done by
+ * hls_segment_open() when the segment is consumed, same as for
+ * segments it fetches itself, so keys are only ever loaded from the
+ * demuxer thread.
+ *
+ * Memory held by fetched and in-flight segments is bounded by
+ * HLS_PREFETCH_MEMORY. Only the segment the demuxer needs next may go
+ * beyond it, others wait for room.
+ *
+ * The queue and all fields in hls_prefetch_t are protected by hp_mutex.
+ * Workers never dereference hps_variant, it's only used for comparison.
+ */
+
+#define HLS_PREFETCH_WORKERS  2
+#define HLS_PREFETCH_SEGMENTS 3
+#define HLS_PREFETCH_MEMORY   (16 * 1024 * 1024)
+#define HLS_PREFETCH_CHUNK    (256 * 1024)
+
+TAILQ_HEAD(hls_prefetch_seg_queue, hls_prefetch_seg);
+
+typedef struct hls_prefetch_seg {
+  TAILQ_ENTRY(hls_prefetch_seg) hps_link;
+  const hls_variant_t *hps_variant;
+  int hps_seq;
+  char *hps_url;
+  int hps_byte_offset;
+  int hps_byte_size;
+  enum {
+    HPS_QUEUED,
+    HPS_FETCHING,
+    HPS_DONE,
+    HPS_FAILED,
+  } hps_state;
+  char hps_dropped;   // Removed while fetching, worker frees it
+  size_t hps_reserved; // Bytes accounted in hp_bytes
+  buf_t *hps_buf;
+  int hps_bw;
+} hls_prefetch_seg_t;
+
+typedef struct hls_prefetch_worker {
+  struct hls_prefetch *hpw_hp;
+  hls_prefetch_seg_t *hpw_seg;
+  cancellable_t *hpw_cancellable;
+  hts_thread_t hpw_thread;
+} hls_prefetch_worker_t;
+
+typedef struct hls_prefetch {
+  hts_mutex_t hp_mutex;
+  hts_cond_t hp_cond;
+  struct hls_prefetch_seg_queue hp_segs;
+  hls_demuxer_t *hp_hd;
+  size_t hp_bytes;
+  int hp_stop;
+
+  // Download speed, measured over time when any worker is active
+  int hp_active;
+  int64_t hp_busy_start;
+  int64_t hp_busy_time;
+  int64_t hp_busy_bytes;
+  int hp_bw;
+
+  hls_prefetch_worker_t hp_workers[HLS_PREFETCH_WORKERS];
+} hls_prefetch_t;
+
+
+/**
+ *
+ */
+static hls_prefetch_seg_t *
+hls_prefetch_find(hls_prefetch_t *hp, const hls_variant_t *hv, int seq)
+{
+  hls_prefetch_seg_t *hps;
+  TAILQ_FOREACH(hps, &hp->hp_segs, hps_link)
+    if(hps->hps_variant == hv && hps->hps_seq == seq)
+      break;
+  return hps;
+}
+
+
+/**
+ *
+ */
+static void
+hls_prefetch_seg_destroy(hls_prefetch_t *hp, hls_prefetch_seg_t *hps)
+{
+  hp->hp_bytes -= hps->hps_reserved;
+  buf_release(hps->hps_buf);
+  free(hps->hps_url);
+  free(hps);
+}
+
+
+/**
+ * Remove segment from queue. hp_mutex must be held
+ */
+static void
+hls_prefetch_seg_drop(hls_prefetch_t *hp, hls_prefetch_seg_t *hps)
+{
+  TAILQ_REMOVE(&hp->hp_segs, hps, hps_link);
+
+  if(hps->hps_state != HPS_FETCHING) {
+    hls_prefetch_seg_destroy(hp, hps);
+  } else {
+    hps->hps_dropped = 1;
+    for(int i = 0; i < HLS_PREFETCH_WORKERS; i++)
+      if(hp->hp_workers[i].hpw_seg == hps)
+        cancellable_cancel(hp->hp_workers[i].hpw_cancellable);
+  }
+  hts_cond_broadcast(&hp->hp_cond);
+}
+
+
+/**
+ * Account 'size' more bytes to the segment. Waits for room unless the
+ * segment is first in line. Returns -1 if the segment was dropped while
+ * waiting. hp_mutex must be held
+ */
+static int
+hls_prefetch_reserve(hls_prefetch_t *hp, hls_prefetch_seg_t *hps, size_t size)
+{
+  while(!hps->hps_dropped && hps != TAILQ_FIRST(&hp->hp_segs) &&
+        hp->hp_bytes + size > HLS_PREFETCH_MEMORY)
+    hts_cond_wait(&hp->hp_cond, &hp->hp_mutex);
+
+  if(hps->hps_dropped)
+    return -1;
+
+  hps->hps_reserved += size;
+  hp->hp_bytes += size;
+  return 0;
+}
+
+
+/**
+ * Download a segment. Called without hp_mutex held
+ */
+static buf_t *
+hls_prefetch_fetch(hls_prefetch_t *hp, hls_prefetch_worker_t *hpw,
+                   hls_prefetch_seg_t *hps)
+{
+  const hls_t *h = hp->hp_hd->hd_hls;
+  fa_open_extra_t foe = {0};
+  char errbuf[512];
+  uint8_t *data = NULL;
+  size_t cap = 0;
+  size_t len = 0;
+
+  foe.foe_open_timeout = 3000;
+  foe.foe_cancellable = hpw->hpw_cancellable;
+
+  int flags = FA_STREAMING;
+  if(hps->hps_byte_offset != -1)
+    flags = 0;
+
+  fa_handle_t *fh = fa_open_ex(hps->hps_url, errbuf, sizeof(errbuf),
+                               flags, &foe);
+  if(fh == NULL) {
+    HLS_TRACE(h, "Prefetch of %s failed -- %s", hps->hps_url, errbuf);
+    return NULL;
+  }
+
+  fa_set_read_timeout(fh, 3000);
+
+  if(hps->hps_byte_size != -1 && hps->hps_byte_offset != -1)
+    fh = fa_slice_open(fh, hps->hps_byte_offset, hps->hps_byte_size);
+
+  const int64_t size = fa_fsize(fh);
+
+  while(1) {
+    if(len == cap) {
+      if(size > 0 && len == size)
+        break;
+
+      const size_t more = size > 0 ? size : MAX(cap, HLS_PREFETCH_CHUNK);
+
+      hts_mutex_lock(&hp->hp_mutex);
+      int r = hls_prefetch_reserve(hp, hps, more);
+      hts_mutex_unlock(&hp->hp_mutex);
+      if(r)
+        goto bad;
+
+      cap += more;
+      data = realloc(data, cap);
+    }
+
+    int r = fa_read(fh, data + len, cap - len);
+    if(r < 0) {
+      if(!cancellable_is_cancelled(hpw->hpw_cancellable))
+        HLS_TRACE(h, "Prefetch of %s failed -- Read error", hps->hps_url);
+      goto bad;
+    }
+    if(r == 0)
+      break;
+    len += r;
+
+    hts_mutex_lock(&hp->hp_mutex);
+    hp->hp_busy_bytes += r;
+    hts_mutex_unlock(&hp->hp_mutex);
+  }
+
+  fa_close(fh);
+  return buf_create_from_malloced(len, data);
+
+ bad:
+  fa_close(fh);
+  free(data);
+  return NULL;
+}
+
+
+/**
+ *
+ */
+static void *
+hls_prefetch_worker(void *aux)
+{
+  hls_prefetch_worker_t *hpw = aux;
+  hls_prefetch_t *hp = hpw->hpw_hp;
+  const hls_t *h = hp->hp_hd->hd_hls;
+  hls_prefetch_seg_t *hps;
+
+  hts_mutex_lock(&hp->hp_mutex);
+
+  while(!hp->hp_stop) {
+
+    TAILQ_FOREACH(hps, &hp->hp_segs, hps_link)
+      if(hps->hps_state == HPS_QUEUED)
+        break;
+
+    if(hps == NULL || (hps != TAILQ_FIRST(&hp->hp_segs) &&
+                       hp->hp_bytes >= HLS_PREFETCH_MEMORY)) {
+      hts_cond_wait(&hp->hp_cond, &hp->hp_mutex);
+      continue;
+    }
+
+    hps->hps_state = HPS_FETCHING;
+    hpw->hpw_seg = hps;
+    cancellable_reset(hpw->hpw_cancellable);
+
+    const int64_t start = arch_get_ts();
+    if(hp->hp_active++ == 0)
+      hp->hp_busy_start = start;
+
+    hts_mutex_unlock(&hp->hp_mutex);
+
+    buf_t *b = hls_prefetch_fetch(hp, hpw, hps);
+
+    hts_mutex_lock(&hp->hp_mutex);
+
+    const int64_t now = arch_get_ts();
+    hp->hp_active--;
+    hp->hp_busy_time += now - hp->hp_busy_start;
+    hp->hp_busy_start = now;
+
+    hpw->hpw_seg = NULL;
+
+    if(hps->hps_dropped) {
+      buf_release(b);
+      hls_prefetch_seg_destroy(hp, hps);
+
+    } else if(b == NULL) {
+      hps->hps_state = HPS_FAILED;
+
+    } else {
+      // Keep only what was actually used in the budget
+      hp->hp_bytes -= hps->hps_reserved - b->b_size;
+      hps->hps_reserved = b->b_size;
+
+      // Segments finishing at the same time share one measurement
+      if(hp->hp_busy_time > 1000) {
+        int64_t bw = 8000000LL * hp->hp_busy_bytes / hp->hp_busy_time;
+        hp->hp_bw = MIN(100000000, bw);
+        hp->hp_busy_time = 0;
+        hp->hp_busy_bytes = 0;
+      }
+      hps->hps_bw = hp->hp_bw;
+
+      hps->hps_buf = b;
+      hps->hps_state = HPS_DONE;
+      HLS_TRACE(h, "Prefetched sequence %d, %d bytes in %d ms, %d bps",
+                hps->hps_seq, (int)b->b_size, (int)((now - start) / 1000),
+                hps->hps_bw);
+    }
+    hts_cond_broadcast(&hp->hp_cond);
+  }
+
+  hts_mutex_unlock(&hp->hp_mutex);
+  return NULL;
+}
+
+
+/**
+ *
+ */
+static hls_prefetch_t *
+hls_prefetch_create(hls_demuxer_t *hd)
+{
+  hls_prefetch_t *hp = calloc(1, sizeof(hls_prefetch_t));
+  hp->hp_hd = hd;
+  hts_mutex_init(&hp->hp_mutex);
+  hts_cond_init(&hp->hp_cond, &hp->hp_mutex);
+  TAILQ_INIT(&hp->hp_segs);
+
+  for(int i = 0; i < HLS_PREFETCH_WORKERS; i++) {
+    hls_prefetch_worker_t *hpw = &hp->hp_workers[i];
+    hpw->hpw_hp = hp;
+    hpw->hpw_cancellable = cancellable_create();
+    hts_thread_create_joinable("hls prefetch", &hpw->hpw_thread,
+                               hls_prefetch_worker, hpw,
+                               THREAD_PRIO_FILESYSTEM);
+  }
+  return hp;
+}
+
+
+/**
+ * Queue the segments following 'hs' (which the demuxer just opened)
+ * and drop everything else
+ */
+void
+hls_prefetch_schedule(hls_demuxer_t *hd, const hls_segment_t *hs)
+{
+  const hls_variant_t *hv = hs->hs_variant;
+  hls_prefetch_seg_t *hps, *next;
+  const hls_segment_t *x;
+  int last = hs->hs_seq;
+  int i;
+
+  x = hs;
+  for(i = 0; i < HLS_PREFETCH_SEGMENTS; i++) {
+    x = TAILQ_NEXT(x, hs_link);
+    if(x == NULL)
+      break;
+    last = x->hs_seq;
+  }
+
+  if(i == 0 && hd->hd_prefetch == NULL)
+    return;
+
+  if(hd->hd_prefetch == NULL)
+    hd->hd_prefetch = hls_prefetch_create(hd);
+
+  hls_prefetch_t *hp = hd->hd_prefetch;
+
+  hts_mutex_lock(&hp->hp_mutex);
+
+  for(hps = TAILQ_FIRST(&hp->hp_segs); hps != NULL; hps = next) {
+    next = TAILQ_NEXT(hps, hps_link);
+    if(hps->hps_variant != hv || hps->hps_seq <= hs->hs_seq ||
+       hps->hps_seq > last)
+      hls_prefetch_seg_drop(hp, hps);
+  }
+
+  x = hs;
+  while((x = TAILQ_NEXT(x, hs_link)) != NULL && x->hs_seq <= last) {
+    if(x->hs_permanent_error || hls_prefetch_find(hp, hv, x->hs_seq))
+      continue;
+
+    hps = calloc(1, sizeof(hls_prefetch_seg_t));
+    hps->hps_variant = hv;
+    hps->hps_seq = x->hs_seq;
+    hps->hps_url = strdup(x->hs_url);
+    hps->hps_byte_offset = x->hs_byte_offset;
+    hps->hps_byte_size = x->hs_byte_size;
+    hps->hps_state = HPS_QUEUED;
+    TAILQ_INSERT_TAIL(&hp->hp_segs, hps, hps_link);
+    hts_cond_broadcast(&hp->hp_cond);
+  }
+
+  hts_mutex_unlock(&hp->hp_mutex);
+}
+
+
+/**
+ * Return the prefetched data for a segment, waiting for it if it's
+ * being downloaded. Returns NULL if the segment was not prefetched,
+ * failed or if the demuxer is cancelled, the caller should fetch it
+ * itself then. The segment is removed from the prefetcher in all cases
+ */
+buf_t *
+hls_prefetch_take(hls_demuxer_t *hd, const hls_segment_t *hs, int *bwp)
+{
+  hls_prefetch_t *hp = hd->hd_prefetch;
+  buf_t *b = NULL;
+
+  if(hp == NULL)
+    return NULL;
+
+  hts_mutex_lock(&hp->hp_mutex);
+
+  hls_prefetch_seg_t *hps = hls_prefetch_find(hp, hs->hs_variant, hs->hs_seq);
+
+  if(hps != NULL) {
+
+    while(hps->hps_state == HPS_FETCHING &&
+          !cancellable_is_cancelled(hd->hd_cancellable))
+      hts_cond_wait_timeout(&hp->hp_cond, &hp->hp_mutex, 100);
+
+    if(hps->hps_state == HPS_DONE) {
+      b = hps->hps_buf;
+      hps->hps_buf = NULL;
+      *bwp = hps->hps_bw;
+    }
+    hls_prefetch_seg_drop(hp, hps);
+  }
+
+  hts_mutex_unlock(&hp->hp_mutex);
+  return b;
+}
+
+
+/**
+ * Drop all segments not belonging to 'keep' (which may be NULL)
+ */
+void
+hls_prefetch_drop(hls_demuxer_t *hd, const hls_variant_t *keep)
+{
+  hls_prefetch_t *hp = hd->hd_prefetch;
+  hls_prefetch_seg_t *hps, *next;
+
+  if(hp == NULL)
+    return;
+
+  hts_mutex_lock(&hp->hp_mutex);
+  for(hps = TAILQ_FIRST(&hp->hp_segs); hps != NULL; hps = next) {
+    next = TAILQ_NEXT(hps, hps_link);
+    if(hps->hps_variant != keep)
+      hls_prefetch_seg_drop(hp, hps);
+  }
+  hts_mutex_unlock(&hp->hp_mutex);
+}
+
+
+/**
+ *
+ */
+void
+hls_prefetch_stop(hls_demuxer_t *hd)
+{
+  hls_prefetch_t *hp = hd->hd_prefetch;
+
+  if(hp == NULL)
+    return;
+
+  hls_prefetch_drop(hd, NULL);
+
+  hts_mutex_lock(&hp->hp_mutex);
+  hp->hp_stop = 1;
+  hts_cond_broadcast(&hp->hp_cond);
+  hts_mutex_unlock(&hp->hp_mutex);
+
+  for(int i = 0; i < HLS_PREFETCH_WORKERS; i++) {
+    hls_prefetch_worker_t *hpw = &hp->hp_workers[i];
+    hts_thread_join(&hpw->hpw_thread);
+    cancellable_release(hpw->hpw_cancellable);
+  }
+
+  assert(TAILQ_FIRST(&hp->hp_segs) == NULL);
+  hts_cond_destroy(&hp->hp_cond);
+  hts_mutex_destroy(&hp->hp_mutex);
+  free(hp);
+  hd->hd_prefetch = NULL;
+}
+
+
+#if ENABLE_BENCHMARKS
+/**
+ * Benchmark
+ *
+ * Runs a local HTTP server (see http_bench_server.h) that serves the
+ * segments of a variant after a fixed delay and caps the speed of every
+ * connection, as a distant CDN would. The segments are read in order
+ * the way the demuxer does, once fetching each segment when it's needed
+ * and once with the prefetcher. Playback of a segment starts when it
+ * has been read and lasts for its duration, the time playback would
+ * have been stalled waiting for the next segment is reported. All data
+ * is verified.
+ */
+#define HPFBENCH_SEGMENTS 16
+#define HPFBENCH_SEGSIZE  (512 * 1024)
+#define HPFBENCH_DURATION 500000
+#define HPFBENCH_LATENCY  250000
+#define HPFBENCH_BANDWIDTH (1536 * 1024)
+
+static uint8_t
+hpfbench_byte(int seq, int o)
+{
+  return seq * 31 + (o ^ (o >> 9));
+}
+
+
+static void
+hpfbench_content(const char *path, int64_t offset, uint8_t *buf, int len)
+{
+  int seq = 0;
+  sscanf(path, "/seg%d.ts", &seq);
+  for(int i = 0; i < len; i++)
+    buf[i] = hpfbench_byte(seq, offset + i);
+}
+
+
+static void
+hpfbench_run(const char *name, int port, int prefetch)
+{
+  hls_t *h = calloc(1, sizeof(hls_t));
+  hls_variant_t *hv = calloc(1, sizeof(hls_variant_t));
+  hls_segment_t *segs = calloc(HPFBENCH_SEGMENTS, sizeof(hls_segment_t));
+  hls_demuxer_t *hd = &h->h_primary;
+  int64_t playhead = 0, stalled = 0;
+  int errors = 0;
+
+  hd->hd_hls = h;
+  hd->hd_cancellable = cancellable_create();
+  hv->hv_demuxer = hd;
+  TAILQ_INIT(&hv->hv_segments);
+
+  for(int i = 0; i < HPFBENCH_SEGMENTS; i++) {
+    hls_segment_t *hs = &segs[i];
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/seg%d.ts", port, i);
+    hs->hs_url = strdup(url);
+    hs->hs_seq = i;
+    hs->hs_byte_offset = -1;
+    hs->hs_byte_size = -1;
+    hs->hs_variant = hv;
+    TAILQ_INSERT_TAIL(&hv->hv_segments, hs, hs_link);
+  }
+
+  const int64_t ts = arch_get_ts();
+
+  for(int i = 0; i < HPFBENCH_SEGMENTS; i++) {
+    hls_segment_t *hs = &segs[i];
+    buf_t *b = NULL;
+
+    if(prefetch)
+      b = hls_prefetch_take(hd, hs, &hs->hs_prefetch_bw);
+    if(b == NULL)
+      b = fa_load(hs->hs_url, NULL);
+    if(prefetch)
+      hls_prefetch_schedule(hd, hs);
+
+    const int64_t ready = arch_get_ts() - ts;
+    if(i == 0) {
+      playhead = ready;
+    } else if(ready > playhead) {
+      stalled += ready - playhead;
+      playhead = ready;
+    }
+    playhead += HPFBENCH_DURATION;
+
+    if(b == NULL || b->b_size != HPFBENCH_SEGSIZE) {
+      errors++;
+    } else {
+      const uint8_t *p = buf_c8(b);
+      for(int o = 0; o < HPFBENCH_SEGSIZE; o++) {
+        if(p[o] != hpfbench_byte(i, o)) {
+          errors++;
+          break;
+        }
+      }
+    }
+    buf_release(b);
+  }
+
+  const int64_t elapsed = arch_get_ts() - ts;
+
+  hls_prefetch_stop(hd);
+
+  printf("hls-prefetch: %-10s %d segments in %d ms, stalled %d ms%s\n",
+         name, HPFBENCH_SEGMENTS, (int)(elapsed / 1000),
+         (int)(stalled / 1000), errors ? "  VERIFY FAILED" : "");
+
+  for(int i = 0; i < HPFBENCH_SEGMENTS; i++)
+    free(segs[i].hs_url);
+  cancellable_release(hd->hd_cancellable);
+  free(segs);
+  free(hv);
+  free(h);
+}
+
+
+static void
+hpfbench(void)
+{
+  char errbuf[256];
+  http_bench_server_t bhs = {
+    .bhs_size      = HPFBENCH_SEGSIZE,
+    .bhs_latency   = HPFBENCH_LATENCY,
+    .bhs_bandwidth = HPFBENCH_BANDWIDTH,
+    .bhs_content   = hpfbench_content,
+  };
+
+  if(http_bench_server_start(&bhs, errbuf, sizeof(errbuf))) {
+    printf("hls-prefetch: Unable to start server -- %s\n", errbuf);
+    return;
+  }
+
+  printf("hls-prefetch: %d ms latency, %d kB/s per connection, "
+         "%d kB segments of %d ms\n",
+         HPFBENCH_LATENCY / 1000, HPFBENCH_BANDWIDTH / 1024,
+         HPFBENCH_SEGSIZE / 1024, HPFBENCH_DURATION / 1000);
+
+  hpfbench_run("sequential", bhs.bhs_port, 0);
+  hpfbench_run("prefetch", bhs.bhs_port, 1);
+
+  http_bench_server_stop(&bhs);
+}
+
+BENCHMARK("hls-prefetch", hpfbench);
+#endif
@@ -21,6 +21,7 @@
 #include <unistd.h>
 
 #include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
 #include <libavutil/mathematics.h>
 
 #include "fileaccess/fa_libav.h"
@@ -29,11 +30,25 @@
 #include "misc/minmax.h"
 #include "misc/str.h"
 #include "misc/bytestream.h"
+#include "fileaccess/fileaccess.h"
 
 #include "hls.h"
 
 #define PTS_MASK 0x1ffffffffLL
 
+/**
+ * PES payloads are assembled into refcounted buffers taken from pools
+ * of power-of-two sizes, picked from the PES length when the stream
+ * tells us and otherwise from the largest PES seen so far on the PID.
+ * Frames that the parser returns as a slice of such a buffer are
+ * passed on to the decoder by reference instead of being copied.
+ */
+#define TS_PES_POOLS    9     // 4kB to 1MB
+#define TS_PES_POOL_MIN 4096
+
+#define TD_BUF_SIZE  2048
+#define TS_READ_SIZE (TD_BUF_SIZE / 188 * 188) // Whole TS packets per read
+
 LIST_HEAD(ts_service_list, ts_service);
 LIST_HEAD(ts_es_list, ts_es);
 
@@ -62,9 +77,11 @@ typedef struct ts_demuxer {
     TD_MUX_MODE_RAW,
   } td_mux_mode;
 
-  uint8_t td_buf[2048];
+  uint8_t td_buf[TD_BUF_SIZE];
   int td_buf_bytes;
 
+  AVBufferPool *td_pes_pools[TS_PES_POOLS];
+
 } ts_demuxer_t;
 
 
@@ -81,9 +98,12 @@ typedef struct ts_es {
   LIST_ENTRY(ts_es) te_link;
   uint16_t te_pid;
 
-  uint8_t *te_buf;
-  int te_buf_size;
+  AVBufferRef *te_pes;
+  int te_pes_cap;      // Payload capacity of te_pes, excluding padding
+  int te_pes_max;      // Largest PES seen so far
   int te_packet_size;
+  char te_pes_aligned; // data_alignment_indicator of current PES
+  char te_split_frames;
 
   int te_data_type;
   int te_probe_frame;
@@ -135,7 +155,7 @@ static void
 te_destroy(ts_es_t *te)
 {
   LIST_REMOVE(te, te_link);
-  free(te->te_buf);
+  av_buffer_unref(&te->te_pes);
   if(te->te_codec != NULL)
     media_codec_deref(te->te_codec);
   free(te);
@@ -173,6 +193,10 @@ ts_demuxer_destroy(ts_demuxer_t *td)
 
   free(td->td_pat.tt_data);
 
+  // Buffers still referenced by queued packets are freed on last unref
+  for(int i = 0; i < TS_PES_POOLS; i++)
+    av_buffer_pool_uninit(&td->td_pes_pools[i]);
+
   free(td);
 }
 
@@ -508,6 +532,8 @@ parse_pes_header(ts_es_t *te, const uint8_t *buf, size_t len)
   if(len < hlen || (hdr & 0xc0) != 0x80)
     return -1;
 
+  te->te_pes_aligned = !!(hdr & 0x04);
+
   if((flags & 0xc0) == 0xc0) {
     if(hlen < 10)
       return -1;
@@ -598,8 +624,8 @@ probe_duration(ts_es_t *te, uint8_t *data, int size)
  *
  */
 static void
-enqueue_packet(ts_demuxer_t *td, const void *data, int len,
-               int64_t dts, int64_t pts, int keyframe,
+enqueue_packet(ts_demuxer_t *td, const uint8_t *data, int len,
+               AVBufferRef *buf, int64_t dts, int64_t pts, int keyframe,
                hls_segment_t *hs, int seq, ts_es_t *te,
                hls_demuxer_t *hd)
 {
@@ -688,8 +714,27 @@ enqueue_packet(ts_demuxer_t *td, const void *data, int len,
     }
   }
 
-  media_buf_t *mb = media_buf_alloc_unlocked(td->td_mp, len);
-  memcpy(mb->mb_data, data, len);
+  media_buf_t *mb;
+
+  /*
+   * If the frame is within the PES buffer just take a reference to it.
+   * The bytes following the frame (rest of the PES payload and the
+   * zeroed tail) are always there to cover for decoders reading past
+   * the end.
+   */
+  if(buf != NULL && data >= buf->data &&
+     data + len + FF_INPUT_BUFFER_PADDING_SIZE <= buf->data + buf->size) {
+    AVPacket pkt;
+    av_init_packet(&pkt);
+    pkt.buf  = buf;
+    pkt.data = (uint8_t *)data;
+    pkt.size = len;
+    mb = media_buf_from_avpkt_unlocked(td->td_mp, &pkt);
+  } else {
+    mb = media_buf_alloc_unlocked(td->td_mp, len);
+    memcpy(mb->mb_data, data, len);
+  }
+
   mb->mb_user_time = user_time;
   mb->mb_dts = dts;
   mb->mb_pts = pts;
@@ -721,7 +766,7 @@ enqueue_packet(ts_demuxer_t *td, const void *data, int len,
  */
 static void
 parse_data(ts_demuxer_t *td, hls_variant_t *hv, ts_es_t *te,
-           const uint8_t *data, int size)
+           const uint8_t *data, int size, AVBufferRef *buf)
 {
   media_codec_t *mc = te->te_codec;
 
@@ -765,7 +810,7 @@ parse_data(ts_demuxer_t *td, hls_variant_t *hv, ts_es_t *te,
       }
 
 
-      enqueue_packet(td, outbuf, outlen, dts, pts, keyframe, hs, seq, te,
+      enqueue_packet(td, outbuf, outlen, buf, dts, pts, keyframe, hs, seq, te,
                      td->td_hd);
     }
 
@@ -794,20 +839,47 @@ drain_parsers(ts_demuxer_t *td)
   while((te = LIST_FIRST(&td->td_elemtary_streams)) != NULL) {
 
     if(te->te_codec != NULL)
-      parse_data(td, NULL, te, NULL, 0);
+      parse_data(td, NULL, te, NULL, 0, NULL);
 
     te_destroy(te);
   }
 }
 
 
+/**
+ * HLS segmenters put one H.264 access unit in each video PES packet,
+ * flagged with data_alignment_indicator and starting with an access
+ * unit delimiter. As long as that holds the parser is told that it's
+ * fed complete frames, otherwise it will look for the start of the
+ * next frame before returning anything and copy every frame into a
+ * buffer of its own on the way. The first PES that breaks the pattern
+ * puts the stream back to normal parsing for good.
+ */
+static void
+check_complete_frames(ts_es_t *te, const uint8_t *data, int size)
+{
+  AVCodecParserContext *pc = te->te_codec->parser_ctx;
+
+  if(!te->te_split_frames && te->te_pes_aligned &&
+     te->te_codec->codec_id == AV_CODEC_ID_H264 && size >= 5 &&
+     ((rd32_be(data) == 1 && (data[4] & 0x1f) == 9) ||
+      ((rd32_be(data) >> 8) == 1 && (data[3] & 0x1f) == 9))) {
+    pc->flags |= PARSER_FLAG_COMPLETE_FRAMES;
+    return;
+  }
+
+  pc->flags &= ~PARSER_FLAG_COMPLETE_FRAMES;
+  te->te_split_frames = 1;
+}
+
+
 /**
  *
  */
 static void
 emit_packet(ts_es_t *te, ts_demuxer_t *td, hls_segment_t *hs)
 {
-  const uint8_t *data = te->te_buf;
+  const uint8_t *data = te->te_pes->data;
   int            size = te->te_packet_size;
 
   if(size < 9)
@@ -831,13 +903,70 @@ emit_packet(ts_es_t *te, ts_demuxer_t *td, hls_segment_t *hs)
   data += hlen;
   size -= hlen;
 
+  if(te->te_data_type == MB_VIDEO && te->te_codec != NULL)
+    check_complete_frames(te, data, size);
 
 #if 0 // Not in use
   if(te->te_data_type == MB_VIDEO && 0)
     parse_h264(td, te, data, size, hs, hv);
   else
 #endif
-    parse_data(td, hs->hs_variant, te, data, size);
+    parse_data(td, hs->hs_variant, te, data, size, te->te_pes);
+}
+
+
+/**
+ * Get a buffer for at least 'size' bytes of PES payload. The usable
+ * size (excluding padding) is returned in *capp
+ */
+static AVBufferRef *
+pes_buf_get(ts_demuxer_t *td, int size, int *capp)
+{
+  AVBufferRef *b;
+
+  size += FF_INPUT_BUFFER_PADDING_SIZE;
+
+  for(int i = 0; i < TS_PES_POOLS; i++) {
+    const int bs = TS_PES_POOL_MIN << i;
+    if(bs < size)
+      continue;
+
+    if(td->td_pes_pools[i] == NULL)
+      td->td_pes_pools[i] = av_buffer_pool_init(bs, NULL);
+
+    b = av_buffer_pool_get(td->td_pes_pools[i]);
+    *capp = bs - FF_INPUT_BUFFER_PADDING_SIZE;
+    return b;
+  }
+
+  b = av_buffer_alloc(size);
+  *capp = size - FF_INPUT_BUFFER_PADDING_SIZE;
+  return b;
+}
+
+
+/**
+ * Queued frames keep a reference to the PES buffer they came from but
+ * only their own size is accounted for in mp_buffer_current. Unbounded
+ * PES buffers are sized from the largest PES seen on the PID so when
+ * the payload turned out to be much smaller (P-frames after an I-frame)
+ * it's moved to a buffer that fits instead of pinning the large one
+ */
+static void
+pes_buf_trim(ts_demuxer_t *td, ts_es_t *te)
+{
+  if(te->te_packet_size + FF_INPUT_BUFFER_PADDING_SIZE >
+     te->te_pes->size / 2)
+    return;
+
+  int cap;
+  AVBufferRef *b = pes_buf_get(td, te->te_packet_size, &cap);
+  if(b == NULL)
+    return;
+  memcpy(b->data, te->te_pes->data, te->te_packet_size);
+  av_buffer_unref(&te->te_pes);
+  te->te_pes = b;
+  te->te_pes_cap = cap;
 }
 
 
@@ -852,26 +981,43 @@ process_es(ts_es_t *te, const uint8_t *tsb, ts_demuxer_t *td, hls_segment_t *hs)
   const uint8_t *data = tsb + off;
   int size            = 188 - off;
 
+  if(te->te_codec == NULL || size < 0)
+    return;
 
   if(pusi) {
-    if(te->te_buf != NULL)
-      memset(te->te_buf + te->te_packet_size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
-    emit_packet(te, td, hs);
+    if(te->te_pes != NULL) {
+      pes_buf_trim(td, te);
+      memset(te->te_pes->data + te->te_packet_size, 0,
+             FF_INPUT_BUFFER_PADDING_SIZE);
+      te->te_pes_max = MAX(te->te_pes_max, te->te_packet_size);
+      emit_packet(te, td, hs);
+      av_buffer_unref(&te->te_pes);
+    }
     te->te_packet_size = 0;
     te->te_current_seq = hs->hs_seq;
+
+    // PES_packet_length is zero (unbounded) for most video streams
+    int len = size >= 6 ? (data[4] << 8 | data[5]) : 0;
+    len = len ? len + 6 : MAX(te->te_pes_max, 188 * 8);
+    te->te_pes = pes_buf_get(td, len, &te->te_pes_cap);
   }
 
-  if(te->te_packet_size + size > te->te_buf_size) {
-    te->te_buf_size = te->te_buf_size * 2 + size;
-    te->te_buf = myreallocf(te->te_buf,
-                            te->te_buf_size + FF_INPUT_BUFFER_PADDING_SIZE);
-    if(te->te_buf == NULL) {
-      te->te_buf_size = 0;
+  if(te->te_pes == NULL)
+    return;
+
+  if(te->te_packet_size + size > te->te_pes_cap) {
+    int cap;
+    AVBufferRef *b = pes_buf_get(td, (te->te_packet_size + size) * 2, &cap);
+    if(b != NULL)
+      memcpy(b->data, te->te_pes->data, te->te_packet_size);
+    av_buffer_unref(&te->te_pes);
+    te->te_pes = b;
+    te->te_pes_cap = cap;
+    if(b == NULL)
       return;
-    }
   }
 
-  memcpy(te->te_buf + te->te_packet_size, data, size);
+  memcpy(te->te_pes->data + te->te_packet_size, data, size);
   te->te_packet_size += size;
 }
 
@@ -912,6 +1058,23 @@ process_tsb(ts_demuxer_t *td, const uint8_t *tsb, hls_segment_t *hs)
 
 
 
+/**
+ * Demux all complete TS packets in td_buf starting at 'offset'. A
+ * trailing partial packet is moved to the start of the buffer
+ */
+static void
+ts_input(ts_demuxer_t *td, int offset, hls_segment_t *hs)
+{
+  while(offset + 188 <= td->td_buf_bytes) {
+    process_tsb(td, td->td_buf + offset, hs);
+    offset += 188;
+  }
+
+  td->td_buf_bytes -= offset;
+  memmove(td->td_buf, td->td_buf + offset, td->td_buf_bytes);
+}
+
+
 /**
  *
  */
@@ -959,10 +1122,12 @@ hls_ts_demuxer_flush(hls_variant_t *hv)
     av_parser_close(mc->parser_ctx);
     mc->parser_ctx = av_parser_init(mc->codec_id);
 
+    av_buffer_unref(&te->te_pes);
     te->te_packet_size = 0;
     te->te_pts = PTS_UNSET;
     te->te_dts = PTS_UNSET;
     te->te_last_seq = 0;
+    te->te_split_frames = 0;
   }
   td_flush_packets(td);
 
@@ -981,7 +1146,7 @@ unmuxed_input(ts_demuxer_t *td, const uint8_t *buf, int len, hls_segment_t *hs)
 
   te->te_current_seq = hs->hs_seq;
 
-  parse_data(td, hs->hs_variant, te, buf, len);
+  parse_data(td, hs->hs_variant, te, buf, len, NULL);
 }
 
 
@@ -1237,16 +1402,7 @@ hls_ts_demuxer_read(hls_demuxer_t *hd)
         td->td_mux_mode = TD_MUX_MODE_TS;
         HLS_TRACE(h, "Variant %s is a transport stream", hv->hv_name);
 
-        while(i <= sizeof(td->td_buf) - 188) {
-          process_tsb(td, td->td_buf + i, hs);
-          i += 188;
-        }
-
-        int spill = sizeof(td->td_buf) - i;
-        assert(spill < 188);
-
-        td->td_buf_bytes = spill;
-        memmove(td->td_buf, td->td_buf + i, spill);
+        ts_input(td, i, hs);
         break;
       }
 
@@ -1288,7 +1444,7 @@ hls_ts_demuxer_read(hls_demuxer_t *hd)
       assert(td->td_buf_bytes < 188);
       r = fa_read(hs->hs_fh,
                   td->td_buf + td->td_buf_bytes,
-                  188 - td->td_buf_bytes);
+                  TS_READ_SIZE - td->td_buf_bytes);
 
       if(cancellable_is_cancelled(hd->hd_cancellable))
         return NULL;
@@ -1304,13 +1460,177 @@ hls_ts_demuxer_read(hls_demuxer_t *hd)
       td->td_buf_bytes += r;
       hd->hd_download_counter += r;
 
-      if(td->td_buf_bytes == 188) {
-        td->td_buf_bytes = 0;
-        process_tsb(td, td->td_buf, hs);
-      }
+      ts_input(td, 0, hs);
       break;
     }
   }
 
   return NULL;
 }
+
+
+/**
+ * Benchmark
+ *
+ * Demux a local transport stream file (given in HLS_TS_BENCH_FILE) as
+ * if it was a single HLS segment and report how many TS packets per
+ * second we get through and how much buffer memory the demuxed frames
+ * keep alive.
+ */
+#define TSBENCH_ROUNDS 3
+
+typedef struct tsbench_result {
+  int64_t time;
+  int tsbs;
+  int frames[2];
+  int64_t bytes;
+  int64_t held;          // Size of the buffers the frames keep alive
+  media_buf_t *last;
+} tsbench_result_t;
+
+
+static void
+tsbench_drain(ts_demuxer_t *td, tsbench_result_t *r)
+{
+  media_buf_t *mb;
+  while((mb = get_pkt(td)) != NULL) {
+    r->frames[mb->mb_data_type == MB_VIDEO]++;
+    r->bytes += mb->mb_size;
+
+    // Frames from the same PES are dequeued back to back. Keep the
+    // previous one around so its buffer can't be reused in between
+    if(mb->mb_pkt.buf == NULL)
+      r->held += mb->mb_size;
+    else if(r->last == NULL ||
+            r->last->mb_pkt.buf->data != mb->mb_pkt.buf->data)
+      r->held += mb->mb_pkt.buf->size;
+
+    if(r->last != NULL)
+      media_buf_free_unlocked(td->td_mp, r->last);
+    r->last = mb->mb_pkt.buf != NULL ? mb : NULL;
+    if(r->last == NULL)
+      media_buf_free_unlocked(td->td_mp, mb);
+  }
+}
+
+
+static void
+tsbench_run(hls_t *h, const uint8_t *data, int size, tsbench_result_t *r)
+{
+  hls_demuxer_t *hd = &h->h_primary;
+  hls_discontinuity_segment_t hds = {.hds_offset = PTS_UNSET};
+  hls_variant_t hv = {.hv_demuxer = hd, .hv_name = "bench"};
+  hls_segment_t hs = {
+    .hs_variant = &hv,
+    .hs_discontinuity_segment = &hds,
+    .hs_ts_offset = PTS_UNSET,
+  };
+
+  TAILQ_INIT(&hv.hv_segments);
+  TAILQ_INSERT_TAIL(&hv.hv_segments, &hs, hs_link);
+  hd->hd_last_dts = PTS_UNSET;
+
+  ts_demuxer_t *td = calloc(1, sizeof(ts_demuxer_t));
+  TAILQ_INIT(&td->td_packets);
+  td->td_mp = h->h_mp;
+  td->td_hd = hd;
+
+  memset(r, 0, sizeof(tsbench_result_t));
+
+  const int64_t ts = arch_get_ts();
+  for(int off = 0; off < size; ) {
+    const int len = MIN(TS_READ_SIZE - td->td_buf_bytes, size - off);
+    memcpy(td->td_buf + td->td_buf_bytes, data + off, len);
+    td->td_buf_bytes += len;
+    off += len;
+    ts_input(td, 0, &hs);
+    tsbench_drain(td, r);
+  }
+  drain_parsers(td);
+  tsbench_drain(td, r);
+  r->time = arch_get_ts() - ts;
+  if(r->last != NULL)
+    media_buf_free_unlocked(td->td_mp, r->last);
+  r->tsbs = size / 188;
+
+  ts_demuxer_destroy(td);
+}
+
+
+static void
+tsbench_report(const tsbench_result_t *r)
+{
+  printf("hls-ts: %d TS packets in %d ms, %d packets/s, %d Mbit/s, "
+         "%d video and %d audio frames, %"PRId64" bytes "
+         "in %"PRId64" bytes of buffers\n",
+         r->tsbs, (int)(r->time / 1000),
+         (int)(r->tsbs * 1000000LL / MAX(r->time, 1)),
+         (int)(r->tsbs * 188 * 8LL / MAX(r->time, 1)),
+         r->frames[1], r->frames[0], r->bytes, r->held);
+}
+
+
+static void
+ts_bench(void)
+{
+  char errbuf[256];
+  const char *path = getenv("HLS_TS_BENCH_FILE");
+
+  if(path == NULL) {
+    printf("hls-ts: Set HLS_TS_BENCH_FILE to the transport stream to demux\n");
+    return;
+  }
+
+  buf_t *b = fa_load(path, FA_LOAD_ERRBUF(errbuf, sizeof(errbuf)), NULL);
+  if(b == NULL) {
+    printf("hls-ts: Unable to load %s -- %s\n", path, errbuf);
+    return;
+  }
+
+  const uint8_t *data = buf_c8(b);
+  int size = buf_size(b);
+
+  // Sync on the first of three consecutive TS packets
+  int i;
+  for(i = 0; i + 188 * 2 < size; i++)
+    if(data[i] == 0x47 && data[i + 188] == 0x47 && data[i + 188 * 2] == 0x47)
+      break;
+
+  if(i + 188 * 2 >= size) {
+    printf("hls-ts: %s is not a transport stream\n", path);
+    buf_release(b);
+    return;
+  }
+  data += i;
+  size = (size - i) / 188 * 188;
+
+  media_pipe_t *mp = mp_create("hls-ts benchmark", 0);
+  mp->mp_video.mq_demuxer_flags |= HLS_QUEUE_KEYFRAME_SEEN;
+  mp->mp_audio.mq_demuxer_flags |= HLS_QUEUE_KEYFRAME_SEEN;
+
+  hls_t h;
+  memset(&h, 0, sizeof(h));
+  h.h_mp = mp;
+  h.h_primary.hd_hls = &h;
+  h.h_primary.hd_type = "primary";
+  h.h_codec_h264 = media_codec_create(AV_CODEC_ID_H264, 1, NULL, NULL, NULL,
+                                      mp);
+
+  tsbench_result_t best, r;
+
+  for(int round = 0; round < TSBENCH_ROUNDS; round++) {
+    tsbench_run(&h, data, size, &r);
+    if(round == 0 || r.time < best.time)
+      best = r;
+  }
+
+  tsbench_report(&best);
+
+  media_codec_deref(h.h_codec_h264);
+  hls_free_audio_tracks(&h);
+  mp_shutdown(mp);
+  mp_destroy(mp);
+  buf_release(b);
+}
+
+BENCHMARK("hls-ts", ts_bench);
@@ -22,6 +22,10 @@
 
 #include "misc/buf.h"
 
+/**
+ * Returned buffer may be shared with the cache, use buf_make_writable()
+ * before modifying it
+ */
 buf_t *blobcache_get(const char *key, const char *stash, int pad,
 		    int *is_expired, char **etag, time_t *mtime);
 
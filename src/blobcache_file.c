@@ -34,12 +34,14 @@
 #include "settings.h"
 #include "notifications.h"
 #include "misc/minmax.h"
+#include "misc/callout.h"
 #include "fileaccess/fileaccess.h"
 
 #define bcprintf(x...) // printf(x)
 
 // Flags
 
+#define BC2_MAGIC_08      0x62630208
 #define BC2_MAGIC_07      0x62630207
 #define BC2_MAGIC_06      0x62630206
 #define BC2_MAGIC_05      0x62630205
@@ -53,10 +55,17 @@ typedef struct blobcache_item {
   uint32_t bi_expiry;
   uint32_t bi_modtime;
   uint32_t bi_size;
+  uint32_t bi_segment; // 0 = Stored in a file of its own (or not yet stored)
+  uint32_t bi_offset;  // Offset in segment
   uint8_t bi_content_type_len;
   uint8_t bi_flags;
+  uint8_t bi_ram_pad;  // Zeroed bytes following payload in bi_ram
+  buf_t *bi_ram;       // Copy held by RAM tier, NULL if not resident
+  TAILQ_ENTRY(blobcache_item) bi_ram_link;
 } blobcache_item_t;
 
+TAILQ_HEAD(blobcache_item_queue, blobcache_item);
+
 typedef struct blobcache_diskitem_06 {
   uint64_t di_key_hash;
   uint64_t di_content_hash;
@@ -82,21 +91,83 @@ typedef struct blobcache_diskitem_07 {
   uint8_t di_etag[0];
 } __attribute__((packed)) blobcache_diskitem_07_t;
 
+typedef struct blobcache_diskitem_08 {
+  uint64_t di_key_hash;
+  uint64_t di_content_hash;
+  uint32_t di_lastaccess;
+  uint32_t di_expiry;
+  uint32_t di_modtime;
+  uint32_t di_size;
+  uint32_t di_segment;
+  uint32_t di_offset;
+  uint8_t di_flags;
+  uint8_t di_etaglen;
+  uint8_t di_content_type_len;
+  uint8_t di_etag[0];
+} __attribute__((packed)) blobcache_diskitem_08_t;
+
 
 TAILQ_HEAD(blobcache_flush_queue, blobcache_flush);
 
 typedef struct blobcache_flush {
   TAILQ_ENTRY(blobcache_flush) bf_link;
+  struct blobcache_flush *bf_hash_link;
   uint64_t bf_key_hash;
   buf_t *bf_buf;
 } blobcache_flush_t;
 
 
+/**
+ * The index is split into shards, each with its own lock and its own
+ * resizable hash table. The top bits of the key hash select shard and the
+ * low bits select bucket within the shard.
+ *
+ * Blobs that are queued for writing but not yet on disk are also hashed
+ * per shard so lookups never need to scan the flush queue.
+ *
+ * Lock order is shard lock -> cache_lock. cache_lock only protects the
+ * flush queue and the run state.
+ */
+#define BLOBCACHE_SHARDS       16
+#define BLOBCACHE_SHARD_SHIFT  60
+
+#define SHARD_INITIAL_BUCKETS  64
+#define SHARD_MAX_LOAD         2  // Average chain length before we grow
 
-#define ITEM_HASH_SIZE 256
-#define ITEM_HASH_MASK (ITEM_HASH_SIZE - 1)
+#define PENDING_HASH_SIZE      64
+#define PENDING_HASH_MASK      (PENDING_HASH_SIZE - 1)
 
-static blobcache_item_t *hashvector[ITEM_HASH_SIZE];
+/**
+ * RAM tier
+ *
+ * Recently read blobs are kept in memory in front of the disk tier so
+ * going back to a page does not hit the disk again. Each shard keeps its
+ * own LRU list and gets an equal share of the total budget. Hits hand out
+ * a reference to the cached buf_t, no copying is done.
+ */
+#if defined(PS3)
+#define BLOBCACHE_RAM_SIZE     (8 * 1024 * 1024)
+#else
+#define BLOBCACHE_RAM_SIZE     (32 * 1024 * 1024)
+#endif
+
+#define RAM_STATS_INTERVAL     2  // Seconds between prop updates
+
+typedef struct blobcache_shard {
+  hts_mutex_t bs_lock;
+  blobcache_item_t **bs_items;
+  unsigned int bs_mask;
+  unsigned int bs_count;
+  uint64_t bs_size;
+  blobcache_flush_t *bs_pending[PENDING_HASH_SIZE];
+
+  struct blobcache_item_queue bs_ram_lru; // Most recently used first
+  size_t bs_ram_size;
+  unsigned int bs_ram_hits;
+  unsigned int bs_ram_misses;
+} __attribute__((aligned(64))) blobcache_shard_t;
+
+static blobcache_shard_t cache_shards[BLOBCACHE_SHARDS];
 
 static struct blobcache_flush_queue flush_queue;
 
@@ -104,7 +175,7 @@ static pool_t *item_pool;
 static hts_mutex_t cache_lock;
 static hts_cond_t cache_cond;
 static hts_thread_t bcthread;
-static enum {
+static volatile enum {
   BLOBCACHE_RUN_BAD_CLOCK,
   BLOBCACHE_RUN,
   BLOBCACHE_STOPPING,
@@ -112,12 +183,298 @@ static enum {
 
 static int loaded_cache_is_from;
 
-static int index_dirty;
+// Per shard budget for RAM tier, 0 disables it
+static size_t ram_shard_budget = BLOBCACHE_RAM_SIZE / BLOBCACHE_SHARDS;
+
+static callout_t ram_stats_timer;
+static prop_t *ram_hits_prop;
+static prop_t *ram_misses_prop;
+static prop_t *ram_bytes_prop;
+
+
+/**
+ * Segment storage
+ *
+ * When enabled, blobs are appended to large segment files instead of
+ * being written to a file of their own. The index holds segment and offset
+ * for each item. Space occupied by overwritten or evicted blobs is
+ * reclaimed by compacting segments from the flush thread when it's idle.
+ *
+ * Both layouts can coexist so the mode can be switched at any time.
+ *
+ * Lock order is shard lock -> segment_lock
+ */
+#define SEGMENT_MAX_SIZE        (32 * 1024 * 1024)
+#define SEGMENT_COMPACT_MINSIZE (SEGMENT_MAX_SIZE / 4)
+
+typedef struct blobcache_segment {
+  LIST_ENTRY(blobcache_segment) sg_link;
+  uint32_t sg_id;
+  uint32_t sg_size;     // Bytes written to file
+  uint32_t sg_live;     // Bytes still referenced from the index
+  int sg_refcount;      // Readers currently using sg_fh
+  int sg_zombie;        // Removed, will be deleted when last reader is done
+  fa_handle_t *sg_fh;   // Shared read handle, only accessed with fa_pread()
+} blobcache_segment_t;
+
+static LIST_HEAD(, blobcache_segment) segments;
+static hts_mutex_t segment_lock;
+static uint32_t next_segment_id = 1;
+
+// Only accessed from flushthread
+static blobcache_segment_t *active_segment;
+static fa_handle_t *active_segment_fh;
+
+// Set from any shard, cleared by the flush thread when the index is saved
+static atomic_t index_dirty;
 
 #define BLOB_CACHE_MINSIZE   (10 * 1000 * 1000)
 #define BLOB_CACHE_MAXSIZE (1000 * 1000 * 1000)
 
-static uint64_t current_cache_size;
+
+/**
+ *
+ */
+static void
+shards_init(blobcache_shard_t *shards)
+{
+  for(int i = 0; i < BLOBCACHE_SHARDS; i++) {
+    blobcache_shard_t *bs = &shards[i];
+    hts_mutex_init(&bs->bs_lock);
+    bs->bs_mask = SHARD_INITIAL_BUCKETS - 1;
+    bs->bs_items = calloc(SHARD_INITIAL_BUCKETS, sizeof(blobcache_item_t *));
+    TAILQ_INIT(&bs->bs_ram_lru);
+  }
+}
+
+
+/**
+ *
+ */
+static void
+shards_lock_all(blobcache_shard_t *shards)
+{
+  for(int i = 0; i < BLOBCACHE_SHARDS; i++)
+    hts_mutex_lock(&shards[i].bs_lock);
+}
+
+
+/**
+ *
+ */
+static void
+shards_unlock_all(blobcache_shard_t *shards)
+{
+  for(int i = BLOBCACHE_SHARDS - 1; i >= 0; i--)
+    hts_mutex_unlock(&shards[i].bs_lock);
+}
+
+
+/**
+ *
+ */
+static inline blobcache_shard_t *
+shard_select(blobcache_shard_t *shards, uint64_t dk)
+{
+  return &shards[dk >> BLOBCACHE_SHARD_SHIFT];
+}
+
+
+/**
+ *
+ */
+static inline blobcache_shard_t *
+shard_for(uint64_t dk)
+{
+  return shard_select(cache_shards, dk);
+}
+
+
+/**
+ * Assume shard is locked
+ */
+static inline blobcache_item_t **
+shard_bucket(blobcache_shard_t *bs, uint64_t dk)
+{
+  return &bs->bs_items[dk & bs->bs_mask];
+}
+
+
+/**
+ * Assume shard is locked
+ */
+static blobcache_item_t *
+shard_lookup(blobcache_shard_t *bs, uint64_t dk)
+{
+  blobcache_item_t *p;
+  for(p = *shard_bucket(bs, dk); p != NULL; p = p->bi_link)
+    if(p->bi_key_hash == dk)
+      return p;
+  return NULL;
+}
+
+
+/**
+ * Double the number of buckets in shard
+ */
+static void
+shard_grow(blobcache_shard_t *bs)
+{
+  const unsigned int newsize = (bs->bs_mask + 1) * 2;
+  blobcache_item_t **v = calloc(newsize, sizeof(blobcache_item_t *));
+  blobcache_item_t *p, *n;
+
+  if(v == NULL)
+    return; // Just live with longer chains
+
+  for(unsigned int i = 0; i <= bs->bs_mask; i++) {
+    for(p = bs->bs_items[i]; p != NULL; p = n) {
+      n = p->bi_link;
+      p->bi_link = v[p->bi_key_hash & (newsize - 1)];
+      v[p->bi_key_hash & (newsize - 1)] = p;
+    }
+  }
+  free(bs->bs_items);
+  bs->bs_items = v;
+  bs->bs_mask = newsize - 1;
+}
+
+
+/**
+ * Assume shard is locked
+ */
+static void
+shard_insert(blobcache_shard_t *bs, blobcache_item_t *p)
+{
+  blobcache_item_t **b = shard_bucket(bs, p->bi_key_hash);
+  p->bi_link = *b;
+  *b = p;
+  bs->bs_count++;
+  bs->bs_size += p->bi_size;
+
+  if(bs->bs_count > (bs->bs_mask + 1) * SHARD_MAX_LOAD)
+    shard_grow(bs);
+}
+
+
+/**
+ * Unlink all items from shard and return them as a singly linked list
+ *
+ * Assume shard is locked
+ */
+static blobcache_item_t *
+shard_steal_all(blobcache_shard_t *bs)
+{
+  blobcache_item_t *r = NULL, *p, *n;
+
+  for(unsigned int i = 0; i <= bs->bs_mask; i++) {
+    for(p = bs->bs_items[i]; p != NULL; p = n) {
+      n = p->bi_link;
+      p->bi_link = r;
+      r = p;
+    }
+    bs->bs_items[i] = NULL;
+  }
+  bs->bs_count = 0;
+  bs->bs_size = 0;
+  return r;
+}
+
+
+/**
+ * Find most recently queued write for the given key
+ *
+ * Assume shard is locked
+ */
+static blobcache_flush_t *
+pending_find(blobcache_shard_t *bs, uint64_t dk)
+{
+  blobcache_flush_t *bf;
+  for(bf = bs->bs_pending[dk & PENDING_HASH_MASK]; bf != NULL;
+      bf = bf->bf_hash_link)
+    if(bf->bf_key_hash == dk)
+      return bf;
+  return NULL;
+}
+
+
+/**
+ * Assume shard is locked
+ */
+static void
+pending_remove(blobcache_shard_t *bs, blobcache_flush_t *bf)
+{
+  blobcache_flush_t **q = &bs->bs_pending[bf->bf_key_hash & PENDING_HASH_MASK];
+  for(; *q != NULL; q = &(*q)->bf_hash_link) {
+    if(*q == bf) {
+      *q = bf->bf_hash_link;
+      return;
+    }
+  }
+  abort();
+}
+
+
+/**
+ * Release RAM tier copy of item (if any)
+ *
+ * Assume shard is locked
+ */
+static void
+ram_drop(blobcache_shard_t *bs, blobcache_item_t *p)
+{
+  if(p->bi_ram == NULL)
+    return;
+
+  TAILQ_REMOVE(&bs->bs_ram_lru, p, bi_ram_link);
+  bs->bs_ram_size -= p->bi_ram->b_size;
+  buf_release(p->bi_ram);
+  p->bi_ram = NULL;
+}
+
+
+/**
+ * Make blob just read from disk resident in RAM tier
+ *
+ * Item might have been replaced or removed while we were reading so
+ * only insert if it still has the same content
+ */
+static void
+ram_insert(uint64_t dk, uint64_t content_hash, buf_t *b, int pad)
+{
+  blobcache_shard_t *bs = shard_for(dk);
+  blobcache_item_t *p;
+
+  if(b->b_size > ram_shard_budget / 2)
+    return;
+
+  hts_mutex_lock(&bs->bs_lock);
+  p = shard_lookup(bs, dk);
+  if(p != NULL && p->bi_ram == NULL && p->bi_content_hash == content_hash) {
+    p->bi_ram = buf_retain(b);
+    p->bi_ram_pad = pad;
+    TAILQ_INSERT_HEAD(&bs->bs_ram_lru, p, bi_ram_link);
+    bs->bs_ram_size += b->b_size;
+
+    while(bs->bs_ram_size > ram_shard_budget)
+      ram_drop(bs, TAILQ_LAST(&bs->bs_ram_lru, blobcache_item_queue));
+  }
+  hts_mutex_unlock(&bs->bs_lock);
+}
+
+
+/**
+ * Sum of all items sizes. Only approximate unless all shards are locked
+ */
+static uint64_t
+current_cache_size(void)
+{
+  uint64_t sum = 0;
+  for(int i = 0; i < BLOBCACHE_SHARDS; i++)
+    sum += cache_shards[i].bs_size;
+  return sum;
+}
+
 
 /**
  *
@@ -130,7 +487,7 @@ blobcache_compute_maxsize(void)
 
   snprintf(path, sizeof(path), "%s", gconf.cache_path);
   if(!fa_fsinfo(path, &ffi)) {
-    uint64_t avail = ffi.ffi_avail + current_cache_size;
+    uint64_t avail = ffi.ffi_avail + current_cache_size();
     avail = MAX(BLOB_CACHE_MINSIZE, MIN(avail / 10, BLOB_CACHE_MAXSIZE));
     return avail;
   }
@@ -182,6 +539,267 @@ make_filename(char *buf, size_t len, uint64_t hash, int for_write)
 }
 
 
+/**
+ *
+ */
+static void
+make_segment_filename(char *buf, size_t len, uint32_t id)
+{
+  snprintf(buf, len, "%s/bc2/seg/%08x.seg", gconf.cache_path, id);
+}
+
+
+/**
+ *
+ */
+static inline uint32_t
+item_record_len(const blobcache_item_t *p)
+{
+  return p->bi_size + p->bi_content_type_len;
+}
+
+
+/**
+ * Assume segment_lock is held
+ */
+static blobcache_segment_t *
+segment_find(uint32_t id)
+{
+  blobcache_segment_t *sg;
+  LIST_FOREACH(sg, &segments, sg_link)
+    if(sg->sg_id == id)
+      return sg;
+  return NULL;
+}
+
+
+/**
+ * Assume segment_lock is held
+ */
+static blobcache_segment_t *
+segment_create(uint32_t id)
+{
+  blobcache_segment_t *sg = calloc(1, sizeof(blobcache_segment_t));
+  sg->sg_id = id;
+  LIST_INSERT_HEAD(&segments, sg, sg_link);
+  if(id >= next_segment_id)
+    next_segment_id = id + 1;
+  return sg;
+}
+
+
+/**
+ *
+ */
+static void
+segment_free(blobcache_segment_t *sg)
+{
+  char filename[PATH_MAX];
+
+  if(sg->sg_fh != NULL)
+    fa_close(sg->sg_fh);
+  make_segment_filename(filename, sizeof(filename), sg->sg_id);
+  fa_unlink(filename, NULL, 0);
+  free(sg);
+}
+
+
+/**
+ * Assume segment_lock is held
+ */
+static void
+segment_destroy(blobcache_segment_t *sg)
+{
+  LIST_REMOVE(sg, sg_link);
+  sg->sg_zombie = 1;
+  if(sg->sg_refcount == 0)
+    segment_free(sg);
+}
+
+
+/**
+ *
+ */
+static void
+segment_add_live(uint32_t id, uint32_t len)
+{
+  hts_mutex_lock(&segment_lock);
+  blobcache_segment_t *sg = segment_find(id);
+  if(sg != NULL)
+    sg->sg_live += len;
+  hts_mutex_unlock(&segment_lock);
+}
+
+
+/**
+ * A record in segment is no longer referenced
+ */
+static void
+segment_release(uint32_t id, uint32_t len)
+{
+  hts_mutex_lock(&segment_lock);
+  blobcache_segment_t *sg = segment_find(id);
+  if(sg != NULL) {
+    sg->sg_live -= MIN(len, sg->sg_live);
+    if(sg->sg_live == 0 && sg != active_segment)
+      segment_destroy(sg);
+  }
+  hts_mutex_unlock(&segment_lock);
+}
+
+
+/**
+ * Read a record from a segment with a single positional read
+ */
+static int
+segment_read(uint32_t id, uint32_t offset, void *buf, size_t len)
+{
+  char filename[PATH_MAX];
+  fa_handle_t *fh;
+  int r = -1;
+
+  hts_mutex_lock(&segment_lock);
+  blobcache_segment_t *sg = segment_find(id);
+  if(sg == NULL || (uint64_t)offset + len > sg->sg_size) {
+    hts_mutex_unlock(&segment_lock);
+    return -1;
+  }
+
+  if(sg->sg_fh == NULL) {
+    make_segment_filename(filename, sizeof(filename), id);
+    sg->sg_fh = fa_open(filename, NULL, 0);
+    if(sg->sg_fh == NULL) {
+      hts_mutex_unlock(&segment_lock);
+      return -1;
+    }
+  }
+  sg->sg_refcount++;
+  fh = sg->sg_fh;
+  hts_mutex_unlock(&segment_lock);
+
+  if(fa_pread(fh, buf, len, offset) == len)
+    r = 0;
+
+  hts_mutex_lock(&segment_lock);
+  sg->sg_refcount--;
+  if(sg->sg_zombie && sg->sg_refcount == 0)
+    segment_free(sg);
+  hts_mutex_unlock(&segment_lock);
+  return r;
+}
+
+
+/**
+ * Close current segment for writing and start a new one
+ *
+ * Only called from flushthread
+ */
+static void
+segment_rotate(void)
+{
+  char filename[PATH_MAX];
+
+  if(active_segment_fh != NULL) {
+    fa_close(active_segment_fh);
+    active_segment_fh = NULL;
+  }
+
+  hts_mutex_lock(&segment_lock);
+  blobcache_segment_t *old = active_segment;
+  active_segment = segment_create(next_segment_id);
+  if(old != NULL && old->sg_live == 0)
+    segment_destroy(old);
+  hts_mutex_unlock(&segment_lock);
+
+  snprintf(filename, sizeof(filename), "%s/bc2/seg", gconf.cache_path);
+  fa_makedir(filename);
+  make_segment_filename(filename, sizeof(filename), active_segment->sg_id);
+  active_segment_fh = fa_open_ex(filename, NULL, 0, FA_WRITE, NULL);
+}
+
+
+/**
+ * Append a record to the active segment. Returns segment id or 0 on error
+ *
+ * Only called from flushthread
+ */
+static uint32_t
+segment_append(const void *ct, size_t ctlen, const void *data, size_t len,
+               uint32_t *offsetp)
+{
+  if(active_segment == NULL ||
+     active_segment->sg_size + ctlen + len > SEGMENT_MAX_SIZE)
+    segment_rotate();
+
+  if(active_segment_fh == NULL)
+    return 0;
+
+  if((ctlen && fa_write(active_segment_fh, ct, ctlen) != ctlen) ||
+     fa_write(active_segment_fh, data, len) != len) {
+    // We don't know how much was written, start over in a fresh segment
+    fa_close(active_segment_fh);
+    active_segment_fh = NULL;
+    hts_mutex_lock(&segment_lock);
+    active_segment->sg_size = SEGMENT_MAX_SIZE;
+    hts_mutex_unlock(&segment_lock);
+    return 0;
+  }
+
+  hts_mutex_lock(&segment_lock);
+  *offsetp = active_segment->sg_size;
+  active_segment->sg_size += ctlen + len;
+  hts_mutex_unlock(&segment_lock);
+  return active_segment->sg_id;
+}
+
+
+/**
+ * Scan segment directory on startup. Assumes index is loaded.
+ */
+static void
+segments_scan(void)
+{
+  char path[PATH_MAX];
+  fa_dir_t *fd;
+  fa_dir_entry_t *fde;
+  blobcache_segment_t *sg;
+  unsigned int id;
+
+  snprintf(path, sizeof(path), "%s/bc2/seg", gconf.cache_path);
+
+  if((fd = fa_scandir(path, NULL, 0)) != NULL) {
+    RB_FOREACH(fde, &fd->fd_entries, fde_link) {
+      const char *fname = rstr_get(fde->fde_filename);
+      if(sscanf(fname, "%08x.seg", &id) != 1)
+        continue;
+
+      hts_mutex_lock(&segment_lock);
+      if(id >= next_segment_id)
+        next_segment_id = id + 1;
+
+      sg = segment_find(id);
+      if(sg == NULL || sg->sg_live == 0) {
+        if(sg != NULL)
+          segment_destroy(sg);
+        snprintf(path, sizeof(path), "%s/bc2/seg/%s", gconf.cache_path, fname);
+        fa_unlink(path, NULL, 0);
+      } else if(!fa_dir_entry_stat(fde)) {
+        sg->sg_size = fde->fde_stat.fs_size;
+      }
+      hts_mutex_unlock(&segment_lock);
+    }
+    fa_dir_free(fd);
+  }
+
+  int cnt = 0;
+  LIST_FOREACH(sg, &segments, sg_link)
+    cnt++;
+
+  if(cnt)
+    TRACE(TRACE_DEBUG, "blobcache", "%d segment files in use", cnt);
+}
+
+
 /**
  *
  */
@@ -192,13 +810,17 @@ save_index(void)
   char filename[PATH_MAX];
   uint8_t *out, *base;
   int i;
+  unsigned int j;
   blobcache_item_t *p;
-  blobcache_diskitem_07_t *di;
+  blobcache_diskitem_08_t *di;
   size_t siz;
 
-  if(!index_dirty)
+  if(!atomic_get(&index_dirty))
     return;
 
+  // Clear before we snapshot so we don't lose updates done while writing
+  atomic_set(&index_dirty, 0);
+
   snprintf(filename, sizeof(filename), "%s/bc2/index.dat", gconf.cache_path);
 
   fa_handle_t *fh = fa_open_ex(filename, errbuf, sizeof(errbuf),
@@ -206,53 +828,67 @@ save_index(void)
   if(fh == NULL) {
     TRACE(TRACE_ERROR, "blobcache", "Unable to write index %s -- %s",
           filename, errbuf);
+    atomic_set(&index_dirty, 1);
     return;
   }
 
+  shards_lock_all(cache_shards);
+
   int items = 0;
   siz = 12 + 20;
 
-  for(i = 0; i < ITEM_HASH_SIZE; i++) {
-    for(p = hashvector[i]; p != NULL; p = p->bi_link) {
-      siz += sizeof(blobcache_diskitem_07_t);
-      siz += p->bi_etag ? strlen(p->bi_etag) : 0;
-      items++;
+  for(i = 0; i < BLOBCACHE_SHARDS; i++) {
+    const blobcache_shard_t *bs = &cache_shards[i];
+    for(j = 0; j <= bs->bs_mask; j++) {
+      for(p = bs->bs_items[j]; p != NULL; p = p->bi_link) {
+        siz += sizeof(blobcache_diskitem_08_t);
+        siz += p->bi_etag ? strlen(p->bi_etag) : 0;
+        items++;
+      }
     }
   }
 
   base = out = mymalloc(siz);
   if(out == NULL) {
+    shards_unlock_all(cache_shards);
     fa_close(fh);
+    atomic_set(&index_dirty, 1);
     return;
   }
-  *(uint32_t *)out = BC2_MAGIC_07;
+  *(uint32_t *)out = BC2_MAGIC_08;
   out += 4;
   *(uint32_t *)out = items;
   out += 4;
   *(uint32_t *)out = time(NULL);
   out += 4;
-  for(i = 0; i < ITEM_HASH_SIZE; i++) {
-    for(p = hashvector[i]; p != NULL; p = p->bi_link) {
-      const int etaglen = p->bi_etag ? strlen(p->bi_etag) : 0;
-      di = (blobcache_diskitem_07_t *)out;
-      di->di_key_hash     = p->bi_key_hash;
-      di->di_content_hash = p->bi_content_hash;
-      di->di_lastaccess   = p->bi_lastaccess;
-      di->di_expiry       = p->bi_expiry;
-      di->di_modtime      = p->bi_modtime;
-      di->di_size         = p->bi_size;
-      di->di_flags        = p->bi_flags;
-      di->di_etaglen      = etaglen;
-      di->di_content_type_len = p->bi_content_type_len;
-      out += sizeof(blobcache_diskitem_07_t);
-      if(etaglen) {
-	memcpy(out, p->bi_etag, etaglen);
-	out += etaglen;
+  for(i = 0; i < BLOBCACHE_SHARDS; i++) {
+    const blobcache_shard_t *bs = &cache_shards[i];
+    for(j = 0; j <= bs->bs_mask; j++) {
+      for(p = bs->bs_items[j]; p != NULL; p = p->bi_link) {
+        const int etaglen = p->bi_etag ? strlen(p->bi_etag) : 0;
+        di = (blobcache_diskitem_08_t *)out;
+        di->di_key_hash     = p->bi_key_hash;
+        di->di_content_hash = p->bi_content_hash;
+        di->di_lastaccess   = p->bi_lastaccess;
+        di->di_expiry       = p->bi_expiry;
+        di->di_modtime      = p->bi_modtime;
+        di->di_size         = p->bi_size;
+        di->di_segment      = p->bi_segment;
+        di->di_offset       = p->bi_offset;
+        di->di_flags        = p->bi_flags;
+        di->di_etaglen      = etaglen;
+        di->di_content_type_len = p->bi_content_type_len;
+        out += sizeof(blobcache_diskitem_08_t);
+        if(etaglen) {
+          memcpy(out, p->bi_etag, etaglen);
+          out += etaglen;
+        }
       }
-
     }
   }
 
+  shards_unlock_all(cache_shards);
+
   sha1_decl(shactx);
   sha1_init(shactx);
   sha1_update(shactx, base, siz - 20);
@@ -261,8 +897,7 @@ save_index(void)
   if(fa_write(fh, base, siz) != siz) {
     TRACE(TRACE_INFO, "blobcache", "Unable to store index file %s -- %s",
 	  filename, strerror(errno));
-  } else {
-    index_dirty = 0;
+    atomic_set(&index_dirty, 1);
   }
 
   free(base);
@@ -271,7 +906,7 @@ save_index(void)
 
 
 /**
- *
+ * Called before flushthread is started so no locking is needed
  */
 static void
 load_index(void)
@@ -337,6 +972,7 @@ load_index(void)
     TRACE(TRACE_INFO, "blobcache", "Upgrading from older format 0x%08x", magic);
     // FALLTHRU
   case BC2_MAGIC_07:
+  case BC2_MAGIC_08:
     loaded_cache_is_from = *(uint32_t *)in;
     in += 4;
     break;
@@ -354,6 +990,7 @@ load_index(void)
 
   for(i = 0; i < items; i++) {
     p = pool_get(item_pool);
+    p->bi_ram = NULL;
     int etaglen;
 
     switch(magic) {
@@ -369,6 +1006,8 @@ load_index(void)
       p->bi_size             = di->di_size;
       p->bi_content_type_len = di->di_content_type_len;
       p->bi_flags            = 0;
+      p->bi_segment          = 0;
+      p->bi_offset           = 0;
       etaglen                = di->di_etaglen;
       in += sizeof(blobcache_diskitem_06_t);
     }
@@ -385,10 +1024,30 @@ load_index(void)
       p->bi_size             = di->di_size;
       p->bi_content_type_len = di->di_content_type_len;
       p->bi_flags            = di->di_flags;
+      p->bi_segment          = 0;
+      p->bi_offset           = 0;
       etaglen                = di->di_etaglen;
       in += sizeof(blobcache_diskitem_07_t);
     }
       break;
+
+    case BC2_MAGIC_08: {
+      const blobcache_diskitem_08_t *di = (blobcache_diskitem_08_t *)in;
+
+      p->bi_key_hash         = di->di_key_hash;
+      p->bi_content_hash     = di->di_content_hash;
+      p->bi_lastaccess       = di->di_lastaccess;
+      p->bi_expiry           = di->di_expiry;
+      p->bi_modtime          = di->di_modtime;
+      p->bi_size             = di->di_size;
+      p->bi_content_type_len = di->di_content_type_len;
+      p->bi_flags            = di->di_flags;
+      p->bi_segment          = di->di_segment;
+      p->bi_offset           = di->di_offset;
+      etaglen                = di->di_etaglen;
+      in += sizeof(blobcache_diskitem_08_t);
+    }
+      break;
     default:
       abort(); // Prevent compilers whining about etaglen not initialized
     }
@@ -401,9 +1060,14 @@ load_index(void)
     } else {
       p->bi_etag = NULL;
     }
-    p->bi_link = hashvector[p->bi_key_hash & ITEM_HASH_MASK];
-    hashvector[p->bi_key_hash & ITEM_HASH_MASK] = p;
-    current_cache_size += p->bi_size;
+    shard_insert(shard_for(p->bi_key_hash), p);
+
+    if(p->bi_segment) {
+      blobcache_segment_t *sg = segment_find(p->bi_segment);
+      if(sg == NULL)
+        sg = segment_create(p->bi_segment);
+      sg->sg_live += item_record_len(p);
+    }
   }
   free(base);
 }
@@ -420,6 +1084,7 @@ blobcache_put(const char *key, const char *stash, buf_t *b,
   uint64_t dk = digest_key(key, stash);
   uint64_t dc = digest_content(b->b_ptr, b->b_size);
   uint32_t now = time(NULL);
+  blobcache_shard_t *bs = shard_for(dk);
   blobcache_item_t *p;
 
   if(etag != NULL && strlen(etag) > 255)
@@ -427,19 +1092,16 @@ blobcache_put(const char *key, const char *stash, buf_t *b,
 
   bcprintf("cache: Writing %s ... ", key);
 
-  hts_mutex_lock(&cache_lock);
   if(bcstate != BLOBCACHE_RUN) {
     bcprintf("Cache not running\n");
-    hts_mutex_unlock(&cache_lock);
     return 0;
   }
 
-  for(p = hashvector[dk & ITEM_HASH_MASK]; p != NULL; p = p->bi_link)
-    if(p->bi_key_hash == dk)
-      break;
+  hts_mutex_lock(&bs->bs_lock);
 
-  hts_cond_signal(&cache_cond);
-  index_dirty = 1;
+  p = shard_lookup(bs, dk);
+
+  atomic_set(&index_dirty, 1);
 
   if(p != NULL && p->bi_content_hash == dc && p->bi_size == b->b_size) {
     p->bi_modtime = mtime;
@@ -447,8 +1109,13 @@ blobcache_put(const char *key, const char *stash, buf_t *b,
     p->bi_lastaccess = now;
     p->bi_flags = flags;
     mystrset(&p->bi_etag, etag);
-    hts_mutex_unlock(&cache_lock);
+    hts_mutex_unlock(&bs->bs_lock);
     bcprintf("Already in\n");
+
+    // Wakeup flush thread so the updated index gets saved
+    hts_mutex_lock(&cache_lock);
+    hts_cond_signal(&cache_cond);
+    hts_mutex_unlock(&cache_lock);
     return 1;
   }
 
@@ -457,17 +1124,31 @@ blobcache_put(const char *key, const char *stash, buf_t *b,
   blobcache_flush_t *bf = pool_get(item_pool);
   bf->bf_key_hash = dk;
   bf->bf_buf = buf_retain(b);
+  bf->bf_hash_link = bs->bs_pending[dk & PENDING_HASH_MASK];
+  bs->bs_pending[dk & PENDING_HASH_MASK] = bf;
+
+  hts_mutex_lock(&cache_lock);
   TAILQ_INSERT_TAIL(&flush_queue, bf, bf_link);
   hts_cond_signal(&cache_cond);
+  hts_mutex_unlock(&cache_lock);
 
   if(p == NULL) {
     p = pool_get(item_pool);
     p->bi_key_hash = dk;
     p->bi_size = 0;
     p->bi_content_type_len = 0;
-    p->bi_link = hashvector[dk & ITEM_HASH_MASK];
     p->bi_etag = NULL;
-    hashvector[dk & ITEM_HASH_MASK] = p;
+    p->bi_segment = 0;
+    p->bi_ram = NULL;
+    shard_insert(bs, p);
+  } else {
+    ram_drop(bs, p);
+
+    if(p->bi_segment) {
+      // Old copy in segment is garbage now, new location is set when flushed
+      segment_release(p->bi_segment, item_record_len(p));
+      p->bi_segment = 0;
+    }
   }
 
   int64_t expiry = (int64_t)maxage + now;
@@ -477,17 +1158,46 @@ blobcache_put(const char *key, const char *stash, buf_t *b,
   p->bi_expiry = MIN(INT32_MAX, expiry);
   p->bi_lastaccess = now;
   p->bi_content_hash = dc;
-  current_cache_size -= p->bi_size;
+  bs->bs_size -= p->bi_size;
   p->bi_size = b->b_size;
-  current_cache_size += p->bi_size;
+  bs->bs_size += p->bi_size;
   p->bi_content_type_len = b->b_content_type ?
     strlen(rstr_get(b->b_content_type)) : 0;
   p->bi_flags = flags;
-  hts_mutex_unlock(&cache_lock);
+  hts_mutex_unlock(&bs->bs_lock);
   return 0;
 }
 
 
+/**
+ * Remove item if it still refers to the given segment location
+ */
+static void
+drop_segment_item(uint64_t dk, uint32_t segment, uint32_t offset)
+{
+  blobcache_shard_t *bs = shard_for(dk);
+  blobcache_item_t *p, **q;
+
+  hts_mutex_lock(&bs->bs_lock);
+  for(q = shard_bucket(bs, dk); (p = *q) != NULL; q = &p->bi_link) {
+    if(p->bi_key_hash == dk) {
+      if(p->bi_segment == segment && p->bi_offset == offset) {
+        *q = p->bi_link;
+        bs->bs_count--;
+        bs->bs_size -= p->bi_size;
+        ram_drop(bs, p);
+        segment_release(segment, item_record_len(p));
+        free(p->bi_etag);
+        pool_put(item_pool, p);
+        atomic_set(&index_dirty, 1);
+      }
+      break;
+    }
+  }
+  hts_mutex_unlock(&bs->bs_lock);
+}
+
+
 /**
  *
  */
@@ -496,26 +1206,27 @@ blobcache_get(const char *key, const char *stash, int pad,
 	      int *ignore_expiry, char **etagp, time_t *mtimep)
 {
   uint64_t dk = digest_key(key, stash);
+  blobcache_shard_t *bs = shard_for(dk);
   blobcache_item_t *p, **q;
   char filename[PATH_MAX];
   uint32_t now;
 
   bcprintf("cache: Reading %s ... ", key);
 
-  hts_mutex_lock(&cache_lock);
+  hts_mutex_lock(&bs->bs_lock);
 
   if(bcstate == BLOBCACHE_STOPPING) {
     bcprintf("Cache stopped ... ");
     p = NULL;
   } else {
-    for(q = &hashvector[dk & ITEM_HASH_MASK]; (p = *q); q = &p->bi_link)
+    for(q = shard_bucket(bs, dk); (p = *q); q = &p->bi_link)
       if(p->bi_key_hash == dk)
 	break;
   }
 
   if(p == NULL) {
     bcprintf("Item not found\n");
-    hts_mutex_unlock(&cache_lock);
+    hts_mutex_unlock(&bs->bs_lock);
     return NULL;
   }
 
@@ -532,25 +1243,36 @@ blobcache_get(const char *key, const char *stash, int pad,
   if(expired && ignore_expiry == NULL)
     goto bad;
 
-  blobcache_flush_t *bf;
   buf_t *b = NULL;
   fa_handle_t *fh = NULL;
-  TAILQ_FOREACH_REVERSE(bf, &flush_queue, blobcache_flush_queue, bf_link) {
-    if(bf->bf_key_hash == p->bi_key_hash) {
-      // Item is not yet written to disk
-      b = buf_retain(bf->bf_buf);
-      break;
-    }
+  blobcache_flush_t *bf;
+
+  if(p->bi_ram != NULL && p->bi_ram_pad >= pad) {
+    b = buf_retain(p->bi_ram);
+    TAILQ_REMOVE(&bs->bs_ram_lru, p, bi_ram_link);
+    TAILQ_INSERT_HEAD(&bs->bs_ram_lru, p, bi_ram_link);
+    bs->bs_ram_hits++;
+  } else if((bf = pending_find(bs, dk)) != NULL) {
+    // Item is not yet written to disk
+    b = buf_retain(bf->bf_buf);
+  } else {
+    bs->bs_ram_misses++;
   }
 
-  if(b == NULL) {
+  if(b == NULL && p->bi_segment == 0) {
     make_filename(filename, sizeof(filename), p->bi_key_hash, 0);
     fh = fa_open(filename, NULL, 0);
     if(fh == NULL) {
     bad:
       *q = p->bi_link;
+      bs->bs_count--;
+      bs->bs_size -= p->bi_size;
+      ram_drop(bs, p);
+      if(p->bi_segment)
+        segment_release(p->bi_segment, item_record_len(p));
+      free(p->bi_etag);
       pool_put(item_pool, p);
-      hts_mutex_unlock(&cache_lock);
+      hts_mutex_unlock(&bs->bs_lock);
       return NULL;
     }
 
@@ -572,39 +1294,70 @@ blobcache_get(const char *key, const char *stash, int pad,
   if(bcstate == BLOBCACHE_RUN)
     p->bi_lastaccess = now;
 
-  index_dirty = 1; // We don't deem it important enough to wakeup on get
+  // We don't deem it important enough to wakeup on get
+  atomic_set(&index_dirty, 1);
 
   if(ignore_expiry != NULL)
     *ignore_expiry = expired;
 
-  hts_mutex_unlock(&cache_lock);
+  // Item may go away as soon as we unlock
+  const uint32_t size = p->bi_size;
+  const int content_type_len = p->bi_content_type_len;
+  const uint32_t segment = p->bi_segment;
+  const uint32_t offset = p->bi_offset;
+  const uint64_t content_hash = p->bi_content_hash;
+
+  hts_mutex_unlock(&bs->bs_lock);
 
-  if(b == NULL) {
+  if(b == NULL && segment) {
 
-    b = buf_create(p->bi_size + pad);
+    b = buf_create(content_type_len + size + pad);
+    if(b == NULL)
+      return NULL;
+
+    if(segment_read(segment, offset, b->b_ptr, content_type_len + size) ||
+       digest_content(b->b_ptr + content_type_len, size) != content_hash) {
+      buf_release(b);
+      drop_segment_item(dk, segment, offset);
+      return NULL;
+    }
+
+    if(content_type_len)
+      b->b_content_type = rstr_allocl(b->b_ptr, content_type_len);
+    b->b_ptr += content_type_len;
+    b->b_size = size;
+    memset(b->b_ptr + size, 0, pad);
+
+  } else if(b == NULL) {
+
+    b = buf_create(size + pad);
     if(b == NULL) {
       fa_close(fh);
       return NULL;
     }
-    b->b_size = p->bi_size; // Get rid of padding in reported length
-    if(p->bi_content_type_len) {
-      b->b_content_type = rstr_allocl(NULL, p->bi_content_type_len);
-      if(fa_read(fh, rstr_data(b->b_content_type), p->bi_content_type_len) !=
-	 p->bi_content_type_len) {
+    b->b_size = size; // Get rid of padding in reported length
+    if(content_type_len) {
+      b->b_content_type = rstr_allocl(NULL, content_type_len);
+      if(fa_read(fh, rstr_data(b->b_content_type), content_type_len) !=
+	 content_type_len) {
 	buf_release(b);
 	fa_close(fh);
 	return NULL;
       }
     }
 
-    if(fa_read(fh, b->b_ptr, p->bi_size) != p->bi_size) {
+    if(fa_read(fh, b->b_ptr, size) != size) {
       buf_release(b);
       fa_close(fh);
       return NULL;
     }
-    memset(b->b_ptr + p->bi_size, 0, pad);
+    memset(b->b_ptr + size, 0, pad);
     fa_close(fh);
+  } else {
+    return b;
   }
+
+  ram_insert(dk, content_hash, b, pad);
   return b;
 }
 
@@ -620,16 +1373,15 @@ blobcache_get_meta(const char *key, const char *stash,
 		   char **etagp, time_t *mtimep)
 {
   uint64_t dk = digest_key(key, stash);
+  blobcache_shard_t *bs = shard_for(dk);
   blobcache_item_t *p;
   int r;
-  hts_mutex_lock(&cache_lock);
+  hts_mutex_lock(&bs->bs_lock);
 
   if(bcstate == BLOBCACHE_STOPPING) {
     p = NULL;
   } else {
-    for(p = hashvector[dk & ITEM_HASH_MASK]; p != NULL; p = p->bi_link)
-      if(p->bi_key_hash == dk)
-	break;
+    p = shard_lookup(bs, dk);
   }
 
   if(p != NULL) {
@@ -645,22 +1397,23 @@ blobcache_get_meta(const char *key, const char *stash,
     r = -1;
   }
 
-  hts_mutex_unlock(&cache_lock);
+  hts_mutex_unlock(&bs->bs_lock);
   return r;
 }
 
 
 /**
- * Assume we're locked
+ * Return true if item exists and is stored in a file of its own
  */
-static blobcache_item_t *
-lookup_item(uint64_t dk)
+static int
+item_has_file(uint64_t dk)
 {
-  blobcache_item_t *p;
-  for(p = hashvector[dk & ITEM_HASH_MASK]; p != NULL; p = p->bi_link)
-    if(p->bi_key_hash == dk)
-      return p;
-  return NULL;
+  blobcache_shard_t *bs = shard_for(dk);
+  hts_mutex_lock(&bs->bs_lock);
+  const blobcache_item_t *p = shard_lookup(bs, dk);
+  int r = p != NULL && p->bi_segment == 0;
+  hts_mutex_unlock(&bs->bs_lock);
+  return r;
 }
 
 /**
@@ -683,7 +1436,7 @@ prune_stale(void)
 
   RB_FOREACH(de1, &d1->fd_entries, fde_link) {
     const char *n1 = rstr_get(de1->fde_filename);
-    if(n1[0] != '.') {
+    if(n1[0] != '.' && strcmp(n1, "seg")) {
       snprintf(path2, sizeof(path2), "%s/bc2/%s",
 	       gconf.cache_path, n1);
 
@@ -696,14 +1449,10 @@ prune_stale(void)
 	    snprintf(path3, sizeof(path3), "%s/bc2/%s/%s",
 		     gconf.cache_path, n1, n2);
 
-            hts_mutex_lock(&cache_lock);
-
-	    if(sscanf(n2, "%016"PRIx64, &k) != 1 ||
-	       lookup_item(k) == NULL) {
+	    if(sscanf(n2, "%016"PRIx64, &k) != 1 || !item_has_file(k)) {
 	      TRACE(TRACE_DEBUG, "blobcache", "Removed stale file %s", path3);
 	      fa_unlink(path3, NULL, 0);
 	    }
-            hts_mutex_unlock(&cache_lock);
 	  }
 	}
         fa_dir_free(d2);
@@ -723,8 +1472,14 @@ static void
 prune_item(blobcache_item_t *p)
 {
   char filename[PATH_MAX];
-  make_filename(filename, sizeof(filename), p->bi_key_hash, 0);
-  fa_unlink(filename, NULL, 0);
+
+  if(p->bi_segment) {
+    segment_release(p->bi_segment, item_record_len(p));
+  } else {
+    make_filename(filename, sizeof(filename), p->bi_key_hash, 0);
+    fa_unlink(filename, NULL, 0);
+  }
+  free(p->bi_etag);
   pool_put(item_pool, p);
 }
 
@@ -737,22 +1492,28 @@ void
 blobcache_evict(const char *key, const char *stash)
 {
   uint64_t dk = digest_key(key, stash);
+  blobcache_shard_t *bs = shard_for(dk);
+  blobcache_item_t *p = NULL, **q;
 
-  hts_mutex_lock(&cache_lock);
+  hts_mutex_lock(&bs->bs_lock);
   if(bcstate == BLOBCACHE_RUN) {
-    blobcache_item_t *p, **q;
-    q = &hashvector[dk & ITEM_HASH_MASK];
+    q = shard_bucket(bs, dk);
     while((p = *q) != NULL) {
       if(p->bi_key_hash == dk) {
-        current_cache_size -= p->bi_size;
+        bs->bs_size -= p->bi_size;
+        bs->bs_count--;
         *q = p->bi_link;
-        prune_item(p);
+        ram_drop(bs, p);
+        atomic_set(&index_dirty, 1);
         break;
       }
       q = &p->bi_link;
     }
   }
-  hts_mutex_unlock(&cache_lock);
+  hts_mutex_unlock(&bs->bs_lock);
+
+  if(p != NULL)
+    prune_item(p);
 }
 
 
@@ -781,41 +1542,48 @@ accesstimecmp(const void *A, const void *B)
 static void
 prune_to_size(uint64_t maxsize)
 {
-  int i, tot = 0, j = 0;
-  blobcache_item_t *p, **sv;
+  int i, tot = 0, j = 0, victims;
+  uint64_t size = 0;
+  blobcache_item_t *p, *n, **sv;
+
+  shards_lock_all(cache_shards);
 
-  for(i = 0; i < ITEM_HASH_SIZE; i++)
-    for(p = hashvector[i]; p != NULL; p = p->bi_link)
-      tot++;
+  for(i = 0; i < BLOBCACHE_SHARDS; i++)
+    tot += cache_shards[i].bs_count;
 
   sv = malloc(sizeof(blobcache_item_t *) * tot);
-  current_cache_size = 0;
-  for(i = 0; i < ITEM_HASH_SIZE; i++) {
-    for(p = hashvector[i]; p != NULL; p = p->bi_link) {
+  for(i = 0; i < BLOBCACHE_SHARDS; i++) {
+    for(p = shard_steal_all(&cache_shards[i]); p != NULL; p = n) {
+      n = p->bi_link;
       sv[j++] = p;
-      current_cache_size += p->bi_size;
+      size += p->bi_size;
     }
-    hashvector[i] = NULL;
   }
 
   assert(j == tot);
 
   qsort(sv, j, sizeof(blobcache_item_t *), accesstimecmp);
   for(i = 0; i < j; i++) {
-    p = sv[i];
-    if(current_cache_size < maxsize)
+    if(size < maxsize)
       break;
-    current_cache_size -= p->bi_size;
-    prune_item(p);
-    index_dirty = 1;
+    size -= sv[i]->bi_size;
+    ram_drop(shard_for(sv[i]->bi_key_hash), sv[i]);
+    atomic_set(&index_dirty, 1);
   }
 
+  victims = i;
+
   for(; i < j; i++) {
     p = sv[i];
-    p->bi_link = hashvector[p->bi_key_hash & ITEM_HASH_MASK];
-    hashvector[p->bi_key_hash & ITEM_HASH_MASK] = p;
+    shard_insert(shard_for(p->bi_key_hash), p);
   }
 
+  shards_unlock_all(cache_shards);
+
+  // Unlinking files may be slow, don't hold any locks while doing it
+  for(i = 0; i < victims; i++)
+    prune_item(sv[i]);
+
   free(sv);
   save_index();
 }
@@ -849,26 +1617,220 @@ static void
 cache_clear(void *opaque, prop_event_t event, ...)
 {
   int i;
-  blobcache_item_t *p, *n;
+  blobcache_item_t *p, *n, *all = NULL;
 
-  hts_mutex_lock(&cache_lock);
+  shards_lock_all(cache_shards);
 
-  for(i = 0; i < ITEM_HASH_SIZE; i++) {
-    for(p = hashvector[i]; p != NULL; p = n) {
+  for(i = 0; i < BLOBCACHE_SHARDS; i++) {
+    for(p = shard_steal_all(&cache_shards[i]); p != NULL; p = n) {
       n = p->bi_link;
-      prune_item(p);
-      index_dirty = 1;
+      ram_drop(&cache_shards[i], p);
+      p->bi_link = all;
+      all = p;
     }
-    hashvector[i] = NULL;
   }
-  current_cache_size = 0;
+  atomic_set(&index_dirty, 1);
+  shards_unlock_all(cache_shards);
+
+  for(p = all; p != NULL; p = n) {
+    n = p->bi_link;
+    prune_item(p);
+  }
   save_index();
-  hts_mutex_unlock(&cache_lock);
   notify_add(NULL, NOTIFY_INFO, NULL, 3, _("Cache cleared"));
 }
 
 
 
+/**
+ *
+ */
+static void
+flush_to_file(blobcache_flush_t *bf)
+{
+  char filename[PATH_MAX];
+  make_filename(filename, sizeof(filename), bf->bf_key_hash, 1);
+  buf_t *b = bf->bf_buf;
+
+  fa_handle_t *fh = fa_open_ex(filename, NULL, 0, FA_WRITE, NULL);
+  if(fh != NULL) {
+
+    if(b->b_content_type != NULL) {
+      const char *str = rstr_get(b->b_content_type);
+      size_t len = strlen(str);
+      if(fa_write(fh, str, len) != len)
+        fa_unlink(filename, NULL, 0);
+    }
+
+    if(fa_write(fh, b->b_ptr, b->b_size) != b->b_size)
+      fa_unlink(filename, NULL, 0);
+
+    fa_close(fh);
+  }
+}
+
+
+/**
+ *
+ */
+static void
+flush_to_segment(blobcache_flush_t *bf)
+{
+  buf_t *b = bf->bf_buf;
+  const char *ct = b->b_content_type ? rstr_get(b->b_content_type) : NULL;
+  const size_t ctlen = ct ? strlen(ct) : 0;
+  uint32_t offset;
+
+  uint32_t segment = segment_append(ct, ctlen, b->b_ptr, b->b_size, &offset);
+  if(segment == 0)
+    return;
+
+  blobcache_shard_t *bs = shard_for(bf->bf_key_hash);
+  hts_mutex_lock(&bs->bs_lock);
+  blobcache_item_t *p = shard_lookup(bs, bf->bf_key_hash);
+
+  // If a newer version is queued we just leave this copy as garbage
+  if(p != NULL && p->bi_segment == 0 &&
+     pending_find(bs, bf->bf_key_hash) == bf) {
+    p->bi_segment = segment;
+    p->bi_offset = offset;
+    segment_add_live(segment, ctlen + b->b_size);
+  }
+  hts_mutex_unlock(&bs->bs_lock);
+}
+
+
+/**
+ * Find the segment with most garbage, if it's worth compacting
+ */
+static uint32_t
+segment_pick_for_compaction(void)
+{
+  blobcache_segment_t *sg;
+  uint32_t id = 0;
+  double best = 0.5; // At least half of segment must be garbage
+
+  hts_mutex_lock(&segment_lock);
+  LIST_FOREACH(sg, &segments, sg_link) {
+    if(sg == active_segment || sg->sg_size < SEGMENT_COMPACT_MINSIZE)
+      continue;
+    const double live = (double)sg->sg_live / sg->sg_size;
+    if(live < best) {
+      best = live;
+      id = sg->sg_id;
+    }
+  }
+  hts_mutex_unlock(&segment_lock);
+  return id;
+}
+
+
+typedef struct compact_item {
+  uint64_t ci_key_hash;
+  uint32_t ci_offset;
+  uint32_t ci_len;
+} compact_item_t;
+
+
+/**
+ * Move all live records out of a segment and into the active one.
+ * The old segment is deleted when its last live record is released.
+ *
+ * Only called from flushthread. Returns 1 if interrupted by other work
+ * and -1 on errors
+ */
+static int
+segment_compact(uint32_t id)
+{
+  compact_item_t *v = NULL;
+  int cnt = 0, capacity = 0, moved = 0, i, r = 0;
+  unsigned int j;
+  blobcache_item_t *p;
+
+  for(i = 0; i < BLOBCACHE_SHARDS; i++) {
+    blobcache_shard_t *bs = &cache_shards[i];
+    hts_mutex_lock(&bs->bs_lock);
+    for(j = 0; j <= bs->bs_mask; j++) {
+      for(p = bs->bs_items[j]; p != NULL; p = p->bi_link) {
+        if(p->bi_segment != id)
+          continue;
+        if(cnt == capacity) {
+          capacity = MAX(64, capacity * 2);
+          v = realloc(v, capacity * sizeof(compact_item_t));
+        }
+        v[cnt].ci_key_hash = p->bi_key_hash;
+        v[cnt].ci_offset = p->bi_offset;
+        v[cnt].ci_len = item_record_len(p);
+        cnt++;
+      }
+    }
+    hts_mutex_unlock(&bs->bs_lock);
+  }
+
+  for(i = 0; i < cnt; i++) {
+    const compact_item_t *ci = &v[i];
+
+    hts_mutex_lock(&cache_lock);
+    const int busy = bcstate == BLOBCACHE_STOPPING ||
+      TAILQ_FIRST(&flush_queue) != NULL;
+    hts_mutex_unlock(&cache_lock);
+    if(busy) {
+      r = 1;
+      break;
+    }
+
+    void *data = malloc(ci->ci_len);
+    if(data == NULL) {
+      r = -1;
+      break;
+    }
+
+    if(segment_read(id, ci->ci_offset, data, ci->ci_len)) {
+      free(data);
+      drop_segment_item(ci->ci_key_hash, id, ci->ci_offset);
+      continue;
+    }
+
+    uint32_t offset;
+    uint32_t segment = segment_append(NULL, 0, data, ci->ci_len, &offset);
+    free(data);
+    if(segment == 0) {
+      r = -1;
+      break;
+    }
+
+    blobcache_shard_t *bs = shard_for(ci->ci_key_hash);
+    hts_mutex_lock(&bs->bs_lock);
+    p = shard_lookup(bs, ci->ci_key_hash);
+    if(p != NULL && p->bi_segment == id && p->bi_offset == ci->ci_offset) {
+      p->bi_segment = segment;
+      p->bi_offset = offset;
+      segment_add_live(segment, ci->ci_len);
+      segment_release(id, ci->ci_len);
+      atomic_set(&index_dirty, 1);
+      moved++;
+    }
+    hts_mutex_unlock(&bs->bs_lock);
+  }
+
+  free(v);
+
+  if(r)
+    return r;
+
+  TRACE(TRACE_DEBUG, "blobcache", "Compacted segment %08x, moved %d of %d items",
+        id, moved, cnt);
+
+  // Nothing can refer to the segment anymore, make sure it's gone
+  hts_mutex_lock(&segment_lock);
+  blobcache_segment_t *sg = segment_find(id);
+  if(sg != NULL)
+    segment_destroy(sg);
+  hts_mutex_unlock(&segment_lock);
+  return 0;
+}
+
+
 /**
  *
  */
@@ -876,6 +1838,7 @@ static void *
 flushthread(void *aux)
 {
   blobcache_flush_t *bf;
+  uint32_t compact_id;
 
   sleep(3);
 
@@ -883,15 +1846,16 @@ flushthread(void *aux)
 
   uint64_t maxsize = blobcache_compute_maxsize();
 
-  hts_mutex_lock(&cache_lock);
   prune_to_size(maxsize);
 
   TRACE(TRACE_INFO, "blobcache",
 	"Initialized: %d items consuming %.2f MB "
         "(out of maximum %.2f MB) on disk in %s/bc2",
-	pool_num(item_pool), current_cache_size / 1000000.0,
+	pool_num(item_pool), current_cache_size() / 1000000.0,
         maxsize / 1000000.0, gconf.cache_path);
 
+  hts_mutex_lock(&cache_lock);
+
   // First make sure clock is valid
   while(bcstate == BLOBCACHE_RUN_BAD_CLOCK) {
     time_t now;
@@ -910,9 +1874,20 @@ flushthread(void *aux)
 
     if((bf = TAILQ_FIRST(&flush_queue)) == NULL) {
 
-      if(index_dirty) {
-        if(hts_cond_wait_timeout(&cache_cond, &cache_lock, 5000))
+      if((compact_id = segment_pick_for_compaction()) != 0) {
+        hts_mutex_unlock(&cache_lock);
+        const int r = segment_compact(compact_id);
+        hts_mutex_lock(&cache_lock);
+        if(r >= 0)
+          continue;
+      }
+
+      if(atomic_get(&index_dirty)) {
+        if(hts_cond_wait_timeout(&cache_cond, &cache_lock, 5000)) {
+          hts_mutex_unlock(&cache_lock);
           save_index();
+          hts_mutex_lock(&cache_lock);
+        }
       } else {
         hts_cond_wait(&cache_cond, &cache_lock);
       }
@@ -920,45 +1895,73 @@ flushthread(void *aux)
     }
 
     hts_mutex_unlock(&cache_lock);
-    char filename[PATH_MAX];
-    make_filename(filename, sizeof(filename), bf->bf_key_hash, 1);
-    buf_t *b = bf->bf_buf;
-
-    fa_handle_t *fh = fa_open_ex(filename, NULL, 0, FA_WRITE, NULL);
-    if(fh != NULL) {
-
-      if(b->b_content_type != NULL) {
-	const char *str = rstr_get(b->b_content_type);
-	size_t len = strlen(str);
-	if(fa_write(fh, str, len) != len)
-	  fa_unlink(filename, NULL, 0);
-      }
 
-      if(fa_write(fh, b->b_ptr, b->b_size) != b->b_size)
-        fa_unlink(filename, NULL, 0);
+    if(gconf.enable_blobcache_segments)
+      flush_to_segment(bf);
+    else
+      flush_to_file(bf);
 
-      fa_close(fh);
-    }
-    hts_mutex_lock(&cache_lock);
+    blobcache_shard_t *bs = shard_for(bf->bf_key_hash);
+    hts_mutex_lock(&bs->bs_lock);
+    pending_remove(bs, bf);
+    hts_mutex_unlock(&bs->bs_lock);
 
+    hts_mutex_lock(&cache_lock);
     assert(TAILQ_FIRST(&flush_queue) == bf);
     TAILQ_REMOVE(&flush_queue, bf, bf_link);
+    hts_mutex_unlock(&cache_lock);
+
     buf_release(bf->bf_buf);
     pool_put(item_pool, bf);
 
     uint64_t maxsize = blobcache_compute_maxsize();
 
-    if(maxsize < current_cache_size)
+    if(maxsize < current_cache_size())
       prune_to_size(maxsize);
+
+    hts_mutex_lock(&cache_lock);
   }
-  save_index();
   hts_mutex_unlock(&cache_lock);
+  save_index();
+
+  if(active_segment_fh != NULL) {
+    fa_close(active_segment_fh);
+    active_segment_fh = NULL;
+  }
   return NULL;
 }
 
 static_assert(sizeof(blobcache_flush_t) <= sizeof(blobcache_item_t),
               "blobcache_flush too big");
 
+
+/**
+ * Publish RAM tier counters. Values are read without locking so they
+ * are only approximate
+ */
+static void
+ram_stats_update(callout_t *c, void *aux)
+{
+  unsigned int hits = 0, misses = 0;
+  size_t bytes = 0;
+
+  for(int i = 0; i < BLOBCACHE_SHARDS; i++) {
+    const blobcache_shard_t *bs = &cache_shards[i];
+    hits   += bs->bs_ram_hits;
+    misses += bs->bs_ram_misses;
+    bytes  += bs->bs_ram_size;
+  }
+
+  prop_set_int(ram_hits_prop, hits);
+  prop_set_int(ram_misses_prop, misses);
+  prop_set_int(ram_bytes_prop, bytes);
+
+  if(bcstate != BLOBCACHE_STOPPING)
+    callout_arm(&ram_stats_timer, ram_stats_update, NULL, RAM_STATS_INTERVAL);
+}
+
+
+
 /**
  *
  */
@@ -979,16 +1982,29 @@ blobcache_init(void)
 
   hts_mutex_init(&cache_lock);
   hts_cond_init(&cache_cond, &cache_lock);
+  hts_mutex_init(&segment_lock);
+  shards_init(cache_shards);
   item_pool = pool_create("blobcacheitems", sizeof(blobcache_item_t), 0);
 
 
   load_index();
 
+  segments_scan();
 
   prop_t *dir = setting_get_dir("general:resets");
   settings_create_action(dir, _p("Clear cached files"),
 			 cache_clear, NULL, 0, NULL);
 
+  ram_hits_prop   = prop_create_root(NULL);
+  ram_misses_prop = prop_create_root(NULL);
+  ram_bytes_prop  = prop_create_root(NULL);
+
+  settings_create_separator(dir, _p("Memory cache"));
+  settings_create_bound_string(dir, _p("Hits"), ram_hits_prop);
+  settings_create_bound_string(dir, _p("Misses"), ram_misses_prop);
+  settings_create_bound_string(dir, _p("Bytes in memory"), ram_bytes_prop);
+  ram_stats_update(NULL, NULL);
+
   hts_thread_create_joinable("blobcache", &bcthread, flushthread, NULL,
                              THREAD_PRIO_BGTASK);
 }
@@ -1002,4 +2018,352 @@ blobcache_fini(void)
   hts_cond_signal(&cache_cond);
   hts_mutex_unlock(&cache_lock);
   hts_thread_join(&bcthread);
+  callout_disarm(&ram_stats_timer);
+}
+
+
+/**
+ * Index benchmark
+ *
+ * Populates a private set of shards with synthetic items and measures
+ * lookup throughput with an increasing number of threads. Disk is never
+ * touched so this only measures the index and its locking.
+ */
+#define BENCH_ITEMS              100000
+#define BENCH_LOOKUPS_PER_THREAD 2000000
+
+static blobcache_shard_t bench_shards[BLOBCACHE_SHARDS];
+
+typedef struct bench_thread {
+  hts_thread_t bt_tid;
+  uint32_t bt_seed;
+  int bt_hits;
+} bench_thread_t;
+
+static uint64_t
+bench_key(uint64_t x)
+{
+  // splitmix64 finalizer, spreads keys like the SHA-1 based key digest
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+
+static void *
+bench_lookup_thread(void *aux)
+{
+  bench_thread_t *bt = aux;
+  uint32_t seed = bt->bt_seed;
+  int hits = 0;
+
+  for(int i = 0; i < BENCH_LOOKUPS_PER_THREAD; i++) {
+    seed = seed * 1664525 + 1013904223;
+    const uint64_t dk = bench_key(seed % BENCH_ITEMS);
+    blobcache_shard_t *bs = shard_select(bench_shards, dk);
+    hts_mutex_lock(&bs->bs_lock);
+    blobcache_item_t *p = shard_lookup(bs, dk);
+    if(p != NULL) {
+      p->bi_lastaccess = i;
+      hits++;
+    }
+    hts_mutex_unlock(&bs->bs_lock);
+  }
+  bt->bt_hits = hits;
+  return NULL;
+}
+
+
+static void
+blobcache_bench(void)
+{
+  bench_thread_t bt[64];
+  blobcache_item_t *p, *n;
+
+  shards_init(bench_shards);
+
+  int64_t ts = arch_get_ts();
+  for(int i = 0; i < BENCH_ITEMS; i++) {
+    p = calloc(1, sizeof(blobcache_item_t));
+    p->bi_key_hash = bench_key(i);
+    p->bi_size = 1000;
+    shard_insert(shard_select(bench_shards, p->bi_key_hash), p);
+  }
+  ts = arch_get_ts() - ts;
+
+  printf("blobcache: Inserted %d items in %d ms, %d buckets/shard\n",
+         BENCH_ITEMS, (int)(ts / 1000), bench_shards[0].bs_mask + 1);
+
+  const int max_threads = MIN(64, MAX(2, gconf.concurrency * 2));
+  double base = 0;
+
+  for(int threads = 1; threads <= max_threads; threads *= 2) {
+    int64_t hits = 0;
+
+    ts = arch_get_ts();
+    for(int i = 0; i < threads; i++) {
+      bt[i].bt_seed = i * 2654435761U + 1;
+      hts_thread_create_joinable("bcbench", &bt[i].bt_tid, bench_lookup_thread,
+                                 &bt[i], THREAD_PRIO_BGTASK);
+    }
+
+    for(int i = 0; i < threads; i++) {
+      hts_thread_join(&bt[i].bt_tid);
+      hits += bt[i].bt_hits;
+    }
+    ts = arch_get_ts() - ts;
+
+    const double lookups = (double)threads * BENCH_LOOKUPS_PER_THREAD;
+    const double rate = lookups / (ts / 1000000.0);
+    if(threads == 1)
+      base = rate;
+
+    printf("blobcache: %2d threads: %10.0f lookups/s (%.2fx)%s\n",
+           threads, rate, rate / base,
+           hits == lookups ? "" : " (lookups failed!)");
+  }
+
+  for(int i = 0; i < BLOBCACHE_SHARDS; i++) {
+    for(p = shard_steal_all(&bench_shards[i]); p != NULL; p = n) {
+      n = p->bi_link;
+      free(p);
+    }
+  }
+}
+
+BENCHMARK("blobcache-index", blobcache_bench);
+
+
+/**
+ * Storage layout benchmark
+ *
+ * Writes the same set of blobs through the regular put/get API, first
+ * with one file per blob and then packed in segment files, and reports
+ * hit latency and disk usage for both. The blobs are evicted afterwards.
+ */
+#define SEGBENCH_ITEMS  4000
+#define SEGBENCH_HITS   40000
+#define SEGBENCH_STASH  "blobcache-bench"
+#define SEGBENCH_BLOCK  4096 // Assumed filesystem allocation unit
+
+
+/**
+ * Store 'items' pseudo random blobs named segbench:0 and up and wait
+ * for all of them to reach the disk
+ */
+static void
+segbench_fill(int items, int maxsize)
+{
+  char key[64];
+
+  for(int i = 0; i < items; i++) {
+    const int size = 500 + bench_key(i) % maxsize;
+    buf_t *b = buf_create(size);
+    for(int j = 0; j < size; j += 8) {
+      uint64_t v = bench_key(i * 65536 + j);
+      memcpy(b->b_ptr + j, &v, MIN(8, size - j));
+    }
+    b->b_content_type = rstr_alloc("image/jpeg");
+    snprintf(key, sizeof(key), "segbench:%d", i);
+    blobcache_put(key, SEGBENCH_STASH, b, 3600, NULL, 0, 0);
+    buf_release(b);
+  }
+
+  while(1) {
+    hts_mutex_lock(&cache_lock);
+    const int done = TAILQ_FIRST(&flush_queue) == NULL;
+    hts_mutex_unlock(&cache_lock);
+    if(done)
+      break;
+    usleep(10000);
+  }
+}
+
+
+/**
+ *
+ */
+static void
+segbench_evict(int items)
+{
+  char key[64];
+
+  for(int i = 0; i < items; i++) {
+    snprintf(key, sizeof(key), "segbench:%d", i);
+    blobcache_evict(key, SEGBENCH_STASH);
+  }
+}
+
+
+/**
+ *
+ */
+static int
+segbench_wait_for_run(void)
+{
+  for(int i = 0; i < 100 && bcstate != BLOBCACHE_RUN; i++)
+    usleep(100000);
+
+  if(bcstate != BLOBCACHE_RUN) {
+    printf("blobcache: Cache not accepting writes, check system clock\n");
+    return -1;
+  }
+  return 0;
+}
+
+
+static void
+segbench_run(int use_segments)
+{
+  char key[64];
+  char filename[PATH_MAX];
+  uint32_t seen_segments[256];
+  int num_segments = 0, files = 0, hits = 0;
+  uint64_t payload = 0, allocated = 0;
+  int64_t maxlat = 0;
+  fa_stat_t st;
+
+  gconf.enable_blobcache_segments = use_segments;
+
+  segbench_fill(SEGBENCH_ITEMS, 30000);
+
+  for(int i = 0; i < SEGBENCH_ITEMS; i++) {
+    snprintf(key, sizeof(key), "segbench:%d", i);
+    const uint64_t dk = digest_key(key, SEGBENCH_STASH);
+    blobcache_shard_t *bs = shard_for(dk);
+    hts_mutex_lock(&bs->bs_lock);
+    const blobcache_item_t *p = shard_lookup(bs, dk);
+    const uint32_t segment = p ? p->bi_segment : 0;
+    const uint32_t len = p ? item_record_len(p) : 0;
+    hts_mutex_unlock(&bs->bs_lock);
+
+    if(segment) {
+      int j;
+      for(j = 0; j < num_segments; j++)
+        if(seen_segments[j] == segment)
+          break;
+      if(j == num_segments && num_segments < 256)
+        seen_segments[num_segments++] = segment;
+      payload += len;
+    } else {
+      make_filename(filename, sizeof(filename), dk, 0);
+      if(!fa_stat(filename, &st, NULL, 0)) {
+        files++;
+        payload += st.fs_size;
+        allocated += (st.fs_size + SEGBENCH_BLOCK - 1) &
+          ~(uint64_t)(SEGBENCH_BLOCK - 1);
+      }
+    }
+  }
+
+  if(num_segments) {
+    files += num_segments;
+    allocated += (payload + SEGBENCH_BLOCK - 1) &
+      ~(uint64_t)(SEGBENCH_BLOCK - 1);
+  }
+
+  uint32_t seed = 1;
+  int64_t ts = arch_get_ts();
+  for(int i = 0; i < SEGBENCH_HITS; i++) {
+    seed = seed * 1664525 + 1013904223;
+    snprintf(key, sizeof(key), "segbench:%d", seed % SEGBENCH_ITEMS);
+    const int64_t t0 = arch_get_ts();
+    buf_t *b = blobcache_get(key, SEGBENCH_STASH, 0, NULL, NULL, NULL);
+    const int64_t lat = arch_get_ts() - t0;
+    maxlat = MAX(lat, maxlat);
+    if(b != NULL) {
+      hits++;
+      buf_release(b);
+    }
+  }
+  ts = arch_get_ts() - ts;
+
+  printf("blobcache: %-8s %5d hits of %5d, avg %6.1f us/hit, max %6d us, "
+         "%5d files, %.2f MB payload, %.2f MB allocated\n",
+         use_segments ? "segments" : "files",
+         hits, SEGBENCH_HITS, (double)ts / SEGBENCH_HITS, (int)maxlat,
+         files, payload / 1000000.0, allocated / 1000000.0);
+
+  segbench_evict(SEGBENCH_ITEMS);
+}
+
+
+static void
+blobcache_segment_bench(void)
+{
+  const int saved_mode = gconf.enable_blobcache_segments;
+  const size_t saved_budget = ram_shard_budget;
+
+  if(segbench_wait_for_run())
+    return;
+
+  // Measure the disk tier only
+  ram_shard_budget = 0;
+
+  segbench_run(0);
+  segbench_run(1);
+
+  ram_shard_budget = saved_budget;
+  gconf.enable_blobcache_segments = saved_mode;
+}
+
+BENCHMARK("blobcache-storage", blobcache_segment_bench);
+
+
+/**
+ * RAM tier benchmark
+ *
+ * Simulates repeatedly going back to a page with a set of thumbnails.
+ * First pass is served from disk, the remaining ones should be served
+ * from the RAM tier.
+ */
+#define RAMBENCH_ITEMS  400
+#define RAMBENCH_PASSES 20
+
+static void
+blobcache_ram_bench(void)
+{
+  char key[64];
+  unsigned int hits0 = 0, misses0 = 0, hits1 = 0, misses1 = 0;
+  int64_t cold = 0, warm = 0;
+
+  if(segbench_wait_for_run())
+    return;
+
+  segbench_fill(RAMBENCH_ITEMS, 40000);
+
+  for(int i = 0; i < BLOBCACHE_SHARDS; i++) {
+    hits0   += cache_shards[i].bs_ram_hits;
+    misses0 += cache_shards[i].bs_ram_misses;
+  }
+
+  for(int pass = 0; pass < RAMBENCH_PASSES; pass++) {
+    const int64_t ts = arch_get_ts();
+    for(int i = 0; i < RAMBENCH_ITEMS; i++) {
+      snprintf(key, sizeof(key), "segbench:%d", i);
+      buf_t *b = blobcache_get(key, SEGBENCH_STASH, 0, NULL, NULL, NULL);
+      if(b != NULL)
+        buf_release(b);
+    }
+    if(pass == 0)
+      cold = arch_get_ts() - ts;
+    else
+      warm += arch_get_ts() - ts;
+  }
+
+  for(int i = 0; i < BLOBCACHE_SHARDS; i++) {
+    hits1   += cache_shards[i].bs_ram_hits;
+    misses1 += cache_shards[i].bs_ram_misses;
+  }
+
+  printf("blobcache: %d items, first pass %.1f us/get, "
+         "later passes %.1f us/get, %u RAM hits, %u misses\n",
+         RAMBENCH_ITEMS, (double)cold / RAMBENCH_ITEMS,
+         (double)warm / (RAMBENCH_ITEMS * (RAMBENCH_PASSES - 1)),
+         hits1 - hits0, misses1 - misses0);
+
+  segbench_evict(RAMBENCH_ITEMS);
 }
+
+BENCHMARK("blobcache-ram", blobcache_ram_bench);
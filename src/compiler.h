@@ -54,6 +54,12 @@
 #define attribute_unused __attribute__((unused))
 #endif
 
+#ifdef _MSC_VER
+#define thread_local_var __declspec(thread)
+#else
+#define thread_local_var __thread
+#endif
+
 #ifdef _MSC_VER
 #define strdup _strdup
 #define alloca _alloca
@@ -20,13 +20,18 @@
 #include <assert.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <limits.h>
 
 #include "main.h"
+#include "arch/arch.h"
+#include "arch/atomic.h"
 #include "fileaccess/fileaccess.h"
 #include "misc/minmax.h"
 
 #include "db_support.h"
 
+static atomic_t db_lock_waits;
+static atomic_t db_deadlocks;
 
 typedef struct unlock_notify {
   int fired;
@@ -52,6 +57,8 @@ wait_for_unlock_notify(sqlite3 *db)
   int rc;
   unlock_notify_t un;
 
+  atomic_inc(&db_lock_waits);
+
   /* Initialize the UnlockNotification structure. */
   un.fired = 0;
   hts_mutex_init(&un.mutex);
@@ -110,6 +117,193 @@ db_preparex(sqlite3 *db, sqlite3_stmt **ppStmt, const char *zSql,
   return rc;
 }
 
+
+/**
+ * Prepared statement cache
+ *
+ * Connections handed out by db_pool_get() keep recently used statements
+ * around. db_prepare_cached() looks them up by the address of the SQL
+ * string (the text is verified as well) and db_finalize() resets and
+ * clears them instead of finalizing. They are finalized for real when
+ * the connection is closed.
+ *
+ * A pooled connection is only used by one thread at a time so the
+ * entries of a cache are not locked. stmt_cache_mutex just protects the
+ * mapping from connection to cache.
+ */
+#define STMT_CACHE_SIZE  32
+#define STMT_CACHE_HASH  16
+
+typedef struct stmt_cache_entry {
+  const char *sce_sql;
+  sqlite3_stmt *sce_stmt;
+  unsigned int sce_lastuse;
+  int sce_busy;
+} stmt_cache_entry_t;
+
+typedef struct stmt_cache {
+  LIST_ENTRY(stmt_cache) sc_link;
+  sqlite3 *sc_db;
+  unsigned int sc_tally;
+  int sc_begin_immediate; // Private cache writer, see db_begin0()
+  stmt_cache_entry_t sc_entries[STMT_CACHE_SIZE];
+} stmt_cache_t;
+
+static LIST_HEAD(, stmt_cache) stmt_caches[STMT_CACHE_HASH];
+static hts_mutex_t stmt_cache_mutex;
+
+
+/**
+ *
+ */
+static inline unsigned int
+stmt_cache_hash(const sqlite3 *db)
+{
+  return ((intptr_t)db >> 4) & (STMT_CACHE_HASH - 1);
+}
+
+
+/**
+ *
+ */
+static stmt_cache_t *
+stmt_cache_find(const sqlite3 *db)
+{
+  stmt_cache_t *sc;
+  hts_mutex_lock(&stmt_cache_mutex);
+  LIST_FOREACH(sc, &stmt_caches[stmt_cache_hash(db)], sc_link)
+    if(sc->sc_db == db)
+      break;
+  hts_mutex_unlock(&stmt_cache_mutex);
+  return sc;
+}
+
+
+/**
+ *
+ */
+static void
+stmt_cache_create(sqlite3 *db, int begin_immediate)
+{
+  stmt_cache_t *sc = calloc(1, sizeof(stmt_cache_t));
+  sc->sc_db = db;
+  sc->sc_begin_immediate = begin_immediate;
+  hts_mutex_lock(&stmt_cache_mutex);
+  LIST_INSERT_HEAD(&stmt_caches[stmt_cache_hash(db)], sc, sc_link);
+  hts_mutex_unlock(&stmt_cache_mutex);
+}
+
+
+/**
+ * Finalize all cached statements and close connection
+ */
+static void
+db_close(sqlite3 *db)
+{
+  stmt_cache_t *sc = stmt_cache_find(db);
+
+  if(sc != NULL) {
+    hts_mutex_lock(&stmt_cache_mutex);
+    LIST_REMOVE(sc, sc_link);
+    hts_mutex_unlock(&stmt_cache_mutex);
+
+    for(int i = 0; i < STMT_CACHE_SIZE; i++) {
+      stmt_cache_entry_t *sce = &sc->sc_entries[i];
+      if(sce->sce_stmt == NULL)
+        continue;
+      if(sce->sce_busy)
+        TRACE(TRACE_ERROR, "DB", "Statement '%s' still in use at close",
+              sce->sce_sql);
+      sqlite3_finalize(sce->sce_stmt);
+    }
+    free(sc);
+  }
+  sqlite3_close(db);
+}
+
+
+/**
+ *
+ */
+int
+db_prepare_cachedx(sqlite3 *db, sqlite3_stmt **ppStmt, const char *zSql,
+                   const char *file, int line)
+{
+  stmt_cache_t *sc = stmt_cache_find(db);
+  stmt_cache_entry_t *sce, *victim = NULL;
+  int rc, i;
+
+  if(sc == NULL)
+    return db_preparex(db, ppStmt, zSql, file, line);
+
+  for(i = 0; i < STMT_CACHE_SIZE; i++) {
+    sce = &sc->sc_entries[i];
+
+    if(sce->sce_busy)
+      continue;
+
+    if(sce->sce_stmt != NULL && sce->sce_sql == zSql) {
+      if(!strcmp(sqlite3_sql(sce->sce_stmt), zSql)) {
+        sce->sce_busy = 1;
+        sce->sce_lastuse = ++sc->sc_tally;
+        *ppStmt = sce->sce_stmt;
+        return SQLITE_OK;
+      }
+      // Same address but different text, entry is stale
+      sqlite3_finalize(sce->sce_stmt);
+      sce->sce_stmt = NULL;
+    }
+
+    // Prefer empty slots, then the least recently used one
+    if(victim == NULL ||
+       (victim->sce_stmt != NULL &&
+        (sce->sce_stmt == NULL || sce->sce_lastuse < victim->sce_lastuse)))
+      victim = sce;
+  }
+
+  rc = db_preparex(db, ppStmt, zSql, file, line);
+  if(rc != SQLITE_OK)
+    return rc;
+
+  if(victim == NULL)
+    return rc; // Every slot is in use, caller gets a private statement
+
+  if(victim->sce_stmt != NULL)
+    sqlite3_finalize(victim->sce_stmt);
+
+  victim->sce_sql = zSql;
+  victim->sce_stmt = *ppStmt;
+  victim->sce_busy = 1;
+  victim->sce_lastuse = ++sc->sc_tally;
+  return rc;
+}
+
+
+/**
+ *
+ */
+int
+db_finalize(sqlite3_stmt *pStmt)
+{
+  if(pStmt == NULL)
+    return SQLITE_OK;
+
+  stmt_cache_t *sc = stmt_cache_find(sqlite3_db_handle(pStmt));
+  if(sc != NULL) {
+    for(int i = 0; i < STMT_CACHE_SIZE; i++) {
+      stmt_cache_entry_t *sce = &sc->sc_entries[i];
+      if(sce->sce_stmt == pStmt) {
+        assert(sce->sce_busy);
+        sce->sce_busy = 0;
+        sqlite3_clear_bindings(pStmt);
+        return sqlite3_reset(pStmt);
+      }
+    }
+  }
+  return sqlite3_finalize(pStmt);
+}
+
+
 /**
  *
  */
@@ -180,8 +374,32 @@ db_get_int_from_query(sqlite3 *db, const char *query, int *v)
 
 
 
+/**
+ * Connections that don't share cache see concurrent writers as
+ * SQLITE_BUSY rather than SQLITE_LOCKED. A deferred transaction that
+ * starts out reading may then fail to upgrade to a write lock without
+ * the busy handler ever being invoked. So writers on such connections
+ * grab the write lock up front instead, waiting for it in the busy
+ * handler.
+ *
+ * Transactions that never write should use db_begin_read() so they
+ * are not serialized with the writers.
+ */
 int
 db_begin0(sqlite3 *db, const char *src)
+{
+  if(db == NULL)
+    return 1;
+
+  stmt_cache_t *sc = stmt_cache_find(db);
+  if(sc != NULL && sc->sc_begin_immediate)
+    return db_one_statement(db, "BEGIN IMMEDIATE;", src);
+  return db_one_statement(db, "BEGIN;", src);
+}
+
+
+int
+db_begin_read0(sqlite3 *db, const char *src)
 {
   return db == NULL || db_one_statement(db, "BEGIN;", src);
 }
@@ -204,6 +422,7 @@ int
 db_rollback_deadlock0(sqlite3 *db, const char *src)
 {
   int r = db == NULL || db_one_statement(db, "ROLLBACK;", src);
+  atomic_inc(&db_deadlocks); // Counted here only, once per retry
   TRACE(TRACE_DEBUG, "DB", "Rollback due to deadlock, and retrying");
   usleep(100000);
   return r;
@@ -349,16 +568,23 @@ db_upgrade_schema(sqlite3 *db, const char *schemadir, const char *dbname,
 
 
 /**
- *
+ * In split mode (gconf.enable_db_split) connections are opened with
+ * private page caches and rely on WAL for concurrency. Readers then never
+ * block on writers and vice versa. Read-only connections are handed out
+ * by db_pool_get_reader() and kept in a separate set of slots.
  */
 struct db_pool {
   int dp_size;
   int dp_closed;
+  int dp_split;
   char *dp_path;
   hts_mutex_t dp_mutex;
+  sqlite3 **dp_readers;
   sqlite3 *dp_pool[0];
 };
 
+#define DB_BUSY_TIMEOUT 10000 // ms
+
 /**
  *
  */
@@ -367,9 +593,11 @@ db_pool_create(const char *path, int size)
 {
   db_pool_t *dp;
   
-  dp = calloc(1, sizeof(db_pool_t) + sizeof(sqlite3 *) * size);
+  dp = calloc(1, sizeof(db_pool_t) + sizeof(sqlite3 *) * size * 2);
   dp->dp_size = size;
+  dp->dp_split = gconf.enable_db_split;
   dp->dp_path = strdup(path);
+  dp->dp_readers = dp->dp_pool + size;
   hts_mutex_init(&dp->dp_mutex);
   return dp;
 }
@@ -383,11 +611,17 @@ db_open(const char *path, int flags)
 {
   int rc;
   sqlite3 *db;
+  int oflags = SQLITE_OPEN_NOMUTEX;
+
+  if(flags & DB_OPEN_READONLY)
+    oflags |= SQLITE_OPEN_READONLY;
+  else
+    oflags |= SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
 
-  rc = sqlite3_open_v2(path, &db,
-		       SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE |
-		       SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_SHAREDCACHE,
-		       NULL);
+  if(!(flags & DB_OPEN_PRIVATE_CACHE))
+    oflags |= SQLITE_OPEN_SHAREDCACHE;
+
+  rc = sqlite3_open_v2(path, &db, oflags, NULL);
 
   if(rc) {
     TRACE(TRACE_ERROR, "DB", "%s: Unable to open database: %s",
@@ -396,6 +630,9 @@ db_open(const char *path, int flags)
     return NULL;
   }
 
+  if(flags & DB_OPEN_PRIVATE_CACHE)
+    sqlite3_busy_timeout(db, DB_BUSY_TIMEOUT);
+
   db_one_statement(db, "PRAGMA synchronous = normal", path);
   if(flags & DB_OPEN_CASE_SENSITIVE_LIKE)
     db_one_statement(db, "PRAGMA case_sensitive_like=1", path);
@@ -417,15 +654,18 @@ db_open(const char *path, int flags)
 /**
  *
  */
-sqlite3 *
-db_pool_get(db_pool_t *dp)
+static sqlite3 *
+db_pool_get0(db_pool_t *dp, int reader)
 {
   int i;
   sqlite3 *db;
+  int flags = DB_OPEN_CASE_SENSITIVE_LIKE;
 
   if(dp == NULL)
     return NULL;
 
+  sqlite3 **slots = reader ? dp->dp_readers : dp->dp_pool;
+
   hts_mutex_lock(&dp->dp_mutex);
 
   if(dp->dp_closed) {
@@ -434,9 +674,9 @@ db_pool_get(db_pool_t *dp)
   }
 
   for(i = 0; i < dp->dp_size; i++) {
-    if(dp->dp_pool[i] != NULL) {
-      db = dp->dp_pool[i];
-      dp->dp_pool[i] = NULL;
+    if(slots[i] != NULL) {
+      db = slots[i];
+      slots[i] = NULL;
       hts_mutex_unlock(&dp->dp_mutex);
       return db;
     }
@@ -444,7 +684,33 @@ db_pool_get(db_pool_t *dp)
 
   hts_mutex_unlock(&dp->dp_mutex);
 
-  return db_open(dp->dp_path, DB_OPEN_CASE_SENSITIVE_LIKE);
+  if(dp->dp_split)
+    flags |= DB_OPEN_PRIVATE_CACHE | (reader ? DB_OPEN_READONLY : 0);
+
+  db = db_open(dp->dp_path, flags);
+  if(db != NULL)
+    stmt_cache_create(db, dp->dp_split && !reader);
+  return db;
+}
+
+
+/**
+ *
+ */
+sqlite3 *
+db_pool_get(db_pool_t *dp)
+{
+  return db_pool_get0(dp, 0);
+}
+
+
+/**
+ *
+ */
+sqlite3 *
+db_pool_get_reader(db_pool_t *dp)
+{
+  return db_pool_get0(dp, dp != NULL && dp->dp_split);
 }
 
 /**
@@ -461,21 +727,24 @@ db_pool_put(db_pool_t *dp, sqlite3 *db)
     TRACE(TRACE_ERROR, "DB",
 	  "%s: db handle returned to pool while in transaction, closing handle",
 	  dp->dp_path);
-    sqlite3_close(db);
+    db_close(db);
     return;
   }
 
+  sqlite3 **slots =
+    sqlite3_db_readonly(db, "main") == 1 ? dp->dp_readers : dp->dp_pool;
+
   hts_mutex_lock(&dp->dp_mutex);
   for(i = 0; i < dp->dp_size; i++) {
-    if(dp->dp_pool[i] == NULL) {
-      dp->dp_pool[i] = db;
+    if(slots[i] == NULL) {
+      slots[i] = db;
       hts_mutex_unlock(&dp->dp_mutex);
       return;
     }
   }
 
   hts_mutex_unlock(&dp->dp_mutex);
-  sqlite3_close(db);
+  db_close(db);
 }
 
 
@@ -491,9 +760,9 @@ db_pool_close(db_pool_t *dp)
 
   hts_mutex_lock(&dp->dp_mutex);
   dp->dp_closed = 1;
-  for(i = 0; i < dp->dp_size; i++)
+  for(i = 0; i < dp->dp_size * 2; i++)
     if(dp->dp_pool[i] != NULL)
-      sqlite3_close(dp->dp_pool[i]);
+      db_close(dp->dp_pool[i]);
   hts_mutex_unlock(&dp->dp_mutex);
 }
 
@@ -719,6 +988,7 @@ memlogger_fn(callout_t *co, void *aux)
 void
 db_init(void)
 {
+  hts_mutex_init(&stmt_cache_mutex);
   sqlite3_temp_directory = gconf.cache_path;
 #if ENABLE_SQLITE_LOCKING
   sqlite3_config(SQLITE_CONFIG_MUTEX, &sqlite_mutexes);
@@ -732,3 +1002,328 @@ db_init(void)
   if(0)
     callout_arm(&memlogger, memlogger_fn, NULL, 1);
 }
+
+
+/**
+ * Statement cache benchmark
+ *
+ * Point lookups on a scratch database, first preparing the statement
+ * every time and then using the statement cache.
+ */
+#define STMTBENCH_ROWS    10000
+#define STMTBENCH_LOOKUPS 100000
+
+static const char stmtbench_sql[] =
+  "SELECT id, mtime FROM item WHERE url = ?1";
+
+static int64_t
+stmtbench_run(sqlite3 *db, int cached)
+{
+  char url[64];
+  sqlite3_stmt *stmt;
+  int found = 0;
+
+  int64_t ts = arch_get_ts();
+  for(int i = 0; i < STMTBENCH_LOOKUPS; i++) {
+    snprintf(url, sizeof(url), "file:///bench/%d",
+             (i * 7919) % STMTBENCH_ROWS);
+
+    if(cached ? db_prepare_cached(db, &stmt, stmtbench_sql) :
+       db_prepare(db, &stmt, stmtbench_sql))
+      return -1;
+
+    sqlite3_bind_text(stmt, 1, url, -1, SQLITE_STATIC);
+    if(db_step(stmt) == SQLITE_ROW)
+      found++;
+
+    if(cached)
+      db_finalize(stmt);
+    else
+      sqlite3_finalize(stmt);
+  }
+  ts = arch_get_ts() - ts;
+
+  if(found != STMTBENCH_LOOKUPS)
+    printf("db: Only found %d of %d rows\n", found, STMTBENCH_LOOKUPS);
+  return ts;
+}
+
+
+static void
+db_stmt_cache_bench(void)
+{
+  char path[PATH_MAX];
+  char url[64];
+  sqlite3_stmt *stmt;
+
+  snprintf(path, sizeof(path), "%s/stmtbench.db", gconf.cache_path);
+  unlink(path);
+
+  db_pool_t *dp = db_pool_create(path, 1);
+  sqlite3 *db = db_pool_get(dp);
+  if(db == NULL)
+    return;
+
+  db_one_statement(db, "CREATE TABLE item(id INTEGER PRIMARY KEY, "
+                   "url TEXT UNIQUE, mtime INTEGER)", NULL);
+
+  db_begin(db);
+  for(int i = 0; i < STMTBENCH_ROWS; i++) {
+    if(db_prepare_cached(db, &stmt,
+                         "INSERT INTO item (url, mtime) VALUES (?1, ?2)"))
+      break;
+    snprintf(url, sizeof(url), "file:///bench/%d", i);
+    sqlite3_bind_text(stmt, 1, url, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, i);
+    db_step(stmt);
+    db_finalize(stmt);
+  }
+  db_commit(db);
+
+  const int64_t plain  = stmtbench_run(db, 0);
+  const int64_t cached = stmtbench_run(db, 1);
+
+  printf("db: %d lookups, prepare each time %.2f us/lookup, "
+         "cached %.2f us/lookup (%.1fx)\n",
+         STMTBENCH_LOOKUPS,
+         (double)plain / STMTBENCH_LOOKUPS,
+         (double)cached / STMTBENCH_LOOKUPS,
+         (double)plain / MAX(cached, 1));
+
+  db_pool_put(dp, db);
+  db_pool_close(dp);
+  unlink(path);
+}
+
+BENCHMARK("db-stmtcache", db_stmt_cache_bench);
+
+
+/**
+ *
+ */
+void
+db_get_lock_stats(int *lock_waits, int *deadlocks)
+{
+  *lock_waits = atomic_get(&db_lock_waits);
+  *deadlocks  = atomic_get(&db_deadlocks);
+}
+
+
+/**
+ * Concurrent read/write stress test
+ *
+ * A couple of writer threads update rows in batched transactions while
+ * reader threads scan directories the way the scanner and the library
+ * views do. Run once with shared cache connections and once in split
+ * mode, counting lock waits and deadlock retries.
+ */
+#define DBSTRESS_DIRS     50
+#define DBSTRESS_ITEMS    100 // per directory
+#define DBSTRESS_READERS  4
+#define DBSTRESS_WRITERS  4
+#define DBSTRESS_OPS      200 // per thread
+#define DBSTRESS_BATCH    20
+
+typedef struct dbstress_thread {
+  db_pool_t *dt_pool;
+  int dt_id;
+  int dt_ops;
+  int dt_errors;
+} dbstress_thread_t;
+
+
+static void *
+dbstress_writer(void *aux)
+{
+  dbstress_thread_t *dt = aux;
+  sqlite3 *db = db_pool_get(dt->dt_pool);
+  sqlite3_stmt *stmt;
+  unsigned int seed = dt->dt_id;
+
+  for(int i = 0; i < DBSTRESS_OPS; i++) {
+    const int dir = rand_r(&seed) % DBSTRESS_DIRS;
+  again:
+    if(db_begin(db)) {
+      dt->dt_errors++;
+      continue;
+    }
+
+    // Look up and then update, like metadb_metadata_write() does
+    int rc = SQLITE_OK;
+    for(int j = 0; j < DBSTRESS_BATCH && rc == SQLITE_OK; j++) {
+      const int id = 1 + dir * DBSTRESS_ITEMS + rand_r(&seed) % DBSTRESS_ITEMS;
+      int mtime = 0;
+
+      rc = db_prepare_cached(db, &stmt, "SELECT mtime FROM item WHERE id = ?1");
+      if(rc)
+        break;
+      sqlite3_bind_int(stmt, 1, id);
+      rc = db_step(stmt);
+      if(rc == SQLITE_ROW)
+        mtime = sqlite3_column_int(stmt, 0);
+      db_finalize(stmt);
+      if(rc != SQLITE_ROW)
+        break;
+
+      rc = db_prepare_cached(db, &stmt,
+                             "UPDATE item SET mtime = ?2 WHERE id = ?1");
+      if(rc)
+        break;
+      sqlite3_bind_int(stmt, 1, id);
+      sqlite3_bind_int(stmt, 2, mtime + 1);
+      rc = db_step(stmt);
+      db_finalize(stmt);
+      if(rc == SQLITE_DONE)
+        rc = SQLITE_OK;
+    }
+
+    if(rc == SQLITE_LOCKED) {
+      db_rollback_deadlock(db);
+      goto again;
+    }
+    if(rc != SQLITE_OK) {
+      db_rollback(db);
+      dt->dt_errors++;
+      continue;
+    }
+    if(db_commit(db)) {
+      db_rollback(db);
+      dt->dt_errors++;
+      continue;
+    }
+    dt->dt_ops++;
+  }
+  db_pool_put(dt->dt_pool, db);
+  return NULL;
+}
+
+
+static void *
+dbstress_reader(void *aux)
+{
+  dbstress_thread_t *dt = aux;
+  sqlite3 *db = db_pool_get_reader(dt->dt_pool);
+  sqlite3_stmt *stmt;
+  unsigned int seed = dt->dt_id;
+
+  for(int i = 0; i < DBSTRESS_OPS; i++) {
+    const int dir = rand_r(&seed) % DBSTRESS_DIRS;
+  again:
+    if(db_begin_read(db)) {
+      dt->dt_errors++;
+      continue;
+    }
+
+    int rc = db_prepare_cached(db, &stmt,
+                               "SELECT id, url, mtime FROM item "
+                               "WHERE parent = ?1");
+    if(!rc) {
+      sqlite3_bind_int(stmt, 1, dir);
+      while((rc = db_step(stmt)) == SQLITE_ROW) {}
+      db_finalize(stmt);
+    }
+
+    if(rc == SQLITE_LOCKED) {
+      db_rollback_deadlock(db);
+      goto again;
+    }
+    db_rollback(db);
+    if(rc != SQLITE_DONE)
+      dt->dt_errors++;
+    else
+      dt->dt_ops++;
+  }
+  db_pool_put(dt->dt_pool, db);
+  return NULL;
+}
+
+
+static void
+dbstress_run(const char *path, int split)
+{
+  dbstress_thread_t dt[DBSTRESS_READERS + DBSTRESS_WRITERS] = {};
+  hts_thread_t tids[DBSTRESS_READERS + DBSTRESS_WRITERS];
+  int waits0, deadlocks0, waits1, deadlocks1, ops = 0, errors = 0;
+
+  const int save = gconf.enable_db_split;
+  gconf.enable_db_split = split;
+  db_pool_t *dp = db_pool_create(path, DBSTRESS_READERS + DBSTRESS_WRITERS);
+  gconf.enable_db_split = save;
+
+  db_get_lock_stats(&waits0, &deadlocks0);
+  int64_t ts = arch_get_ts();
+
+  for(int i = 0; i < DBSTRESS_READERS + DBSTRESS_WRITERS; i++) {
+    dt[i].dt_pool = dp;
+    dt[i].dt_id = i + 1;
+    hts_thread_create_joinable("dbstress", &tids[i],
+                               i < DBSTRESS_WRITERS ?
+                               dbstress_writer : dbstress_reader,
+                               &dt[i], THREAD_PRIO_BGTASK);
+  }
+
+  for(int i = 0; i < DBSTRESS_READERS + DBSTRESS_WRITERS; i++) {
+    hts_thread_join(&tids[i]);
+    ops += dt[i].dt_ops;
+    errors += dt[i].dt_errors;
+  }
+
+  ts = arch_get_ts() - ts;
+  db_get_lock_stats(&waits1, &deadlocks1);
+  db_pool_close(dp);
+
+  printf("db: %-12s %d ops in %d ms, %d lock waits, "
+         "%d deadlock retries, %d errors\n",
+         split ? "split/WAL" : "sharedcache", ops, (int)(ts / 1000),
+         waits1 - waits0, deadlocks1 - deadlocks0, errors);
+}
+
+
+static void
+db_stress_bench(void)
+{
+  char path[PATH_MAX];
+  char url[64];
+  sqlite3_stmt *stmt;
+
+  snprintf(path, sizeof(path), "%s/dbstress.db", gconf.cache_path);
+  unlink(path);
+
+  db_pool_t *dp = db_pool_create(path, 1);
+  sqlite3 *db = db_pool_get(dp);
+  if(db == NULL)
+    return;
+
+  db_one_statement(db, "PRAGMA journal_mode=wal", NULL);
+  db_one_statement(db, "CREATE TABLE item(id INTEGER PRIMARY KEY, "
+                   "url TEXT UNIQUE, parent INTEGER, mtime INTEGER)", NULL);
+  db_one_statement(db, "CREATE INDEX item_parent_idx ON item(parent)", NULL);
+
+  db_begin(db);
+  for(int i = 0; i < DBSTRESS_DIRS * DBSTRESS_ITEMS; i++) {
+    if(db_prepare_cached(db, &stmt,
+                         "INSERT INTO item (url, parent, mtime) "
+                         "VALUES (?1, ?2, 0)"))
+      break;
+    snprintf(url, sizeof(url), "file:///bench/%d", i);
+    sqlite3_bind_text(stmt, 1, url, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, i / DBSTRESS_ITEMS);
+    db_step(stmt);
+    db_finalize(stmt);
+  }
+  db_commit(db);
+  db_pool_put(dp, db);
+  db_pool_close(dp);
+
+  dbstress_run(path, 0);
+  dbstress_run(path, 1);
+
+  unlink(path);
+  // Left behind if a read-only connection was the last one closed
+  snprintf(path, sizeof(path), "%s/dbstress.db-wal", gconf.cache_path);
+  unlink(path);
+  snprintf(path, sizeof(path), "%s/dbstress.db-shm", gconf.cache_path);
+  unlink(path);
+}
+
+BENCHMARK("db-stress", db_stress_bench);
@@ -29,6 +29,8 @@ int db_get_int64_from_query(sqlite3 *db, const char *query, int64_t *v);
 
 int db_begin0(sqlite3 *db, const char *src);
 
+int db_begin_read0(sqlite3 *db, const char *src);
+
 int db_commit0(sqlite3 *db, const char *src);
 
 int db_rollback0(sqlite3 *db, const char *src);
@@ -45,13 +47,30 @@ int db_preparex(sqlite3 *db, sqlite3_stmt **ppStmt, const char *zSql,
 
 #define db_prepare(db, stmt, sql) db_preparex(db, stmt, sql, __FILE__, __LINE__)
 
+/**
+ * Like db_prepare() but reuses a statement previously prepared on the same
+ * connection with the same SQL string. Meant for constant SQL strings.
+ *
+ * Statements must be released with db_finalize()
+ */
+int db_prepare_cachedx(sqlite3 *db, sqlite3_stmt **ppStmt, const char *zSql,
+                       const char *file, int line);
+
+#define db_prepare_cached(db, stmt, sql) \
+  db_prepare_cachedx(db, stmt, sql, __FILE__, __LINE__)
+
+int db_finalize(sqlite3_stmt *pStmt);
+
 #define db_begin(db)    db_begin0(db, __FUNCTION__)
+#define db_begin_read(db) db_begin_read0(db, __FUNCTION__)
 #define db_commit(db)   db_commit0(db, __FUNCTION__)
 #define db_rollback(db) db_rollback0(db, __FUNCTION__)
 #define db_rollback_deadlock(db) db_rollback_deadlock0(db, __FUNCTION__)
 
 
 #define DB_OPEN_CASE_SENSITIVE_LIKE 0x1
+#define DB_OPEN_PRIVATE_CACHE       0x2
+#define DB_OPEN_READONLY            0x4
 
 sqlite3 *db_open(const char *path, int flags);
 
@@ -64,6 +83,15 @@ db_pool_t *db_pool_create(const char *path, int size);
 
 sqlite3 *db_pool_get(db_pool_t *p);
 
+/**
+ * Get a connection for queries that never write. When the pool is in
+ * split mode (gconf.enable_db_split) this is a read-only connection that
+ * runs concurrently with writers, otherwise same as db_pool_get().
+ *
+ * Return it with db_pool_put()
+ */
+sqlite3 *db_pool_get_reader(db_pool_t *p);
+
 void db_pool_put(db_pool_t *p, sqlite3 *db);
 
 void db_pool_close(db_pool_t *dp);
@@ -80,4 +108,6 @@ static __inline void db_bind_rstr(sqlite3_stmt *stmt, int col, rstr_t *rstr)
 
 void db_escape_path_query(char *dst, size_t dstlen, const char *src);
 
+void db_get_lock_stats(int *lock_waits, int *deadlocks);
+
 void db_init(void);
@@ -90,6 +90,16 @@ kvstore_get(void)
 }
 
 
+/**
+ *
+ */
+static void *
+kvstore_get_reader(void)
+{
+  return db_pool_get_reader(kvstore_pool);
+}
+
+
 /**
  *
  */
@@ -156,8 +166,8 @@ get_url(void *db, const char *url, uint64_t *id)
   int rc;
   sqlite3_stmt *stmt;
 
-  rc = db_prepare(db, &stmt,
-		  "SELECT id FROM url WHERE url=?1");
+  rc = db_prepare_cached(db, &stmt,
+                         "SELECT id FROM url WHERE url=?1");
 
   if(rc != SQLITE_OK)
     return rc;
@@ -166,19 +176,19 @@ get_url(void *db, const char *url, uint64_t *id)
 
   rc = sqlite3_step(stmt);
   if(rc == SQLITE_LOCKED) {
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     return SQLITE_LOCKED;
   }
   if(rc == SQLITE_ROW) {
     *id = sqlite3_column_int64(stmt, 0);
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     return SQLITE_OK;
 
   } else if(rc == SQLITE_DONE) {
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
 
-    rc = db_prepare(db, &stmt,
-		    "INSERT INTO url ('url') VALUES (?1)");
+    rc = db_prepare_cached(db, &stmt,
+                           "INSERT INTO url ('url') VALUES (?1)");
 
     if(rc != SQLITE_OK)
       return rc;
@@ -196,7 +206,7 @@ get_url(void *db, const char *url, uint64_t *id)
 
     }
   }
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   return rc;
 }
 
@@ -266,18 +276,18 @@ kv_value_cb(void *opaque, prop_event_t event, ...)
     }
 
     if(event == PROP_SET_VOID) {
-      rc = db_prepare(db, &stmt,
-		      "DELETE FROM url_kv "
-		      "WHERE url_id = ?1 "
-		      "AND domain = ?4 "
-		      "AND key = ?2");
+      rc = db_prepare_cached(db, &stmt,
+                             "DELETE FROM url_kv "
+                             "WHERE url_id = ?1 "
+                             "AND domain = ?4 "
+                             "AND key = ?2");
     } else {
 
-      rc = db_prepare(db, &stmt,
-		      "INSERT OR REPLACE INTO url_kv "
-		      "(url_id, domain, key, value) "
-		      "VALUES "
-		      "(?1, ?4, ?2, ?3)");
+      rc = db_prepare_cached(db, &stmt,
+                             "INSERT OR REPLACE INTO url_kv "
+                             "(url_id, domain, key, value) "
+                             "VALUES "
+                             "(?1, ?4, ?2, ?3)");
     }
 
     if(rc != SQLITE_OK) {
@@ -315,7 +325,7 @@ kv_value_cb(void *opaque, prop_event_t event, ...)
     db_bind_rstr(stmt, 2, kpbv->kpbv_name);
 
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
 
     if(rc == SQLITE_LOCKED) {
       db_rollback_deadlock(db);
@@ -425,16 +435,16 @@ kv_prop_bind_create(prop_t *p, const char *url)
   sqlite3_stmt *stmt;
   int rc;
 
-  db = kvstore_get();
+  db = kvstore_get_reader();
   if(db == NULL)
     return;
 
-  rc = db_prepare(db, &stmt,
-		  "SELECT id,key,value "
-		  "FROM url "
-		  "LEFT OUTER JOIN url_kv ON id = url_id "
-		  "WHERE url=?1 "
-		  "AND domain=?2");
+  rc = db_prepare_cached(db, &stmt,
+                         "SELECT id,key,value "
+                         "FROM url "
+                         "LEFT OUTER JOIN url_kv ON id = url_id "
+                         "WHERE url=?1 "
+                         "AND domain=?2");
 
 
   if(rc != SQLITE_OK) {
@@ -467,7 +477,7 @@ kv_prop_bind_create(prop_t *p, const char *url)
     }
   }
 
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   kvstore_close(db);
 
   kv_prop_bind_t *kpb = calloc(1, sizeof(kv_prop_bind_t));
@@ -493,14 +503,14 @@ kv_url_opt_get(void *db, const char *url, int domain, const char *key)
   if(db == NULL)
     return NULL;
 
-  rc = db_prepare(db, &stmt,
-		  "SELECT value "
-		  "FROM url, url_kv "
-		  "WHERE url=?1 "
-		  "AND key = ?2 "
-		  "AND domain = ?3 "
-		  "AND url.id = url_id"
-		  );
+  rc = db_prepare_cached(db, &stmt,
+                         "SELECT value "
+                         "FROM url, url_kv "
+                         "WHERE url=?1 "
+                         "AND key = ?2 "
+                         "AND domain = ?3 "
+                         "AND url.id = url_id"
+                         );
 
   if(rc != SQLITE_OK) {
     return NULL;
@@ -511,7 +521,7 @@ kv_url_opt_get(void *db, const char *url, int domain, const char *key)
 
   if(db_step(stmt) == SQLITE_ROW)
     return stmt;
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   return NULL;
 }
 
@@ -604,12 +614,12 @@ kv_url_opt_get_rstr(const char *url, int domain, const char *key)
     return rval;
   }
 
-  void *db = kvstore_get();
+  void *db = kvstore_get_reader();
   sqlite3_stmt *stmt = kv_url_opt_get(db, url, domain, key);
   rstr_t *r = NULL;
   if(stmt) {
     r = db_rstr(stmt, 0);
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     if(gconf.enable_kvstore_debug)
       TRACE(TRACE_DEBUG, "kvstore","GET DB url=%s key=%s domain=%d value=%s",
             url, key, domain, rstr_get(r));
@@ -674,12 +684,12 @@ kv_url_opt_get_int(const char *url, int domain, const char *key, int def)
     return rval;
   }
 
-  void *db = kvstore_get();
+  void *db = kvstore_get_reader();
   sqlite3_stmt *stmt = kv_url_opt_get(db, url, domain, key);
   int v = def;
   if(stmt) {
     v = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     if(gconf.enable_kvstore_debug)
       TRACE(TRACE_DEBUG, "kvstore","GET DB url=%s key=%s domain=%d value=%d",
             url, key, domain, v);
@@ -757,12 +767,12 @@ kv_url_opt_get_int64(const char *url, int domain, const char *key, int64_t def)
   }
 
 
-  void *db = kvstore_get();
+  void *db = kvstore_get_reader();
   sqlite3_stmt *stmt = kv_url_opt_get(db, url, domain, key);
   int64_t v = def;
   if(stmt) {
     v = sqlite3_column_int64(stmt, 0);
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     if(gconf.enable_kvstore_debug)
       TRACE(TRACE_DEBUG, "kvstore",
             "GET DB url=%s key=%s domain=%d value=%"PRId64,
@@ -789,11 +799,11 @@ kv_write_db(void *db, const kvstore_write_t *kw, int64_t id)
   sqlite3_stmt *stmt;
 
   if(kw->kw_type == KVSTORE_SET_VOID) {
-    rc = db_prepare(db, &stmt,
-                    "DELETE FROM url_kv "
-                    "WHERE url_id = ?1 "
-                    "AND key = ?2 "
-                    "AND domain = ?3");
+    rc = db_prepare_cached(db, &stmt,
+                           "DELETE FROM url_kv "
+                           "WHERE url_id = ?1 "
+                           "AND key = ?2 "
+                           "AND domain = ?3");
 
     if(rc != SQLITE_OK)
       return rc;
@@ -802,12 +812,12 @@ kv_write_db(void *db, const kvstore_write_t *kw, int64_t id)
 
   } else {
 
-    rc = db_prepare(db, &stmt,
-                    "INSERT OR REPLACE INTO url_kv "
-                    "(url_id, key, domain, value) "
-                    "VALUES "
-                    "(?1, ?2, ?3, ?4)"
-                    );
+    rc = db_prepare_cached(db, &stmt,
+                           "INSERT OR REPLACE INTO url_kv "
+                           "(url_id, key, domain, value) "
+                           "VALUES "
+                           "(?1, ?2, ?3, ?4)"
+                           );
 
     if(rc != SQLITE_OK)
       return rc;
@@ -838,7 +848,7 @@ kv_write_db(void *db, const kvstore_write_t *kw, int64_t id)
   sqlite3_bind_int(stmt, 3, kw->kw_domain);
 
   rc = sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
 
 
   if(rc == SQLITE_DONE)
@@ -98,14 +98,14 @@ es_prop_release_duk(duk_context *ctx)
 {
   prop_t *p = duk_require_pointer(ctx, 0);
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(p->hp_parent == NULL)
     prop_destroy0(p);
 
   prop_ref_dec_locked(p);
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return 0;
 }
 
@@ -168,10 +168,10 @@ es_prop_get_value_duk(duk_context *ctx)
 {
   prop_t *p = es_stprop_get(ctx, 0);
   char tmp[64];
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(p->hp_type == PROP_ZOMBIE) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     duk_error(ctx, ST_ERROR_PROP_ZOMBIE, NULL);
   }
 
@@ -179,7 +179,7 @@ es_prop_get_value_duk(duk_context *ctx)
   case PROP_CSTRING:
     {
       const char *s = p->hp_cstring;
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock();
       duk_push_string(ctx, s);
     }
     break;
@@ -187,7 +187,7 @@ es_prop_get_value_duk(duk_context *ctx)
   case PROP_RSTRING:
     {
       rstr_t *r = rstr_dup(p->hp_rstring);
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock();
       duk_push_string(ctx, rstr_get(r));
       rstr_release(r);
     }
@@ -195,7 +195,7 @@ es_prop_get_value_duk(duk_context *ctx)
   case PROP_URI:
     {
       rstr_t *r = rstr_dup(p->hp_uri_title);
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock();
       duk_push_string(ctx, rstr_get(r));
       rstr_release(r);
     }
@@ -203,19 +203,19 @@ es_prop_get_value_duk(duk_context *ctx)
   case PROP_FLOAT:
     {
       const float v = p->hp_float;
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock();
       duk_push_number(ctx, v);
     }
     break;
   case PROP_INT:
     {
       const int v = p->hp_int;
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock();
       duk_push_int(ctx, v);
     }
     break;
   case PROP_VOID:
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     duk_push_null(ctx);
     break;
   case PROP_DIR:
@@ -231,14 +231,14 @@ es_prop_get_value_duk(duk_context *ctx)
       }
       htsbuf_qprintf(&hq, "}]");
       char *str = htsbuf_to_string(&hq);
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock();
       duk_push_string(ctx, str);
       free(str);
       break;
     }
   default:
     snprintf(tmp, sizeof(tmp), "[prop internal type %d]", p->hp_type);
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     duk_push_string(ctx, tmp);
     break;
   }
@@ -261,10 +261,10 @@ es_prop_get_child_duk(duk_context *ctx)
     str = duk_require_string(ctx, 1);
   }
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(p->hp_type == PROP_ZOMBIE) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     duk_error(ctx, ST_ERROR_PROP_ZOMBIE, NULL);
   }
 
@@ -283,11 +283,11 @@ es_prop_get_child_duk(duk_context *ctx)
 
   if(p != NULL) {
     p = prop_ref_inc(p);
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     es_push_native_obj(ctx, &es_native_prop, p);
     return 1;
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return 0;
 }
 
@@ -302,11 +302,11 @@ es_prop_enum_duk(duk_context *ctx)
 
   duk_push_array(ctx);
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
 
   if(p->hp_type != PROP_DIR) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     return 1;
   }
 
@@ -322,7 +322,7 @@ es_prop_enum_duk(duk_context *ctx)
   TAILQ_FOREACH(c, &p->hp_childs, hp_parent_link)
     names[i++] = c->hp_name ? strdup(c->hp_name) : NULL;
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 
   for(int i = 0; i < cnt; i++) {
     if(names[i])
@@ -347,7 +347,7 @@ es_prop_has_duk(duk_context *ctx)
   const char *name = duk_get_string(ctx, 1);
   int yes = 0;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(p->hp_type == PROP_DIR) {
     prop_t *c;
@@ -358,7 +358,7 @@ es_prop_has_duk(duk_context *ctx)
       }
     }
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   duk_push_boolean(ctx, yes);
   return 1;
 }
@@ -875,7 +875,7 @@ es_prop_is_value(duk_context *ctx)
   } else {
     int v;
 
-    hts_mutex_lock(&prop_mutex);
+    prop_lock();
 
     switch(p->hp_type) {
     case PROP_CSTRING:
@@ -890,7 +890,7 @@ es_prop_is_value(duk_context *ctx)
       v = 0;
       break;
     }
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     duk_push_boolean(ctx, v);
   }
   return 1;
@@ -179,7 +179,7 @@ file_open_file(prop_t *page, const char *url, fa_stat_t *fs,
   char errbuf[200];
   metadata_t *md = NULL;
 
-  void *db = metadb_get();
+  void *db = metadb_get_reader();
   md = metadb_metadata_get(db, url, fs->fs_mtime);
   metadb_close(db);
 
@@ -17,9 +17,12 @@
  *  This program is also available under a commercial proprietary license.
  *  For more information, contact andreas@lonelycoder.com
  */
+#include <unistd.h>
+
 #include "arch/halloc.h"
 
 #include "main.h"
+#include "arch/arch.h"
 #include "fileaccess.h"
 #include "fa_proto.h"
 #include "misc/minmax.h"
@@ -32,6 +35,26 @@
 #define BF_ZONES 8
 #define BF_MASK (BF_ZONES - 1)
 
+/**
+ * Read-ahead
+ *
+ * FA_BUFFERED_BIG handles that are read sequentially get a fetcher
+ * thread that keeps a window ahead of the read position filled in the
+ * zone cache. The window is sized after how fast the data is consumed.
+ * When the reader jumps somewhere the fetcher is not heading, the read
+ * that is in flight is aborted via the outbound cancellable and the
+ * fetcher starts over from the new position.
+ *
+ * While the fetcher runs bf_ra_mutex protects the zone cache, bf_fpos
+ * and bf_size. Only one thread at a time may use the source handle.
+ * The fetcher owns it while bf_ra_busy is set, everybody else must go
+ * through fab_src_claim() / fab_src_release().
+ */
+#define RA_MEM_SIZE         (4 * 1024 * 1024)
+#define RA_START_THRESHOLD  (512 * 1024)  // Sequential bytes before start
+#define RA_WINDOW_SECONDS   4
+#define RA_RATE_INTERVAL    500000
+
 static HTS_MUTEX_DECL(buffered_global_mutex);
 
 typedef struct buffered_zone {
@@ -72,6 +95,34 @@ typedef struct buffered_file {
 
   buffered_zone_t bf_zones[BF_ZONES];
 
+  int bf_user_cancelled;
+
+  int bf_ra_enabled;
+  int bf_ra_running;
+  hts_thread_t bf_ra_thread;
+  hts_mutex_t bf_ra_mutex;
+  hts_cond_t bf_ra_cond;
+  void *bf_ra_buf;
+
+  int bf_ra_stop;
+  int bf_ra_busy;         // Fetcher is reading from source
+  int bf_ra_claimed;      // Someone else needs the source
+  int bf_ra_cancelled;    // Outbound cancellable was fired to abort a fetch
+  int bf_ra_error;
+  int bf_ra_gen;          // Bumped when the fetcher is redirected
+  int bf_ra_window;
+  int64_t bf_ra_pos;      // Next position to fetch
+  int64_t bf_ra_busy_pos; // Start of fetch in flight
+
+  int64_t bf_ra_seq;      // Bytes read sequentially while not running
+  int64_t bf_ra_seq_pos;
+
+  int bf_ra_rate;         // Consumption rate (bytes / s)
+  int64_t bf_ra_rate_ts;
+  int64_t bf_ra_rate_bytes;
+  int64_t bf_ra_rate_stall;
+
+  int64_t bf_ra_stall;    // Total time readers waited for the fetcher (us)
 
 } buffered_file_t;
 
@@ -79,6 +130,8 @@ typedef struct buffered_file {
 static buffered_file_t *parked;
 static callout_t parked_callout;
 
+static void fab_ra_stop(buffered_file_t *bf);
+
 #ifdef DEBUG
 /**
  *
@@ -237,7 +290,10 @@ need_to_fill(const buffered_file_t *bf, int64_t fpos, size_t rd)
 static void
 fab_destroy(buffered_file_t *bf)
 {
+  fab_ra_stop(bf);
   bf->bf_src->fh_proto->fap_close(bf->bf_src);
+  hts_cond_destroy(&bf->bf_ra_cond);
+  hts_mutex_destroy(&bf->bf_ra_mutex);
 
   if(bf->bf_mem != NULL)
     hfree(bf->bf_mem, bf->bf_mem_size);
@@ -275,6 +331,8 @@ fab_park(fa_handle_t *handle)
   cancellable_unbind(bf->bf_inbound_cancellable, bf);
   bf->bf_inbound_cancellable = NULL;
 
+  fab_ra_stop(bf);
+
   buffered_file_t *closeme = NULL;
   fa_handle_t *src = bf->bf_src;
 
@@ -313,6 +371,99 @@ fab_close(fa_handle_t *handle)
 }
 
 
+/**
+ * Redirect the fetcher to 'pos', aborting any fetch in flight.
+ * bf_ra_mutex must be held
+ */
+static void
+fab_ra_retarget(buffered_file_t *bf, int64_t pos)
+{
+  bf->bf_ra_gen++;
+  bf->bf_ra_pos = pos;
+  bf->bf_ra_error = 0;
+
+  if(bf->bf_ra_busy && !bf->bf_ra_cancelled) {
+    bf->bf_ra_cancelled = 1;
+    cancellable_cancel(bf->bf_outbound_cancellable);
+  }
+  hts_cond_broadcast(&bf->bf_ra_cond);
+}
+
+
+/**
+ * Get exclusive access to the source handle
+ */
+static void
+fab_src_claim(buffered_file_t *bf)
+{
+  if(!bf->bf_ra_running)
+    return;
+
+  hts_mutex_lock(&bf->bf_ra_mutex);
+  bf->bf_ra_claimed++;
+  while(bf->bf_ra_busy)
+    hts_cond_wait(&bf->bf_ra_cond, &bf->bf_ra_mutex);
+  hts_mutex_unlock(&bf->bf_ra_mutex);
+}
+
+
+/**
+ *
+ */
+static void
+fab_src_release(buffered_file_t *bf)
+{
+  if(!bf->bf_ra_running)
+    return;
+
+  hts_mutex_lock(&bf->bf_ra_mutex);
+  bf->bf_ra_claimed--;
+  hts_cond_broadcast(&bf->bf_ra_cond);
+  hts_mutex_unlock(&bf->bf_ra_mutex);
+}
+
+
+/**
+ *
+ */
+static int64_t
+fab_seek_ra(buffered_file_t *bf, int64_t np, int lazy)
+{
+  fa_handle_t *src = bf->bf_src;
+  int mpos;
+
+  hts_mutex_lock(&bf->bf_ra_mutex);
+
+  if(resolve_zone(bf, np, 1, &mpos) == -1 &&
+     !(bf->bf_ra_busy && np >= bf->bf_ra_busy_pos && np < bf->bf_ra_pos)) {
+
+    // Not cached and not on its way, restart fetcher at new position
+    fab_ra_retarget(bf, np);
+
+    bf->bf_ra_claimed++;
+    while(bf->bf_ra_busy)
+      hts_cond_wait(&bf->bf_ra_cond, &bf->bf_ra_mutex);
+    hts_mutex_unlock(&bf->bf_ra_mutex);
+
+    const int ok = src->fh_proto->fap_seek(src, np, SEEK_SET, lazy) == np;
+
+    hts_mutex_lock(&bf->bf_ra_mutex);
+    bf->bf_ra_claimed--;
+
+    if(!ok) {
+      fab_ra_retarget(bf, bf->bf_fpos);
+      hts_mutex_unlock(&bf->bf_ra_mutex);
+      return -1;
+    }
+  }
+
+  bf->bf_fpos = np;
+  hts_cond_broadcast(&bf->bf_ra_cond);
+  hts_mutex_unlock(&bf->bf_ra_mutex);
+  return np;
+}
+
+
 /**
  *
  */
@@ -334,7 +485,9 @@ fab_seek(fa_handle_t *handle, int64_t pos, int whence, int lazy)
     break;
 
   case SEEK_END:
+    fab_src_claim(bf);
     np = src->fh_proto->fap_seek(src, pos, whence, lazy);
+    fab_src_release(bf);
     break;
 
   default:
@@ -344,6 +497,9 @@ fab_seek(fa_handle_t *handle, int64_t pos, int whence, int lazy)
   if(np < 0)
     return -1;
 
+  if(bf->bf_ra_running)
+    return fab_seek_ra(bf, np, lazy);
+
   int mpos;
   int cs = resolve_zone(bf, np, 1, &mpos);
 
@@ -367,12 +523,26 @@ static int64_t
 fab_fsize(fa_handle_t *handle)
 {
   buffered_file_t *bf = (buffered_file_t *)handle;
-  if(bf->bf_size != -1)
-    return bf->bf_size;
-
   fa_handle_t *src = bf->bf_src;
-  bf->bf_size = src->fh_proto->fap_fsize(src);
-  return bf->bf_size;
+  int64_t size;
+
+  if(bf->bf_ra_running) {
+    hts_mutex_lock(&bf->bf_ra_mutex);
+    size = bf->bf_size;
+    hts_mutex_unlock(&bf->bf_ra_mutex);
+  } else {
+    size = bf->bf_size;
+  }
+
+  if(size != -1)
+    return size;
+
+  fab_src_claim(bf);
+  if(bf->bf_size == -1)
+    bf->bf_size = src->fh_proto->fap_fsize(src);
+  size = bf->bf_size;
+  fab_src_release(bf);
+  return size;
 }
 
 
@@ -380,7 +550,8 @@ fab_fsize(fa_handle_t *handle)
  *
  */
 static void
-store_in_cache(buffered_file_t *bf, const void *buf, size_t size)
+store_in_cache(buffered_file_t *bf, const void *buf, size_t size,
+               int64_t fpos)
 {
   if(size > bf->bf_mem_size)
     return;
@@ -396,7 +567,7 @@ store_in_cache(buffered_file_t *bf, const void *buf, size_t size)
 
   erase_zone(bf, bf->bf_mem_ptr, s1);
 
-  map_zone(bf, bf->bf_mem_ptr, s1, bf->bf_fpos);
+  map_zone(bf, bf->bf_mem_ptr, s1, fpos);
   memcpy(bf->bf_mem + bf->bf_mem_ptr, buf, s1);
 
   bf->bf_mem_ptr += s1;
@@ -408,7 +579,7 @@ store_in_cache(buffered_file_t *bf, const void *buf, size_t size)
   if(s2 > 0) {
     erase_zone(bf, bf->bf_mem_ptr, s2);
 
-    map_zone(bf, bf->bf_mem_ptr, s2, bf->bf_fpos + s1);
+    map_zone(bf, bf->bf_mem_ptr, s2, fpos + s1);
     memcpy(bf->bf_mem + bf->bf_mem_ptr, buf + s1, s2);
 
     bf->bf_mem_ptr += s2;
@@ -417,21 +588,223 @@ store_in_cache(buffered_file_t *bf, const void *buf, size_t size)
 
 
 
+/**
+ * Fetcher thread
+ */
+static void *
+fab_ra_thread(void *aux)
+{
+  buffered_file_t *bf = aux;
+  fa_handle_t *src = bf->bf_src;
+  int mpos, cs;
+
+  hts_mutex_lock(&bf->bf_ra_mutex);
+
+  while(!bf->bf_ra_stop) {
+
+    while((cs = resolve_zone(bf, bf->bf_ra_pos, INT32_MAX, &mpos)) > 0)
+      bf->bf_ra_pos += cs;
+
+    if(bf->bf_ra_pos < bf->bf_fpos) {
+      bf->bf_ra_pos = bf->bf_fpos;
+      continue;
+    }
+
+    if(bf->bf_ra_claimed || bf->bf_ra_error ||
+       (bf->bf_size != -1 && bf->bf_ra_pos >= bf->bf_size) ||
+       bf->bf_ra_pos - bf->bf_fpos >= bf->bf_ra_window) {
+      hts_cond_wait(&bf->bf_ra_cond, &bf->bf_ra_mutex);
+      continue;
+    }
+
+    const int64_t pos = bf->bf_ra_pos;
+    const int gen = bf->bf_ra_gen;
+    int len = bf->bf_min_request;
+    if(bf->bf_size != -1)
+      len = MIN(len, bf->bf_size - pos);
+
+    bf->bf_ra_busy = 1;
+    bf->bf_ra_busy_pos = pos;
+    bf->bf_ra_pos = pos + len;
+    hts_mutex_unlock(&bf->bf_ra_mutex);
+
+    int r = -1;
+    if(src->fh_proto->fap_seek(src, pos, SEEK_SET, 0) == pos)
+      r = src->fh_proto->fap_read(src, bf->bf_ra_buf, len);
+
+    hts_mutex_lock(&bf->bf_ra_mutex);
+    bf->bf_ra_busy = 0;
+
+    if(bf->bf_ra_cancelled) {
+      // We aborted this fetch ourselves, make the source usable again
+      // unless the user cancelled as well
+      bf->bf_ra_cancelled = 0;
+      if(!bf->bf_user_cancelled) {
+        cancellable_reset(bf->bf_outbound_cancellable);
+        if(bf->bf_user_cancelled)
+          cancellable_cancel(bf->bf_outbound_cancellable);
+      }
+    }
+
+    if(gen == bf->bf_ra_gen) {
+      if(r > 0)
+        store_in_cache(bf, bf->bf_ra_buf, r, pos);
+
+      if(r < 0) {
+        bf->bf_ra_error = 1;
+        bf->bf_ra_pos = pos;
+      } else if(r != len) {
+        bf->bf_size = pos + r;
+        bf->bf_ra_pos = pos + r;
+      }
+    }
+    hts_cond_broadcast(&bf->bf_ra_cond);
+  }
+  hts_mutex_unlock(&bf->bf_ra_mutex);
+  return NULL;
+}
+
+
 /**
  *
  */
+static void
+fab_ra_start(buffered_file_t *bf)
+{
+  bf->bf_ra_buf = malloc(bf->bf_min_request);
+  bf->bf_ra_pos = bf->bf_fpos;
+  bf->bf_ra_window = 2 * bf->bf_min_request;
+  bf->bf_ra_rate = 0;
+  bf->bf_ra_rate_ts = arch_get_ts();
+  bf->bf_ra_rate_bytes = 0;
+  bf->bf_ra_rate_stall = bf->bf_ra_stall;
+  bf->bf_ra_stop = 0;
+  bf->bf_ra_running = 1;
+  hts_thread_create_joinable("fa readahead", &bf->bf_ra_thread,
+                             fab_ra_thread, bf, THREAD_PRIO_DEMUXER);
+}
+
+
+/**
+ *
+ */
+static void
+fab_ra_stop(buffered_file_t *bf)
+{
+  if(!bf->bf_ra_running)
+    return;
+
+  hts_mutex_lock(&bf->bf_ra_mutex);
+  bf->bf_ra_stop = 1;
+  fab_ra_retarget(bf, bf->bf_fpos);
+  hts_mutex_unlock(&bf->bf_ra_mutex);
+
+  hts_thread_join(&bf->bf_ra_thread);
+  bf->bf_ra_running = 0;
+  bf->bf_ra_seq = 0;
+  free(bf->bf_ra_buf);
+  bf->bf_ra_buf = NULL;
+}
+
+
+/**
+ * Size the window to hold RA_WINDOW_SECONDS worth of data at the rate
+ * the reader consumes it. Time spent waiting for the fetcher does not
+ * count, otherwise a starved reader would shrink its own window.
+ * bf_ra_mutex must be held
+ */
+static void
+fab_ra_update_rate(buffered_file_t *bf, int bytes)
+{
+  const int64_t now = arch_get_ts();
+
+  bf->bf_ra_rate_bytes += bytes;
+
+  const int64_t delta = now - bf->bf_ra_rate_ts -
+    (bf->bf_ra_stall - bf->bf_ra_rate_stall);
+
+  if(delta < RA_RATE_INTERVAL)
+    return;
+
+  const int rate = bf->bf_ra_rate_bytes * 1000000 / delta;
+  bf->bf_ra_rate = bf->bf_ra_rate ? (bf->bf_ra_rate * 3 + rate) / 4 : rate;
+
+  bf->bf_ra_rate_ts = now;
+  bf->bf_ra_rate_bytes = 0;
+  bf->bf_ra_rate_stall = bf->bf_ra_stall;
+
+  // Leave room for the chunk in flight and some data behind the reader
+  const int64_t max = bf->bf_mem_size * 3 / 4 - bf->bf_min_request;
+  const int64_t min = 2 * bf->bf_min_request;
+  bf->bf_ra_window = MAX(MIN((int64_t)bf->bf_ra_rate * RA_WINDOW_SECONDS,
+                             max), min);
+}
+
+
+/**
+ * Read while the fetcher thread is running, data is only taken from
+ * the cache
+ */
 static int
-fab_read(fa_handle_t *handle, void *buf, size_t size)
+fab_read_ra(buffered_file_t *bf, void *buf, size_t size)
 {
-  buffered_file_t *bf = (buffered_file_t *)handle;
-  fa_handle_t *src = bf->bf_src;
+  int rval = 0;
+  int mpos;
 
-  if(bf->bf_mem == NULL) {
-    bf->bf_mem = halloc(bf->bf_mem_size);
-    if(bf->bf_mem == NULL)
-      return -1;
+  hts_mutex_lock(&bf->bf_ra_mutex);
+
+  if(bf->bf_size != -1 && bf->bf_fpos + size > bf->bf_size)
+    size = bf->bf_size - bf->bf_fpos;
+
+  while(size > 0) {
+    int cs = resolve_zone(bf, bf->bf_fpos, size, &mpos);
+    if(cs > 0) {
+      memcpy(buf, bf->bf_mem + mpos, cs);
+      rval += cs;
+      buf += cs;
+      bf->bf_fpos += cs;
+      size -= cs;
+      continue;
+    }
+
+    if(bf->bf_size != -1 && bf->bf_fpos >= bf->bf_size)
+      break;
+
+    if(bf->bf_ra_error) {
+      bf->bf_ra_error = 0;
+      if(rval == 0)
+        rval = -1;
+      break;
+    }
+
+    if(bf->bf_fpos != bf->bf_ra_pos &&
+       !(bf->bf_ra_busy && bf->bf_fpos >= bf->bf_ra_busy_pos &&
+         bf->bf_fpos < bf->bf_ra_pos))
+      fab_ra_retarget(bf, bf->bf_fpos);
+
+    hts_cond_broadcast(&bf->bf_ra_cond);
+    const int64_t ts = arch_get_ts();
+    hts_cond_wait(&bf->bf_ra_cond, &bf->bf_ra_mutex);
+    bf->bf_ra_stall += arch_get_ts() - ts;
   }
 
+  if(rval > 0)
+    fab_ra_update_rate(bf, rval);
+
+  hts_cond_broadcast(&bf->bf_ra_cond);
+  hts_mutex_unlock(&bf->bf_ra_mutex);
+  return rval;
+}
+
+
+/**
+ *
+ */
+static int
+fab_read_sync(buffered_file_t *bf, void *buf, size_t size)
+{
+  fa_handle_t *src = bf->bf_src;
+
   if(bf->bf_size != -1 && bf->bf_fpos + size > bf->bf_size)
     size = bf->bf_size - bf->bf_fpos;
 
@@ -457,7 +830,7 @@ fab_read(fa_handle_t *handle, void *buf, size_t size)
 
       int r = src->fh_proto->fap_read(src, buf, rreq);
       if(r > 0) {
-	store_in_cache(bf, buf, r);
+	store_in_cache(bf, buf, r, bf->bf_fpos);
 	rval += r;
 	buf += r;
 	bf->bf_fpos += r;
@@ -508,6 +881,43 @@ fab_read(fa_handle_t *handle, void *buf, size_t size)
 }
 
 
+/**
+ *
+ */
+static int
+fab_read(fa_handle_t *handle, void *buf, size_t size)
+{
+  buffered_file_t *bf = (buffered_file_t *)handle;
+
+  if(bf->bf_mem == NULL) {
+    bf->bf_mem = halloc(bf->bf_mem_size);
+    if(bf->bf_mem == NULL)
+      return -1;
+  }
+
+  if(bf->bf_ra_running)
+    return fab_read_ra(bf, buf, size);
+
+  if(bf->bf_ra_enabled) {
+    // Short skips back and forth are still considered sequential
+    if(llabs(bf->bf_fpos - bf->bf_ra_seq_pos) > bf->bf_min_request)
+      bf->bf_ra_seq = 0;
+
+    if(bf->bf_ra_seq >= RA_START_THRESHOLD) {
+      fab_ra_start(bf);
+      return fab_read_ra(bf, buf, size);
+    }
+
+    int r = fab_read_sync(bf, buf, size);
+    if(r > 0)
+      bf->bf_ra_seq += r;
+    bf->bf_ra_seq_pos = bf->bf_fpos;
+    return r;
+  }
+  return fab_read_sync(bf, buf, size);
+}
+
+
 #if BF_CHK
 static int
 fab_read_chk(fa_handle_t *handle, void *buf, size_t size)
@@ -556,8 +966,11 @@ fab_set_read_timeout(fa_handle_t *handle, int ms)
 {
   buffered_file_t *bf = (buffered_file_t *)handle;
   fa_handle_t *fh = bf->bf_src;
-  if(fh->fh_proto->fap_set_read_timeout != NULL)
+  if(fh->fh_proto->fap_set_read_timeout != NULL) {
+    fab_src_claim(bf);
     fh->fh_proto->fap_set_read_timeout(fh, ms);
+    fab_src_release(bf);
+  }
 }
 
 
@@ -589,9 +1002,35 @@ static void
 fab_cancel(void *aux)
 {
   buffered_file_t *bf = aux;
+  bf->bf_user_cancelled = 1;
   cancellable_cancel_locked(bf->bf_outbound_cancellable);
 }
 
+/**
+ *
+ */
+static void
+fab_init(buffered_file_t *bf, fa_handle_t *src, int mflags, int flags)
+{
+  if(!(mflags & FA_BUFFERED_NO_PREFETCH))
+    bf->bf_min_request = mflags & FA_BUFFERED_BIG ? 256 * 1024 : 64 * 1024;
+  bf->bf_mem_size = 1024 * 1024;
+  bf->bf_flags = flags;
+
+  if(mflags & FA_BUFFERED_BIG && !(mflags & FA_BUFFERED_NO_PREFETCH)) {
+    bf->bf_ra_enabled = 1;
+    bf->bf_mem_size = RA_MEM_SIZE;
+  }
+
+  hts_mutex_init(&bf->bf_ra_mutex);
+  hts_cond_init(&bf->bf_ra_cond, &bf->bf_ra_mutex);
+
+  bf->bf_src = src;
+  bf->bf_size = -1;
+  bf->h.fh_proto = &fa_protocol_buffered;
+}
+
+
 /**
  *
  */
@@ -640,6 +1079,9 @@ fa_buffered_open(const char *url, char *errbuf, size_t errsize, int flags,
   int mflags = flags;
   flags &= ~ (FA_BUFFERED_SMALL | FA_BUFFERED_BIG | FA_BUFFERED_NO_PREFETCH);
 
+  if(mflags & FA_BUFFERED_BIG)
+    flags |= FA_PARALLEL;
+
   fa_open_extra_t new_foe;
 
   buffered_file_t *bf = calloc(1, sizeof(buffered_file_t));
@@ -669,16 +1111,196 @@ fa_buffered_open(const char *url, char *errbuf, size_t errsize, int flags,
   }
 
   bf->bf_url = strdup(url);
-  if(!(mflags & FA_BUFFERED_NO_PREFETCH))
-    bf->bf_min_request = mflags & FA_BUFFERED_BIG ? 256 * 1024 : 64 * 1024;
-  bf->bf_mem_size = 1024 * 1024;
-  bf->bf_flags = flags;
-
-  bf->bf_src = fh;
-  bf->bf_size = -1;
-  bf->h.fh_proto = &fa_protocol_buffered;
+  fab_init(bf, fh, mflags, flags);
 #if BF_CHK
   bf->bf_chk = fa_open_ex(url, NULL, 0, 0, NULL);
 #endif
   return &bf->h;
 }
+
+
+/**
+ * Benchmark
+ *
+ * Plays back from a throttled source where every request costs a fixed
+ * latency plus transfer time, as a remote HTTP or SMB server would.
+ * Packets are read at a constant bitrate with a jump forward every
+ * second and a short step back in between. The time spent blocked in
+ * fab_read() is measured with and without read-ahead, and all data
+ * returned is verified.
+ */
+#define FABBENCH_FILESIZE  (256 * 1024 * 1024)
+#define FABBENCH_LATENCY   15000
+#define FABBENCH_BANDWIDTH (8 * 1024 * 1024)
+#define FABBENCH_BITRATE   (2 * 1024 * 1024)
+#define FABBENCH_PACKET    (32 * 1024)
+#define FABBENCH_DURATION  3000000
+
+typedef struct fabbench_src {
+  fa_handle_t h;
+  int64_t fs_fpos;
+  cancellable_t *fs_cancellable;
+  int fs_requests;
+  int fs_aborted;
+} fabbench_src_t;
+
+
+static uint8_t
+fabbench_byte(int64_t o)
+{
+  return o ^ (o >> 11) ^ (o >> 19);
+}
+
+
+static int
+fabbench_src_read(fa_handle_t *fh, void *buf, size_t size)
+{
+  fabbench_src_t *fs = (fabbench_src_t *)fh;
+  uint8_t *u8 = buf;
+
+  size = MIN(size, MAX(FABBENCH_FILESIZE - fs->fs_fpos, 0));
+
+  const int64_t done = arch_get_ts() + FABBENCH_LATENCY +
+    size * 1000000LL / FABBENCH_BANDWIDTH;
+
+  fs->fs_requests++;
+  while(arch_get_ts() < done) {
+    if(cancellable_is_cancelled(fs->fs_cancellable)) {
+      fs->fs_aborted++;
+      return -1;
+    }
+    usleep(1000);
+  }
+
+  for(int i = 0; i < size; i++)
+    u8[i] = fabbench_byte(fs->fs_fpos + i);
+  fs->fs_fpos += size;
+  return size;
+}
+
+
+static int64_t
+fabbench_src_seek(fa_handle_t *fh, int64_t pos, int whence, int lazy)
+{
+  fabbench_src_t *fs = (fabbench_src_t *)fh;
+  if(whence == SEEK_END)
+    pos += FABBENCH_FILESIZE;
+  else if(whence == SEEK_CUR)
+    pos += fs->fs_fpos;
+  if(pos < 0 || pos > FABBENCH_FILESIZE)
+    return -1;
+  fs->fs_fpos = pos;
+  return pos;
+}
+
+
+static int64_t
+fabbench_src_fsize(fa_handle_t *fh)
+{
+  return FABBENCH_FILESIZE;
+}
+
+
+static void
+fabbench_src_close(fa_handle_t *fh)
+{
+  free(fh);
+}
+
+
+static fa_protocol_t fabbench_src_protocol = {
+  .fap_name  = "fabbench",
+  .fap_close = fabbench_src_close,
+  .fap_read  = fabbench_src_read,
+  .fap_seek  = fabbench_src_seek,
+  .fap_fsize = fabbench_src_fsize,
+};
+
+
+static void
+fabbench_run(const char *name, int readahead)
+{
+  fabbench_src_t *fs = calloc(1, sizeof(fabbench_src_t));
+  buffered_file_t *bf = calloc(1, sizeof(buffered_file_t));
+  uint8_t *pkt = malloc(FABBENCH_PACKET);
+  int64_t stall = 0, pos = 0;
+  int reads = 0, slow = 0, errors = 0;
+
+  fs->h.fh_proto = &fabbench_src_protocol;
+  bf->bf_outbound_cancellable = cancellable_create();
+  fs->fs_cancellable = bf->bf_outbound_cancellable;
+  bf->bf_url = strdup("fabbench");
+  fab_init(bf, &fs->h, FA_BUFFERED_BIG, 0);
+  bf->bf_ra_enabled = readahead;
+
+  const int64_t start = arch_get_ts();
+
+  for(int i = 0; ; i++) {
+    const int64_t due = start +
+      (int64_t)i * FABBENCH_PACKET * 1000000 / FABBENCH_BITRATE;
+    if(due > start + FABBENCH_DURATION)
+      break;
+
+    const int64_t now = arch_get_ts();
+    if(due > now)
+      usleep(due - now);
+
+    if(i % 64 == 63)
+      pos += 20 * 1024 * 1024;
+    else if(i % 64 == 31)
+      pos -= 64 * 1024;
+
+    int64_t ts = arch_get_ts();
+    if(fab_seek(&bf->h, pos, SEEK_SET, 0) != pos) {
+      errors++;
+      break;
+    }
+    int r = fab_read(&bf->h, pkt, FABBENCH_PACKET);
+    ts = arch_get_ts() - ts;
+
+    reads++;
+    stall += ts;
+    if(ts > 10000)
+      slow++;
+
+    if(r != FABBENCH_PACKET) {
+      errors++;
+      break;
+    }
+
+    for(int j = 0; j < r; j++) {
+      if(pkt[j] != fabbench_byte(pos + j)) {
+        errors++;
+        break;
+      }
+    }
+    pos += r;
+  }
+
+  const int window = bf->bf_ra_window;
+  const int64_t ra_stall = bf->bf_ra_stall;
+  const int requests = fs->fs_requests;
+  const int aborted = fs->fs_aborted;
+
+  fab_close(&bf->h);
+  free(pkt);
+
+  printf("fa-buffer: %-10s %d reads  blocked %d ms  %d reads > 10ms  "
+         "%d source requests (%d aborted)\n",
+         name, reads, (int)(stall / 1000), slow, requests, aborted);
+  if(readahead)
+    printf("fa-buffer: %-10s waited for fetcher %d ms, final window %d kB\n",
+           name, (int)(ra_stall / 1000), window / 1024);
+  if(errors)
+    printf("fa-buffer: %-10s %d errors\n", name, errors);
+}
+
+
+static void
+fabbench(void)
+{
+  fabbench_run("sync", 0);
+  fabbench_run("readahead", 1);
+}
+
+BENCHMARK("fa-buffer", fabbench);
@@ -55,6 +55,7 @@ typedef struct fa_bundle_fh {
   const unsigned char *ptr;
   int size;
   int pos;
+  buf_t *buf;
 } fa_bundle_fh_t;
 
 
@@ -115,6 +116,8 @@ b_open(fa_protocol_t *fap, const char *url, char *errbuf, size_t errlen,
 static void
 b_close(fa_handle_t *fh0)
 {
+  fa_bundle_fh_t *fh = (fa_bundle_fh_t *)fh0;
+  buf_release(fh->buf);
   free(fh0);
 }
 
@@ -492,3 +495,18 @@ memfile_make(const void *mem, size_t len)
   fh->h.fh_proto = &fa_protocol_memfile;
   return &fh->h;
 }
+
+
+/**
+ * Same as memfile_make() but the handle keeps a reference to 'b'
+ */
+fa_handle_t *
+memfile_make_buf(buf_t *b)
+{
+  fa_bundle_fh_t *fh = calloc(1, sizeof(fa_bundle_fh_t));
+  fh->buf = buf_retain(b);
+  fh->ptr = b->b_ptr;
+  fh->size = b->b_size;
+  fh->h.fh_proto = &fa_protocol_memfile;
+  return &fh->h;
+}
@@ -39,3 +39,4 @@
 #define FA_NON_INTERACTIVE      0x20000 // No auth popups, etc
 #define FA_NO_COOKIES           0x40000
 #define FA_SSL_VERIFY           0x80000
+#define FA_PARALLEL             0x100000 // Allow fetching over several connections
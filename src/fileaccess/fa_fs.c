@@ -352,6 +352,23 @@ fs_seek(fa_handle_t *fh0, int64_t pos, int whence, int lazy)
   return lseek(fh->parts[pn].fd, pos, SEEK_SET);
 }
 
+/**
+ * Positional read
+ */
+static int
+fs_pread(fa_handle_t *fh0, void *buf, size_t size, int64_t offset)
+{
+  fs_handle_t *fh = (fs_handle_t *)fh0;
+  if(fh->part_count == 1)
+    return pread(fh->parts[0].fd, buf, size, offset);
+
+  // Split files are never shared between threads so this is fine
+  if(fs_seek(fh0, offset, SEEK_SET, 0) < 0)
+    return -1;
+  return fs_read(fh0, buf, size);
+}
+
+
 /**
  * Return size of file
  */
@@ -868,6 +885,7 @@ fa_protocol_t fa_protocol_fs = {
   .fap_open  = fs_open,
   .fap_close = fs_close,
   .fap_read  = fs_read,
+  .fap_pread = fs_pread,
   .fap_write = fs_write,
   .fap_seek  = fs_seek,
   .fap_fsize = fs_fsize,
@@ -34,6 +34,9 @@
 #include "fileaccess.h"
 #include "http_client.h"
 #include "networking/net.h"
+#if ENABLE_BENCHMARKS
+#include "networking/http_bench_server.h"
+#endif
 #include "fa_proto.h"
 #include "task.h"
 #include "htsmsg/htsmsg_xml.h"
@@ -68,6 +71,9 @@ static struct http_request_inspector_list http_request_inspectors;
 
 static int http_tokenize(char *buf, char **vec, int vecsize, int delimiter);
 
+struct http_parallel;
+static void http_par_stop(struct http_parallel *hp);
+
 
 #define HTTP_TRACE(dbg, x, ...) do {                    \
     if(dbg)                                             \
@@ -210,6 +216,9 @@ typedef struct http_file {
 
   int hf_id;
 
+  char hf_parallel_ok;
+  struct http_parallel *hf_parallel;
+
 } http_file_t;
 
 
@@ -1761,6 +1770,9 @@ http_open0(http_file_t *hf, int probe, char *errbuf, int errlen,
 static void
 http_destroy(http_file_t *hf)
 {
+  if(hf->hf_parallel != NULL)
+    http_par_stop(hf->hf_parallel);
+
   http_detach(hf,
 	      hf->hf_rsize == 0 &&
 	      hf->hf_connection_mode == CONNECTION_MODE_PERSISTENT,
@@ -1790,7 +1802,10 @@ http_open_ex(fa_protocol_t *fap, const char *url, char *errbuf, size_t errlen,
   hf->hf_url = strdup(url);
   if(!(flags & FA_NO_DEBUG))
     hf->hf_debug = !!(flags & FA_DEBUG) || gconf.enable_http_debug;
-  hf->hf_streaming = !!(flags & FA_STREAMING);
+  hf->hf_parallel_ok = gconf.enable_http_parallel &&
+    flags & (FA_STREAMING | FA_PARALLEL);
+  // Parallel fetch needs ranges, so open with a range request
+  hf->hf_streaming = !!(flags & FA_STREAMING) && !hf->hf_parallel_ok;
   hf->hf_no_retries = !!(flags & FA_NO_RETRIES);
   hf->hf_no_cookies = !!(flags & FA_NO_COOKIES);
   hf->hf_ssl_verify = !!(flags & FA_SSL_VERIFY);
@@ -2092,15 +2107,401 @@ http_read_i(http_file_t *hf, void *buf, const size_t size)
 }
 
 
+/**
+ * Parallel range fetching
+ *
+ * Handles opened with FA_PARALLEL or FA_STREAMING (and the feature
+ * enabled in settings) that have been read sequentially long enough to
+ * otherwise switch to a streaming request are instead fetched as fixed
+ * size segments ahead of the read position. Each worker thread has its
+ * own clone of the http_file and thus its own connection from the
+ * pool, so on high latency links several requests are in flight at
+ * once. The reader picks up finished segments in order.
+ *
+ * Segments and the fields in http_parallel_t are protected by
+ * hp_mutex. The handle's cancellable is forwarded to per worker
+ * cancellables so a cancel aborts all requests in flight.
+ */
+#define HTTP_PAR_WORKERS      4
+#define HTTP_PAR_SEGMENTS     8
+#define HTTP_PAR_SEGMENT_SIZE (512 * 1024)
+
+TAILQ_HEAD(http_segment_queue, http_segment);
+
+typedef struct http_segment {
+  TAILQ_ENTRY(http_segment) hs_link;
+  int64_t hs_start;
+  int hs_size;
+  int hs_len;        // Bytes received, less than hs_size on early EOF
+  enum {
+    HS_QUEUED,
+    HS_FETCHING,
+    HS_DONE,
+    HS_FAILED,
+  } hs_state;
+  char hs_dropped;   // Removed while fetching, worker frees it
+  uint8_t hs_data[0];
+} http_segment_t;
+
+typedef struct http_worker {
+  struct http_parallel *hw_hp;
+  http_file_t *hw_hf;
+  cancellable_t *hw_cancellable;
+  hts_thread_t hw_thread;
+} http_worker_t;
+
+typedef struct http_parallel {
+  hts_mutex_t hp_mutex;
+  hts_cond_t hp_cond;
+  struct http_segment_queue hp_segments;
+  int hp_num_segments;
+  int64_t hp_next;   // Start of next segment to queue
+  int hp_stop;
+  int hp_cancelled;
+  int hp_epoch;      // Bumped when resuming after cancel
+  cancellable_t *hp_cancellable;
+  http_worker_t hp_workers[HTTP_PAR_WORKERS];
+} http_parallel_t;
+
+
+/**
+ * Create a file that requests the same resource as 'src'
+ */
+static http_file_t *
+http_clone(const http_file_t *src, cancellable_t *c)
+{
+  http_file_t *hf = calloc(1, sizeof(http_file_t));
+  hf->hf_id = atomic_add_and_fetch(&http_file_tally, 1);
+  hf->hf_version = src->hf_version;
+  hf->hf_url = strdup(src->hf_url);
+  if(src->hf_original_url != NULL)
+    hf->hf_original_url = strdup(src->hf_original_url);
+  if(src->hf_auth != NULL)
+    hf->hf_auth = strdup(src->hf_auth);
+  if(src->hf_auth_realm != NULL)
+    hf->hf_auth_realm = strdup(src->hf_auth_realm);
+  hf->hf_ext_auth = src->hf_ext_auth;
+  hf->hf_debug = src->hf_debug;
+  hf->hf_ssl_verify = src->hf_ssl_verify;
+  hf->hf_no_cookies = src->hf_no_cookies;
+  hf->hf_connect_timeout = src->hf_connect_timeout;
+  hf->hf_read_timeout = src->hf_read_timeout;
+  hf->hf_filesize = src->hf_filesize;
+  hf->hf_user_request_headers = src->hf_user_request_headers;
+  hf->hf_cancellable = c;
+  return hf;
+}
+
+
+/**
+ * Remove segment from queue. hp_mutex must be held
+ */
+static void
+http_par_drop(http_parallel_t *hp, http_segment_t *hs)
+{
+  TAILQ_REMOVE(&hp->hp_segments, hs, hs_link);
+  hp->hp_num_segments--;
+  if(hs->hs_state == HS_FETCHING)
+    hs->hs_dropped = 1;
+  else
+    free(hs);
+}
+
+
+/**
+ * Make sure the first segment covers 'pos' and queue segments after it
+ * up to the limit. hp_mutex must be held
+ */
+static void
+http_par_schedule(http_parallel_t *hp, int64_t pos, int64_t filesize)
+{
+  http_segment_t *hs;
+
+  while((hs = TAILQ_FIRST(&hp->hp_segments)) != NULL) {
+    if(pos >= hs->hs_start && pos < hs->hs_start + hs->hs_size)
+      break;
+
+    if(pos < hs->hs_start || pos >= hp->hp_next) {
+      // Seeked outside of what we have queued, start over
+      while((hs = TAILQ_FIRST(&hp->hp_segments)) != NULL)
+        http_par_drop(hp, hs);
+      break;
+    }
+    http_par_drop(hp, hs);
+  }
+
+  if(TAILQ_FIRST(&hp->hp_segments) == NULL)
+    hp->hp_next = pos;
+
+  while(hp->hp_num_segments < HTTP_PAR_SEGMENTS && hp->hp_next < filesize) {
+    const int size = MIN(HTTP_PAR_SEGMENT_SIZE, filesize - hp->hp_next);
+    hs = malloc(sizeof(http_segment_t) + size);
+    hs->hs_start = hp->hp_next;
+    hs->hs_size = size;
+    hs->hs_len = 0;
+    hs->hs_state = HS_QUEUED;
+    hs->hs_dropped = 0;
+    TAILQ_INSERT_TAIL(&hp->hp_segments, hs, hs_link);
+    hp->hp_num_segments++;
+    hp->hp_next += size;
+    hts_cond_broadcast(&hp->hp_cond);
+  }
+}
+
+
+/**
+ *
+ */
+static void *
+http_par_worker(void *aux)
+{
+  http_worker_t *hw = aux;
+  http_parallel_t *hp = hw->hw_hp;
+  http_file_t *hf = hw->hw_hf;
+  http_segment_t *hs;
+
+  hts_mutex_lock(&hp->hp_mutex);
+
+  while(!hp->hp_stop) {
+
+    TAILQ_FOREACH(hs, &hp->hp_segments, hs_link)
+      if(hs->hs_state == HS_QUEUED)
+        break;
+
+    if(hs == NULL || hp->hp_cancelled) {
+      hts_cond_wait(&hp->hp_cond, &hp->hp_mutex);
+      continue;
+    }
+
+    hs->hs_state = HS_FETCHING;
+    const int epoch = hp->hp_epoch;
+    hts_mutex_unlock(&hp->hp_mutex);
+
+    if(hf->hf_rsize != 0)
+      http_detach(hf, 0, "Stale data on connection");
+
+    // Request exactly this segment, never switch to streaming
+    hf->hf_pos = hs->hs_start;
+    hf->hf_consecutive_read = 0;
+    const int r = http_read_i(hf, hs->hs_data, hs->hs_size);
+
+    hts_mutex_lock(&hp->hp_mutex);
+    if(hs->hs_dropped) {
+      free(hs);
+    } else if(r < 0) {
+      // If it was aborted by a cancel that has since been undone, retry
+      hs->hs_state = epoch != hp->hp_epoch ? HS_QUEUED : HS_FAILED;
+    } else {
+      hs->hs_len = r;
+      hs->hs_state = HS_DONE;
+    }
+    hts_cond_broadcast(&hp->hp_cond);
+  }
+
+  hts_mutex_unlock(&hp->hp_mutex);
+  return NULL;
+}
+
+
+/**
+ * Called with the cancellable lock held
+ */
+static void
+http_par_cancel(void *aux)
+{
+  http_parallel_t *hp = aux;
+
+  for(int i = 0; i < HTTP_PAR_WORKERS; i++)
+    cancellable_cancel_locked(hp->hp_workers[i].hw_cancellable);
+
+  hts_mutex_lock(&hp->hp_mutex);
+  hp->hp_cancelled = 1;
+  hts_cond_broadcast(&hp->hp_cond);
+  hts_mutex_unlock(&hp->hp_mutex);
+}
+
+
+/**
+ *
+ */
+static void
+http_par_start(http_file_t *hf)
+{
+  http_parallel_t *hp = calloc(1, sizeof(http_parallel_t));
+
+  HF_TRACE(hf, "%s: switching to parallel fetch", hf->hf_url);
+
+  hts_mutex_init(&hp->hp_mutex);
+  hts_cond_init(&hp->hp_cond, &hp->hp_mutex);
+  TAILQ_INIT(&hp->hp_segments);
+
+  // From now on all requests are made by the workers
+  http_detach(hf,
+              hf->hf_rsize == 0 &&
+              hf->hf_connection_mode == CONNECTION_MODE_PERSISTENT,
+              "Switching to parallel fetch");
+
+  for(int i = 0; i < HTTP_PAR_WORKERS; i++) {
+    http_worker_t *hw = &hp->hp_workers[i];
+    hw->hw_hp = hp;
+    hw->hw_cancellable = cancellable_create();
+    hw->hw_hf = http_clone(hf, hw->hw_cancellable);
+    hts_thread_create_joinable("http worker", &hw->hw_thread,
+                               http_par_worker, hw, THREAD_PRIO_FILESYSTEM);
+  }
+
+  if(hf->hf_cancellable != NULL)
+    hp->hp_cancellable = cancellable_bind(hf->hf_cancellable,
+                                          http_par_cancel, hp);
+  hf->hf_parallel = hp;
+}
+
+
+/**
+ *
+ */
+static void
+http_par_stop(http_parallel_t *hp)
+{
+  http_segment_t *hs;
+  int busy = 0;
+
+  cancellable_unbind(hp->hp_cancellable, hp);
+
+  hts_mutex_lock(&hp->hp_mutex);
+  hp->hp_stop = 1;
+  TAILQ_FOREACH(hs, &hp->hp_segments, hs_link)
+    if(hs->hs_state == HS_FETCHING)
+      busy = 1;
+  hts_cond_broadcast(&hp->hp_cond);
+  hts_mutex_unlock(&hp->hp_mutex);
+
+  for(int i = 0; i < HTTP_PAR_WORKERS; i++) {
+    http_worker_t *hw = &hp->hp_workers[i];
+    if(busy)
+      cancellable_cancel(hw->hw_cancellable);
+    hts_thread_join(&hw->hw_thread);
+    http_destroy(hw->hw_hf);
+  }
+
+  while((hs = TAILQ_FIRST(&hp->hp_segments)) != NULL)
+    http_par_drop(hp, hs);
+
+  hts_cond_destroy(&hp->hp_cond);
+  hts_mutex_destroy(&hp->hp_mutex);
+  free(hp);
+}
+
+
+/**
+ * A cancel of the handle has been undone (cancellable_reset()), get
+ * the workers going again
+ */
+static void
+http_par_resume(http_file_t *hf, http_parallel_t *hp)
+{
+  http_segment_t *hs;
+
+  for(int i = 0; i < HTTP_PAR_WORKERS; i++)
+    cancellable_reset(hp->hp_workers[i].hw_cancellable);
+
+  cancellable_unbind(hp->hp_cancellable, hp);
+  hp->hp_cancellable = cancellable_bind(hf->hf_cancellable,
+                                        http_par_cancel, hp);
+
+  hts_mutex_lock(&hp->hp_mutex);
+  hp->hp_cancelled = 0;
+  hp->hp_epoch++;
+  TAILQ_FOREACH(hs, &hp->hp_segments, hs_link)
+    if(hs->hs_state == HS_FAILED)
+      hs->hs_state = HS_QUEUED;
+  hts_cond_broadcast(&hp->hp_cond);
+  hts_mutex_unlock(&hp->hp_mutex);
+}
+
+
+/**
+ *
+ */
+static int
+http_par_read(http_file_t *hf, void *buf, const size_t size)
+{
+  http_parallel_t *hp = hf->hf_parallel;
+  http_segment_t *hs;
+  int total = 0;
+
+  hts_mutex_lock(&hp->hp_mutex);
+  const int cancelled = hp->hp_cancelled;
+  hts_mutex_unlock(&hp->hp_mutex);
+
+  if(cancelled && !cancellable_is_cancelled(hf->hf_cancellable))
+    http_par_resume(hf, hp);
+
+  hts_mutex_lock(&hp->hp_mutex);
+
+  while(total < size && hf->hf_pos < hf->hf_filesize) {
+
+    if(hp->hp_cancelled) {
+      if(total == 0)
+        total = -1;
+      break;
+    }
+
+    http_par_schedule(hp, hf->hf_pos, hf->hf_filesize);
+
+    hs = TAILQ_FIRST(&hp->hp_segments);
+
+    if(hs->hs_state == HS_FAILED) {
+      // Retry it on next read
+      hs->hs_state = HS_QUEUED;
+      hts_cond_broadcast(&hp->hp_cond);
+      if(total == 0)
+        total = -1;
+      break;
+    }
+
+    if(hs->hs_state != HS_DONE) {
+      hts_cond_wait(&hp->hp_cond, &hp->hp_mutex);
+      continue;
+    }
+
+    const int offset = hf->hf_pos - hs->hs_start;
+    if(offset >= hs->hs_len)
+      break; // Server ended the file early
+
+    const int len = MIN(size - total, hs->hs_len - offset);
+    memcpy(buf + total, hs->hs_data + offset, len);
+    total += len;
+    hf->hf_pos += len;
+  }
+
+  hts_mutex_unlock(&hp->hp_mutex);
+  return total;
+}
+
+
+/**
+ *
+ */
 static int
 http_read(fa_handle_t *handle, void *buf, const size_t size)
 {
   http_file_t *hf = (http_file_t *)handle;
+  int r;
+
+  if(hf->hf_parallel == NULL && hf->hf_parallel_ok &&
+     hf->hf_consecutive_read > STREAMING_LIMIT &&
+     hf->hf_filesize != -1 && !hf->hf_no_ranges)
+    http_par_start(hf);
+
+  if(hf->hf_parallel != NULL)
+    r = http_par_read(hf, buf, size);
+  else
+    r = http_read_i(hf, buf, size);
 
   if(hf->hf_stats_speed == NULL)
-    return http_read_i(hf, buf, size);
+    return r;
 
-  int r = http_read_i(hf, buf, size);
   hf->hf_bytes_downloaded += r;
 
   time_t now = time(NULL);
@@ -3571,3 +3972,110 @@ http_req_get_result(http_req_aux_t *hra)
 {
   return hra->result;
 }
+
+
+#if ENABLE_BENCHMARKS
+/**
+ * Benchmark
+ *
+ * Runs a local HTTP server (see http_bench_server.h) that answers range
+ * requests after a fixed delay and caps the speed of every connection,
+ * as a distant server would. A file is read from start to end, once
+ * over a single connection and once with parallel fetch, and the
+ * sustained throughput is reported. All data is verified.
+ */
+#define HPBENCH_FILESIZE  (24 * 1024 * 1024)
+#define HPBENCH_LATENCY   40000
+#define HPBENCH_BANDWIDTH (4 * 1024 * 1024)
+
+static uint8_t
+hpbench_byte(int64_t o)
+{
+  return o ^ (o >> 11) ^ (o >> 19);
+}
+
+
+static void
+hpbench_content(const char *path, int64_t offset, uint8_t *buf, int len)
+{
+  for(int i = 0; i < len; i++)
+    buf[i] = hpbench_byte(offset + i);
+}
+
+
+static void
+hpbench_run(const char *name, int port, int parallel)
+{
+  char url[64];
+  char errbuf[256];
+  const int bufsize = 65536;
+  uint8_t *buf = malloc(bufsize);
+  int64_t pos = 0;
+  int errors = 0;
+
+  const int saved = gconf.enable_http_parallel;
+  gconf.enable_http_parallel = parallel;
+
+  snprintf(url, sizeof(url), "http://127.0.0.1:%d/file", port);
+
+  const int64_t ts = arch_get_ts();
+  fa_handle_t *fh = http_open(&fa_protocol_http, url, errbuf, sizeof(errbuf),
+                              FA_PARALLEL, NULL);
+  if(fh == NULL) {
+    printf("http-parallel: Unable to open %s -- %s\n", url, errbuf);
+    goto out;
+  }
+
+  int r;
+  while((r = http_read(fh, buf, bufsize)) > 0) {
+    for(int i = 0; i < r; i++) {
+      if(buf[i] != hpbench_byte(pos + i)) {
+        errors++;
+        break;
+      }
+    }
+    pos += r;
+  }
+  if(r < 0)
+    errors++;
+
+  const int64_t elapsed = arch_get_ts() - ts;
+  http_close(fh);
+
+  printf("http-parallel: %-8s %d MB in %d ms, %d kB/s%s\n",
+         name, (int)(pos >> 20), (int)(elapsed / 1000),
+         (int)(pos * 1000000 / elapsed / 1024),
+         pos != HPBENCH_FILESIZE || errors ? "  VERIFY FAILED" : "");
+ out:
+  gconf.enable_http_parallel = saved;
+  free(buf);
+}
+
+
+static void
+hpbench(void)
+{
+  char errbuf[256];
+  http_bench_server_t bhs = {
+    .bhs_size      = HPBENCH_FILESIZE,
+    .bhs_latency   = HPBENCH_LATENCY,
+    .bhs_bandwidth = HPBENCH_BANDWIDTH,
+    .bhs_content   = hpbench_content,
+  };
+
+  if(http_bench_server_start(&bhs, errbuf, sizeof(errbuf))) {
+    printf("http-parallel: Unable to start server -- %s\n", errbuf);
+    return;
+  }
+
+  printf("http-parallel: %d ms latency, %d kB/s per connection\n",
+         HPBENCH_LATENCY / 1000, HPBENCH_BANDWIDTH / 1024);
+
+  hpbench_run("single", bhs.bhs_port, 0);
+  hpbench_run("parallel", bhs.bhs_port, 1);
+
+  http_bench_server_stop(&bhs);
+}
+
+BENCHMARK("http-parallel", hpbench);
+#endif
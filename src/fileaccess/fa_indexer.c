@@ -221,7 +221,7 @@ static int
 find_unprocessed_directory(const char *prefix)
 {
   char pfx[PATH_MAX];
-  void *db = metadb_get();
+  void *db = metadb_get_reader();
 
   struct item_queue q;
   db_escape_path_query(pfx, sizeof(pfx), prefix);
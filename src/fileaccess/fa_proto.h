@@ -81,6 +81,12 @@ typedef struct fa_protocol {
    */
   int (*fap_write)(fa_handle_t *fh, const void *buf, size_t size);
 
+  /**
+   * Read from file at offset without changing file position.
+   * Same semantics as POSIX pread(2). Optional
+   */
+  int (*fap_pread)(fa_handle_t *fh, void *buf, size_t size, int64_t offset);
+
   /**
    * Seek in file. Same semantics as POSIX lseek(2)
    */
@@ -537,7 +537,9 @@ doscan(scanner_t *s)
   int err = 1;
 
   assert(s->s_fd == NULL);
-  s->s_fd = metadb_metadata_scandir(getdb(s), s->s_url, NULL);
+  void *db = metadb_get_reader();
+  s->s_fd = metadb_metadata_scandir(db, s->s_url, NULL);
+  metadb_close(db);
 
   if(s->s_fd == NULL) {
     s->s_fd = fa_scandir(s->s_url, errbuf, sizeof(errbuf));
@@ -56,6 +56,7 @@
 
 static struct fa_protocol_list fileaccess_all_protocols;
 static HTS_MUTEX_DECL(fap_mutex);
+static HTS_MUTEX_DECL(pread_fallback_mutex);
 static fa_protocol_t *native_fap;
 
 /**
@@ -332,6 +333,32 @@ fa_read(void *fh_, void *buf, size_t size)
   return r;
 }
 
+/**
+ * Positional read. If the protocol can't do it natively we fall back to
+ * seek + read serialized by a global lock. Handles shared between
+ * threads must only be read using this function.
+ */
+int
+fa_pread(void *fh_, void *buf, size_t size, int64_t offset)
+{
+  fa_handle_t *fh = fh_;
+  int r;
+
+  if(size == 0)
+    return 0;
+
+  if(fh->fh_proto->fap_pread != NULL)
+    return fh->fh_proto->fap_pread(fh, buf, size, offset);
+
+  hts_mutex_lock(&pread_fallback_mutex);
+  if(fa_seek(fh, offset, SEEK_SET) != offset)
+    r = -1;
+  else
+    r = fa_read(fh, buf, size);
+  hts_mutex_unlock(&pread_fallback_mutex);
+  return r;
+}
+
 /**
  *
  */
@@ -201,6 +201,7 @@ void *fa_open_resolver(const char *url, char *errbuf, size_t errsize,
 void fa_close(void *fh);
 void fa_close_with_park(fa_handle_t *fh, int park);
 int fa_read(void *fh, void *buf, size_t size);
+int fa_pread(void *fh, void *buf, size_t size, int64_t offset);
 void fa_deadline(void *fh_, int deadline);
 int fa_write(void *fh, const void *buf, size_t size);
 
@@ -364,6 +365,8 @@ void memfile_unregister(int id);
 
 fa_handle_t *memfile_make(const void *mem, size_t len);
 
+fa_handle_t *memfile_make_buf(buf_t *b);
+
 // Expose part of a file as a new file, fa is owned by the slicer
 // so you must never touch it again
 
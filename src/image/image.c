@@ -82,6 +82,10 @@ image_clear_component(image_component_t *ic)
   case IMAGE_TEXT_INFO:
     free(ic->text_info.ti_charpos);
     break;
+
+  case IMAGE_GLYPHS:
+    free(ic->glyphs.icg_glyphs);
+    break;
   }
   ic->type = IMAGE_component_none;
 }
@@ -155,6 +159,11 @@ image_dump(const image_t *im, const char *prefix)
             ti->ti_flags & IMAGE_TEXT_WRAPPED   ? "Wrapped" : "",
             ti->ti_flags & IMAGE_TEXT_TRUNCATED ? "Truncated" : "");
       break;
+
+    case IMAGE_GLYPHS:
+      tracelog(TRACE_NO_PROP, TRACE_DEBUG, prefix,
+               "[%d]: Glyphs, %d quads", i, ic->glyphs.icg_count);
+      break;
     }
   }
 }
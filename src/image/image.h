@@ -66,6 +66,7 @@ typedef enum image_component_type {
   IMAGE_CODED,
   IMAGE_VECTOR,
   IMAGE_TEXT_INFO,
+  IMAGE_GLYPHS,
 } image_component_type_t;
 
 
@@ -120,6 +121,39 @@ typedef struct image_component_text_info {
 } image_component_text_info_t;
 
 
+/**
+ * One glyph of rendered text, placed in a shared glyph atlas page
+ * (see text_atlas_get_page()). Coordinates in the image are in
+ * pixels from the top left corner, including the margin
+ */
+typedef struct image_glyph {
+  int16_t ig_x;
+  int16_t ig_y;
+  uint16_t ig_width;
+  uint16_t ig_height;
+  uint16_t ig_s;       // Top left corner in atlas page
+  uint16_t ig_t;
+  uint16_t ig_s_width;
+  uint16_t ig_t_height;
+  uint8_t ig_page;
+  uint32_t ig_color;   // Low 24 bit is BGR, high 8 bit is alpha
+} image_glyph_t;
+
+
+/**
+ * Text rendered as glyph references instead of a pixmap. For each
+ * atlas page the glyphs are valid as long as the page has not been
+ * evicted after icg_page_version (0 if the page is not used)
+ */
+#define IMAGE_GLYPH_PAGES 8
+
+typedef struct image_component_glyphs {
+  image_glyph_t *icg_glyphs;
+  int icg_count;
+  int icg_page_version[IMAGE_GLYPH_PAGES];
+} image_component_glyphs_t;
+
+
 /**
  *
  */
@@ -131,6 +165,7 @@ typedef struct image_component {
     image_component_coded_t coded;
     image_component_vector_t vector;
     image_component_text_info_t text_info;
+    image_component_glyphs_t glyphs;
   };
 
 } image_component_t;
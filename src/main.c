@@ -70,6 +70,7 @@
 #include "fileaccess/fileaccess.h"
 
 static LIST_HEAD(, inithelper) inithelpers;
+static LIST_HEAD(, benchmark) benchmarks;
 
 /**
  *
@@ -201,6 +202,38 @@ fini_group(int group)
 }
 
 
+/**
+ *
+ */
+void
+benchmark_register(benchmark_t *b)
+{
+  LIST_INSERT_HEAD(&benchmarks, b, link);
+}
+
+
+/**
+ *
+ */
+int
+benchmark_run(const char *name)
+{
+  const benchmark_t *b;
+  LIST_FOREACH(b, &benchmarks, link) {
+    if(!strcmp(b->name, name)) {
+      TRACE(TRACE_INFO, "bench", "Running benchmark %s", name);
+      b->run();
+      return 0;
+    }
+  }
+
+  printf("Unknown benchmark '%s', available benchmarks:\n", name);
+  LIST_FOREACH(b, &benchmarks, link)
+    printf("  %s\n", b->name);
+  return 1;
+}
+
+
 /**
  *
  */
@@ -481,6 +514,9 @@ main_init(void)
 
   runcontrol_init();
 
+  if(gconf.benchmark != NULL)
+    exit(benchmark_run(gconf.benchmark));
+
 }
 
 
@@ -533,6 +569,7 @@ parse_opts(int argc, char **argv)
 	     "   --proxy <host:port> - Use SOCKS 4/5 proxy for http requests.\n"
 	     "   -j <path>           - Load javascript file\n"
 	     "   --skin <skin>       - Select skin (for GLW ui)\n"
+	     "   --bench <name>      - Run built-in benchmark and exit\n"
 	     "\n"
 	     "  URL is any URL-type supported, "
 	     "e.g., \"file:///...\"\n"
@@ -651,6 +688,9 @@ parse_opts(int argc, char **argv)
     } else if (!strcmp(argv[0], "--skin") && argc > 1) {
       mystrset(&gconf.skin, argv[1]);
       argc -= 2; argv += 2;
+    } else if (!strcmp(argv[0], "--bench") && argc > 1) {
+      gconf.benchmark = argv[1];
+      argc -= 2; argv += 2;
     } else if (!strcmp(argv[0], "--upgrade-path") && argc > 1) {
       mystrset(&gconf.upgrade_path, argv[1]);
       argc -= 2; argv += 2;
@@ -235,8 +235,13 @@ typedef struct gconf {
   int enable_omnigrade;
   int enable_http_debug;
   int disable_http_reuse;
+  int enable_http_parallel;
   int enable_experimental;
   int enable_indexer;
+  int enable_blobcache_segments;
+  int enable_db_split;
+  int enable_text_atlas;
+  int enable_prop_lock_profiler;
   int enable_detailed_avdiff;
   int enable_hls_debug;
   int enable_ftp_client_debug;
@@ -278,6 +283,8 @@ typedef struct gconf {
   const char *initial_url;
   const char *initial_view;
 
+  const char *benchmark;
+
   char *ui;
   char *skin;
 
@@ -377,3 +384,28 @@ extern void inithelper_register(inithelper_t *ih);
 void init_group(int group);
 
 void fini_group(int group);
+
+
+/**
+ * Benchmarks are registered in the same way as inithelpers and are
+ * run (instead of starting the UI) with --bench <name>
+ */
+typedef struct benchmark {
+  LIST_ENTRY(benchmark) link;
+  const char *name;
+  void (*run)(void);
+} benchmark_t;
+
+extern void benchmark_register(benchmark_t *b);
+
+#define BENCHMARK(name_, run_)                                     \
+  static benchmark_t HTS_JOIN(benchmark, __LINE__) = {             \
+    .name = name_,                                                 \
+    .run = run_,                                                   \
+  };                                                               \
+  INITIALIZER(HTS_JOIN(benchmarkctor, __LINE__))                   \
+  {                                                                \
+    benchmark_register(&HTS_JOIN(benchmark, __LINE__));            \
+  }
+
+int benchmark_run(const char *name);
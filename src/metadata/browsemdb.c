@@ -76,7 +76,7 @@ count_items(void *db, const char *query, const char *url)
 static int
 get_percentage(const char *url)
 {
-  void *db = metadb_get();
+  void *db = metadb_get_reader();
   int remain, done;
   int rval;
   if(db == NULL)
@@ -497,7 +497,7 @@ static void *
 bmdb_thread(void *aux)
 {
   bmdb_t *b = aux;
-  void *db = metadb_get();
+  void *db = metadb_get_reader();
   bmdb_query_exec(db, b);
   metadb_close(db);
   bmdb_destroy(b);
@@ -325,6 +325,8 @@ void metadb_fini(void);
 
 void *metadb_get(void);
 
+void *metadb_get_reader(void);
+
 void metadb_close(void *db);
 
 void metadb_metadata_write(void *db, const char *url, time_t mtime,
@@ -154,6 +154,16 @@ metadb_get(void)
 }
 
 
+/**
+ * Connection for lookups that never write, see db_pool_get_reader()
+ */
+void *
+metadb_get_reader(void)
+{
+  return db_pool_get_reader(metadb_pool);
+}
+
+
 /**
  *
  */
@@ -174,8 +184,8 @@ db_item_get(sqlite3 *db, const char *url, time_t *mtimep)
   int64_t rval = METADATA_PERMANENT_ERROR;
   sqlite3_stmt *stmt;
 
-  rc = db_prepare(db, &stmt,
-		  "SELECT id,mtime from item where url=?1 ");
+  rc = db_prepare_cached(db, &stmt,
+                         "SELECT id,mtime from item where url=?1 ");
   if(rc)
     return METADATA_PERMANENT_ERROR;
   sqlite3_bind_text(stmt, 1, url, -1, SQLITE_STATIC);
@@ -189,7 +199,7 @@ db_item_get(sqlite3 *db, const char *url, time_t *mtimep)
   } else if(rc == SQLITE_LOCKED)
     rval = METADATA_DEADLOCK;
 
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   return rval;
 }
 
@@ -1342,11 +1352,11 @@ metadb_metadata_get_artist(sqlite3 *db, get_cache_t *gc, int64_t id)
   int rc;
   sqlite3_stmt *sel;
 
-  rc = db_prepare(db, &sel,
-		  "SELECT title "
-		  "FROM artist "
-		  "WHERE id = ?1 AND ds_id=1"
-		  );
+  rc = db_prepare_cached(db, &sel,
+                         "SELECT title "
+                         "FROM artist "
+                         "WHERE id = ?1 AND ds_id=1"
+                         );
 
   if(rc != SQLITE_OK)
     return METADATA_PERMANENT_ERROR;
@@ -1356,7 +1366,7 @@ metadb_metadata_get_artist(sqlite3 *db, get_cache_t *gc, int64_t id)
   rc = db_step(sel);
 
   if(rc != SQLITE_ROW) {
-    sqlite3_finalize(sel);
+    db_finalize(sel);
     return METADATA_PERMANENT_ERROR;
   }
 
@@ -1364,7 +1374,7 @@ metadb_metadata_get_artist(sqlite3 *db, get_cache_t *gc, int64_t id)
 
   rstr_release(gc->gc_artist_title);
   gc->gc_artist_title = rstr_alloc((void *)sqlite3_column_text(sel, 0));
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return 0;
 }
 
@@ -1384,10 +1394,10 @@ metadb_metadata_get_album(sqlite3 *db, get_cache_t *gc, int64_t id)
   int rc;
   sqlite3_stmt *sel;
 
-  rc = db_prepare(db, &sel,
-		  "SELECT title "
-		  "FROM album "
-		  "WHERE id = ?1 AND ds_id=1");
+  rc = db_prepare_cached(db, &sel,
+                         "SELECT title "
+                         "FROM album "
+                         "WHERE id = ?1 AND ds_id=1");
 
   if(rc != SQLITE_OK)
     return METADATA_PERMANENT_ERROR;
@@ -1397,14 +1407,14 @@ metadb_metadata_get_album(sqlite3 *db, get_cache_t *gc, int64_t id)
   rc = db_step(sel);
 
   if(rc != SQLITE_ROW) {
-    sqlite3_finalize(sel);
+    db_finalize(sel);
     return METADATA_PERMANENT_ERROR;
   }
 
   gc->gc_album_id = id;
   rstr_release(gc->gc_album_title);
   gc->gc_album_title = rstr_alloc((void *)sqlite3_column_text(sel, 0));
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return 0;
 }
 
@@ -1419,11 +1429,11 @@ metadb_metadata_get_audio(sqlite3 *db, metadata_t *md, int64_t item_id,
   int rc;
   sqlite3_stmt *sel;
 
-  rc = db_prepare(db, &sel,
-		  "SELECT title, album_id, artist_id, duration, track "
-		  "FROM audioitem "
-		  "WHERE item_id = ?1 AND ds_id = 1"
-		  );
+  rc = db_prepare_cached(db, &sel,
+                         "SELECT title, album_id, artist_id, duration, track "
+                         "FROM audioitem "
+                         "WHERE item_id = ?1 AND ds_id = 1"
+                         );
 
   if(rc != SQLITE_OK)
     return METADATA_PERMANENT_ERROR;
@@ -1433,7 +1443,7 @@ metadb_metadata_get_audio(sqlite3 *db, metadata_t *md, int64_t item_id,
   rc = db_step(sel);
 
   if(rc != SQLITE_ROW) {
-    sqlite3_finalize(sel);
+    db_finalize(sel);
     return METADATA_PERMANENT_ERROR;
   }
 
@@ -1448,7 +1458,7 @@ metadb_metadata_get_audio(sqlite3 *db, metadata_t *md, int64_t item_id,
   md->md_duration = sqlite3_column_int(sel, 3) / 1000.0f;
   md->md_track = sqlite3_column_int(sel, 4);
 
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return 0;
 }
 
@@ -1463,12 +1473,12 @@ metadb_metadata_get_video(sqlite3 *db, metadata_t *md, int64_t item_id,
   int rc;
   sqlite3_stmt *sel;
 
-  rc = db_prepare(db, &sel,
-		  "SELECT id, title, duration, format, year "
-		  "FROM videoitem "
-		  "WHERE item_id = ?1 "
-		  "AND ds_id = ?2"
-		  );
+  rc = db_prepare_cached(db, &sel,
+                         "SELECT id, title, duration, format, year "
+                         "FROM videoitem "
+                         "WHERE item_id = ?1 "
+                         "AND ds_id = ?2"
+                         );
 
   if(rc != SQLITE_OK)
     return METADATA_PERMANENT_ERROR;
@@ -1479,7 +1489,7 @@ metadb_metadata_get_video(sqlite3 *db, metadata_t *md, int64_t item_id,
   rc = db_step(sel);
 
   if(rc != SQLITE_ROW) {
-    sqlite3_finalize(sel);
+    db_finalize(sel);
     return METADATA_PERMANENT_ERROR;
   }
 
@@ -1490,7 +1500,7 @@ metadb_metadata_get_video(sqlite3 *db, metadata_t *md, int64_t item_id,
   md->md_format = rstr_alloc((void *)sqlite3_column_text(sel, 3));
   md->md_year = sqlite3_column_int(sel, 4);
 
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return id;
 }
 
@@ -1632,11 +1642,11 @@ metadb_videoitem_alternatives(prop_t *p, const char *url, int dsid,
 {
   void *db;
 
-  if((db = metadb_get()) == NULL)
+  if((db = metadb_get_reader()) == NULL)
     return;
 
  again:
-  if(db_begin(db)) {
+  if(db_begin_read(db)) {
     metadb_close(db);
     return;
   }
@@ -1690,7 +1700,7 @@ metadb_item_get_preferred_ds(const char *url)
   int rc, id = 0;
   sqlite3_stmt *stmt;
 
-  if((db = metadb_get()) == NULL)
+  if((db = metadb_get_reader()) == NULL)
     return METADATA_PERMANENT_ERROR;
 
   rc = db_prepare(db, &stmt,
@@ -1726,7 +1736,7 @@ metadb_item_get_user_title(const char *url)
   sqlite3_stmt *stmt;
   rstr_t *ret = NULL;
 
-  if((db = metadb_get()) == NULL)
+  if((db = metadb_get_reader()) == NULL)
     return NULL;
 
   rc = db_prepare(db, &stmt, 
@@ -2037,6 +2047,58 @@ metadb_get_videoinfo(void *db, const char *url,
 }
 
 
+/**
+ * Per item track counters used when numbering streams
+ */
+typedef struct stream_tracks {
+  int atrack;
+  int strack;
+  int vtrack;
+} stream_tracks_t;
+
+
+/**
+ * Add stream from a row with the columns:
+ *
+ *   streamindex, info, isolang, codec, mediatype, disposition, title
+ *
+ * starting at column 'c'
+ */
+static void
+metadb_add_stream_from_row(metadata_t *md, sqlite3_stmt *sel, int c,
+                           stream_tracks_t *st)
+{
+  int type;
+  int tn;
+  const char *str = (const char *)sqlite3_column_text(sel, c + 4);
+
+  if(str == NULL)
+    return;
+
+  if(!strcmp(str, "audio")) {
+    type = MEDIA_TYPE_AUDIO;
+    tn = ++st->atrack;
+  } else if(!strcmp(str, "video")) {
+    type = MEDIA_TYPE_VIDEO;
+    tn = ++st->vtrack;
+  } else if(!strcmp(str, "subtitle")) {
+    type = MEDIA_TYPE_SUBTITLE;
+    tn = ++st->strack;
+  } else {
+    return;
+  }
+  metadata_add_stream(md,
+                      (const char *)sqlite3_column_text(sel, c + 3),
+                      type,
+                      sqlite3_column_int(sel, c + 0),
+                      (const char *)sqlite3_column_text(sel, c + 6),
+                      (const char *)sqlite3_column_text(sel, c + 1),
+                      (const char *)sqlite3_column_text(sel, c + 2),
+                      sqlite3_column_int(sel, c + 5),
+                      tn, -1);
+}
+
+
 /**
  *
  */
@@ -2045,50 +2107,25 @@ metadb_metadata_get_streams(sqlite3 *db, metadata_t *md, int64_t videoitem_id)
 {
   int rc;
   sqlite3_stmt *sel;
-  int atrack = 0;
-  int strack = 0;
-  int vtrack = 0;
+  stream_tracks_t st = {0};
 
-  rc = db_prepare(db, &sel,
-		  "SELECT streamindex, info, isolang, codec, "
-		  "mediatype, disposition, title "
-		  "FROM videostream "
-		  "WHERE videoitem_id = ?1 "
-		  "ORDER BY streamindex"
-		  );
+  rc = db_prepare_cached(db, &sel,
+                         "SELECT streamindex, info, isolang, codec, "
+                         "mediatype, disposition, title "
+                         "FROM videostream "
+                         "WHERE videoitem_id = ?1 "
+                         "ORDER BY streamindex"
+                         );
 
   if(rc != SQLITE_OK)
     return METADATA_PERMANENT_ERROR;
 
   sqlite3_bind_int64(sel, 1, videoitem_id);
 
-  while((rc = db_step(sel)) == SQLITE_ROW) {
-    int type;
-    int tn;
-    const char *str = (const char *)sqlite3_column_text(sel, 4);
-    if(!strcmp(str, "audio")) {
-      type = MEDIA_TYPE_AUDIO;
-      tn = ++atrack;
-    } else if(!strcmp(str, "video")) {
-      type = MEDIA_TYPE_VIDEO;
-      tn = ++vtrack;
-    } else if(!strcmp(str, "subtitle")) {
-      type = MEDIA_TYPE_SUBTITLE;
-      tn = ++strack;
-    } else {
-      continue;
-    }
-    metadata_add_stream(md, 
-			(const char *)sqlite3_column_text(sel, 3),
-			type,
-			sqlite3_column_int(sel, 0),
-			(const char *)sqlite3_column_text(sel, 6),
-			(const char *)sqlite3_column_text(sel, 1),
-			(const char *)sqlite3_column_text(sel, 2),
-			sqlite3_column_int(sel, 5),
-			tn, -1);
-  }
-  sqlite3_finalize(sel);
+  while((rc = db_step(sel)) == SQLITE_ROW)
+    metadb_add_stream_from_row(md, sel, 0, &st);
+
+  db_finalize(sel);
   return 0;
 }
 
@@ -2102,11 +2139,11 @@ metadb_metadata_get_image(sqlite3 *db, metadata_t *md, int64_t item_id)
   int rc;
   sqlite3_stmt *sel;
 
-  rc = db_prepare(db, &sel,
-		  "SELECT original_time, manufacturer, equipment "
-		  "FROM imageitem "
-		  "WHERE item_id = ?1"
-		  );
+  rc = db_prepare_cached(db, &sel,
+                         "SELECT original_time, manufacturer, equipment "
+                         "FROM imageitem "
+                         "WHERE item_id = ?1"
+                         );
 
   if(rc != SQLITE_OK)
     return METADATA_PERMANENT_ERROR;
@@ -2116,14 +2153,14 @@ metadb_metadata_get_image(sqlite3 *db, metadata_t *md, int64_t item_id)
   rc = db_step(sel);
 
   if(rc != SQLITE_ROW) {
-    sqlite3_finalize(sel);
+    db_finalize(sel);
     return METADATA_PERMANENT_ERROR;
   }
 
   md->md_time = sqlite3_column_int(sel, 0);
   md->md_manufacturer = rstr_alloc((void *)sqlite3_column_text(sel, 1));
   md->md_equipment = rstr_alloc((void *)sqlite3_column_text(sel, 2));
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return 0;
 }
 
@@ -2185,13 +2222,13 @@ metadb_metadata_get(void *db, const char *url, time_t mtime)
   int rc;
   sqlite3_stmt *sel;
 
-  if(db_begin(db))
+  if(db_begin_read(db))
     return NULL;
 
-  rc = db_prepare(db, &sel,
-		  "SELECT id,contenttype,parent from item "
-		  "where url=?1 AND "
-		  "mtime=?2");
+  rc = db_prepare_cached(db, &sel,
+                         "SELECT id,contenttype,parent from item "
+                         "where url=?1 AND "
+                         "mtime=?2");
 
   if(rc != SQLITE_OK) {
     db_rollback(db);
@@ -2204,7 +2241,7 @@ metadb_metadata_get(void *db, const char *url, time_t mtime)
   rc = db_step(sel);
 
   if(rc != SQLITE_ROW) {
-    sqlite3_finalize(sel);
+    db_finalize(sel);
     db_rollback(db);
     return NULL;
   }
@@ -2223,20 +2260,227 @@ metadb_metadata_get(void *db, const char *url, time_t mtime)
       METADATA_CACHE_STATUS_FULL :
       METADATA_CACHE_STATUS_UNPARENTED;
 
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   db_rollback(db);
   return md;
 }
 
 
+/**
+ * Directory loading
+ *
+ * Instead of looking up metadata for each item separately all children
+ * of a directory are loaded with a fixed number of queries (one per
+ * content type plus one for the video streams) and matched up with the
+ * directory entries in memory.
+ */
+typedef struct scandir_item {
+  int64_t si_id;
+  fa_dir_entry_t *si_fde;
+  int si_contenttype;
+  int si_index_status;
+  stream_tracks_t si_tracks;
+} scandir_item_t;
+
+
+/**
+ *
+ */
+static int
+scandir_item_cmp(const void *A, const void *B)
+{
+  const scandir_item_t *a = A;
+  const scandir_item_t *b = B;
+  if(a->si_id < b->si_id)
+    return -1;
+  return a->si_id > b->si_id;
+}
+
+
+/**
+ *
+ */
+static scandir_item_t *
+scandir_item_find(scandir_item_t *v, int num, int64_t id)
+{
+  scandir_item_t skel;
+  skel.si_id = id;
+  return bsearch(&skel, v, num, sizeof(scandir_item_t), scandir_item_cmp);
+}
+
+
+/**
+ * Run one of the batch queries. It must take parent item id as ?1 and
+ * return the item id in the first column. 'cb' is invoked for each row
+ * that refers to a known item.
+ */
+static int
+scandir_batch(sqlite3 *db, const char *sql, int64_t parent_id,
+              scandir_item_t *v, int num,
+              void (*cb)(sqlite3_stmt *sel, scandir_item_t *si))
+{
+  sqlite3_stmt *sel;
+  int rc = db_prepare_cached(db, &sel, sql);
+  if(rc != SQLITE_OK)
+    return rc;
+
+  sqlite3_bind_int64(sel, 1, parent_id);
+
+  while((rc = db_step(sel)) == SQLITE_ROW) {
+    scandir_item_t *si = scandir_item_find(v, num,
+                                           sqlite3_column_int64(sel, 0));
+    if(si != NULL)
+      cb(sel, si);
+  }
+  db_finalize(sel);
+  return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+
+/**
+ *
+ */
+static void
+scandir_audio_row(sqlite3_stmt *sel, scandir_item_t *si)
+{
+  fa_dir_entry_t *fde = si->si_fde;
+  if(si->si_contenttype != CONTENT_AUDIO || fde->fde_md != NULL)
+    return;
+
+  metadata_t *md = metadata_create();
+  md->md_contenttype = CONTENT_AUDIO;
+  md->md_title    = rstr_alloc((void *)sqlite3_column_text(sel, 1));
+  md->md_duration = sqlite3_column_int(sel, 2) / 1000.0f;
+  md->md_track    = sqlite3_column_int(sel, 3);
+  md->md_album    = rstr_alloc((void *)sqlite3_column_text(sel, 4));
+  md->md_artist   = rstr_alloc((void *)sqlite3_column_text(sel, 5));
+  fde->fde_md = md;
+}
+
+
+/**
+ *
+ */
+static void
+scandir_video_row(sqlite3_stmt *sel, scandir_item_t *si)
+{
+  fa_dir_entry_t *fde = si->si_fde;
+  if(si->si_contenttype != CONTENT_VIDEO || fde->fde_md != NULL)
+    return;
+
+  metadata_t *md = metadata_create();
+  md->md_contenttype = CONTENT_VIDEO;
+  md->md_title    = rstr_alloc((void *)sqlite3_column_text(sel, 1));
+  md->md_duration = sqlite3_column_int(sel, 2) / 1000.0f;
+  md->md_format   = rstr_alloc((void *)sqlite3_column_text(sel, 3));
+  md->md_year     = sqlite3_column_int(sel, 4);
+  fde->fde_md = md;
+}
+
+
+/**
+ *
+ */
+static void
+scandir_stream_row(sqlite3_stmt *sel, scandir_item_t *si)
+{
+  fa_dir_entry_t *fde = si->si_fde;
+  if(si->si_contenttype != CONTENT_VIDEO || fde->fde_md == NULL)
+    return;
+
+  metadb_add_stream_from_row(fde->fde_md, sel, 1, &si->si_tracks);
+}
+
+
+/**
+ *
+ */
+static void
+scandir_image_row(sqlite3_stmt *sel, scandir_item_t *si)
+{
+  fa_dir_entry_t *fde = si->si_fde;
+  if(si->si_contenttype != CONTENT_IMAGE || fde->fde_md != NULL)
+    return;
+
+  metadata_t *md = metadata_create();
+  md->md_contenttype = CONTENT_IMAGE;
+  md->md_time         = sqlite3_column_int(sel, 1);
+  md->md_manufacturer = rstr_alloc((void *)sqlite3_column_text(sel, 2));
+  md->md_equipment    = rstr_alloc((void *)sqlite3_column_text(sel, 3));
+  fde->fde_md = md;
+}
+
+
+/**
+ * Load metadata for all items in 'v' (sorted on id)
+ */
+static int
+scandir_load_metadata(sqlite3 *db, int64_t parent_id,
+                      scandir_item_t *v, int num)
+{
+  int rc;
+
+  rc = scandir_batch(db,
+                     "SELECT ai.item_id, ai.title, ai.duration, ai.track, "
+                     "al.title, ar.title "
+                     "FROM item "
+                     "JOIN audioitem AS ai ON ai.item_id = item.id "
+                     "AND ai.ds_id = 1 "
+                     "LEFT JOIN album AS al ON al.id = ai.album_id "
+                     "AND al.ds_id = 1 "
+                     "LEFT JOIN artist AS ar ON ar.id = ai.artist_id "
+                     "AND ar.ds_id = 1 "
+                     "WHERE item.parent = ?1",
+                     parent_id, v, num, scandir_audio_row);
+  if(rc)
+    return rc;
+
+  rc = scandir_batch(db,
+                     "SELECT vi.item_id, vi.title, vi.duration, vi.format, "
+                     "vi.year "
+                     "FROM item "
+                     "JOIN videoitem AS vi ON vi.item_id = item.id "
+                     "AND vi.ds_id = 1 "
+                     "WHERE item.parent = ?1",
+                     parent_id, v, num, scandir_video_row);
+  if(rc)
+    return rc;
+
+  rc = scandir_batch(db,
+                     "SELECT vi.item_id, vs.streamindex, vs.info, "
+                     "vs.isolang, vs.codec, vs.mediatype, vs.disposition, "
+                     "vs.title "
+                     "FROM item "
+                     "JOIN videoitem AS vi ON vi.item_id = item.id "
+                     "AND vi.ds_id = 1 "
+                     "JOIN videostream AS vs ON vs.videoitem_id = vi.id "
+                     "WHERE item.parent = ?1 "
+                     "ORDER BY vi.item_id, vs.streamindex",
+                     parent_id, v, num, scandir_stream_row);
+  if(rc)
+    return rc;
+
+  return scandir_batch(db,
+                       "SELECT im.item_id, im.original_time, "
+                       "im.manufacturer, im.equipment "
+                       "FROM item "
+                       "JOIN imageitem AS im ON im.item_id = item.id "
+                       "WHERE item.parent = ?1",
+                       parent_id, v, num, scandir_image_row);
+}
+
+
 /**
  *
  */
 fa_dir_t *
 metadb_metadata_scandir(void *db, const char *url, time_t *mtime)
 {
+  scandir_item_t *v = NULL;
+  int num = 0, capacity = 0;
+
  again:
-  if(db_begin(db))
+  if(db_begin_read(db))
     return NULL;
 
   int64_t parent_id = db_item_get(db, url, mtime);
@@ -2253,11 +2497,11 @@ metadb_metadata_scandir(void *db, const char *url, time_t *mtime)
   sqlite3_stmt *sel;
   int rc;
 
-  rc = db_prepare(db, &sel,
-		  "SELECT id, url, contenttype, mtime, indexstatus "
-		  "FROM item "
-		  "WHERE parent = ?1"
-		  );
+  rc = db_prepare_cached(db, &sel,
+                         "SELECT id, url, contenttype, mtime, indexstatus "
+                         "FROM item "
+                         "WHERE parent = ?1"
+                         );
 
   if(rc != SQLITE_OK) {
     db_rollback(db);
@@ -2268,8 +2512,6 @@ metadb_metadata_scandir(void *db, const char *url, time_t *mtime)
 
   fa_dir_t *fd = fa_dir_alloc();
 
-  get_cache_t gc = {0};
-
   while((rc = db_step(sel)) == SQLITE_ROW) {
     if(sqlite3_column_type(sel, 2) != SQLITE_INTEGER)
       continue;
@@ -2289,17 +2531,60 @@ metadb_metadata_scandir(void *db, const char *url, time_t *mtime)
 	fde->fde_stat.fs_mtime = sqlite3_column_int(sel, 3);
       }
 
-      fde->fde_md = metadata_get(db, item_id, contenttype, &gc);
-      if(fde->fde_md != NULL) {
-	fde->fde_md->md_cache_status = METADATA_CACHE_STATUS_FULL;
-        fde->fde_md->md_index_status = sqlite3_column_int(sel, 4);
+      switch(contenttype) {
+      case CONTENT_DIR:
+      case CONTENT_SHARE:
+      case CONTENT_DVD:
+        fde->fde_md = metadata_create();
+        fde->fde_md->md_contenttype = contenttype;
+        break;
+      }
+
+      if(num == capacity) {
+        capacity = MAX(capacity * 2, 64);
+        v = realloc(v, capacity * sizeof(scandir_item_t));
       }
+      scandir_item_t *si = &v[num++];
+      si->si_id = item_id;
+      si->si_fde = fde;
+      si->si_contenttype = contenttype;
+      si->si_index_status = sqlite3_column_int(sel, 4);
+      memset(&si->si_tracks, 0, sizeof(stream_tracks_t));
     }
   }
 
-  sqlite3_finalize(sel);
+  db_finalize(sel);
 
-  get_cache_release(&gc);
+  if(rc == SQLITE_DONE && num > 0) {
+    qsort(v, num, sizeof(scandir_item_t), scandir_item_cmp);
+    rc = scandir_load_metadata(db, parent_id, v, num);
+  }
+
+  if(rc == SQLITE_LOCKED) {
+    fa_dir_free(fd);
+    free(v);
+    v = NULL;
+    num = capacity = 0;
+    db_rollback_deadlock(db);
+    goto again;
+  }
+
+  if(rc != SQLITE_DONE && rc != SQLITE_OK) {
+    // Don't let the caller use (and cache) incomplete metadata
+    fa_dir_free(fd);
+    free(v);
+    db_rollback(db);
+    return NULL;
+  }
+
+  for(int i = 0; i < num; i++) {
+    metadata_t *md = v[i].si_fde->fde_md;
+    if(md != NULL) {
+      md->md_cache_status = METADATA_CACHE_STATUS_FULL;
+      md->md_index_status = v[i].si_index_status;
+    }
+  }
+  free(v);
 
   db_rollback(db);
 
@@ -2396,7 +2681,7 @@ metadb_parent_item(void *db, const char *url, const char *parent_url)
 metadata_t *
 metadata_get_video_data(const char *url)
 {
-  void *db = metadb_get();
+  void *db = metadb_get_reader();
   metadata_t *md;
 
   int r = metadb_get_videoinfo(db, url, NULL, 0, NULL, &md, 0);
@@ -2407,4 +2692,216 @@ metadata_get_video_data(const char *url)
 }
 
 
+/**
+ * Directory scan benchmark
+ *
+ * Builds a scratch metadb with one directory of audio, video and image
+ * items and compares loading it the old way (metadata_get() for each
+ * item) with metadb_metadata_scandir()
+ */
+#define SCANBENCH_ITEMS  2000
+#define SCANBENCH_ROUNDS 10
+#define SCANBENCH_DIR    "file:///scanbench"
+
+/**
+ * Directory loading as done before batching, one metadata_get() per item
+ */
+static fa_dir_t *
+scanbench_per_item(sqlite3 *db, int64_t parent_id)
+{
+  sqlite3_stmt *sel;
+  get_cache_t gc = {0};
+  char fname[256];
+
+  if(db_prepare_cached(db, &sel,
+                       "SELECT id, url, contenttype, mtime, indexstatus "
+                       "FROM item "
+                       "WHERE parent = ?1"))
+    return NULL;
+
+  sqlite3_bind_int64(sel, 1, parent_id);
+
+  fa_dir_t *fd = fa_dir_alloc();
+
+  while(db_step(sel) == SQLITE_ROW) {
+    const char *url = (const char *)sqlite3_column_text(sel, 1);
+    const int contenttype = sqlite3_column_int(sel, 2);
+    fa_url_get_last_component(fname, sizeof(fname), url);
+    fa_dir_entry_t *fde = fa_dir_add(fd, url, fname, contenttype);
+    if(fde != NULL)
+      fde->fde_md = metadata_get(db, sqlite3_column_int64(sel, 0),
+                                 contenttype, &gc);
+  }
+  db_finalize(sel);
+  get_cache_release(&gc);
+  return fd;
+}
+
+
+/**
+ * Return number of entries with metadata or -1 if the two directories
+ * differ
+ */
+static int
+scanbench_compare(fa_dir_t *a, fa_dir_t *b)
+{
+  fa_dir_entry_t *x, *y;
+  int count = 0;
+
+  if(a == NULL || b == NULL || a->fd_count != b->fd_count)
+    return -1;
+
+  for(x = RB_FIRST(&a->fd_entries), y = RB_FIRST(&b->fd_entries);
+      x != NULL && y != NULL;
+      x = RB_NEXT(x, fde_link), y = RB_NEXT(y, fde_link)) {
+    const metadata_t *m = x->fde_md, *n = y->fde_md;
+    if(strcmp(rstr_get(x->fde_url), rstr_get(y->fde_url)) ||
+       (m == NULL) != (n == NULL))
+      return -1;
+    if(m == NULL)
+      continue;
+
+    const metadata_stream_t *ms, *ns;
+    for(ms = TAILQ_FIRST(&m->md_streams), ns = TAILQ_FIRST(&n->md_streams);
+        ms != NULL && ns != NULL;
+        ms = TAILQ_NEXT(ms, ms_link), ns = TAILQ_NEXT(ns, ms_link))
+      if(ms->ms_streamindex != ns->ms_streamindex ||
+         ms->ms_tracknum != ns->ms_tracknum)
+        return -1;
+
+    if(ms != NULL || ns != NULL ||
+       m->md_contenttype != n->md_contenttype ||
+       strcmp(rstr_get(m->md_title) ?: "", rstr_get(n->md_title) ?: "") ||
+       strcmp(rstr_get(m->md_album) ?: "", rstr_get(n->md_album) ?: "") ||
+       strcmp(rstr_get(m->md_artist) ?: "", rstr_get(n->md_artist) ?: "") ||
+       m->md_track != n->md_track || m->md_time != n->md_time)
+      return -1;
+    count++;
+  }
+  return count;
+}
+
+
+static void
+scanbench_populate(sqlite3 *db)
+{
+  char url[128];
+  char str[64];
+
+  db_begin(db);
+  for(int i = 0; i < SCANBENCH_ITEMS; i++) {
+    metadata_t *md = metadata_create();
+    snprintf(str, sizeof(str), "Item %d", i);
+    md->md_title = rstr_alloc(str);
+
+    switch(i & 3) {
+    case 0:
+    case 1:
+      md->md_contenttype = CONTENT_AUDIO;
+      snprintf(str, sizeof(str), "Album %d", i / 20);
+      md->md_album = rstr_alloc(str);
+      snprintf(str, sizeof(str), "Artist %d", i / 40);
+      md->md_artist = rstr_alloc(str);
+      md->md_duration = 180 + i % 120;
+      md->md_track = 1 + i % 20;
+      break;
+    case 2:
+      md->md_contenttype = CONTENT_VIDEO;
+      md->md_duration = 5400;
+      md->md_format = rstr_alloc("Matroska");
+      metadata_add_stream(md, "h264", MEDIA_TYPE_VIDEO, 0, NULL, "1080p",
+                          NULL, 0, 1, -1);
+      metadata_add_stream(md, "ac3", MEDIA_TYPE_AUDIO, 1, NULL, "5.1",
+                          "eng", 0, 1, -1);
+      metadata_add_stream(md, "srt", MEDIA_TYPE_SUBTITLE, 2, NULL, NULL,
+                          "swe", 0, 1, -1);
+      break;
+    case 3:
+      md->md_contenttype = CONTENT_IMAGE;
+      md->md_time = 1400000000 + i;
+      md->md_manufacturer = rstr_alloc("Camera Corp");
+      md->md_equipment = rstr_alloc("Model 1");
+      break;
+    }
+    snprintf(url, sizeof(url), SCANBENCH_DIR "/item%d", i);
+    metadb_metadata_writex(db, url, 1, md, SCANBENCH_DIR, 1,
+                           INDEX_STATUS_UNSET);
+    metadata_destroy(md);
+  }
+  db_commit(db);
+}
+
+
+static void
+metadb_scandir_bench(void)
+{
+  char path[256];
+  char kvpath[256];
+  char schema[256];
+  time_t mtime;
+  int64_t per_item = 0, batched = 0;
+  int matched = 0;
+
+  snprintf(kvpath, sizeof(kvpath), "%s/scanbench-kv.db", gconf.cache_path);
+  snprintf(path, sizeof(path), "%s/scanbench.db", gconf.cache_path);
+  unlink(kvpath);
+  unlink(path);
+
+  sqlite3 *kv = db_open(kvpath, 0);
+  if(kv == NULL)
+    return;
+  snprintf(schema, sizeof(schema), "%s/res/kvstore", app_dataroot());
+  int r = db_upgrade_schema(kv, schema, "scanbench-kv", NULL, NULL);
+  sqlite3_close(kv);
+  if(r)
+    return;
+
+  db_pool_t *dp = db_pool_create(path, 1);
+  sqlite3 *db = db_pool_get(dp);
+  if(db == NULL)
+    return;
+
+  snprintf(schema, sizeof(schema), "%s/res/metadb", app_dataroot());
+  if(db_upgrade_schema(db, schema, "scanbench", "kvstore", kvpath)) {
+    db_pool_put(dp, db);
+    return;
+  }
+
+  scanbench_populate(db);
+
+  for(int i = 0; i < SCANBENCH_ROUNDS; i++) {
+    int64_t ts = arch_get_ts();
+    db_begin(db);
+    fa_dir_t *a = scanbench_per_item(db, db_item_get(db, SCANBENCH_DIR,
+                                                     &mtime));
+    db_rollback(db);
+    per_item += arch_get_ts() - ts;
+
+    ts = arch_get_ts();
+    fa_dir_t *b = metadb_metadata_scandir(db, SCANBENCH_DIR, &mtime);
+    batched += arch_get_ts() - ts;
+
+    matched = scanbench_compare(a, b);
+    if(a != NULL)
+      fa_dir_free(a);
+    if(b != NULL)
+      fa_dir_free(b);
+  }
+
+  printf("metadb: %d items, per item lookups %.2f ms/scan, "
+         "batched %.2f ms/scan, ",
+         SCANBENCH_ITEMS,
+         per_item / (1000.0 * SCANBENCH_ROUNDS),
+         batched / (1000.0 * SCANBENCH_ROUNDS));
+  if(matched < 0)
+    printf("results differ!\n");
+  else
+    printf("%d items with identical metadata\n", matched);
+
+  db_pool_put(dp, db);
+  db_pool_close(dp);
+  unlink(kvpath);
+  unlink(path);
+}
 
+BENCHMARK("metadb-scandir", metadb_scandir_bench);
@@ -24,25 +24,11 @@
 #include "callout.h"
 #include "arch/arch.h"
 
-static LIST_HEAD(, callout) callouts;
+static timerwheel_t callouts;
 
 static hts_mutex_t callout_mutex;
 static hts_cond_t callout_cond;
 
-/**
- *htsmsg_t *props
- */
-static int
-calloutcmp(callout_t *a, callout_t *b)
-{
-  if(a->c_deadline < b->c_deadline)
-    return -1;
-  else if(a->c_deadline > b->c_deadline)
-    return 1;
- return 0;
-}
-
-
 /**
  *
  */
@@ -59,7 +45,7 @@ callout_arm0(callout_t *d, callout_callback_t *callback, void *opaque,
   } else {
 
     if(d->c_callback != NULL) {
-      LIST_REMOVE(d, c_link);
+      timerwheel_disarm(&callouts, &d->c_twe);
     } else {
       retain = lockmgr;
     }
@@ -68,11 +54,10 @@ callout_arm0(callout_t *d, callout_callback_t *callback, void *opaque,
   d->c_callback = callback;
   d->c_opaque = opaque;
   d->c_delta = delta;
-  d->c_deadline = arch_get_ts() + delta;
   d->c_armed_by_file = file;
   d->c_armed_by_line = line;
   d->c_lockmgr = lockmgr;
-  LIST_INSERT_SORTED(&callouts, d, c_link, calloutcmp, callout_t);
+  timerwheel_arm(&callouts, &d->c_twe, arch_get_ts() + delta);
   hts_cond_signal(&callout_cond);
   hts_mutex_unlock(&callout_mutex);
   if(retain)
@@ -124,10 +109,10 @@ callout_rearm(callout_t *d, int64_t delta)
   hts_mutex_lock(&callout_mutex);
 
   if(d->c_callback != NULL) {
-    d->c_deadline += delta - d->c_delta;
+    const int64_t deadline = d->c_twe.twe_deadline + delta - d->c_delta;
     d->c_delta = delta;
-    LIST_REMOVE(d, c_link);
-    LIST_INSERT_SORTED(&callouts, d, c_link, calloutcmp, callout_t);
+    timerwheel_disarm(&callouts, &d->c_twe);
+    timerwheel_arm(&callouts, &d->c_twe, deadline);
   }
 
   hts_mutex_unlock(&callout_mutex);
@@ -144,7 +129,7 @@ callout_disarm(callout_t *c)
   lockmgr_fn_t *lm;
   if(c->c_callback) {
     lm = c->c_lockmgr;
-    LIST_REMOVE(c, c_link);
+    timerwheel_disarm(&callouts, &c->c_twe);
     c->c_callback = NULL;
   } else {
     lm = NULL;
@@ -161,8 +146,8 @@ callout_disarm(callout_t *c)
 static void *
 callout_loop(void *aux)
 {
-  uint64_t now;
-  callout_t *c;
+  int64_t now;
+  timerwheel_entry_t *twe;
   callout_callback_t *cc;
 
   hts_mutex_lock(&callout_mutex);
@@ -171,9 +156,9 @@ callout_loop(void *aux)
 
     now = arch_get_ts();
 
-    while((c = LIST_FIRST(&callouts)) != NULL && c->c_deadline <= now) {
+    while((twe = timerwheel_get_expired(&callouts, now)) != NULL) {
+      callout_t *c = timerwheel_entry_to(twe, callout_t, c_twe);
       cc = c->c_callback;
-      LIST_REMOVE(c, c_link);
       c->c_callback = NULL;
       lockmgr_fn_t *lm = c->c_lockmgr;
       const char *file = c->c_armed_by_file;
@@ -199,9 +184,10 @@ callout_loop(void *aux)
       now = ts;
     }
 
-    if((c = LIST_FIRST(&callouts)) != NULL) {
+    const int64_t next = timerwheel_next_deadline(&callouts);
+    if(next != INT64_MAX) {
 
-      int timeout = (c->c_deadline - now + 999) / 1000;
+      int timeout = (next - now + 999) / 1000;
       hts_cond_wait_timeout(&callout_cond, &callout_mutex, timeout);
     } else {
       hts_cond_wait(&callout_cond, &callout_mutex);
@@ -273,6 +259,7 @@ callout_init(void)
 
   hts_mutex_init(&callout_mutex);
   hts_cond_init(&callout_cond, &callout_mutex);
+  timerwheel_init(&callouts, arch_get_ts());
 
   hts_thread_create_detached("callout", callout_loop, NULL,
 			     THREAD_PRIO_BGTASK);
@@ -73,6 +73,24 @@ typedef struct pool_segment {
 } pool_segment_t;
 
 
+/**
+ * Per thread cache of free items for POOL_THREAD_CACHE pools
+ *
+ * Items are taken from and returned to the calling thread's magazine
+ * without any locking. The magazine is refilled from, and drained to,
+ * the shared free list in batches while holding p_mutex.
+ */
+#define POOL_MAGAZINE_BATCH 32
+
+typedef struct pool_magazine {
+  LIST_ENTRY(pool_magazine) pm_link;
+  pool_t *pm_pool;
+  pool_item_t *pm_items;
+  int pm_count;
+  int pm_num_out; // Items handed out minus items returned by this thread
+} pool_magazine_t;
+
+
 #define ROUND_UP(p, round) ((p + round - 1) & ~(round - 1))
 
 /**
@@ -104,6 +122,84 @@ pool_segment_create(pool_t *p)
 }
 
 
+/**
+ * Move 'count' items from magazine to the shared free list.
+ * Must be called with p_mutex held
+ */
+static void
+pool_magazine_drain(pool_t *p, pool_magazine_t *pm, int count)
+{
+  pool_item_t *pi;
+
+  for(; count > 0 && (pi = pm->pm_items) != NULL; count--) {
+    pm->pm_items = pi->link;
+    pm->pm_count--;
+    pi->link = p->p_item;
+    p->p_item = pi;
+  }
+}
+
+
+/**
+ *
+ */
+static void attribute_unused
+pool_magazine_refill(pool_t *p, pool_magazine_t *pm)
+{
+  hts_mutex_lock(&p->p_mutex);
+  for(int i = 0; i < POOL_MAGAZINE_BATCH; i++) {
+    pool_item_t *pi = p->p_item;
+    if(pi == NULL) {
+      pool_segment_create(p);
+      pi = p->p_item;
+    }
+    p->p_item = pi->link;
+    pi->link = pm->pm_items;
+    pm->pm_items = pi;
+    pm->pm_count++;
+  }
+  hts_mutex_unlock(&p->p_mutex);
+}
+
+
+/**
+ * Called when a thread exits
+ */
+static void
+pool_magazine_release(void *aux)
+{
+  pool_magazine_t *pm = aux;
+  pool_t *p = pm->pm_pool;
+
+  hts_mutex_lock(&p->p_mutex);
+  pool_magazine_drain(p, pm, pm->pm_count);
+  p->p_num_out += pm->pm_num_out;
+  LIST_REMOVE(pm, pm_link);
+  hts_mutex_unlock(&p->p_mutex);
+  free(pm);
+}
+
+
+/**
+ *
+ */
+static pool_magazine_t *
+pool_magazine_get(pool_t *p)
+{
+  pool_magazine_t *pm = hts_thread_get_specific(p->p_magazine_key);
+  if(likely(pm != NULL))
+    return pm;
+
+  pm = calloc(1, sizeof(pool_magazine_t));
+  pm->pm_pool = p;
+  hts_mutex_lock(&p->p_mutex);
+  LIST_INSERT_HEAD(&p->p_magazines, pm, pm_link);
+  hts_mutex_unlock(&p->p_mutex);
+  hts_thread_set_specific(p->p_magazine_key, pm);
+  return pm;
+}
+
+
 /**
  *
  */
@@ -121,6 +217,13 @@ pool_init(pool_t *p, const char *name, size_t item_size, int flags)
 
   p->p_item_size = item_size;
   p->p_flags = flags;
+
+  hts_mutex_init(&p->p_mutex);
+  LIST_INIT(&p->p_magazines);
+
+  if(flags & POOL_THREAD_CACHE)
+    hts_thread_key_create((unsigned int *)&p->p_magazine_key,
+                          pool_magazine_release);
 }
 
 
@@ -142,17 +245,11 @@ pool_create(const char *name, size_t item_size, int flags)
  *
  */
 static void
-mark_segments(pool_t *p)
+mark_free_items(pool_t *p, pool_item_t *pi)
 {
-  pool_item_t *pi;
   pool_segment_t *ps;
 
-  LIST_FOREACH(ps, &p->p_segments, ps_link) {
-    ps->ps_mark = malloc(ps->ps_avail_size / p->p_item_size);
-    memset(ps->ps_mark, 0xff, ps->ps_avail_size / p->p_item_size);
-  }
-
-  for(pi = p->p_item; pi != NULL; pi = pi->link) {
+  for(; pi != NULL; pi = pi->link) {
     LIST_FOREACH(ps, &p->p_segments, ps_link) {
       size_t off = (void *)pi - ps->ps_addr;
 
@@ -169,6 +266,28 @@ mark_segments(pool_t *p)
   }
 }
 
+
+/**
+ * Items cached in other threads' magazines are counted as free. For
+ * POOL_THREAD_CACHE pools the result is only accurate if no other
+ * thread uses the pool meanwhile.
+ */
+static void
+mark_segments(pool_t *p)
+{
+  pool_segment_t *ps;
+  pool_magazine_t *pm;
+
+  LIST_FOREACH(ps, &p->p_segments, ps_link) {
+    ps->ps_mark = malloc(ps->ps_avail_size / p->p_item_size);
+    memset(ps->ps_mark, 0xff, ps->ps_avail_size / p->p_item_size);
+  }
+
+  mark_free_items(p, p->p_item);
+  LIST_FOREACH(pm, &p->p_magazines, pm_link)
+    mark_free_items(p, pm->pm_items);
+}
+
 static void
 unmark_segments(pool_t *p)
 {
@@ -213,6 +332,16 @@ pool_destroy(pool_t *p)
   }
 #endif
 
+  pool_magazine_t *pm;
+  while((pm = LIST_FIRST(&p->p_magazines)) != NULL) {
+    p->p_num_out += pm->pm_num_out;
+    LIST_REMOVE(pm, pm_link);
+    free(pm);
+  }
+
+  if(p->p_flags & POOL_THREAD_CACHE)
+    hts_thread_key_delete(p->p_magazine_key);
+
   while((ps = LIST_FIRST(&p->p_segments)) != NULL) {
     LIST_REMOVE(ps, ps_link);
 #ifdef POOL_DEBUG
@@ -225,6 +354,7 @@ pool_destroy(pool_t *p)
     TRACE(TRACE_INFO, "pool", "Destroying pool '%s', %d items out",
 	  p->p_name, p->p_num_out);
 
+  hts_mutex_destroy(&p->p_mutex);
   free(p);
 }
 
@@ -242,7 +372,15 @@ pool_get_ex(pool_t *p, const char *file, int line)
 pool_get(pool_t *p)
 #endif
 {
-  p->p_num_out++;
+  pool_magazine_t *pm = NULL;
+
+  if(p->p_flags & POOL_THREAD_CACHE) {
+    pm = pool_magazine_get(p);
+    pm->pm_num_out++;
+  } else {
+    p->p_num_out++;
+  }
+
 #if defined(POOL_BY_MMAP)
   return mmap(NULL, p->p_item_size_req, PROT_WRITE | PROT_READ,
               MAP_ANON | MAP_PRIVATE, -1, 0);
@@ -253,12 +391,22 @@ pool_get(pool_t *p)
   else
     return malloc(p->p_item_size_req);
 #else
-  pool_item_t *pi = p->p_item;
-  if(pi == NULL) {
-    pool_segment_create(p);
+  pool_item_t *pi;
+
+  if(pm != NULL) {
+    if(pm->pm_items == NULL)
+      pool_magazine_refill(p, pm);
+    pi = pm->pm_items;
+    pm->pm_items = pi->link;
+    pm->pm_count--;
+  } else {
     pi = p->p_item;
+    if(pi == NULL) {
+      pool_segment_create(p);
+      pi = p->p_item;
+    }
+    p->p_item = pi->link;
   }
-  p->p_item = pi->link;
 
 
   if(p->p_flags & POOL_ZERO_MEM)
@@ -283,6 +431,15 @@ pool_get(pool_t *p)
 void
 pool_put(pool_t *p, void *ptr)
 {
+  pool_magazine_t *pm = NULL;
+
+  if(p->p_flags & POOL_THREAD_CACHE) {
+    pm = pool_magazine_get(p);
+    pm->pm_num_out--;
+  } else {
+    p->p_num_out--;
+  }
+
 #if defined(POOL_BY_MMAP)
 
 #if defined(MADV_FREE)
@@ -303,11 +460,19 @@ pool_put(pool_t *p, void *ptr)
 
 #ifdef POOL_DEBUG
   pool_segment_t *ps;
+
+  // Segments may be added by other threads when refilling their magazines
+  if(pm != NULL)
+    hts_mutex_lock(&p->p_mutex);
+
   LIST_FOREACH(ps, &p->p_segments, ps_link)
     if((uintptr_t)pi >= (uintptr_t)ps->ps_addr &&
        (uintptr_t)pi < (uintptr_t)ps->ps_addr + ps->ps_avail_size)
       break;
 
+  if(pm != NULL)
+    hts_mutex_unlock(&p->p_mutex);
+
   if(ps == NULL) {
     TRACE(TRACE_ERROR, "POOL", "%s: Item %p not in any segment",
           p->p_name, pi);
@@ -324,10 +489,21 @@ pool_put(pool_t *p, void *ptr)
   memset(pi, 0xff, p->p_item_size);
 #endif
 
-  pi->link = p->p_item;
-  p->p_item = pi;
+  if(pm != NULL) {
+    pi->link = pm->pm_items;
+    pm->pm_items = pi;
+    pm->pm_count++;
+
+    if(pm->pm_count >= POOL_MAGAZINE_BATCH * 2) {
+      hts_mutex_lock(&p->p_mutex);
+      pool_magazine_drain(p, pm, POOL_MAGAZINE_BATCH);
+      hts_mutex_unlock(&p->p_mutex);
+    }
+  } else {
+    pi->link = p->p_item;
+    p->p_item = pi;
+  }
 #endif
-  p->p_num_out--;
 }
 
 
@@ -337,7 +513,16 @@ pool_put(pool_t *p, void *ptr)
 int
 pool_num(pool_t *p)
 {
-  return p->p_num_out;
+  if(!(p->p_flags & POOL_THREAD_CACHE))
+    return p->p_num_out;
+
+  pool_magazine_t *pm;
+  hts_mutex_lock(&p->p_mutex);
+  int r = p->p_num_out;
+  LIST_FOREACH(pm, &p->p_magazines, pm_link)
+    r += pm->pm_num_out;
+  hts_mutex_unlock(&p->p_mutex);
+  return r;
 }
 
 
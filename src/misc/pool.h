@@ -27,6 +27,7 @@
 #endif
 
 LIST_HEAD(pool_segment_list, pool_segment);
+LIST_HEAD(pool_magazine_list, pool_magazine);
 
 
 /**
@@ -44,10 +45,20 @@ typedef struct pool {
 
   int p_num_out;
   const char *p_name;
+
+  // Per thread magazines, only used with POOL_THREAD_CACHE
+  hts_key_t p_magazine_key;
+  struct pool_magazine_list p_magazines;
 } pool_t;
 
 
-#define POOL_ZERO_MEM  0x2
+#define POOL_ZERO_MEM     0x2
+
+/**
+ * Pool may be used from multiple threads without any external locking.
+ * Each thread gets its own cache of free items.
+ */
+#define POOL_THREAD_CACHE 0x4
 
 pool_t *pool_create(const char *name, size_t item_size, int flags);
 
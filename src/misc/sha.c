@@ -0,0 +1,198 @@
+/*
+ *  Copyright (C) 2007-2015 Lonelycoder AB
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  This program is also available under a commercial proprietary license.
+ *  For more information, contact andreas@lonelycoder.com
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "sha.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+  (__GNUC__ >= 5 || defined(__clang__))
+#define SHA1_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#else
+#define SHA1_X86 0
+#endif
+
+
+#if SHA1_X86
+
+static int sha1_x86_available = -1;
+
+/**
+ * SHA extensions, plus SSSE3 and SSE4.1 for the shuffles and extracts
+ */
+static int
+sha1_x86_probe(void)
+{
+  unsigned int eax, ebx, ecx, edx;
+
+  if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return 0;
+
+  if(!(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1))
+    return 0;
+
+  if(__get_cpuid_max(0, NULL) < 7)
+    return 0;
+
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  return !!(ebx & (1 << 29));
+}
+
+
+/**
+ * One group of four rounds. The message schedule for the group three
+ * steps ahead is computed along the way, interleaved as suggested by
+ * Intel so the dependency chains overlap.
+ */
+#define SHA1_X86_ROUNDS(g) do {                                         \
+    if(g < 4) {                                                         \
+      M[g] = _mm_loadu_si128((const __m128i *)(data + g * 16));         \
+      M[g] = _mm_shuffle_epi8(M[g], bswap);                             \
+    }                                                                   \
+    if(g == 0)                                                          \
+      E = _mm_add_epi32(E, M[0]);                                       \
+    else                                                                \
+      E = _mm_sha1nexte_epu32(prev, M[g & 3]);                          \
+    prev = ABCD;                                                        \
+    ABCD = _mm_sha1rnds4_epu32(ABCD, E, g / 5);                         \
+    if(g >= 1 && g <= 16)                                               \
+      M[(g - 1) & 3] = _mm_sha1msg1_epu32(M[(g - 1) & 3], M[g & 3]);    \
+    if(g >= 2 && g <= 17)                                               \
+      M[(g - 2) & 3] = _mm_xor_si128(M[(g - 2) & 3], M[g & 3]);         \
+    if(g >= 3 && g <= 18)                                               \
+      M[(g - 3) & 3] = _mm_sha1msg2_epu32(M[(g - 3) & 3], M[g & 3]);    \
+  } while(0)
+
+
+/**
+ *
+ */
+__attribute__((target("sha,ssse3,sse4.1")))
+static void
+sha1_x86_blocks(uint32_t state[5], const uint8_t *data, size_t blocks)
+{
+  const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL,
+                                       0x08090a0b0c0d0e0fULL);
+  __m128i ABCD = _mm_loadu_si128((const __m128i *)state);
+  __m128i E0   = _mm_set_epi32(state[4], 0, 0, 0);
+  __m128i M[4], E, prev;
+
+  ABCD = _mm_shuffle_epi32(ABCD, 0x1b);
+
+  for(; blocks > 0; blocks--, data += 64) {
+    const __m128i ABCD_save = ABCD;
+    E = E0;
+
+    SHA1_X86_ROUNDS(0);  SHA1_X86_ROUNDS(1);
+    SHA1_X86_ROUNDS(2);  SHA1_X86_ROUNDS(3);
+    SHA1_X86_ROUNDS(4);  SHA1_X86_ROUNDS(5);
+    SHA1_X86_ROUNDS(6);  SHA1_X86_ROUNDS(7);
+    SHA1_X86_ROUNDS(8);  SHA1_X86_ROUNDS(9);
+    SHA1_X86_ROUNDS(10); SHA1_X86_ROUNDS(11);
+    SHA1_X86_ROUNDS(12); SHA1_X86_ROUNDS(13);
+    SHA1_X86_ROUNDS(14); SHA1_X86_ROUNDS(15);
+    SHA1_X86_ROUNDS(16); SHA1_X86_ROUNDS(17);
+    SHA1_X86_ROUNDS(18); SHA1_X86_ROUNDS(19);
+
+    E0 = _mm_sha1nexte_epu32(prev, E0);
+    ABCD = _mm_add_epi32(ABCD, ABCD_save);
+  }
+
+  ABCD = _mm_shuffle_epi32(ABCD, 0x1b);
+  _mm_storeu_si128((__m128i *)state, ABCD);
+  state[4] = _mm_extract_epi32(E0, 3);
+}
+
+
+/**
+ *
+ */
+static void
+sha1_x86(const uint8_t *data, size_t len, uint8_t *digest)
+{
+  uint32_t state[5] = {
+    0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+  };
+  uint8_t tail[128] = {0};
+  const size_t full = len / 64;
+  const size_t rem = len & 63;
+  const uint64_t bits = (uint64_t)len * 8;
+
+  sha1_x86_blocks(state, data, full);
+
+  memcpy(tail, data + full * 64, rem);
+  tail[rem] = 0x80;
+  const int tailblocks = rem < 56 ? 1 : 2;
+  for(int i = 0; i < 8; i++)
+    tail[tailblocks * 64 - 1 - i] = bits >> (i * 8);
+  sha1_x86_blocks(state, tail, tailblocks);
+
+  for(int i = 0; i < 5; i++) {
+    digest[i * 4 + 0] = state[i] >> 24;
+    digest[i * 4 + 1] = state[i] >> 16;
+    digest[i * 4 + 2] = state[i] >> 8;
+    digest[i * 4 + 3] = state[i];
+  }
+}
+
+#endif
+
+
+/**
+ * SHA-1 of a single buffer. Uses the SHA instructions when the CPU
+ * has them and the regular implementation otherwise
+ */
+void
+sha1_digest(const void *data, size_t len, uint8_t *digest)
+{
+#if SHA1_X86
+  if(sha1_x86_available == -1)
+    sha1_x86_available = sha1_x86_probe();
+
+  if(sha1_x86_available) {
+    sha1_x86(data, len, digest);
+    return;
+  }
+#endif
+
+  sha1_decl(shactx);
+  sha1_init(shactx);
+  sha1_update(shactx, data, len);
+  sha1_final(shactx, digest);
+}
+
+
+/**
+ * Returns 1 if sha1_digest() is hardware accelerated
+ */
+int
+sha1_digest_accelerated(void)
+{
+#if SHA1_X86
+  if(sha1_x86_available == -1)
+    sha1_x86_available = sha1_x86_probe();
+  return sha1_x86_available;
+#else
+  return 0;
+#endif
+}
@@ -18,6 +18,8 @@
  *  For more information, contact andreas@lonelycoder.com
  */
 #pragma once
+#include <stdint.h>
+#include <stddef.h>
 #include "config.h"
 
 #if ENABLE_COMMONCRYPTO
@@ -64,3 +66,7 @@
 #else
 #error no sha1
 #endif
+
+void sha1_digest(const void *data, size_t len, uint8_t *digest);
+
+int sha1_digest_accelerated(void);
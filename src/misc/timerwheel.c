@@ -0,0 +1,358 @@
+/*
+ *  Copyright (C) 2007-2015 Lonelycoder AB
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  This program is also available under a commercial proprietary license.
+ *  For more information, contact andreas@lonelycoder.com
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "arch/arch.h"
+#include "timerwheel.h"
+
+#define TW_SLOT_MASK (TW_SLOTS - 1)
+
+// Longest delta (in ticks) the wheel can hold. Entries further away are
+// parked in the last bucket and reinserted when it is reached
+#define TW_MAX_DELTA ((1ULL << (TW_SLOT_BITS * TW_LEVELS)) - 1)
+
+
+/**
+ *
+ */
+void
+timerwheel_init(timerwheel_t *tw, int64_t now)
+{
+  memset(tw, 0, sizeof(timerwheel_t));
+  tw->tw_tick = now >> TW_TICK_SHIFT;
+}
+
+
+/**
+ * Put entry into its bucket relative to the current tick
+ */
+static void
+timerwheel_insert(timerwheel_t *tw, timerwheel_entry_t *twe)
+{
+  const int64_t t = (twe->twe_deadline + (1 << TW_TICK_SHIFT) - 1) >>
+    TW_TICK_SHIFT;
+
+  if(t < (int64_t)tw->tw_tick) {
+    twe->twe_slot = TW_SLOT_DUE;
+    LIST_INSERT_HEAD(&tw->tw_due, twe, twe_link);
+    return;
+  }
+
+  uint64_t tick = t;
+  uint64_t delta = tick - tw->tw_tick;
+
+  if(delta > TW_MAX_DELTA) {
+    delta = TW_MAX_DELTA;
+    tick = tw->tw_tick + delta;
+  }
+
+  int level = 0;
+  while(delta >> (TW_SLOT_BITS * (level + 1)))
+    level++;
+
+  const int slot = (tick >> (TW_SLOT_BITS * level)) & TW_SLOT_MASK;
+  twe->twe_slot = level * TW_SLOTS + slot;
+  LIST_INSERT_HEAD(&tw->tw_slots[level][slot], twe, twe_link);
+  tw->tw_bitmap[level] |= 1ULL << slot;
+}
+
+
+/**
+ * Entry must not be armed
+ */
+void
+timerwheel_arm(timerwheel_t *tw, timerwheel_entry_t *twe, int64_t deadline)
+{
+  twe->twe_deadline = deadline;
+  timerwheel_insert(tw, twe);
+  tw->tw_count++;
+}
+
+
+/**
+ *
+ */
+void
+timerwheel_disarm(timerwheel_t *tw, timerwheel_entry_t *twe)
+{
+  LIST_REMOVE(twe, twe_link);
+  tw->tw_count--;
+
+  if(twe->twe_slot == TW_SLOT_DUE)
+    return;
+
+  const int level = twe->twe_slot / TW_SLOTS;
+  const int slot  = twe->twe_slot & TW_SLOT_MASK;
+  if(LIST_FIRST(&tw->tw_slots[level][slot]) == NULL)
+    tw->tw_bitmap[level] &= ~(1ULL << slot);
+}
+
+
+/**
+ * Return the first tick >= tw_tick at which a bucket needs to be
+ * processed, either expired (level 0) or cascaded (level 1 and up)
+ */
+static uint64_t
+timerwheel_next_stop(const timerwheel_t *tw)
+{
+  uint64_t r = UINT64_MAX;
+
+  for(int level = 0; level < TW_LEVELS; level++) {
+    const uint64_t bitmap = tw->tw_bitmap[level];
+    if(bitmap == 0)
+      continue;
+
+    const int shift = TW_SLOT_BITS * level;
+    const uint64_t block = tw->tw_tick >> shift;
+    const int idx = block & TW_SLOT_MASK;
+
+    // The current bucket is still pending if we sit on its first tick
+    const int first = tw->tw_tick & ((1ULL << shift) - 1) ? idx + 1 : idx;
+
+    uint64_t b;
+    const uint64_t ahead = first < TW_SLOTS ? bitmap >> first << first : 0;
+    if(ahead)
+      b = (block & ~(uint64_t)TW_SLOT_MASK) + __builtin_ctzll(ahead);
+    else
+      b = (block & ~(uint64_t)TW_SLOT_MASK) + TW_SLOTS +
+        __builtin_ctzll(bitmap);
+
+    const uint64_t t = b << shift;
+    if(t < r)
+      r = t;
+  }
+  return r;
+}
+
+
+/**
+ * Move all entries in a bucket one or more levels down
+ */
+static void
+timerwheel_cascade(timerwheel_t *tw, int level, int slot)
+{
+  struct timerwheel_entry_list l;
+  timerwheel_entry_t *twe;
+
+  LIST_MOVE(&l, &tw->tw_slots[level][slot], twe_link);
+  LIST_INIT(&tw->tw_slots[level][slot]);
+  tw->tw_bitmap[level] &= ~(1ULL << slot);
+
+  while((twe = LIST_FIRST(&l)) != NULL) {
+    LIST_REMOVE(twe, twe_link);
+    timerwheel_insert(tw, twe);
+  }
+}
+
+
+/**
+ * Advance the wheel towards 'now', stopping after the first tick that
+ * had anything to do. Returns 0 when the wheel has caught up
+ */
+static int
+timerwheel_advance(timerwheel_t *tw, int64_t now)
+{
+  const uint64_t target = now >> TW_TICK_SHIFT;
+
+  if(tw->tw_tick > target)
+    return 0;
+
+  const uint64_t stop = tw->tw_count ? timerwheel_next_stop(tw) : UINT64_MAX;
+  if(stop > target) {
+    tw->tw_tick = target + 1;
+    return 0;
+  }
+
+  tw->tw_tick = stop;
+
+  for(int level = 1; level < TW_LEVELS; level++) {
+    const int shift = TW_SLOT_BITS * level;
+    if(stop & ((1ULL << shift) - 1))
+      break;
+    timerwheel_cascade(tw, level, (stop >> shift) & TW_SLOT_MASK);
+  }
+
+  const int slot = stop & TW_SLOT_MASK;
+  timerwheel_entry_t *twe;
+  while((twe = LIST_FIRST(&tw->tw_slots[0][slot])) != NULL) {
+    LIST_REMOVE(twe, twe_link);
+    twe->twe_slot = TW_SLOT_DUE;
+    LIST_INSERT_HEAD(&tw->tw_due, twe, twe_link);
+  }
+  tw->tw_bitmap[0] &= ~(1ULL << slot);
+
+  tw->tw_tick = stop + 1;
+  return 1;
+}
+
+
+/**
+ * Remove and return one entry with a deadline at or before 'now'.
+ * Entries are not returned in strict deadline order, only entries
+ * expiring within the same tick may be reordered.
+ */
+timerwheel_entry_t *
+timerwheel_get_expired(timerwheel_t *tw, int64_t now)
+{
+  timerwheel_entry_t *twe;
+
+  while((twe = LIST_FIRST(&tw->tw_due)) == NULL) {
+    if(!timerwheel_advance(tw, now))
+      return NULL;
+  }
+  LIST_REMOVE(twe, twe_link);
+  tw->tw_count--;
+  return twe;
+}
+
+
+/**
+ * Return the earliest time at which timerwheel_get_expired() may return
+ * an entry, or INT64_MAX if the wheel is empty. This is a lower bound,
+ * waking up at this time may find nothing to do if it was a bucket on a
+ * higher level that needed to be cascaded.
+ */
+int64_t
+timerwheel_next_deadline(const timerwheel_t *tw)
+{
+  if(tw->tw_count == 0)
+    return INT64_MAX;
+  if(LIST_FIRST(&tw->tw_due) != NULL)
+    return 0;
+  return timerwheel_next_stop(tw) << TW_TICK_SHIFT;
+}
+
+
+/**
+ * Benchmark
+ *
+ * Arm, rearm and cancel a large number of timers with random deadlines,
+ * then let a batch of them expire on a simulated clock and verify that
+ * none fires early or more than one tick late. For reference the same
+ * arm and cancel pattern is run against a sorted list (as callouts and
+ * asyncio timers were kept before) with fewer timers.
+ */
+#define TWBENCH_TIMERS 100000
+#define TWBENCH_LIST_TIMERS 10000
+
+typedef struct twbench_timer {
+  timerwheel_entry_t tbt_twe;
+  LIST_ENTRY(twbench_timer) tbt_link;
+  int64_t tbt_deadline;
+  int tbt_fired;
+} twbench_timer_t;
+
+LIST_HEAD(twbench_timer_list, twbench_timer);
+
+static int
+twbench_cmp(const twbench_timer_t *a, const twbench_timer_t *b)
+{
+  return a->tbt_deadline < b->tbt_deadline ? -1 : 1;
+}
+
+
+static void
+timerwheel_bench(void)
+{
+  twbench_timer_t *v = calloc(TWBENCH_TIMERS, sizeof(twbench_timer_t));
+  timerwheel_t *tw = malloc(sizeof(timerwheel_t));
+  int64_t now = 1000000000LL;
+  unsigned int seed = 1;
+  int64_t ts;
+
+  timerwheel_init(tw, now);
+
+  for(int i = 0; i < TWBENCH_TIMERS; i++)
+    v[i].tbt_deadline = now + rand_r(&seed) % 60000000;
+
+  ts = arch_get_ts();
+  for(int i = 0; i < TWBENCH_TIMERS; i++)
+    timerwheel_arm(tw, &v[i].tbt_twe, v[i].tbt_deadline);
+  const int64_t arm = arch_get_ts() - ts;
+
+  ts = arch_get_ts();
+  for(int i = 0; i < TWBENCH_TIMERS; i++) {
+    v[i].tbt_deadline += rand_r(&seed) % 1000000;
+    timerwheel_disarm(tw, &v[i].tbt_twe);
+    timerwheel_arm(tw, &v[i].tbt_twe, v[i].tbt_deadline);
+  }
+  const int64_t rearm = arch_get_ts() - ts;
+
+  // Cancel every other timer, let the rest expire
+  ts = arch_get_ts();
+  for(int i = 0; i < TWBENCH_TIMERS; i += 2)
+    timerwheel_disarm(tw, &v[i].tbt_twe);
+  const int64_t cancel = arch_get_ts() - ts;
+
+  int early = 0, late = 0, wrong = 0, wakeups = 0;
+  timerwheel_entry_t *twe;
+
+  ts = arch_get_ts();
+  while(tw->tw_count) {
+    wakeups++;
+    now = timerwheel_next_deadline(tw);
+    while((twe = timerwheel_get_expired(tw, now)) != NULL) {
+      twbench_timer_t *t = timerwheel_entry_to(twe, twbench_timer_t, tbt_twe);
+      if(t->tbt_deadline > now)
+        early++;
+      if(now - t->tbt_deadline >= (1 << TW_TICK_SHIFT))
+        late++;
+      t->tbt_fired++;
+    }
+  }
+  const int64_t expire = arch_get_ts() - ts;
+
+  for(int i = 0; i < TWBENCH_TIMERS; i++)
+    if(v[i].tbt_fired != (i & 1))
+      wrong++;
+
+  printf("timerwheel: %d timers  arm %d ns  rearm %d ns  cancel %d ns  "
+         "expire %d ns per timer, %d wakeups\n",
+         TWBENCH_TIMERS,
+         (int)(arm * 1000 / TWBENCH_TIMERS),
+         (int)(rearm * 1000 / TWBENCH_TIMERS),
+         (int)(cancel * 2000 / TWBENCH_TIMERS),
+         (int)(expire * 2000 / TWBENCH_TIMERS),
+         wakeups);
+  if(early || late || wrong)
+    printf("timerwheel: %d timers fired early, %d late, %d wrongly\n",
+           early, late, wrong);
+  free(tw);
+
+  struct twbench_timer_list list;
+  LIST_INIT(&list);
+
+  ts = arch_get_ts();
+  for(int i = 0; i < TWBENCH_LIST_TIMERS; i++)
+    LIST_INSERT_SORTED(&list, &v[i], tbt_link, twbench_cmp, twbench_timer_t);
+  for(int i = 0; i < TWBENCH_LIST_TIMERS; i++)
+    LIST_REMOVE(&v[i], tbt_link);
+  const int64_t sorted = arch_get_ts() - ts;
+
+  printf("timerwheel: sorted list, %d timers  arm+cancel %d ns per timer\n",
+         TWBENCH_LIST_TIMERS, (int)(sorted * 1000 / TWBENCH_LIST_TIMERS));
+
+  free(v);
+}
+
+BENCHMARK("timerwheel", timerwheel_bench);
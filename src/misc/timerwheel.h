@@ -0,0 +1,73 @@
+/*
+ *  Copyright (C) 2007-2015 Lonelycoder AB
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  This program is also available under a commercial proprietary license.
+ *  For more information, contact andreas@lonelycoder.com
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "queue.h"
+
+/**
+ * Hierarchical timing wheel
+ *
+ * Timers are kept in TW_LEVELS levels of TW_SLOTS buckets each. Level 0
+ * has a resolution of one tick (1 << TW_TICK_SHIFT us) and every level
+ * above covers TW_SLOTS times the range of the one below. Entries are
+ * moved down a level when the wheel reaches the start of their bucket.
+ *
+ * Arm and disarm are O(1). Timers never fire early and fire at most one
+ * tick late. The wheel does no locking of its own and does not track
+ * whether an entry is armed, that is up to the user.
+ */
+#define TW_TICK_SHIFT 10
+#define TW_SLOT_BITS  6
+#define TW_SLOTS      (1 << TW_SLOT_BITS)
+#define TW_LEVELS     6
+
+typedef struct timerwheel_entry {
+  LIST_ENTRY(timerwheel_entry) twe_link;
+  int64_t twe_deadline;
+  int twe_slot;   // level * TW_SLOTS + slot or TW_SLOT_DUE
+} timerwheel_entry_t;
+
+#define TW_SLOT_DUE -1
+
+LIST_HEAD(timerwheel_entry_list, timerwheel_entry);
+
+typedef struct timerwheel {
+  uint64_t tw_tick;    // Next tick to process
+  int tw_count;
+  uint64_t tw_bitmap[TW_LEVELS];
+  struct timerwheel_entry_list tw_due;
+  struct timerwheel_entry_list tw_slots[TW_LEVELS][TW_SLOTS];
+} timerwheel_t;
+
+void timerwheel_init(timerwheel_t *tw, int64_t now);
+
+void timerwheel_arm(timerwheel_t *tw, timerwheel_entry_t *twe,
+                    int64_t deadline);
+
+void timerwheel_disarm(timerwheel_t *tw, timerwheel_entry_t *twe);
+
+timerwheel_entry_t *timerwheel_get_expired(timerwheel_t *tw, int64_t now);
+
+int64_t timerwheel_next_deadline(const timerwheel_t *tw);
+
+#define timerwheel_entry_to(ptr, type, field) \
+  ((type *)((char *)(ptr) - offsetof(type, field)))
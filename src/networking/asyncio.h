@@ -20,10 +20,11 @@
 #pragma once
 #include "net.h"
 #include "misc/redblack.h"
+#include "misc/timerwheel.h"
 
 
 typedef struct asyncio_timer {
-  LIST_ENTRY(asyncio_timer) at_link;
+  timerwheel_entry_t at_twe;
   int64_t at_expire;
   void (*at_fn)(void *opaque);
   void *at_opaque;
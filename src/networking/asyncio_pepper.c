@@ -96,8 +96,7 @@ static PP_Resource asyncio_msgloop;
 static void (*workers[MAX_WORKERS])(void);
 static int workers_cnt;
 
-LIST_HEAD(asyncio_timer_list, asyncio_timer);
-static struct asyncio_timer_list asyncio_timers;
+static timerwheel_t asyncio_timers;
 
 static void tcp_do_write(asyncio_fd_t *af);
 static void tcp_do_recv(asyncio_fd_t *af);
@@ -163,29 +162,16 @@ asyncio_timer_init(asyncio_timer_t *at, void (*fn)(void *opaque),
 }
 
 
-/**
- *
- */
-static int
-at_compar(const asyncio_timer_t *a, const asyncio_timer_t *b)
-{
-  if(a->at_expire < b->at_expire)
-    return -1;
-  return 1;
-}
-
-
 /**
  *
  */
 static void
 process_timers(int64_t now)
 {
-  asyncio_timer_t *at;
+  timerwheel_entry_t *twe;
 
-  while((at = LIST_FIRST(&asyncio_timers)) != NULL &&
-        at->at_expire <= now) {
-    LIST_REMOVE(at, at_link);
+  while((twe = timerwheel_get_expired(&asyncio_timers, now)) != NULL) {
+    asyncio_timer_t *at = timerwheel_entry_to(twe, asyncio_timer_t, at_twe);
     at->at_expire = 0;
     at->at_fn(at->at_opaque);
   }
@@ -199,10 +185,10 @@ void
 asyncio_timer_arm(asyncio_timer_t *at, int64_t expire)
 {
   if(at->at_expire)
-    LIST_REMOVE(at, at_link);
+    timerwheel_disarm(&asyncio_timers, &at->at_twe);
 
   at->at_expire = expire;
-  LIST_INSERT_SORTED(&asyncio_timers, at, at_link, at_compar, asyncio_timer_t);
+  timerwheel_arm(&asyncio_timers, &at->at_twe, expire);
 }
 
 
@@ -223,7 +209,7 @@ void
 asyncio_timer_disarm(asyncio_timer_t *at)
 {
   if(at->at_expire) {
-    LIST_REMOVE(at, at_link);
+    timerwheel_disarm(&asyncio_timers, &at->at_twe);
     at->at_expire = 0;
   }
 }
@@ -1159,6 +1145,7 @@ static void
 asyncio_start_on_thread(void *aux, int val)
 {
   asyncio_courier = prop_courier_create_notify(asyncio_courier_notify, NULL);
+  timerwheel_init(&asyncio_timers, async_current_time());
 
   init_group(INIT_GROUP_ASYNCIO);
   asyncio_periodic(NULL, 0);
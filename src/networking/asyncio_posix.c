@@ -25,6 +25,7 @@
 #include <poll.h>
 #include <errno.h>
 #include <netinet/in.h>
+#include <sys/resource.h>
 
 #include "main.h"
 #include "arch/arch.h"
@@ -34,6 +35,10 @@
 #include "prop/prop.h"
 #include "misc/minmax.h"
 
+#if ENABLE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 
 /**
  *
@@ -56,13 +61,12 @@ static void asyncio_ssl_handshake(asyncio_fd_t *af);
 
 LIST_HEAD(asyncio_fd_list, asyncio_fd);
 LIST_HEAD(asyncio_worker_list, asyncio_worker);
-LIST_HEAD(asyncio_timer_list, asyncio_timer);
 TAILQ_HEAD(asyncio_dns_req_queue, asyncio_dns_req);
 TAILQ_HEAD(asyncio_task_queue, asyncio_task);
 
 static hts_thread_t asyncio_thread_id;
 
-static struct asyncio_timer_list asyncio_timers;
+static timerwheel_t asyncio_timers;
 
 static hts_mutex_t asyncio_worker_mutex;
 static struct asyncio_worker_list asyncio_workers;
@@ -71,6 +75,11 @@ static int asyncio_pipe[2];
 static struct asyncio_fd_list asyncio_fds;
 static int asyncio_num_fds;
 
+#if ENABLE_EPOLL
+static int asyncio_epfd = -1;
+static struct asyncio_fd_list asyncio_dirty_fds;
+#endif
+
 struct prop_courier *asyncio_courier;
 
 static hts_mutex_t asyncio_dns_mutex;
@@ -120,7 +129,13 @@ struct asyncio_fd {
   htsbuf_queue_t af_sendq;
   htsbuf_queue_t af_recvq;
 
-  int64_t af_timeout;
+  asyncio_timer_t af_timer;
+
+#if ENABLE_EPOLL
+  LIST_ENTRY(asyncio_fd) af_dirty_link;
+  int af_epoll_events;  // Events registered with epoll, -1 if not added
+  int af_dirty;
+#endif
 
   int af_refcount;
   int af_fd;
@@ -277,18 +292,6 @@ asyncio_timer_init(asyncio_timer_t *at, void (*fn)(void *opaque),
 }
 
 
-/**
- *
- */
-static int
-at_compar(const asyncio_timer_t *a, const asyncio_timer_t *b)
-{
-  if(a->at_expire < b->at_expire)
-    return -1;
-  return 1;
-}
-
-
 /**
  *
  */
@@ -297,10 +300,10 @@ asyncio_timer_arm(asyncio_timer_t *at, int64_t expire)
 {
   asyncio_verify_thread();
   if(at->at_expire)
-    LIST_REMOVE(at, at_link);
+    timerwheel_disarm(&asyncio_timers, &at->at_twe);
 
   at->at_expire = expire;
-  LIST_INSERT_SORTED(&asyncio_timers, at, at_link, at_compar, asyncio_timer_t);
+  timerwheel_arm(&asyncio_timers, &at->at_twe, expire);
 }
 
 
@@ -322,7 +325,7 @@ asyncio_timer_disarm(asyncio_timer_t *at)
 {
   asyncio_verify_thread();
   if(at->at_expire) {
-    LIST_REMOVE(at, at_link);
+    timerwheel_disarm(&asyncio_timers, &at->at_twe);
     at->at_expire = 0;
   }
 }
@@ -352,6 +355,56 @@ af_release(asyncio_fd_t *af)
 }
 
 
+/**
+ * Interest changes are collected on a list and handed to the kernel
+ * right before waiting, so an fd that changes its events several times
+ * during one iteration costs at most one epoll_ctl()
+ */
+static void
+asyncio_fd_dirty(asyncio_fd_t *af)
+{
+#if ENABLE_EPOLL
+  if(asyncio_epfd == -1 || af->af_dirty)
+    return;
+  af->af_dirty = 1;
+  LIST_INSERT_HEAD(&asyncio_dirty_fds, af, af_dirty_link);
+#endif
+}
+
+
+/**
+ * Drop the fd from the epoll set while it's still open. Once closed the
+ * number may be reused by a new socket which a late EPOLL_CTL_DEL would
+ * hit instead
+ */
+static void
+asyncio_fd_close(asyncio_fd_t *af)
+{
+#if ENABLE_EPOLL
+  if(af->af_epoll_events != -1) {
+    struct epoll_event ev = {0};
+    epoll_ctl(asyncio_epfd, EPOLL_CTL_DEL, af->af_fd, &ev);
+    af->af_epoll_events = -1;
+  }
+#endif
+  close(af->af_fd);
+  af->af_fd = -1;
+}
+
+
+/**
+ *
+ */
+static void
+asyncio_fd_timeout(void *aux)
+{
+  asyncio_fd_t *af = aux;
+  af->af_refcount++;
+  af->af_callback(af, af->af_opaque, ASYNCIO_TIMEOUT, 0);
+  af_release(af);
+}
+
+
 /**
  *
  */
@@ -368,39 +421,90 @@ events_to_poll(int events)
  *
  */
 static void
-asyncio_dopoll(void)
+asyncio_run_timers(void)
 {
-  asyncio_timer_t *at;
+  timerwheel_entry_t *twe;
 
-  while((at = LIST_FIRST(&asyncio_timers)) != NULL &&
-        at->at_expire <= async_now) {
-    LIST_REMOVE(at, at_link);
+  while((twe = timerwheel_get_expired(&asyncio_timers, async_now)) != NULL) {
+    asyncio_timer_t *at = timerwheel_entry_to(twe, asyncio_timer_t, at_twe);
     at->at_expire = 0;
     at->at_fn(at->at_opaque);
   }
+}
+
+
+/**
+ *
+ */
+static int
+asyncio_poll_timeout(void)
+{
+  const int64_t next = timerwheel_next_deadline(&asyncio_timers);
+  if(next == INT64_MAX)
+    return -1;
+  return MIN(INT32_MAX, MAX(0, (next - async_now + 999) / 1000));
+}
+
+
+/**
+ * Deliver events (in poll() format) to an fd
+ */
+static void
+asyncio_fd_dispatch(asyncio_fd_t *af, int revents, int pollerr)
+{
+  if(af->af_callback == NULL)
+    return;
+
+  if(revents & POLLHUP) {
+    af->af_callback(af, af->af_opaque, ASYNCIO_ERROR, ECONNRESET);
+    return;
+  }
+
+  if(revents & POLLERR || pollerr) {
+    int err;
+    socklen_t errlen = sizeof(int);
+
+    if(getsockopt(af->af_fd, SOL_SOCKET, SO_ERROR, (void *)&err, &errlen)) {
+      TRACE(TRACE_ERROR, "ASYNCIO", "getsockopt failed for %s 0x%x -- %s",
+            af->af_name, af->af_fd, strerror(errno));
+      af->af_callback(af, af->af_opaque, ASYNCIO_ERROR, ENOBUFS);
+    } else {
+      if(err) {
+        af->af_callback(af, af->af_opaque, ASYNCIO_ERROR, err);
+        return;
+      }
+    }
+  }
+
+  const int events =
+    (revents & POLLIN  ? ASYNCIO_READ  : 0) |
+    (revents & POLLOUT ? ASYNCIO_WRITE : 0);
+
+  if(events)
+    af->af_callback(af, af->af_opaque, events, 0);
+}
+
+
+/**
+ * Fallback when epoll is not available. Rebuilds the pollfd array from
+ * all fds on every iteration
+ */
+static void
+asyncio_dopoll(void)
+{
+  asyncio_run_timers();
 
   asyncio_fd_t *af;
   struct pollfd *fds = alloca(asyncio_num_fds * sizeof(struct pollfd));
   asyncio_fd_t **afds  = alloca(asyncio_num_fds * sizeof(asyncio_fd_t *));
   int n = 0;
 
-  int timeout = INT32_MAX;
-
   LIST_FOREACH(af, &asyncio_fds, af_link) {
     if(af->af_pending_errno) {
       af->af_callback(af, af->af_opaque, ASYNCIO_ERROR, af->af_pending_errno);
       goto release;
     }
 
-    if(af->af_timeout) {
-      if(af->af_timeout <= async_now) {
-        af->af_timeout = 0;
-        af->af_callback(af, af->af_opaque, ASYNCIO_TIMEOUT, 0);
-        goto release;
-      }
-      timeout = MIN(timeout, (af->af_timeout - async_now + 999) / 1000);
-    }
-
     if(af->af_fd == -1) {
       continue;
     }
@@ -421,68 +525,130 @@ asyncio_dopoll(void)
     n++;
   }
 
-  if((at = LIST_FIRST(&asyncio_timers)) != NULL)
-    timeout = MIN(timeout, (at->at_expire - async_now + 999) / 1000);
+  int err = poll(fds, n, asyncio_poll_timeout());
 
-  if(timeout == INT32_MAX)
-    timeout = -1;
+  async_now = arch_get_ts();
 
-  int err = poll(fds, n, timeout);
+  for(int i = 0; i < n; i++)
+    asyncio_fd_dispatch(afds[i], fds[i].revents, err < 0);
 
-  async_now = arch_get_ts();
+ release:
 
-  for(int i = 0; i < n; i++) {
-    af = afds[i];
+  for(int i = 0; i < n; i++)
+    af_release(afds[i]);
+}
 
-    if(af->af_callback == NULL)
-      continue;
 
-    if(fds[i].revents & POLLHUP) {
-      af->af_callback(af, af->af_opaque, ASYNCIO_ERROR, ECONNRESET);
-      continue;
-    }
+#if ENABLE_EPOLL
 
-    if(fds[i].revents & POLLERR || err < 0) {
-      int err;
-      socklen_t errlen = sizeof(int);
+/**
+ * Hand the current set of wanted events for an fd to the kernel
+ */
+static void
+asyncio_epoll_sync(asyncio_fd_t *af)
+{
+  int events;
 
-      if(getsockopt(af->af_fd, SOL_SOCKET, SO_ERROR, (void *)&err, &errlen)) {
-        TRACE(TRACE_ERROR, "ASYNCIO", "getsockopt failed for %s 0x%x -- %s",
-              af->af_name, af->af_fd, strerror(errno));
-        af->af_callback(af, af->af_opaque, ASYNCIO_ERROR, ENOBUFS);
-      } else {
-        if(err) {
-          af->af_callback(af, af->af_opaque, ASYNCIO_ERROR, err);
-          continue;
-        }
-      }
-    }
+#if ENABLE_OPENSSL
+  if(af->af_ssl != NULL)
+    events = asyncio_ssl_events(af);
+  else
+#endif
+    events = af->af_poll_events;
+
+  // The SSL code above may end up in callbacks that close the fd
+  if(af->af_fd == -1 || af->af_callback == NULL)
+    return;
 
-    const int events =
-      (fds[i].revents & POLLIN  ? ASYNCIO_READ  : 0) |
-      (fds[i].revents & POLLOUT ? ASYNCIO_WRITE : 0);
+  events =
+    (events & POLLIN  ? EPOLLIN  : 0) |
+    (events & POLLOUT ? EPOLLOUT : 0);
 
-    if(events)
-      af->af_callback(af, af->af_opaque, events, 0);
+  if(events == af->af_epoll_events)
+    return;
 
-    if(0) {
-      int64_t now = arch_get_ts();
+  struct epoll_event ev = {0};
+  ev.events = events;
+  ev.data.ptr = af;
 
-      if(now - async_now > 10000) {
-        TRACE(TRACE_ERROR, "ASYNCIO", "Long callback on socktet %s (%d µs)",
-              af->af_name, (int) (now - async_now));
-      }
-      async_now = now;
+  const int op = af->af_epoll_events == -1 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+  if(epoll_ctl(asyncio_epfd, op, af->af_fd, &ev)) {
+    TRACE(TRACE_ERROR, "ASYNCIO", "epoll_ctl failed for %s 0x%x -- %s",
+          af->af_name, af->af_fd, strerror(errno));
+    return;
+  }
+  af->af_epoll_events = events;
+}
+
+
+/**
+ * Only fds that changed since last iteration are visited. The list is
+ * detached first so fds marked dirty again by callbacks are picked up
+ * on the next iteration instead of looping here.
+ */
+static void
+asyncio_epoll_dopoll(void)
+{
+  asyncio_run_timers();
+
+  struct asyncio_fd_list dirty;
+  asyncio_fd_t *af;
+
+  LIST_MOVE(&dirty, &asyncio_dirty_fds, af_dirty_link);
+  LIST_INIT(&asyncio_dirty_fds);
+
+  while((af = LIST_FIRST(&dirty)) != NULL) {
+    LIST_REMOVE(af, af_dirty_link);
+    af->af_dirty = 0;
+    af->af_refcount++;
+
+    if(af->af_pending_errno) {
+      const int err = af->af_pending_errno;
+      af->af_pending_errno = 0;
+      af->af_callback(af, af->af_opaque, ASYNCIO_ERROR, err);
     }
+
+    if(af->af_fd != -1 && af->af_callback != NULL)
+      asyncio_epoll_sync(af);
+    af_release(af);
   }
 
+  struct epoll_event ev[64];
+  asyncio_fd_t *afds[64];
 
- release:
+  const int timeout =
+    LIST_FIRST(&asyncio_dirty_fds) != NULL ? 0 : asyncio_poll_timeout();
+
+  int n = epoll_wait(asyncio_epfd, ev, 64, timeout);
+
+  async_now = arch_get_ts();
+
+  for(int i = 0; i < n; i++) {
+    afds[i] = ev[i].data.ptr;
+    afds[i]->af_refcount++;
+  }
+
+  for(int i = 0; i < n; i++) {
+    const int e = ev[i].events;
+    af = afds[i];
+    asyncio_fd_dispatch(af,
+                        (e & EPOLLIN  ? POLLIN  : 0) |
+                        (e & EPOLLOUT ? POLLOUT : 0) |
+                        (e & EPOLLHUP ? POLLHUP : 0) |
+                        (e & EPOLLERR ? POLLERR : 0), 0);
+#if ENABLE_OPENSSL
+    // Wanted events of SSL connections depend on the state of the session
+    if(af->af_ssl != NULL && af->af_callback != NULL)
+      asyncio_fd_dirty(af);
+#endif
+  }
 
   for(int i = 0; i < n; i++)
     af_release(afds[i]);
 }
 
+#endif
+
 
 /**
  *
@@ -494,6 +660,7 @@ asyncio_set_events(asyncio_fd_t *af, int events)
   af->af_ext_events = events;
 
   af->af_poll_events = events_to_poll(events);
+  asyncio_fd_dirty(af);
 }
 
 
@@ -531,6 +698,10 @@ asyncio_add_fd(int fd, int events, asyncio_fd_callback_t *cb, void *opaque,
   af->af_refcount = 1;
   af->af_fd = fd;
   af->af_name = strdup(name);
+#if ENABLE_EPOLL
+  af->af_epoll_events = -1;
+#endif
+  asyncio_timer_init(&af->af_timer, asyncio_fd_timeout, af);
   asyncio_set_events(af, events);
   af->af_callback = cb;
   af->af_opaque = opaque;
@@ -560,10 +731,16 @@ asyncio_del_fd(asyncio_fd_t *af)
 #endif
 
   if(af->af_fd != -1)
-    close(af->af_fd);
-  af->af_fd = -1;
+    asyncio_fd_close(af);
   LIST_REMOVE(af, af_link);
   asyncio_num_fds--;
+  asyncio_timer_disarm(&af->af_timer);
+#if ENABLE_EPOLL
+  if(af->af_dirty) {
+    LIST_REMOVE(af, af_dirty_link);
+    af->af_dirty = 0;
+  }
+#endif
   af->af_callback = NULL;
   af_release(af);
 }
@@ -575,7 +752,7 @@ asyncio_del_fd(asyncio_fd_t *af)
 void
 asyncio_set_timeout_delta_sec(asyncio_fd_t *af, int delta)
 {
-  af->af_timeout = delta * 1000000LL + async_now;
+  asyncio_timer_arm(&af->af_timer, delta * 1000000LL + async_now);
 }
 
 /**
@@ -661,13 +838,21 @@ asyncio_thread(void *aux)
                  asyncio_courier, "Pipe");
 
   async_now = arch_get_ts();
+  timerwheel_init(&asyncio_timers, async_now);
 
   init_group(INIT_GROUP_ASYNCIO);
 
   asyncio_trig_network_change();
 
-  while(1)
+  while(1) {
+#if ENABLE_EPOLL
+    if(asyncio_epfd != -1) {
+      asyncio_epoll_dopoll();
+      continue;
+    }
+#endif
     asyncio_dopoll();
+  }
   return NULL;
 }
 
@@ -707,6 +892,13 @@ asyncio_init_early(void)
 
   arch_pipe(asyncio_pipe);
 
+#if ENABLE_EPOLL
+  asyncio_epfd = epoll_create(64);
+  if(asyncio_epfd == -1)
+    TRACE(TRACE_ERROR, "ASYNCIO", "epoll unavailable, using poll() -- %s",
+          strerror(errno));
+#endif
+
   asyncio_dns_worker = asyncio_add_worker(adr_deliver_cb);
 }
 
@@ -895,6 +1087,7 @@ do_write(asyncio_fd_t *af)
 #if ENABLE_OPENSSL
   if(af->af_ssl != NULL) {
     asyncio_ssl_write(af);
+    asyncio_fd_dirty(af);
     return;
   }
 #endif
@@ -923,6 +1116,7 @@ do_write(asyncio_fd_t *af)
     if(r == -1) {
       asyncio_rem_events(af, ASYNCIO_WRITE);
       af->af_pending_errno = errno;
+      asyncio_fd_dirty(af);
       return;
     }
 
@@ -980,13 +1174,13 @@ asyncio_tcp_connected(asyncio_fd_t *af, void *opaque, int events, int error)
   if(events & ASYNCIO_ERROR) {
     char buf[256];
     snprintf(buf, sizeof(buf), "%s", strerror(error));
-    af->af_timeout = 0;
+    asyncio_timer_disarm(&af->af_timer);
     af->af_error_callback(af->af_opaque, buf);
     return 0;
   }
 
   if(events & ASYNCIO_READ) {
-    af->af_timeout = 0;
+    asyncio_timer_disarm(&af->af_timer);
 #if ENABLE_OPENSSL
     if(af->af_ssl != NULL) {
       asyncio_ssl_read(af);
@@ -1010,7 +1204,7 @@ asyncio_tcp_connected(asyncio_fd_t *af, void *opaque, int events, int error)
       return 0;
     }
 
-    af->af_timeout = 0;
+    asyncio_timer_disarm(&af->af_timer);
 
     asyncio_rem_events(af, ASYNCIO_WRITE);
     int err;
@@ -1111,7 +1305,7 @@ asyncio_connect(const char *name, const net_addr_t *addr,
 
   af->af_error_callback = error_cb;
   af->af_read_callback  = read_cb;
-  af->af_timeout = arch_get_ts() + timeout * 1000;
+  asyncio_timer_arm(&af->af_timer, arch_get_ts() + timeout * 1000);
   af->af_hostname = hostname ? strdup(hostname) : NULL;
 
 #if ENABLE_OPENSSL
@@ -1131,6 +1325,7 @@ asyncio_connect(const char *name, const net_addr_t *addr,
       // Got fail directly, but we still want to notify the user about
       // the error asynchronously. Just to make things easier
       af->af_pending_errno = errno;
+      asyncio_fd_dirty(af);
     }
   } else {
     asyncio_add_events(af, ASYNCIO_WRITE);
@@ -1206,45 +1401,70 @@ struct asyncio_dns_req {
 };
 
 
-static int adr_resolver_running;
+#define ADR_MAX_RESOLVERS 4
+
+static int adr_resolvers_running;
+
 
 /**
  *
  */
-static int
-adr_resolve(asyncio_dns_req_t *adr)
+static void
+adr_set_result(asyncio_dns_req_t *adr, int r)
 {
-  return net_resolve(adr->adr_hostname, &adr->adr_addr, &adr->adr_errmsg);
+  if(r) {
+    adr->adr_status = ASYNCIO_DNS_STATUS_FAILED;
+    adr->adr_data = adr->adr_errmsg;
+  } else {
+    adr->adr_status = ASYNCIO_DNS_STATUS_COMPLETED;
+    adr->adr_data = &adr->adr_addr;
+  }
 }
 
 
 /**
- *
+ * Resolver threads. Up to ADR_MAX_RESOLVERS run at the same time, each
+ * exits when there is nothing more to resolve. Pending requests for the
+ * same hostname are picked up together and resolved once.
  */
 static void *
 adr_resolver(void *aux)
 {
-  asyncio_dns_req_t *adr;
+  asyncio_dns_req_t *adr, *a, *next;
+  struct asyncio_dns_req_queue same;
+
   hts_mutex_lock(&asyncio_dns_mutex);
   while((adr = TAILQ_FIRST(&asyncio_dns_pending)) != NULL) {
     TAILQ_REMOVE(&asyncio_dns_pending, adr, adr_link);
 
+    TAILQ_INIT(&same);
+    for(a = TAILQ_FIRST(&asyncio_dns_pending); a != NULL; a = next) {
+      next = TAILQ_NEXT(a, adr_link);
+      if(!strcasecmp(a->adr_hostname, adr->adr_hostname)) {
+        TAILQ_REMOVE(&asyncio_dns_pending, a, adr_link);
+        TAILQ_INSERT_TAIL(&same, a, adr_link);
+      }
+    }
+
     hts_mutex_unlock(&asyncio_dns_mutex);
 
-    
-    if(adr_resolve(adr)) {
-      adr->adr_status = ASYNCIO_DNS_STATUS_FAILED;
-      adr->adr_data = adr->adr_errmsg;
-    } else {
-      adr->adr_status = ASYNCIO_DNS_STATUS_COMPLETED;
-      adr->adr_data = &adr->adr_addr;
+    int r = net_resolve_cached(adr->adr_hostname, &adr->adr_addr,
+                               &adr->adr_errmsg);
+    adr_set_result(adr, r);
+
+    TAILQ_FOREACH(a, &same, adr_link) {
+      a->adr_addr = adr->adr_addr;
+      a->adr_errmsg = adr->adr_errmsg;
+      adr_set_result(a, r);
     }
+
     hts_mutex_lock(&asyncio_dns_mutex);
     TAILQ_INSERT_TAIL(&asyncio_dns_completed, adr, adr_link);
+    TAILQ_MERGE(&asyncio_dns_completed, &same, adr_link);
     asyncio_wakeup(asyncio_dns_worker);
   }
 
-  adr_resolver_running = 0;
+  adr_resolvers_running--;
   hts_mutex_unlock(&asyncio_dns_mutex);
   return NULL;
 }
@@ -1265,11 +1485,23 @@ asyncio_dns_lookup_host(const char *hostname,
   adr->adr_hostname = strdup(hostname);
   adr->adr_cb = cb;
   adr->adr_opaque = opaque;
-  
+
+  // Cached results are still delivered asynchronously
+  int r;
+  if(net_resolve_cache_lookup(hostname, &adr->adr_addr,
+                              &adr->adr_errmsg, &r)) {
+    adr_set_result(adr, r);
+    hts_mutex_lock(&asyncio_dns_mutex);
+    TAILQ_INSERT_TAIL(&asyncio_dns_completed, adr, adr_link);
+    hts_mutex_unlock(&asyncio_dns_mutex);
+    asyncio_wakeup(asyncio_dns_worker);
+    return adr;
+  }
+
   hts_mutex_lock(&asyncio_dns_mutex);
   TAILQ_INSERT_TAIL(&asyncio_dns_pending, adr, adr_link);
-  if(!adr_resolver_running) {
-    adr_resolver_running = 1;
+  if(adr_resolvers_running < ADR_MAX_RESOLVERS) {
+    adr_resolvers_running++;
     hts_thread_create_detached("DNS resolver", adr_resolver, NULL, 
 			       THREAD_PRIO_BGTASK);
   }
@@ -1403,8 +1635,7 @@ asyncio_udp_event(asyncio_fd_t *af, void *opaque, int events, int error)
   static uint8_t udp_recv_buf[8192];
 
   if(events & ASYNCIO_ERROR) {
-    close(af->af_fd);
-    af->af_fd = -1;
+    asyncio_fd_close(af);
     af->af_suspended = 1;
     return 0;
   }
@@ -1544,6 +1775,7 @@ asyncio_do_network_change(void *aux)
 void
 asyncio_trig_network_change(void)
 {
+  net_resolver_flush();
   net_refresh_network_status();
   asyncio_run_task(asyncio_do_network_change, NULL);
 }
@@ -1568,8 +1800,7 @@ asyncio_do_suspend(void *aux)
     if(af->af_fd == -1)
       continue;
     af->af_suspended = 1;
-    close(af->af_fd);
-    af->af_fd = -1;
+    asyncio_fd_close(af);
   }
 }
 
@@ -1837,3 +2068,170 @@ asyncio_ssl_free(void *ctx)
 }
 
 #endif
+
+
+/**
+ * Idle socket benchmark
+ *
+ * A large number of sockets that never see any traffic are registered
+ * while a single socket pair ping-pongs a byte through the asyncio
+ * thread. Every round trip is one wakeup of the event loop so the time
+ * per round is dominated by the per-wakeup overhead of the backend.
+ * For reference the same rounds are run with a plain poll() over all
+ * the sockets, rebuilding the pollfd array every time.
+ */
+#define IDLEBENCH_SOCKETS 1000
+#define IDLEBENCH_ROUNDS  20000
+
+static struct {
+  int fds[IDLEBENCH_SOCKETS];
+  asyncio_fd_t *afs[IDLEBENCH_SOCKETS];
+  int num;
+  int ping[2];
+  asyncio_fd_t *ping_af;
+  int rounds;
+  hts_mutex_t mutex;
+  hts_cond_t cond;
+  int done;
+} idlebench;
+
+
+static void
+idlebench_signal(void)
+{
+  hts_mutex_lock(&idlebench.mutex);
+  idlebench.done = 1;
+  hts_cond_signal(&idlebench.cond);
+  hts_mutex_unlock(&idlebench.mutex);
+}
+
+
+static void
+idlebench_wait(void)
+{
+  hts_mutex_lock(&idlebench.mutex);
+  while(!idlebench.done)
+    hts_cond_wait(&idlebench.cond, &idlebench.mutex);
+  idlebench.done = 0;
+  hts_mutex_unlock(&idlebench.mutex);
+}
+
+
+static int
+idlebench_idle_cb(asyncio_fd_t *af, void *opaque, int events, int error)
+{
+  return 0;
+}
+
+
+static int
+idlebench_ping_cb(asyncio_fd_t *af, void *opaque, int events, int error)
+{
+  char x;
+  if(read(idlebench.ping[0], &x, 1) != 1)
+    return 0;
+
+  if(++idlebench.rounds == IDLEBENCH_ROUNDS)
+    idlebench_signal();
+  else if(write(idlebench.ping[1], &x, 1) != 1)
+    idlebench_signal();
+  return 0;
+}
+
+
+static void
+idlebench_start(void *aux)
+{
+  for(int i = 0; i < idlebench.num; i++)
+    idlebench.afs[i] = asyncio_add_fd(idlebench.fds[i], ASYNCIO_READ,
+                                      idlebench_idle_cb, NULL, "idle");
+
+  idlebench.ping_af = asyncio_add_fd(idlebench.ping[0], ASYNCIO_READ,
+                                     idlebench_ping_cb, NULL, "ping");
+  char x = 0;
+  if(write(idlebench.ping[1], &x, 1) != 1)
+    idlebench_signal();
+}
+
+
+static void
+idlebench_stop(void *aux)
+{
+  for(int i = 0; i < idlebench.num; i++)
+    asyncio_del_fd(idlebench.afs[i]);
+  asyncio_del_fd(idlebench.ping_af);
+  idlebench_signal();
+}
+
+
+static void
+asyncio_idle_bench(void)
+{
+  struct rlimit rl;
+  char x = 0;
+
+  if(!getrlimit(RLIMIT_NOFILE, &rl) &&
+     rl.rlim_cur < IDLEBENCH_SOCKETS + 256 && rl.rlim_cur < rl.rlim_max) {
+    rl.rlim_cur = MIN(rl.rlim_max, IDLEBENCH_SOCKETS + 256);
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+
+  hts_mutex_init(&idlebench.mutex);
+  hts_cond_init(&idlebench.cond, &idlebench.mutex);
+
+  if(socketpair(AF_UNIX, SOCK_STREAM, 0, idlebench.ping)) {
+    printf("asyncio: socketpair failed -- %s\n", strerror(errno));
+    return;
+  }
+
+  for(idlebench.num = 0; idlebench.num < IDLEBENCH_SOCKETS; idlebench.num++) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(fd == -1)
+      break;
+    idlebench.fds[idlebench.num] = fd;
+  }
+
+  // Reference, poll() over all sockets from this thread
+  const int nfds = idlebench.num + 1;
+  struct pollfd *fds = malloc(nfds * sizeof(struct pollfd));
+  int64_t ts = arch_get_ts();
+  for(int i = 0; i < IDLEBENCH_ROUNDS; i++) {
+    for(int j = 0; j < idlebench.num; j++) {
+      fds[j].fd = idlebench.fds[j];
+      fds[j].events = POLLIN;
+      fds[j].revents = 0;
+    }
+    fds[idlebench.num].fd = idlebench.ping[0];
+    fds[idlebench.num].events = POLLIN;
+    fds[idlebench.num].revents = 0;
+
+    if(write(idlebench.ping[1], &x, 1) != 1 ||
+       poll(fds, nfds, -1) != 1 ||
+       read(idlebench.ping[0], &x, 1) != 1)
+      break;
+  }
+  const int64_t ref = arch_get_ts() - ts;
+  free(fds);
+
+  ts = arch_get_ts();
+  asyncio_run_task(idlebench_start, NULL);
+  idlebench_wait();
+  const int64_t loop = arch_get_ts() - ts;
+
+  asyncio_run_task(idlebench_stop, NULL);
+  idlebench_wait();
+  close(idlebench.ping[1]);
+
+  printf("asyncio: %d idle sockets, %d rounds  %s: %d ns per wakeup  "
+         "poll() reference: %d ns per wakeup\n",
+         idlebench.num, idlebench.rounds,
+#if ENABLE_EPOLL
+         asyncio_epfd != -1 ? "epoll" : "poll",
+#else
+         "poll",
+#endif
+         (int)(loop * 1000 / IDLEBENCH_ROUNDS),
+         (int)(ref * 1000 / IDLEBENCH_ROUNDS));
+}
+
+BENCHMARK("asyncio-idle", asyncio_idle_bench);
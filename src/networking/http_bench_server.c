@@ -0,0 +1,198 @@
+/*
+ *  Copyright (C) 2007-2015 Lonelycoder AB
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  This program is also available under a commercial proprietary license.
+ *  For more information, contact andreas@lonelycoder.com
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "main.h"
+#include "misc/minmax.h"
+#include "net.h"
+#include "http_bench_server.h"
+
+#if defined(__linux__) || defined(__APPLE__)
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/**
+ * Connections get a copy of the server settings as keep-alive
+ * connections might still be around when the server is stopped
+ */
+typedef struct http_bench_connection {
+  http_bench_server_t bhc_server;
+  int bhc_fd;
+} http_bench_connection_t;
+
+
+/**
+ *
+ */
+static void *
+http_bench_connection(void *aux)
+{
+  http_bench_connection_t *bhc = aux;
+  const http_bench_server_t *bhs = &bhc->bhc_server;
+  tcpcon_t *tc = tcp_from_fd(bhc->bhc_fd);
+  uint8_t *buf = malloc(16384);
+  char line[1024];
+  char path[256];
+
+  while(tcp_read_line(tc, line, sizeof(line)) >= 0) {
+    int64_t start = 0, end = bhs->bhs_size - 1;
+    int range = 0;
+
+    path[0] = 0;
+    sscanf(line, "GET %255s", path);
+
+    while(1) {
+      if(tcp_read_line(tc, line, sizeof(line)) < 0)
+        goto done;
+      if(!line[0])
+        break;
+      if(!strncasecmp(line, "Range: bytes=", 13)) {
+        char *e;
+        start = strtoll(line + 13, &e, 10);
+        if(*e == '-' && e[1])
+          end = strtoll(e + 1, NULL, 10);
+        range = 1;
+      }
+    }
+
+    end = MIN(end, bhs->bhs_size - 1);
+
+    usleep(bhs->bhs_latency);
+
+    if(range) {
+      tcp_printf(tc,
+                 "HTTP/1.1 206 Partial Content\r\n"
+                 "Accept-Ranges: bytes\r\n"
+                 "Content-Range: bytes %"PRId64"-%"PRId64"/%"PRId64"\r\n"
+                 "Content-Length: %"PRId64"\r\n"
+                 "\r\n",
+                 start, end, bhs->bhs_size, end - start + 1);
+    } else {
+      tcp_printf(tc,
+                 "HTTP/1.1 200 OK\r\n"
+                 "Accept-Ranges: bytes\r\n"
+                 "Content-Length: %"PRId64"\r\n"
+                 "\r\n", bhs->bhs_size);
+    }
+
+    const int64_t ts = arch_get_ts();
+    for(int64_t o = start; o <= end;) {
+      const int len = MIN(16384, end + 1 - o);
+      bhs->bhs_content(path, o, buf, len);
+      if(tcp_write_data(tc, buf, len))
+        goto done;
+      o += len;
+
+      const int64_t due = ts + (o - start) * 1000000 / bhs->bhs_bandwidth;
+      const int64_t now = arch_get_ts();
+      if(due > now)
+        usleep(due - now);
+    }
+  }
+ done:
+  free(buf);
+  free(bhc);
+  tcp_close(tc);
+  return NULL;
+}
+
+
+/**
+ *
+ */
+static void *
+http_bench_accept(void *aux)
+{
+  http_bench_server_t *bhs = aux;
+  int fd;
+
+  while((fd = accept(bhs->bhs_fd, NULL, NULL)) != -1) {
+    http_bench_connection_t *bhc = malloc(sizeof(http_bench_connection_t));
+    bhc->bhc_server = *bhs;
+    bhc->bhc_fd = fd;
+    hts_thread_create_detached("httpbench", http_bench_connection, bhc,
+                               THREAD_PRIO_BGTASK);
+  }
+  return NULL;
+}
+
+
+/**
+ *
+ */
+int
+http_bench_server_start(http_bench_server_t *bhs, char *errbuf, size_t errlen)
+{
+  struct sockaddr_in sin = {0};
+  socklen_t slen = sizeof(sin);
+
+  bhs->bhs_fd = socket(AF_INET, SOCK_STREAM, 0);
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if(bhs->bhs_fd == -1 ||
+     bind(bhs->bhs_fd, (struct sockaddr *)&sin, sizeof(sin)) ||
+     listen(bhs->bhs_fd, 16) ||
+     getsockname(bhs->bhs_fd, (struct sockaddr *)&sin, &slen)) {
+    snprintf(errbuf, errlen, "%s", strerror(errno));
+    if(bhs->bhs_fd != -1)
+      close(bhs->bhs_fd);
+    return -1;
+  }
+
+  bhs->bhs_port = ntohs(sin.sin_port);
+  hts_thread_create_joinable("httpbench", &bhs->bhs_tid, http_bench_accept,
+                             bhs, THREAD_PRIO_BGTASK);
+  return 0;
+}
+
+
+/**
+ *
+ */
+void
+http_bench_server_stop(http_bench_server_t *bhs)
+{
+  shutdown(bhs->bhs_fd, SHUT_RDWR);
+  hts_thread_join(&bhs->bhs_tid);
+  close(bhs->bhs_fd);
+}
+
+#else
+
+int
+http_bench_server_start(http_bench_server_t *bhs, char *errbuf, size_t errlen)
+{
+  snprintf(errbuf, errlen, "Not supported on this platform");
+  return -1;
+}
+
+void
+http_bench_server_stop(http_bench_server_t *bhs)
+{
+}
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ *  Copyright (C) 2007-2015 Lonelycoder AB
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  This program is also available under a commercial proprietary license.
+ *  For more information, contact andreas@lonelycoder.com
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "arch/threads.h"
+
+/**
+ * Loopback HTTP server for benchmarks
+ *
+ * Every path is a resource of bhs_size bytes. The response is sent
+ * after bhs_latency µs and each connection is capped at bhs_bandwidth
+ * bytes per second, as a distant server would. Range requests are
+ * answered with 206. The content is produced by bhs_content so the
+ * client can verify what it got.
+ */
+
+typedef void (http_bench_content_t)(const char *path, int64_t offset,
+                                    uint8_t *buf, int len);
+
+typedef struct http_bench_server {
+  int64_t bhs_size;
+  int bhs_latency;
+  int bhs_bandwidth;
+  http_bench_content_t *bhs_content;
+
+  // Set by http_bench_server_start()
+  int bhs_port;
+  int bhs_fd;
+  hts_thread_t bhs_tid;
+} http_bench_server_t;
+
+int http_bench_server_start(http_bench_server_t *bhs,
+                            char *errbuf, size_t errlen);
+
+void http_bench_server_stop(http_bench_server_t *bhs);
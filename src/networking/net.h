@@ -89,10 +89,35 @@ void tcp_set_read_timeout(tcpcon_t *tc, int ms);
 
 
 
+/**
+ * net_resolve() returns 0 on success, NET_RESOLVE_NOT_FOUND if the name
+ * server says the host does not exist (or has no address) and -1 for
+ * all other errors, which might go away if retried
+ */
+#define NET_RESOLVE_NOT_FOUND -2
+
 int net_resolve(const char *hostname, net_addr_t *addr, const char **errmsg);
 
 int net_resolve_numeric(const char *hostname, net_addr_t *addr);
 
+int net_resolve_cached(const char *hostname, net_addr_t *addr,
+                       const char **errmsg);
+
+int net_resolve_cache_lookup(const char *hostname, net_addr_t *addr,
+                             const char **errmsg, int *rp);
+
+void net_resolver_flush(void);
+
+typedef struct net_resolver_stats {
+  int hits;
+  int negative_hits;
+  int misses;
+  int joined;       // Lookups that waited for an identical one in flight
+  int entries;
+} net_resolver_stats_t;
+
+void net_resolver_get_stats(net_resolver_stats_t *stats);
+
 void net_change_nonblocking(int fd, int on);
 
 void net_change_ndelay(int fd, int on);
@@ -508,7 +508,7 @@ tcp_connect(const char *hostname, int port,
     goto connected;
 
   } else {
-    if(net_resolve(hostname, &addr, &errmsg)) {
+    if(net_resolve_cached(hostname, &addr, &errmsg)) {
 
       snprintf(errbuf, errlen, "Unable to resolve %s -- %s", hostname, errmsg);
 
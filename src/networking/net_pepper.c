@@ -180,6 +180,8 @@ net_resolve(const char *hostname, net_addr_t *addr, const char **err)
 
   } else {
     *err = pepper_errmsg(r);
+    if(r == PP_ERROR_NAME_NOT_RESOLVED)
+      rval = NET_RESOLVE_NOT_FOUND;
   }
 
   ppb_core->ReleaseResource(res);
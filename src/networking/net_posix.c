@@ -202,7 +202,8 @@ net_resolve(const char *hostname, net_addr_t *addr, const char **err)
     }
 
     free(tmphstbuf);
-    return -1;
+    return herr == HOST_NOT_FOUND || herr == NO_ADDRESS ?
+      NET_RESOLVE_NOT_FOUND : -1;
 
   } else if(hp == NULL) {
     *err = "Resolver internal error";
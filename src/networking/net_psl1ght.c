@@ -135,11 +135,11 @@ net_resolve(const char *hostname, net_addr_t *addr, const char **err)
     switch(herr) {
     case HOST_NOT_FOUND:
       *err = "Unknown host";
-      return -1;
+      return NET_RESOLVE_NOT_FOUND;
 
     case NO_ADDRESS:
       *err = "The requested name is valid but does not have an IP address";
-      return -1;
+      return NET_RESOLVE_NOT_FOUND;
 
     case NO_RECOVERY:
       *err = "A non-recoverable name server error occurred";
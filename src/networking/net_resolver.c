@@ -0,0 +1,303 @@
+/*
+ *  Copyright (C) 2007-2015 Lonelycoder AB
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  This program is also available under a commercial proprietary license.
+ *  For more information, contact andreas@lonelycoder.com
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "arch/arch.h"
+#include "arch/threads.h"
+#include "misc/queue.h"
+#include "net.h"
+
+/**
+ * Hostname resolver cache
+ *
+ * Sits in front of net_resolve(). Successful lookups and hosts that
+ * do not exist (NET_RESOLVE_NOT_FOUND) are cached. Other failures, such
+ * as name server timeouts, are passed on but not cached. The system
+ * resolver does not tell us the TTL of the records so fixed lifetimes
+ * are used, shorter for failures.
+ *
+ * Only one lookup per hostname is in flight at a time. Other callers
+ * asking for the same name wait for that lookup to finish instead of
+ * starting their own.
+ *
+ * Error messages from net_resolve() are static strings so they can be
+ * kept in the cache as is.
+ *
+ * net_resolver_flush() bumps resolver_generation. Lookups that were in
+ * flight across a flush are handed to their callers but not cached as
+ * they might have been answered by the old network.
+ */
+
+#define RESOLVER_HASH_SIZE    64
+#define RESOLVER_MAX_ENTRIES  256
+#define RESOLVER_POSITIVE_TTL (300 * 1000000LL)
+#define RESOLVER_NEGATIVE_TTL (30 * 1000000LL)
+
+LIST_HEAD(resolver_entry_list, resolver_entry);
+TAILQ_HEAD(resolver_entry_queue, resolver_entry);
+
+typedef struct resolver_entry {
+  LIST_ENTRY(resolver_entry) re_hash_link;
+  TAILQ_ENTRY(resolver_entry) re_lru_link;
+  char *re_hostname;
+  int64_t re_expire;
+  const char *re_errmsg;   // NULL if lookup succeeded
+  net_addr_t re_addr;
+  int re_inflight;
+  int re_waiters;
+} resolver_entry_t;
+
+static hts_mutex_t resolver_mutex;
+static hts_cond_t resolver_cond;
+static struct resolver_entry_list resolver_hash[RESOLVER_HASH_SIZE];
+static struct resolver_entry_queue resolver_lru;
+static int resolver_entries;
+static int resolver_generation;
+static net_resolver_stats_t resolver_stats;
+
+
+/**
+ *
+ */
+static resolver_entry_t *
+resolver_find(const char *hostname, unsigned int *hashp)
+{
+  unsigned int h = 5381;
+  for(const char *s = hostname; *s; s++)
+    h = h * 33 + (*s | 0x20);
+  h &= RESOLVER_HASH_SIZE - 1;
+  *hashp = h;
+
+  resolver_entry_t *re;
+  LIST_FOREACH(re, &resolver_hash[h], re_hash_link)
+    if(!strcasecmp(re->re_hostname, hostname))
+      return re;
+  return NULL;
+}
+
+
+/**
+ *
+ */
+static void
+resolver_entry_destroy(resolver_entry_t *re)
+{
+  LIST_REMOVE(re, re_hash_link);
+  TAILQ_REMOVE(&resolver_lru, re, re_lru_link);
+  free(re->re_hostname);
+  free(re);
+  resolver_entries--;
+}
+
+
+/**
+ * Drop least recently used entries nobody is waiting for
+ */
+static void
+resolver_trim(void)
+{
+  resolver_entry_t *re, *prev;
+
+  for(re = TAILQ_LAST(&resolver_lru, resolver_entry_queue);
+      re != NULL && resolver_entries > RESOLVER_MAX_ENTRIES; re = prev) {
+    prev = TAILQ_PREV(re, resolver_entry_queue, re_lru_link);
+    if(!re->re_inflight && !re->re_waiters)
+      resolver_entry_destroy(re);
+  }
+}
+
+
+/**
+ *
+ */
+static int
+resolver_result(const resolver_entry_t *re, net_addr_t *addr,
+                const char **errmsg)
+{
+  if(re->re_errmsg != NULL) {
+    *errmsg = re->re_errmsg;
+    return -1;
+  }
+  *addr = re->re_addr;
+  return 0;
+}
+
+
+/**
+ * Returns 1 if the result was found in the cache
+ */
+static int
+resolver_lookup_locked(const char *hostname, net_addr_t *addr,
+                       const char **errmsg, int *rp)
+{
+  unsigned int h;
+  resolver_entry_t *re = resolver_find(hostname, &h);
+
+  if(re == NULL || re->re_inflight || re->re_expire < arch_get_ts())
+    return 0;
+
+  TAILQ_REMOVE(&resolver_lru, re, re_lru_link);
+  TAILQ_INSERT_HEAD(&resolver_lru, re, re_lru_link);
+
+  if(re->re_errmsg != NULL)
+    resolver_stats.negative_hits++;
+  else
+    resolver_stats.hits++;
+
+  *rp = resolver_result(re, addr, errmsg);
+  return 1;
+}
+
+
+/**
+ * Non-blocking cache lookup. Returns 1 if the hostname was found, with
+ * the outcome of the lookup in *rp (as returned by net_resolve())
+ */
+int
+net_resolve_cache_lookup(const char *hostname, net_addr_t *addr,
+                         const char **errmsg, int *rp)
+{
+  hts_mutex_lock(&resolver_mutex);
+  int r = resolver_lookup_locked(hostname, addr, errmsg, rp);
+  hts_mutex_unlock(&resolver_mutex);
+  return r;
+}
+
+
+/**
+ * Same as net_resolve() but answers from the cache when possible
+ */
+int
+net_resolve_cached(const char *hostname, net_addr_t *addr,
+                   const char **errmsg)
+{
+  unsigned int h;
+  resolver_entry_t *re;
+  int r;
+
+  if(!net_resolve_numeric(hostname, addr))
+    return 0;
+
+  hts_mutex_lock(&resolver_mutex);
+
+  if(resolver_lookup_locked(hostname, addr, errmsg, &r)) {
+    hts_mutex_unlock(&resolver_mutex);
+    return r;
+  }
+
+  re = resolver_find(hostname, &h);
+
+  if(re != NULL && re->re_inflight) {
+    resolver_stats.joined++;
+    re->re_waiters++;
+    while(re->re_inflight)
+      hts_cond_wait(&resolver_cond, &resolver_mutex);
+    re->re_waiters--;
+    r = resolver_result(re, addr, errmsg);
+    hts_mutex_unlock(&resolver_mutex);
+    return r;
+  }
+
+  if(re == NULL) {
+    re = calloc(1, sizeof(resolver_entry_t));
+    re->re_hostname = strdup(hostname);
+    LIST_INSERT_HEAD(&resolver_hash[h], re, re_hash_link);
+    resolver_entries++;
+  } else {
+    TAILQ_REMOVE(&resolver_lru, re, re_lru_link);
+  }
+  TAILQ_INSERT_HEAD(&resolver_lru, re, re_lru_link);
+
+  resolver_stats.misses++;
+  re->re_inflight = 1;
+  const int generation = resolver_generation;
+  resolver_trim();
+  hts_mutex_unlock(&resolver_mutex);
+
+  net_addr_t a = {0};
+  const char *err = NULL;
+  r = net_resolve(hostname, &a, &err);
+
+  hts_mutex_lock(&resolver_mutex);
+  re->re_inflight = 0;
+  if(r) {
+    re->re_errmsg = err ?: "Unknown error";
+    re->re_expire = r == NET_RESOLVE_NOT_FOUND ?
+      arch_get_ts() + RESOLVER_NEGATIVE_TTL : 0;
+  } else {
+    re->re_errmsg = NULL;
+    re->re_addr = a;
+    re->re_expire = arch_get_ts() + RESOLVER_POSITIVE_TTL;
+  }
+  if(generation != resolver_generation)
+    re->re_expire = 0;
+  r = resolver_result(re, addr, errmsg);
+  hts_cond_broadcast(&resolver_cond);
+  hts_mutex_unlock(&resolver_mutex);
+  return r;
+}
+
+
+/**
+ * Forget all cached results, for example when the network changes
+ */
+void
+net_resolver_flush(void)
+{
+  resolver_entry_t *re, *next;
+
+  hts_mutex_lock(&resolver_mutex);
+  resolver_generation++;
+  for(re = TAILQ_FIRST(&resolver_lru); re != NULL; re = next) {
+    next = TAILQ_NEXT(re, re_lru_link);
+    if(re->re_inflight || re->re_waiters)
+      re->re_expire = 0;
+    else
+      resolver_entry_destroy(re);
+  }
+  hts_mutex_unlock(&resolver_mutex);
+}
+
+
+/**
+ *
+ */
+void
+net_resolver_get_stats(net_resolver_stats_t *stats)
+{
+  hts_mutex_lock(&resolver_mutex);
+  *stats = resolver_stats;
+  stats->entries = resolver_entries;
+  hts_mutex_unlock(&resolver_mutex);
+}
+
+
+/**
+ *
+ */
+INITIALIZER(net_resolver_init)
+{
+  hts_mutex_init(&resolver_mutex);
+  hts_cond_init(&resolver_cond, &resolver_mutex);
+  TAILQ_INIT(&resolver_lru);
+}
@@ -143,6 +143,7 @@ void prop_init_late(void);
 #define PROP_SUB_SEND_VALUE_PROP      0x100
 #define PROP_SUB_NO_INITIAL_UPDATE    0x200
 #define PROP_SUB_EARLY_DEL_CHILD      0x400
+#define PROP_SUB_COALESCE             0x800
 // Remember that flags field is uint16_t in prop_i.h so don't go above 0x8000
 // for persistent flags
 
@@ -423,6 +424,7 @@ void prop_request_delete(prop_t *p);
 void prop_request_delete_multi(prop_vec_t *pv);
 
 #define PROP_COURIER_TRACE_TIMES 0x1
+#define PROP_COURIER_COALESCE    0x2 // PROP_SUB_COALESCE for all subscriptions
 
 prop_courier_t *prop_courier_create_thread(hts_mutex_t *entrymutex,
 					   const char *name,
@@ -450,6 +452,10 @@ int prop_courier_check(prop_courier_t *pc);
 
 void prop_courier_destroy(prop_courier_t *pc);
 
+void prop_courier_set_flags(prop_courier_t *pc, int flags);
+
+int prop_courier_coalesced(prop_courier_t *pc);
+
 void prop_notify_dispatch(struct prop_notify_queue *q, const char *tracename);
 
 void prop_courier_stop(prop_courier_t *pc);
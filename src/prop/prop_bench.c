@@ -0,0 +1,415 @@
+/*
+ *  Copyright (C) 2007-2015 Lonelycoder AB
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  This program is also available under a commercial proprietary license.
+ *  For more information, contact andreas@lonelycoder.com
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "arch/arch.h"
+#include "misc/minmax.h"
+
+#include "prop.h"
+#include "prop_i.h"
+
+/**
+ * Named child lookup benchmark
+ *
+ * Builds a directory with many named children using prop_create() and
+ * then looks all of them up again by name. The same lookups done as a
+ * plain walk over the children (how prop_create() used to find them)
+ * serve as reference.
+ */
+#define PROPBENCH_CHILDS 5000
+#define PROPBENCH_ROUNDS 10
+
+static prop_t *
+propbench_walk(prop_t *p, const char *name)
+{
+  prop_t *c;
+  TAILQ_FOREACH(c, &p->hp_childs, hp_parent_link)
+    if(c->hp_name != NULL && !strcmp(c->hp_name, name))
+      break;
+  return c;
+}
+
+
+static void
+prop_create_bench(void)
+{
+  char name[32];
+  int errors = 0;
+  prop_t *root = prop_create_root(NULL);
+
+  int64_t ts = arch_get_ts();
+  for(int i = 0; i < PROPBENCH_CHILDS; i++) {
+    snprintf(name, sizeof(name), "child%d", i);
+    prop_set(root, name, PROP_SET_INT, i);
+  }
+  const int64_t build = arch_get_ts() - ts;
+
+  ts = arch_get_ts();
+  for(int r = 0; r < PROPBENCH_ROUNDS; r++) {
+    for(int i = 0; i < PROPBENCH_CHILDS; i++) {
+      snprintf(name, sizeof(name), "child%d", (i * 7919) % PROPBENCH_CHILDS);
+      prop_create(root, name);
+    }
+  }
+  const int64_t indexed = arch_get_ts() - ts;
+
+  prop_lock();
+  ts = arch_get_ts();
+  for(int r = 0; r < PROPBENCH_ROUNDS; r++) {
+    for(int i = 0; i < PROPBENCH_CHILDS; i++) {
+      snprintf(name, sizeof(name), "child%d", (i * 7919) % PROPBENCH_CHILDS);
+      propbench_walk(root, name);
+    }
+  }
+  const int64_t walk = arch_get_ts() - ts;
+  prop_unlock();
+
+  // Remove every other child and verify that the index agrees with
+  // the child list for both removed and remaining names
+  for(int i = 0; i < PROPBENCH_CHILDS; i += 2) {
+    snprintf(name, sizeof(name), "child%d", i);
+    prop_destroy_by_name(root, name);
+  }
+
+  for(int i = 0; i < PROPBENCH_CHILDS; i++) {
+    snprintf(name, sizeof(name), "child%d", i);
+    prop_lock();
+    prop_t *c = propbench_walk(root, name);
+    prop_unlock();
+    prop_t *f = prop_find(root, name, NULL);
+    if(c != f || (c == NULL) != !(i & 1))
+      errors++;
+    prop_ref_dec(f);
+  }
+
+  const int lookups = PROPBENCH_CHILDS * PROPBENCH_ROUNDS;
+
+  printf("prop: %d childs created in %d ms\n",
+         PROPBENCH_CHILDS, (int)(build / 1000));
+  printf("prop: %d lookups, walk %.2f us/lookup, "
+         "prop_create() %.2f us/lookup (%.1fx)\n",
+         lookups,
+         (double)walk / lookups,
+         (double)indexed / lookups,
+         (double)walk / MAX(indexed, 1));
+  if(errors)
+    printf("prop: %d lookups did not match the child list\n", errors);
+
+  prop_destroy(root);
+}
+
+BENCHMARK("prop-create", prop_create_bench);
+
+
+/**
+ * Multi threaded read/write stress
+ *
+ * Threads look up and read values in a small tree with an occasional
+ * write mixed in. Reads are done with prop_get_int(), which runs under
+ * prop_read_lock(), and for reference with the same walk done holding
+ * prop_mutex as all reads used to.
+ */
+#define PROPSTRESS_DIRS    16
+#define PROPSTRESS_ITEMS   16
+#define PROPSTRESS_OPS     200000
+#define PROPSTRESS_WRITE_EVERY 64
+#define PROPSTRESS_MAX_THREADS 8
+
+typedef struct propstress_thread {
+  prop_t *pst_root;
+  int pst_id;
+  int pst_locked;
+  int pst_sum;
+} propstress_thread_t;
+
+
+static void *
+propstress_thread(void *aux)
+{
+  propstress_thread_t *pst = aux;
+  unsigned int seed = pst->pst_id;
+  char dir[16], item[16];
+  int sum = 0;
+
+  for(int i = 0; i < PROPSTRESS_OPS; i++) {
+    snprintf(dir, sizeof(dir), "dir%d", rand_r(&seed) % PROPSTRESS_DIRS);
+    snprintf(item, sizeof(item), "item%d", rand_r(&seed) % PROPSTRESS_ITEMS);
+
+    if(i % PROPSTRESS_WRITE_EVERY == 0) {
+      prop_setv(pst->pst_root, dir, item, NULL, PROP_SET_INT, i);
+    } else if(pst->pst_locked) {
+      prop_lock();
+      prop_t *c = propbench_walk(pst->pst_root, dir);
+      if(c != NULL && c->hp_type == PROP_DIR)
+        c = propbench_walk(c, item);
+      if(c != NULL && c->hp_type == PROP_INT)
+        sum += c->hp_int;
+      prop_unlock();
+    } else {
+      sum += prop_get_int(pst->pst_root, dir, item, NULL);
+    }
+  }
+  pst->pst_sum = sum;
+  return NULL;
+}
+
+
+static int64_t
+propstress_run(prop_t *root, int threads, int locked)
+{
+  propstress_thread_t pst[PROPSTRESS_MAX_THREADS];
+  hts_thread_t tids[PROPSTRESS_MAX_THREADS];
+
+  int64_t ts = arch_get_ts();
+  for(int i = 0; i < threads; i++) {
+    pst[i].pst_root = root;
+    pst[i].pst_id = i + 1;
+    pst[i].pst_locked = locked;
+    hts_thread_create_joinable("propstress", &tids[i], propstress_thread,
+                               &pst[i], THREAD_PRIO_BGTASK);
+  }
+  for(int i = 0; i < threads; i++)
+    hts_thread_join(&tids[i]);
+  return arch_get_ts() - ts;
+}
+
+
+static void
+prop_stress_bench(void)
+{
+  char dir[16], item[16];
+  prop_t *root = prop_create_root(NULL);
+
+  for(int i = 0; i < PROPSTRESS_DIRS; i++) {
+    snprintf(dir, sizeof(dir), "dir%d", i);
+    for(int j = 0; j < PROPSTRESS_ITEMS; j++) {
+      snprintf(item, sizeof(item), "item%d", j);
+      prop_setv(root, dir, item, NULL, PROP_SET_INT, j);
+    }
+  }
+
+  const int maxthreads = MIN(MAX(gconf.concurrency, 1),
+                             PROPSTRESS_MAX_THREADS);
+
+  for(int threads = 1; threads <= maxthreads; threads *= 2) {
+    const int64_t locked = propstress_run(root, threads, 1);
+    const int64_t shared = propstress_run(root, threads, 0);
+    const double ops = (double)threads * PROPSTRESS_OPS;
+
+    printf("prop: %d threads, prop_mutex %.2f Mops/s, "
+           "read lock %.2f Mops/s\n",
+           threads, ops / MAX(locked, 1), ops / MAX(shared, 1));
+  }
+
+  // Show what the profiler has to say about the contended case
+  const int save = gconf.enable_prop_lock_profiler;
+  gconf.enable_prop_lock_profiler = 1;
+  prop_lock_profile_report(0);
+  propstress_run(root, maxthreads, 1);
+  prop_lock_profile_report(5);
+  gconf.enable_prop_lock_profiler = save;
+
+  prop_destroy(root);
+}
+
+BENCHMARK("prop-stress", prop_stress_bench);
+
+
+/**
+ * Notification coalescing
+ *
+ * A few properties are updated at a high rate while the courier is
+ * only polled now and then, like a UI showing progress and playback
+ * time. Counts how many notifications are delivered with and without
+ * PROP_SUB_COALESCE and checks that the last value always arrives.
+ */
+#define PROPCOALESCE_PROPS   8
+#define PROPCOALESCE_UPDATES 100000
+#define PROPCOALESCE_POLL_EVERY 1000
+
+typedef struct propcoalesce_sub {
+  int pcs_value;
+  int pcs_count;
+} propcoalesce_sub_t;
+
+
+static void
+propcoalesce_cb(void *opaque, int value)
+{
+  propcoalesce_sub_t *pcs = opaque;
+  pcs->pcs_value = value;
+  pcs->pcs_count++;
+}
+
+
+static void
+propcoalesce_run(int flags)
+{
+  prop_t *props[PROPCOALESCE_PROPS];
+  prop_sub_t *subs[PROPCOALESCE_PROPS];
+  propcoalesce_sub_t pcs[PROPCOALESCE_PROPS] = {};
+  prop_courier_t *pc = prop_courier_create_passive();
+  int delivered = 0, errors = 0;
+
+  for(int i = 0; i < PROPCOALESCE_PROPS; i++) {
+    props[i] = prop_create_root(NULL);
+    prop_set_int(props[i], -1);
+    subs[i] = prop_subscribe(flags | PROP_SUB_NO_INITIAL_UPDATE,
+                             PROP_TAG_CALLBACK_INT, propcoalesce_cb, &pcs[i],
+                             PROP_TAG_COURIER, pc,
+                             PROP_TAG_ROOT, props[i],
+                             NULL);
+  }
+
+  int64_t ts = arch_get_ts();
+  for(int i = 0; i < PROPCOALESCE_UPDATES; i++) {
+    prop_set_int(props[i % PROPCOALESCE_PROPS], i);
+    if(i % PROPCOALESCE_POLL_EVERY == PROPCOALESCE_POLL_EVERY - 1)
+      prop_courier_poll(pc);
+  }
+  prop_courier_poll(pc);
+  ts = arch_get_ts() - ts;
+
+  for(int i = 0; i < PROPCOALESCE_PROPS; i++) {
+    delivered += pcs[i].pcs_count;
+    if(pcs[i].pcs_value !=
+       PROPCOALESCE_UPDATES - PROPCOALESCE_PROPS + i)
+      errors++;
+    prop_unsubscribe(subs[i]);
+    prop_destroy(props[i]);
+  }
+
+  printf("prop: %s: %d updates, %d notifications delivered, "
+         "%d coalesced, %d ms\n",
+         flags & PROP_SUB_COALESCE ? "coalesced" : "plain",
+         PROPCOALESCE_UPDATES, delivered, prop_courier_coalesced(pc),
+         (int)(ts / 1000));
+  if(errors)
+    printf("prop: %d subscriptions did not see the last value\n", errors);
+
+  prop_courier_destroy(pc);
+}
+
+
+static void
+prop_coalesce_bench(void)
+{
+  propcoalesce_run(0);
+  propcoalesce_run(PROP_SUB_COALESCE);
+}
+
+BENCHMARK("prop-coalesce", prop_coalesce_bench);
+
+
+/**
+ * notify_pool contention
+ *
+ * Producer threads allocate and release notifications in bursts, from
+ * notify_pool with its per thread magazines and, for reference, from a
+ * plain pool serialized by a mutex the way all prop pools are used
+ * under prop_mutex.
+ */
+#define POOLBENCH_BURST 16
+#define POOLBENCH_OPS   1000000
+
+typedef struct poolbench_thread {
+  pool_t *pbt_pool;
+  hts_mutex_t *pbt_mutex;
+} poolbench_thread_t;
+
+
+static void *
+poolbench_thread(void *aux)
+{
+  poolbench_thread_t *pbt = aux;
+  void *v[POOLBENCH_BURST];
+
+  for(int i = 0; i < POOLBENCH_OPS / POOLBENCH_BURST; i++) {
+    for(int j = 0; j < POOLBENCH_BURST; j++) {
+      if(pbt->pbt_mutex)
+        hts_mutex_lock(pbt->pbt_mutex);
+      v[j] = pool_get(pbt->pbt_pool);
+      if(pbt->pbt_mutex)
+        hts_mutex_unlock(pbt->pbt_mutex);
+    }
+    for(int j = 0; j < POOLBENCH_BURST; j++) {
+      if(pbt->pbt_mutex)
+        hts_mutex_lock(pbt->pbt_mutex);
+      pool_put(pbt->pbt_pool, v[j]);
+      if(pbt->pbt_mutex)
+        hts_mutex_unlock(pbt->pbt_mutex);
+    }
+  }
+  return NULL;
+}
+
+
+static int64_t
+poolbench_run(pool_t *pool, hts_mutex_t *mutex, int threads)
+{
+  poolbench_thread_t pbt[PROPSTRESS_MAX_THREADS];
+  hts_thread_t tids[PROPSTRESS_MAX_THREADS];
+
+  int64_t ts = arch_get_ts();
+  for(int i = 0; i < threads; i++) {
+    pbt[i].pbt_pool = pool;
+    pbt[i].pbt_mutex = mutex;
+    hts_thread_create_joinable("poolbench", &tids[i], poolbench_thread,
+                               &pbt[i], THREAD_PRIO_BGTASK);
+  }
+  for(int i = 0; i < threads; i++)
+    hts_thread_join(&tids[i]);
+  return arch_get_ts() - ts;
+}
+
+
+static void
+pool_notify_bench(void)
+{
+  hts_mutex_t mutex;
+  hts_mutex_init(&mutex);
+  pool_t *plain = pool_create("notifybench", sizeof(prop_notify_t), 0);
+  const int out = pool_num(notify_pool);
+
+  const int maxthreads = MIN(MAX(gconf.concurrency, 1),
+                             PROPSTRESS_MAX_THREADS);
+
+  for(int threads = 1; threads <= maxthreads; threads *= 2) {
+    const int64_t locked = poolbench_run(plain, &mutex, threads);
+    const int64_t cached = poolbench_run(notify_pool, NULL, threads);
+    const double ops = 2.0 * threads * POOLBENCH_OPS;
+
+    printf("pool: %d threads, mutex %.1f Mops/s, "
+           "thread cache %.1f Mops/s\n",
+           threads, ops / MAX(locked, 1), ops / MAX(cached, 1));
+  }
+
+  if(pool_num(notify_pool) != out)
+    printf("pool: notify_pool has %d items out, expected %d\n",
+           pool_num(notify_pool), out);
+
+  pool_destroy(plain);
+  hts_mutex_destroy(&mutex);
+}
+
+BENCHMARK("pool-notify", pool_notify_bench);
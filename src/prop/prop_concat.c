@@ -313,7 +313,7 @@ prop_concat_add_source(prop_concat_t *pc, prop_t *src, prop_t *header)
   pcs->pcs_header = header;
   pcs->pcs_pc = pc;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   pc->pc_refcount++;
   TAILQ_INSERT_TAIL(&pc->pc_queue, pcs, pcs_link);
 
@@ -325,7 +325,7 @@ prop_concat_add_source(prop_concat_t *pc, prop_t *src, prop_t *header)
 
   pcs->pcs_index = pc->pc_index_tally++;
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -340,14 +340,14 @@ prop_concat_create(prop_t *dst)
   pc->pc_dst = prop_ref_inc(dst);
   TAILQ_INIT(&pc->pc_queue);
   pc->pc_refcount = 2; // one for subscription, one for caller
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   pc->pc_dstsub = prop_subscribe(PROP_SUB_INTERNAL | PROP_SUB_DONTLOCK |
                                  PROP_SUB_TRACK_DESTROY,
                                  PROP_TAG_CALLBACK, dst_cb, pc,
                                  PROP_TAG_ROOT, dst,
                                  NULL);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 
   return pc;
 }
@@ -359,7 +359,7 @@ prop_concat_create(prop_t *dst)
 void
 prop_concat_release(prop_concat_t *pc)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_concat_release0(pc);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
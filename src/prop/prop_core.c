@@ -129,9 +129,9 @@ prop_get_name0(prop_t *p)
 rstr_t *
 prop_get_name(prop_t *p)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_read_lock();
   rstr_t *r = prop_get_name0(p);
-  hts_mutex_unlock(&prop_mutex);
+  prop_read_unlock();
   return r;
 }
 
@@ -262,11 +262,11 @@ prop_ref_dec_traced(prop_t *p, const char *file, int line)
   extern void prop_tag_dump(prop_t *p);
   prop_tag_dump(p);
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   assert(p->hp_tags == NULL);
   memset(p, 0xdd, sizeof(prop_t));
   pool_put(prop_pool, p);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -381,9 +381,9 @@ prop_ref_dec(prop_t *p)
   assert(p->hp_magic == PROP_MAGIC);
   memset(p, 0xdd, sizeof(prop_t));
 #endif
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   pool_put(prop_pool, p);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -431,10 +431,10 @@ prop_t *
 prop_xref_addref(prop_t *p)
 {
   if(p != NULL) {
-    hts_mutex_lock(&prop_mutex);
+    prop_lock();
     assert(p->hp_xref < 255);
     p->hp_xref++;
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
   }
   return p;
 }
@@ -457,11 +457,9 @@ prop_psd_release(prop_sub_dispatch_t *psd)
 /**
  *
  */
-void
-prop_sub_ref_dec_locked(prop_sub_t *s)
+static void
+prop_sub_destroy_locked(prop_sub_t *s)
 {
-  if(atomic_dec(&s->hps_refcount))
-    return;
   s->hps_lockmgr(s->hps_lock, LOCKMGR_RELEASE);
 
   if(s->hps_dispatch_mode == PROP_SUB_DISPATCH_MODE_GROUP) {
@@ -472,6 +470,18 @@ prop_sub_ref_dec_locked(prop_sub_t *s)
 }
 
 
+/**
+ *
+ */
+void
+prop_sub_ref_dec_locked(prop_sub_t *s)
+{
+  if(atomic_dec(&s->hps_refcount))
+    return;
+  prop_sub_destroy_locked(s);
+}
+
+
 /**
  *
  */
@@ -979,15 +989,21 @@ prop_notify_dispatch(struct prop_notify_queue *q, const char *trace_name)
       prop_dispatch_one(n, LOCKMGR_LOCK);
   }
 
-  hts_mutex_lock(&prop_mutex);
-
+  // notify_pool is thread safe on its own so prop_mutex is only needed
+  // if this was the last reference to the subscription
   for(n = TAILQ_FIRST(q); n != NULL; n = next) {
     next = TAILQ_NEXT(n, hpn_link);
 
-    prop_sub_ref_dec_locked(n->hpn_sub);
+    prop_sub_t *s = n->hpn_sub;
     pool_put(notify_pool, n);
+
+    if(atomic_dec(&s->hps_refcount))
+      continue;
+
+    prop_lock();
+    prop_sub_destroy_locked(s);
+    prop_unlock();
   }
-  hts_mutex_unlock(&prop_mutex);
 }
 
 
@@ -1005,13 +1021,13 @@ prop_courier(void *aux)
   if(pc->pc_prologue)
     pc->pc_prologue();
   
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   while(pc->pc_run) {
 
     if(TAILQ_FIRST(&pc->pc_queue_exp) == NULL &&
        TAILQ_FIRST(&pc->pc_queue_nor) == NULL) {
-      hts_cond_wait(&pc->pc_cond, &prop_mutex);
+      prop_cond_wait(&pc->pc_cond);
       continue;
     }
 
@@ -1022,14 +1038,15 @@ prop_courier(void *aux)
     if((n = TAILQ_FIRST(&pc->pc_queue_nor)) != NULL) {
       TAILQ_REMOVE(&pc->pc_queue_nor, n, hpn_link);
       TAILQ_INSERT_TAIL(&q_nor, n, hpn_link);
+      pc->pc_nor_gen++;
     }
 
     const char *tt = pc->pc_flags & PROP_COURIER_TRACE_TIMES ?
       pc->pc_name : NULL;
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     prop_notify_dispatch(&q_exp, tt);
     prop_notify_dispatch(&q_nor, tt);
-    hts_mutex_lock(&prop_mutex);
+    prop_lock();
   }
 
   while((n = TAILQ_FIRST(&pc->pc_queue_exp)) != NULL) {
@@ -1041,11 +1058,12 @@ prop_courier(void *aux)
     TAILQ_REMOVE(&pc->pc_queue_nor, n, hpn_link);
     prop_notify_free(n);
   }
+  pc->pc_nor_gen++;
 
   if(pc->pc_detached)
     free(pc);
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 
   if(pc->pc_epilogue)
     pc->pc_epilogue();
@@ -1062,7 +1080,7 @@ prop_global_dispatch_thread(void *aux)
   prop_sub_dispatch_t *psd, *s;
   prop_notify_t *n;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   while(1) {
     psd = TAILQ_FIRST(&prop_global_dispatch_queue);
     if(psd == NULL) {
@@ -1070,7 +1088,7 @@ prop_global_dispatch_thread(void *aux)
         break;
 
       prop_global_dispatch_avail++;
-      hts_cond_wait(&prop_global_dispatch_cond, &prop_mutex);
+      prop_cond_wait(&prop_global_dispatch_cond);
       prop_global_dispatch_avail--;
       continue;
     }
@@ -1082,9 +1100,9 @@ prop_global_dispatch_thread(void *aux)
     n = TAILQ_FIRST(&psd->psd_notifications);
     assert(n != NULL);
 
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     int r = prop_dispatch_one(n, LOCKMGR_TRY);
-    hts_mutex_lock(&prop_mutex);
+    prop_lock();
 
     TAILQ_REMOVE(&prop_global_dispatch_dispatching_queue, psd, psd_link);
 
@@ -1115,9 +1133,9 @@ prop_global_dispatch_thread(void *aux)
 
         TAILQ_INSERT_TAIL(&prop_global_dispatch_dispatching_queue, psd,
                           psd_link);
-        hts_mutex_unlock(&prop_mutex);
+        prop_unlock();
         prop_dispatch_one(n, LOCKMGR_LOCK);
-        hts_mutex_lock(&prop_mutex);
+        prop_lock();
         TAILQ_REMOVE(&prop_global_dispatch_dispatching_queue, psd, psd_link);
 
       } else {
@@ -1152,7 +1170,7 @@ prop_global_dispatch_thread(void *aux)
     pool_put(notify_pool, n);
   }
   prop_global_dispatch_running--;
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return NULL;
 }
 
@@ -1206,6 +1224,10 @@ courier_enqueue0(prop_sub_t *s, prop_notify_t *n, int expedite)
     else
       TAILQ_INSERT_TAIL(&pc->pc_queue_nor, n, hpn_link);
 
+    // Anything queued after a value notification must not be reordered
+    // with it, so it can no longer be coalesced
+    s->hps_pending_value = NULL;
+
     courier_notify(pc);
     break;
 
@@ -1258,6 +1280,80 @@ prop_get_notify(prop_sub_t *s)
 }
 
 
+/**
+ *
+ */
+static void
+prop_notify_set_value(prop_notify_t *n, prop_t *p)
+{
+  switch(p->hp_type) {
+  case PROP_RSTRING:
+    assert(p->hp_rstring != NULL);
+    n->hpn_rstring = rstr_dup(p->hp_rstring);
+    n->hpn_rstrtype = p->hp_rstrtype;
+    n->hpn_event = PROP_SET_RSTRING;
+    break;
+
+  case PROP_CSTRING:
+    n->hpn_cstring = p->hp_cstring;
+    n->hpn_event = PROP_SET_CSTRING;
+    break;
+
+  case PROP_URI:
+    n->hpn_uri_title = rstr_dup(p->hp_uri_title);
+    n->hpn_uri       = rstr_dup(p->hp_uri);
+    n->hpn_event = PROP_SET_URI;
+    break;
+
+  case PROP_FLOAT:
+    n->hpn_float = p->hp_float;
+    n->hpn_event = PROP_SET_FLOAT;
+    break;
+
+  case PROP_INT:
+    n->hpn_float = p->hp_float;
+    n->hpn_event = PROP_SET_INT;
+    break;
+
+  case PROP_DIR:
+    n->hpn_event = PROP_SET_DIR;
+    break;
+
+  case PROP_VOID:
+    n->hpn_event = PROP_SET_VOID;
+    break;
+
+  case PROP_PROP:
+    n->hpn_prop = prop_ref_inc(p->hp_prop);
+    n->hpn_event = PROP_SET_PROP;
+    break;
+
+  case PROP_ZOMBIE:
+  case PROP_PROXY:
+    abort();
+  }
+}
+
+
+/**
+ * Value notifications can be coalesced if they are delivered on
+ * pc_queue_nor and are the only notification sent for each change.
+ */
+static int
+prop_sub_may_coalesce(prop_sub_t *s)
+{
+  if(s->hps_dispatch_mode != PROP_SUB_DISPATCH_MODE_COURIER)
+    return 0;
+
+  if(s->hps_flags & (PROP_SUB_EXPEDITE | PROP_SUB_SEND_VALUE_PROP))
+    return 0;
+
+  const prop_courier_t *pc = s->hps_dispatch;
+  return s->hps_flags & PROP_SUB_COALESCE ||
+    pc->pc_flags & PROP_COURIER_COALESCE;
+}
+
+
 /**
  *
  */
@@ -1403,55 +1499,29 @@ prop_build_notify_value(prop_sub_t *s, int direct, const char *origin,
     }
   }
 
-  n = prop_get_notify(s);
-
-  switch(p->hp_type) {
-  case PROP_RSTRING:
-    assert(p->hp_rstring != NULL);
-    n->hpn_rstring = rstr_dup(p->hp_rstring);
-    n->hpn_rstrtype = p->hp_rstrtype;
-    n->hpn_event = PROP_SET_RSTRING;
-    break;
-
-  case PROP_CSTRING:
-    n->hpn_cstring = p->hp_cstring;
-    n->hpn_event = PROP_SET_CSTRING;
-    break;
-
-  case PROP_URI:
-    n->hpn_uri_title = rstr_dup(p->hp_uri_title);
-    n->hpn_uri       = rstr_dup(p->hp_uri);
-    n->hpn_event = PROP_SET_URI;
-    break;
-
-  case PROP_FLOAT:
-    n->hpn_float = p->hp_float;
-    n->hpn_event = PROP_SET_FLOAT;
-    break;
-
-  case PROP_INT:
-    n->hpn_float = p->hp_float;
-    n->hpn_event = PROP_SET_INT;
-    break;
-
-  case PROP_DIR:
-    n->hpn_event = PROP_SET_DIR;
-    break;
-
-  case PROP_VOID:
-    n->hpn_event = PROP_SET_VOID;
-    break;
+  if(pnq == NULL && prop_sub_may_coalesce(s)) {
+    prop_courier_t *pc = s->hps_dispatch;
+    n = s->hps_pending_value;
 
-  case PROP_PROP:
-    n->hpn_prop = prop_ref_inc(p->hp_prop);
-    n->hpn_event = PROP_SET_PROP;
-    break;
+    if(n != NULL && s->hps_pending_gen == pc->pc_nor_gen) {
+      // Still undelivered, just replace the value
+      prop_notify_free_payload(n);
+      prop_notify_set_value(n, p);
+      pc->pc_coalesced++;
+      return;
+    }
 
-  case PROP_ZOMBIE:
-  case PROP_PROXY:
-    abort();
+    n = prop_get_notify(s);
+    prop_notify_set_value(n, p);
+    prop_courier_enqueue(s, n);
+    s->hps_pending_value = n;
+    s->hps_pending_gen = pc->pc_nor_gen;
+    return;
   }
 
+  n = prop_get_notify(s);
+  prop_notify_set_value(n, p);
+
   if(pnq) {
     TAILQ_INSERT_TAIL(pnq, n, hpn_link);
   } else {
@@ -1780,9 +1850,9 @@ prop_send_ext_event(prop_t *p, event_t *e)
 {
   if(p == NULL)
     return;
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_send_ext_event0(p, e);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -1812,6 +1882,240 @@ prop_check_canonical_subs_descending(prop_t *p)
 }
 
 
+/**
+ * Name index for directories with many children
+ *
+ * Looking up a child by name is a linear walk over hp_childs. Once a
+ * walk passes PROP_NAME_INDEX_THRESHOLD children an open addressing
+ * hash table of the named children is attached to the directory and
+ * kept up to date as children come and go.
+ *
+ * Siblings may share a name. The index holds all of them and if a
+ * lookup finds more than one match we fall back to the linear walk as
+ * only that knows which one comes first.
+ *
+ * Very few directories are large enough to get an index, so instead of
+ * growing every prop_t by a pointer the indexes are kept in a small
+ * hash table keyed on the directory and PROP_NAME_INDEXED tells if
+ * there is one to look for.
+ */
+#define PROP_NAME_INDEX_THRESHOLD 32
+
+#define PNI_DIR_HASH_SIZE 64
+
+#define PNI_TOMBSTONE ((prop_t *)-1)
+
+typedef struct prop_name_index_slot {
+  prop_t *p;
+  unsigned int hash;
+} prop_name_index_slot_t;
+
+typedef struct prop_name_index {
+  LIST_ENTRY(prop_name_index) pni_link;
+  prop_t *pni_dir;
+  unsigned int pni_mask;
+  unsigned int pni_used;    // Live entries
+  unsigned int pni_fill;    // Live entries + tombstones
+  prop_name_index_slot_t *pni_slots;
+} prop_name_index_t;
+
+static LIST_HEAD(, prop_name_index) prop_name_indexes[PNI_DIR_HASH_SIZE];
+
+
+/**
+ *
+ */
+static unsigned int
+pni_dir_hash(const prop_t *p)
+{
+  return ((uintptr_t)p / sizeof(prop_t)) & (PNI_DIR_HASH_SIZE - 1);
+}
+
+
+/**
+ *
+ */
+static prop_name_index_t *
+prop_name_index_get(const prop_t *p)
+{
+  prop_name_index_t *pni;
+
+  if(!(p->hp_flags & PROP_NAME_INDEXED))
+    return NULL;
+
+  LIST_FOREACH(pni, &prop_name_indexes[pni_dir_hash(p)], pni_link)
+    if(pni->pni_dir == p)
+      return pni;
+  abort();
+}
+
+
+/**
+ *
+ */
+static void
+pni_insert(prop_name_index_t *pni, prop_t *p, unsigned int hash)
+{
+  unsigned int i = hash & pni->pni_mask;
+  while(pni->pni_slots[i].p != NULL && pni->pni_slots[i].p != PNI_TOMBSTONE)
+    i = (i + 1) & pni->pni_mask;
+
+  if(pni->pni_slots[i].p == NULL)
+    pni->pni_fill++;
+  pni->pni_slots[i].p = p;
+  pni->pni_slots[i].hash = hash;
+  pni->pni_used++;
+}
+
+
+/**
+ * Rehash into a table sized for 'count' live entries
+ */
+static void
+pni_resize(prop_name_index_t *pni, unsigned int count)
+{
+  prop_name_index_slot_t *old = pni->pni_slots;
+  const unsigned int oldsize = old != NULL ? pni->pni_mask + 1 : 0;
+  unsigned int size = 16;
+
+  while(size < count * 2)
+    size *= 2;
+
+  pni->pni_slots = calloc(size, sizeof(prop_name_index_slot_t));
+  pni->pni_mask = size - 1;
+  pni->pni_used = 0;
+  pni->pni_fill = 0;
+
+  for(unsigned int i = 0; i < oldsize; i++)
+    if(old[i].p != NULL && old[i].p != PNI_TOMBSTONE)
+      pni_insert(pni, old[i].p, old[i].hash);
+  free(old);
+}
+
+
+/**
+ *
+ */
+static void
+prop_name_index_add(prop_t *parent, prop_t *c)
+{
+  prop_name_index_t *pni = prop_name_index_get(parent);
+  if(pni == NULL || c->hp_name == NULL)
+    return;
+
+  if((pni->pni_fill + 1) * 4 > (pni->pni_mask + 1) * 3)
+    pni_resize(pni, pni->pni_used + 1);
+  pni_insert(pni, c, mystrhash(c->hp_name));
+}
+
+
+/**
+ *
+ */
+static void
+prop_name_index_del(prop_t *parent, prop_t *c)
+{
+  prop_name_index_t *pni = prop_name_index_get(parent);
+  if(pni == NULL || c->hp_name == NULL)
+    return;
+
+  unsigned int i = mystrhash(c->hp_name) & pni->pni_mask;
+  while(pni->pni_slots[i].p != NULL) {
+    if(pni->pni_slots[i].p == c) {
+      pni->pni_slots[i].p = PNI_TOMBSTONE;
+      pni->pni_used--;
+      return;
+    }
+    i = (i + 1) & pni->pni_mask;
+  }
+  abort();
+}
+
+
+/**
+ *
+ */
+static void
+prop_name_index_destroy(prop_t *p)
+{
+  prop_name_index_t *pni = prop_name_index_get(p);
+  if(pni == NULL)
+    return;
+  p->hp_flags &= ~PROP_NAME_INDEXED;
+  LIST_REMOVE(pni, pni_link);
+  free(pni->pni_slots);
+  free(pni);
+}
+
+
+/**
+ *
+ */
+static void
+prop_name_index_create(prop_t *p)
+{
+  prop_t *c;
+  prop_name_index_t *pni = calloc(1, sizeof(prop_name_index_t));
+  unsigned int count = 0;
+
+  TAILQ_FOREACH(c, &p->hp_childs, hp_parent_link)
+    count++;
+
+  pni_resize(pni, count);
+  pni->pni_dir = p;
+  LIST_INSERT_HEAD(&prop_name_indexes[pni_dir_hash(p)], pni, pni_link);
+  p->hp_flags |= PROP_NAME_INDEXED;
+
+  TAILQ_FOREACH(c, &p->hp_childs, hp_parent_link)
+    prop_name_index_add(p, c);
+}
+
+
+/**
+ * Find first child of directory 'p' named 'name'
+ *
+ * Readers (holding prop_read_lock()) must pass may_index = 0 as they
+ * are not allowed to attach an index
+ */
+static prop_t *
+prop_find_child0(prop_t *p, const char *name, int may_index)
+{
+  prop_name_index_t *pni = prop_name_index_get(p);
+  prop_t *c, *r = NULL;
+
+  if(pni != NULL) {
+    const unsigned int hash = mystrhash(name);
+    unsigned int i = hash & pni->pni_mask;
+
+    for(; (c = pni->pni_slots[i].p) != NULL; i = (i + 1) & pni->pni_mask) {
+      if(c == PNI_TOMBSTONE || pni->pni_slots[i].hash != hash ||
+         strcmp(c->hp_name, name))
+        continue;
+      if(r != NULL)
+        goto walk; // Duplicate names, need list order
+      r = c;
+    }
+    return r;
+  }
+
+ walk:
+  {
+    unsigned int n = 0;
+    TAILQ_FOREACH(c, &p->hp_childs, hp_parent_link) {
+      if(c->hp_name != NULL && !strcmp(c->hp_name, name))
+        break;
+      n++;
+    }
+
+    if(may_index && pni == NULL && n >= PROP_NAME_INDEX_THRESHOLD)
+      prop_name_index_create(p);
+    return c;
+  }
+}
+
+#define prop_find_child(p, name) prop_find_child0(p, name, 1)
+
+
 /**
  *
  */
@@ -1892,6 +2196,8 @@ prop_make_dir(prop_t *p, prop_sub_t *skipme, const char *origin)
 static void
 prop_insert(prop_t *p, prop_t *parent, prop_t *before, prop_sub_t *skipme)
 {
+  prop_name_index_add(parent, p);
+
   if(before != NULL) {
     assert(before->hp_parent == parent);
     TAILQ_INSERT_BEFORE(before, p, hp_parent_link);
@@ -1948,21 +2254,17 @@ prop_create0(prop_t *parent, const char *name, prop_sub_t *skipme, int noalloc)
 
   prop_make_dir(parent, skipme, "prop_create()");
 
-  if(name != NULL) {
-    TAILQ_FOREACH(hp, &parent->hp_childs, hp_parent_link) {
-      if(hp->hp_name != NULL && !strcmp(hp->hp_name, name)) {
-
-	if(!(hp->hp_flags & PROP_NAME_NOT_ALLOCATED) && noalloc) {
-	  // Trick: We have a pointer to a compile time constant string
-	  // and the current prop does not have that, we could switch to
-	  // it and thus save some memory allocation
-	  free((void *)hp->hp_name);
-	  hp->hp_name = name;
-	  hp->hp_flags |= PROP_NAME_NOT_ALLOCATED;
-	}
-	return hp;
-      }
+  if(name != NULL && (hp = prop_find_child(parent, name)) != NULL) {
+
+    if(!(hp->hp_flags & PROP_NAME_NOT_ALLOCATED) && noalloc) {
+      // Trick: We have a pointer to a compile time constant string
+      // and the current prop does not have that, we could switch to
+      // it and thus save some memory allocation
+      free((void *)hp->hp_name);
+      hp->hp_name = name;
+      hp->hp_flags |= PROP_NAME_NOT_ALLOCATED;
     }
+    return hp;
   }
 
   hp = prop_make(name, noalloc, parent);
@@ -1984,7 +2286,7 @@ prop_create_ex(prop_t *parent, const char *name, prop_sub_t *skipme,
 	       int noalloc, int incref)
 {
   prop_t *p;
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   if(parent != NULL && parent->hp_type != PROP_ZOMBIE) {
     p = prop_create0(parent, name, skipme, noalloc);
   } else {
@@ -1992,7 +2294,7 @@ prop_create_ex(prop_t *parent, const char *name, prop_sub_t *skipme,
   }
   if(incref)
     p = prop_ref_inc(p);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return p;
 }
 
@@ -2003,9 +2305,9 @@ prop_create_ex(prop_t *parent, const char *name, prop_sub_t *skipme,
 prop_t *
 prop_create_root_ex(const char *name, int noalloc)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_t *p = prop_make(name, noalloc, NULL);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return p;
 }
 
@@ -2023,11 +2325,11 @@ prop_create_multi(prop_t *p, ...)
   if(p == NULL)
     return NULL;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(p->hp_type == PROP_ZOMBIE) {
     p = prop_ref_inc(p);
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     return p;
   }
 
@@ -2035,7 +2337,7 @@ prop_create_multi(prop_t *p, ...)
     p = prop_create0(p, name, NULL, 0);
 
   p = prop_ref_inc(p);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return p;
 }
 
@@ -2048,19 +2350,18 @@ prop_create_after(prop_t *parent, const char *name, prop_t *after,
 		  prop_sub_t *skipme)
 {
   prop_t *p;
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(parent != NULL && parent->hp_type != PROP_ZOMBIE) {
 
     prop_make_dir(parent, skipme, "prop_create_after()");
 
-    TAILQ_FOREACH(p, &parent->hp_childs, hp_parent_link)
-      if(p->hp_name != NULL && !strcmp(p->hp_name, name))
-	break;
+    p = prop_find_child(parent, name);
 
     if(p == NULL) {
 
       p = prop_make(name, 0, parent);
+      prop_name_index_add(parent, p);
   
       if(after == NULL) {
 	TAILQ_INSERT_HEAD(&parent->hp_childs, p, hp_parent_link);
@@ -2099,7 +2400,7 @@ prop_create_after(prop_t *parent, const char *name, prop_t *after,
     p = NULL;
   }
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return p;
 }
 
@@ -2141,9 +2442,9 @@ prop_set_parent_ex(prop_t *p, prop_t *parent, prop_t *before,
   if(parent == NULL)
     return -1;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   r = prop_set_parent0(p, parent, before, skipme);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return r;
 }
 
@@ -2157,7 +2458,7 @@ prop_set_parent_vector(prop_vec_t *pv, prop_t *parent, prop_t *before,
 {
   int i;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(parent == NULL || parent->hp_type == PROP_ZOMBIE) {
 
@@ -2175,6 +2476,8 @@ prop_set_parent_vector(prop_vec_t *pv, prop_t *parent, prop_t *before,
       p->hp_parent = parent;
       if(parent->hp_flags & (PROP_MULTI_SUB | PROP_MULTI_NOTIFY))
 	prop_flood_flag(p, PROP_MULTI_NOTIFY, 0);
+
+      prop_name_index_add(parent, p);
     
       if(before) {
 	TAILQ_INSERT_BEFORE(before, p, hp_parent_link);
@@ -2185,7 +2488,7 @@ prop_set_parent_vector(prop_vec_t *pv, prop_t *parent, prop_t *before,
     prop_notify_childv(pv, parent, before ? PROP_ADD_CHILD_VECTOR_BEFORE : 
 		       PROP_ADD_CHILD_VECTOR, skipme, before);
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -2203,6 +2506,7 @@ prop_unparent0(prop_t *p, prop_sub_t *skipme)
 
   prop_notify_child(p, parent, PROP_DEL_CHILD, NULL, 0);
   
+  prop_name_index_del(parent, p);
   TAILQ_REMOVE(&parent->hp_childs, p, hp_parent_link);
   p->hp_parent = NULL;
   
@@ -2216,9 +2520,9 @@ prop_unparent0(prop_t *p, prop_sub_t *skipme)
 void
 prop_unparent_ex(prop_t *p, prop_sub_t *skipme)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_unparent0(p, skipme);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 /**
@@ -2227,7 +2531,7 @@ prop_unparent_ex(prop_t *p, prop_sub_t *skipme)
 void
 prop_unparent_childs(prop_t *p)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   if(p->hp_type == PROP_DIR) {
     prop_t *c, *next;
     for(c = TAILQ_FIRST(&p->hp_childs); c != NULL; c = next) {
@@ -2235,7 +2539,7 @@ prop_unparent_childs(prop_t *p)
       prop_unparent0(p, NULL);
     }
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -2247,6 +2551,7 @@ prop_destroy_child(prop_t *p, prop_t *c)
 {
   if(!prop_destroy0(c)) {
     prop_notify_child(c, p, PROP_DEL_CHILD, NULL, 0);
+    prop_name_index_del(p, c);
     TAILQ_REMOVE(&p->hp_childs, c, hp_parent_link);
     c->hp_parent = NULL;
   }
@@ -2311,6 +2616,7 @@ prop_destroy0(prop_t *p)
     abort();
 
   case PROP_DIR:
+    prop_name_index_destroy(p);
     for(c = TAILQ_FIRST(&p->hp_childs); c != NULL; c = next) {
       next = TAILQ_NEXT(c, hp_parent_link);
       prop_destroy_child(p, c);
@@ -2385,6 +2691,7 @@ prop_destroy0(prop_t *p)
       if(!(s->hps_flags & PROP_SUB_EARLY_DEL_CHILD))
         prop_build_notify_child(s, p, PROP_DEL_CHILD, 0, 0);
 
+    prop_name_index_del(parent, p);
     TAILQ_REMOVE(&parent->hp_childs, p, hp_parent_link);
     p->hp_parent = NULL;
 
@@ -2407,9 +2714,9 @@ prop_destroy(prop_t *p)
 {
   if(p == NULL)
     return;
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_destroy0(p);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -2425,6 +2732,7 @@ prop_destroy_childs0(prop_t *p)
   struct prop_queue childs;
   TAILQ_MOVE(&childs, &p->hp_childs, hp_parent_link);
   TAILQ_INIT(&p->hp_childs);
+  prop_name_index_destroy(p);
 
   p->hp_type = PROP_VOID;
   p->hp_selected = NULL;
@@ -2452,10 +2760,10 @@ prop_destroy_childs(prop_t *p)
 {
   if(p == NULL)
     return;
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   if(p->hp_type == PROP_DIR)
     prop_destroy_childs0(p);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -2488,9 +2796,9 @@ prop_void_childs(prop_t *p)
 {
   if(p == NULL)
     return;
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_void_childs0(p);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 /**
@@ -2499,7 +2807,7 @@ prop_void_childs(prop_t *p)
 void
 prop_destroy_by_name(prop_t *p, const char *name)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   if(p->hp_type == PROP_DIR) {
     prop_t *c;
     if(name == NULL) {
@@ -2510,15 +2818,11 @@ prop_destroy_by_name(prop_t *p, const char *name)
 	  prop_destroy_child(p, c);
       }
     } else {
-      TAILQ_FOREACH(c, &p->hp_childs, hp_parent_link) {
-	if(c->hp_name != NULL && !strcmp(c->hp_name, name)) {
-	  prop_destroy_child(p, c);
-	  break;
-	}
-      }
+      if((c = prop_find_child(p, name)) != NULL)
+	prop_destroy_child(p, c);
     }
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -2528,13 +2832,13 @@ prop_destroy_by_name(prop_t *p, const char *name)
 void
 prop_destroy_first(prop_t *p)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   if(p->hp_type == PROP_DIR) {
     prop_t *c = TAILQ_FIRST(&p->hp_childs);
     if(c != NULL)
       prop_destroy_child(p, c);
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -2633,9 +2937,9 @@ prop_move0(prop_t *p, prop_t *before, prop_sub_t *skipme)
 void
 prop_move(prop_t *p, prop_t *before)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_move0(p, before, NULL);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -2669,9 +2973,9 @@ prop_req_move0(prop_t *p, prop_t *before, prop_sub_t *skipme)
 void
 prop_req_move(prop_t *p, prop_t *before)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_req_move0(p, before, NULL);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -2721,11 +3025,7 @@ prop_subfind(prop_t *p, const char **name, int follow_symlinks,
 	return NULL;
       }
     } else {
-
-      TAILQ_FOREACH(c, &p->hp_childs, hp_parent_link) {
-	if(c->hp_name != NULL && !strcmp(c->hp_name, name[0]))
-	  break;
-      }
+      c = prop_find_child(p, name[0]);
     }
     p = c ?: prop_create0(p, name[0], NULL, 0);    
     name++;
@@ -2744,6 +3044,46 @@ prop_subfind(prop_t *p, const char **name, int follow_symlinks,
 }
 
 
+/**
+ * Like prop_subfind() but for readers. Returns NULL if the path does
+ * not exist in full, leaving it to the caller to retry with prop_lock()
+ * held and let prop_subfind() create it.
+ */
+static prop_t *
+prop_subfind_ro(prop_t *p, const char **name, int follow_symlinks)
+{
+  prop_t *c;
+
+  while(name[0] != NULL) {
+    while(follow_symlinks && p->hp_originator != NULL)
+      p = p->hp_originator;
+
+    if(p->hp_type != PROP_DIR)
+      return NULL;
+
+    if(name[0][0] == '*') {
+      unsigned int i = atoi(name[0]+1);
+      TAILQ_FOREACH(c, &p->hp_childs, hp_parent_link) {
+	if(i == 0)
+	  break;
+	i--;
+      }
+    } else {
+      c = prop_find_child0(p, name[0], 0);
+    }
+    if(c == NULL)
+      return NULL;
+    p = c;
+    name++;
+  }
+
+  while(follow_symlinks && p->hp_originator != NULL)
+    p = p->hp_originator;
+
+  return p;
+}
+
+
 LIST_HEAD(prop_root_node_list, prop_root_node);
 
 /**
@@ -2849,7 +3189,16 @@ prop_get_by_name(const char **name, int follow_symlinks, ...)
     return NULL;
 
   name++;
-  hts_mutex_lock(&prop_mutex);
+
+  // Most lookups are for props that already exist
+  prop_read_lock();
+  prop_t *r = p->hp_type == PROP_DIR ?
+    prop_ref_inc(prop_subfind_ro(p, name, follow_symlinks)) : NULL;
+  prop_read_unlock();
+  if(r != NULL)
+    return r;
+
+  prop_lock();
   if(p->hp_type == PROP_PROXY) {
     int len = 0;
     if(p->hp_proxy_pfx != NULL)
@@ -2889,7 +3238,7 @@ prop_get_by_name(const char **name, int follow_symlinks, ...)
 
   p = prop_ref_inc(p);
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return p;
 }
 
@@ -3130,7 +3479,7 @@ prop_subscribe_ex(const char *file, int line, int flags, ...)
     canonical = value = pr ? pr->p : NULL;
 
     if(dolock)
-      hts_mutex_lock(&prop_mutex);
+      prop_lock();
 
     if(value != NULL) {
       if(value->hp_type == PROP_PROXY) {
@@ -3155,7 +3504,7 @@ prop_subscribe_ex(const char *file, int line, int flags, ...)
     }
 
     if(dolock)
-      hts_mutex_lock(&prop_mutex);
+      prop_lock();
 
     if(p == NULL || p->hp_type == PROP_ZOMBIE) {
       canonical = value = NULL;
@@ -3176,7 +3525,7 @@ prop_subscribe_ex(const char *file, int line, int flags, ...)
   if(flags & PROP_SUB_SINGLETON) {
     LIST_FOREACH(s, &value->hp_value_subscriptions, hps_value_prop_link) {
       if(s->hps_callback == cb && s->hps_opaque == opaque) {
-	hts_mutex_unlock(&prop_mutex);
+	prop_unlock();
 	return NULL;
       }
     }
@@ -3208,6 +3557,7 @@ prop_subscribe_ex(const char *file, int line, int flags, ...)
   s->hps_opaque = opaque;
   atomic_set(&s->hps_refcount, 1);
   s->hps_user_int = user_int;
+  s->hps_pending_value = NULL;
 
   if(origin_chain[0] != NULL) {
     
@@ -3384,7 +3734,7 @@ prop_subscribe_ex(const char *file, int line, int flags, ...)
     }
   }
   if(dolock)
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
   return s;
 }
 
@@ -3476,9 +3826,9 @@ prop_unsubscribe(prop_sub_t *s)
   if(s == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_unsubscribe0(s);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -3491,9 +3841,9 @@ prop_sub_reemit(prop_sub_t *s)
   if(s == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_build_notify_value(s, 0, "reemit", s->hps_value_prop, NULL);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -3513,14 +3863,15 @@ prop_init(void)
 
 
   prop_pool   = pool_create("prop", sizeof(prop_t), 0);
-  notify_pool = pool_create("notify", sizeof(prop_notify_t), 0);
+  notify_pool = pool_create("notify", sizeof(prop_notify_t),
+                            POOL_THREAD_CACHE);
   sub_pool    = pool_create("subs", sizeof(prop_sub_t), 0);
   pot_pool    = pool_create("pots", sizeof(prop_originator_tracking_t), 0);
   psd_pool    = pool_create("psds", sizeof(prop_sub_dispatch_t), 0);
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_global = prop_make("global", 1, NULL);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -3542,7 +3893,7 @@ prop_set_epilogue(prop_sub_t *skipme, prop_t *p, const char *origin)
 {
   prop_notify_value(p, skipme, origin);
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -3591,9 +3942,9 @@ prop_set_string_ex(prop_t *p, prop_sub_t *skipme, const char *str,
     return;
   }
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_set_string_exl(p, skipme, str, type);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -3645,9 +3996,9 @@ prop_set_rstring_ex(prop_t *p, prop_sub_t *skipme, rstr_t *rstr,
     return;
   }
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_set_rstring_exl(p, skipme, rstr, type);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -3662,9 +4013,9 @@ prop_adopt_rstring_ex(prop_t *p, prop_sub_t *skipme, rstr_t *rstr,
     if(rstr == NULL) {
       prop_set_void_ex(p, skipme);
     } else {
-      hts_mutex_lock(&prop_mutex);
+      prop_lock();
       prop_set_rstring_exl(p, skipme, rstr, type);
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock();
     }
   }
   rstr_release(rstr);
@@ -3715,9 +4066,9 @@ prop_set_cstring_ex(prop_t *p, prop_sub_t *skipme, const char *cstr)
     return;
   }
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_set_cstring_exl(p, skipme, cstr);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -3736,23 +4087,23 @@ prop_set_uri_ex(prop_t *p, prop_sub_t *skipme, const char *title,
     return;
   }
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(p->hp_type == PROP_ZOMBIE) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     return;
   }
 
   if(p->hp_type != PROP_URI) {
 
     if(prop_clean(p)) {
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock();
       return;
     }
 
   } else if(!strcmp(rstr_get(p->hp_uri_title) ?: "", title ?: "") &&
 	    !strcmp(rstr_get(p->hp_uri)   ?: "", url   ?: "")) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     return;
   } else {
     rstr_release(p->hp_uri_title);
@@ -3886,9 +4237,9 @@ prop_set_float_exl(prop_t *p, prop_sub_t *skipme, float v)
 void
 prop_set_float_ex(prop_t *p, prop_sub_t *skipme, float v)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_set_float_exl(p, skipme, v);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -3898,7 +4249,7 @@ prop_set_float_ex(prop_t *p, prop_sub_t *skipme, float v)
 void
 prop_add_float_ex(prop_t *p, prop_sub_t *skipme, float v)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if((p = prop_get_float_locked(p)) != NULL) {
     float n = p->hp_float + v;
@@ -3915,7 +4266,7 @@ prop_add_float_ex(prop_t *p, prop_sub_t *skipme, float v)
       prop_notify_value(p, skipme, "prop_add_float()");
     }
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -3925,7 +4276,7 @@ prop_add_float_ex(prop_t *p, prop_sub_t *skipme, float v)
 void
 prop_set_float_clipping_range(prop_t *p, float min, float max)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if((p = prop_get_float_locked(p)) != NULL) {
 
@@ -3947,7 +4298,7 @@ prop_set_float_clipping_range(prop_t *p, float min, float max)
     }
   }
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -3999,9 +4350,9 @@ prop_set_int_ex(prop_t *p, prop_sub_t *skipme, int v)
   if(p == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_set_int_exl(p, skipme, v);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -4015,16 +4366,16 @@ prop_add_int_ex(prop_t *p, prop_sub_t *skipme, int v)
   if(p == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(p->hp_type == PROP_PROXY) {
     prop_proxy_add_int(p, v);
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     return;
   }
 
   if(p->hp_type == PROP_ZOMBIE) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     return;
   }
 
@@ -4033,7 +4384,7 @@ prop_add_int_ex(prop_t *p, prop_sub_t *skipme, int v)
     if(p->hp_type == PROP_FLOAT) {
       prop_float_to_int(p);
     } else if(prop_clean(p)) {
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock();
       return;
     } else {
       p->hp_int = 0;
@@ -4055,7 +4406,7 @@ prop_add_int_ex(prop_t *p, prop_sub_t *skipme, int v)
     p->hp_int = n;
     prop_notify_value(p, skipme, "prop_add_int()");
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -4068,16 +4419,16 @@ prop_toggle_int_ex(prop_t *p, prop_sub_t *skipme)
   if(p == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(p->hp_type == PROP_PROXY) {
     prop_proxy_toggle_int(p);
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     return;
   }
 
   if(p->hp_type == PROP_ZOMBIE) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     return;
   }
 
@@ -4086,7 +4437,7 @@ prop_toggle_int_ex(prop_t *p, prop_sub_t *skipme)
     if(p->hp_type == PROP_FLOAT) {
       prop_float_to_int(p);
     } else if(prop_clean(p)) {
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock();
       return;
     } else {
       p->hp_int = 0;
@@ -4110,10 +4461,10 @@ prop_set_int_clipping_range(prop_t *p, int min, int max)
   if(p == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(p->hp_type == PROP_ZOMBIE) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     return;
   }
 
@@ -4122,7 +4473,7 @@ prop_set_int_clipping_range(prop_t *p, int min, int max)
     if(p->hp_type == PROP_FLOAT) {
       prop_float_to_int(p);
     } else if(prop_clean(p)) {
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock();
       return;
     } else {
       p->hp_int = 0;
@@ -4147,7 +4498,7 @@ prop_set_int_clipping_range(prop_t *p, int min, int max)
     prop_notify_value(p, NULL, "prop_set_int_clipping_range()");
   }
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -4185,9 +4536,9 @@ prop_set_void_ex(prop_t *p, prop_sub_t *skipme)
   if(p == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_set_void_exl(p, skipme);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -4226,9 +4577,9 @@ prop_set_prop_ex(prop_t *p, prop_sub_t *skipme, prop_t *x)
   if(p == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_set_prop_exl(p, skipme, x);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -4241,7 +4592,7 @@ prop_copy_ex(prop_t *dst, prop_sub_t *skipme, prop_t *src)
   if(dst == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(src == NULL) {
     prop_set_void_exl(dst, skipme);
@@ -4266,7 +4617,7 @@ prop_copy_ex(prop_t *dst, prop_sub_t *skipme, prop_t *src)
     }
   }
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -4862,9 +5213,9 @@ prop_link_ex(prop_t *src, prop_t *dst, prop_sub_t *skipme,
   if(dst == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_link_exl(src, dst, skipme, hard, debug);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -4879,9 +5230,9 @@ prop_unlink_ex(prop_t *p, prop_sub_t *skipme)
   if(p == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_unlink_exl(p, skipme);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -4891,13 +5242,13 @@ prop_unlink_ex(prop_t *p, prop_sub_t *skipme)
 prop_t *
 prop_follow(prop_t *p)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_read_lock();
 
   while(p->hp_originator != NULL)
     p = p->hp_originator;
   
   p = prop_ref_inc(p);
-  hts_mutex_unlock(&prop_mutex);
+  prop_read_unlock();
   return p;
 }
 
@@ -4908,14 +5259,14 @@ prop_follow(prop_t *p)
 prop_t *
 prop_get_prop(prop_t *p)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_read_lock();
 
   if(p != NULL && p->hp_type == PROP_PROP) {
     p = prop_ref_inc(p->hp_prop);
   } else {
     p = prop_ref_inc(p);
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_read_unlock();
   return p;
 }
 
@@ -4926,7 +5277,7 @@ prop_get_prop(prop_t *p)
 int
 prop_compare(const prop_t *a, const prop_t *b)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   while(a->hp_originator != NULL)
     a = a->hp_originator;
@@ -4934,7 +5285,7 @@ prop_compare(const prop_t *a, const prop_t *b)
   while(b->hp_originator != NULL)
     b = b->hp_originator;
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return a == b;
 }
 
@@ -4947,16 +5298,16 @@ prop_select_ex(prop_t *p, prop_t *extra, prop_sub_t *skipme)
 {
   prop_t *parent;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(p->hp_type == PROP_ZOMBIE) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     return;
   }
 
   if(p->hp_type == PROP_PROXY) {
     prop_proxy_select(p);
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     return;
   }
 
@@ -4968,7 +5319,7 @@ prop_select_ex(prop_t *p, prop_t *extra, prop_sub_t *skipme)
     parent->hp_selected = p;
   }
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -4978,14 +5329,14 @@ prop_select_ex(prop_t *p, prop_t *extra, prop_sub_t *skipme)
 void
 prop_unselect_ex(prop_t *parent, prop_sub_t *skipme)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(parent->hp_type == PROP_DIR) {
     prop_notify_child2(NULL, parent, NULL, PROP_SELECT_CHILD, skipme, 0);
     parent->hp_selected = NULL;
   }
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -4995,18 +5346,15 @@ prop_unselect_ex(prop_t *parent, prop_sub_t *skipme)
 void
 prop_select_by_value_ex(prop_t *p, const char *name, prop_sub_t *skipme)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(p->hp_type == PROP_DIR) {
-    prop_t *c;
-    TAILQ_FOREACH(c, &p->hp_childs, hp_parent_link)
-      if(c->hp_name != NULL && !strcmp(c->hp_name, name))
-        break;
+    prop_t *c = prop_find_child(p, name);
 
     prop_notify_child2(c, p, NULL, PROP_SELECT_CHILD, skipme, 0);
     p->hp_selected = c;
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -5036,9 +5384,9 @@ prop_suggest_focus0(prop_t *p)
 void
 prop_suggest_focus(prop_t *p)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_suggest_focus0(p);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -5048,7 +5396,7 @@ prop_suggest_focus(prop_t *p)
 prop_t *
 prop_findv(prop_t *p, char **names)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_read_lock();
 
   while(p->hp_originator != NULL)
     p = p->hp_originator;
@@ -5063,9 +5411,7 @@ prop_findv(prop_t *p, char **names)
       break;
     }
 
-    TAILQ_FOREACH(c, &p->hp_childs, hp_parent_link)
-      if(c->hp_name != NULL && !strcmp(c->hp_name, n))
-	break;
+    c = prop_find_child0(p, n, 0);
     if(c == NULL)
       break;
 
@@ -5074,13 +5420,13 @@ prop_findv(prop_t *p, char **names)
     p = c;
   }
   c = prop_ref_inc(c);
-  hts_mutex_unlock(&prop_mutex);
+  prop_read_unlock();
   return c;
 }
 
 
 /**
- *
+ * Called with prop_read_lock() held
  */
 static prop_t *
 prop_find0(prop_t *p, va_list ap)
@@ -5095,9 +5441,7 @@ prop_find0(prop_t *p, va_list ap)
       break;
     }
 
-    TAILQ_FOREACH(c, &p->hp_childs, hp_parent_link)
-      if(c->hp_name != NULL && !strcmp(c->hp_name, n))
-	break;
+    c = prop_find_child0(p, n, 0);
     if(c == NULL)
 	return NULL;
     p = c;
@@ -5115,9 +5459,9 @@ prop_find(prop_t *p, ...)
   va_list ap;
   va_start(ap, p);
 
-  hts_mutex_lock(&prop_mutex);
+  prop_read_lock();
   prop_t *c = prop_ref_inc(prop_find0(p, ap));
-  hts_mutex_unlock(&prop_mutex);
+  prop_read_unlock();
   va_end(ap);
   return c;
 }
@@ -5129,10 +5473,10 @@ prop_find(prop_t *p, ...)
 prop_t *
 prop_first_child(prop_t *p)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_t *c = p && p->hp_type == PROP_DIR ? TAILQ_FIRST(&p->hp_childs) : NULL;
   c = prop_ref_inc(c);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return c;
 }
 
@@ -5143,12 +5487,12 @@ prop_first_child(prop_t *p)
 void
 prop_request_new_child(prop_t *p)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(p->hp_type == PROP_DIR || p->hp_type == PROP_VOID)
     prop_notify_child(NULL, p, PROP_REQ_NEW_CHILD, NULL, 0);
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -5159,11 +5503,11 @@ void
 prop_request_delete(prop_t *c)
 {
   prop_t *p;
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(c->hp_type == PROP_PROXY) {
 
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     return;
   }
 
@@ -5179,7 +5523,7 @@ prop_request_delete(prop_t *c)
       prop_vec_release(pv);
     }
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -5189,10 +5533,10 @@ prop_request_delete(prop_t *c)
 void
 prop_request_delete_multi(prop_vec_t *pv)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_notify_childv(pv, pv->pv_vec[0]->hp_parent,
 		     PROP_REQ_DELETE_VECTOR, NULL, NULL);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 /**
@@ -5281,18 +5625,19 @@ int
 prop_courier_wait(prop_courier_t *pc, struct prop_notify_queue *q, int timeout)
 {
   int r = 0;
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   if(TAILQ_FIRST(&pc->pc_queue_exp) == NULL &&
      TAILQ_FIRST(&pc->pc_queue_nor) == NULL) {
     if(timeout)
-      r = hts_cond_wait_timeout(&pc->pc_cond, &prop_mutex, timeout);
+      r = prop_cond_wait_timeout(&pc->pc_cond, timeout);
     else
-      hts_cond_wait(&pc->pc_cond, &prop_mutex);
+      prop_cond_wait(&pc->pc_cond);
   }
 
   TAILQ_MOVE(q, &pc->pc_queue_exp, hpn_link);
   TAILQ_MERGE(q, &pc->pc_queue_nor, hpn_link);
-  hts_mutex_unlock(&prop_mutex);
+  pc->pc_nor_gen++;
+  prop_unlock();
   return r;
 }
 
@@ -5340,17 +5685,17 @@ prop_courier_destroy(prop_courier_t *pc)
           pc->pc_name);
 
 #ifdef POOL_DEBUG
-    hts_mutex_lock(&prop_mutex);
+    prop_lock();
     pool_foreach(sub_pool, debug_check_courier, pc);
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
 #endif
   }
 
   if(pc->pc_run) {
-    hts_mutex_lock(&prop_mutex);
+    prop_lock();
     pc->pc_run = 0;
     hts_cond_signal(&pc->pc_cond);
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
 
     hts_thread_join(&pc->pc_thread);
   }
@@ -5358,12 +5703,41 @@ prop_courier_destroy(prop_courier_t *pc)
   if(pc->pc_has_cond)
     hts_cond_destroy(&pc->pc_cond);
 
+  if(pc->pc_coalesced)
+    TRACE(TRACE_DEBUG, "prop", "Courier '%s' coalesced %d notifications",
+          pc->pc_name ?: "<unnamed>", pc->pc_coalesced);
+
   free(pc->pc_name);
 
   free(pc);
 }
 
 
+/**
+ *
+ */
+void
+prop_courier_set_flags(prop_courier_t *pc, int flags)
+{
+  prop_lock();
+  pc->pc_flags |= flags;
+  prop_unlock();
+}
+
+
+/**
+ * Number of value notifications merged into an already queued one
+ */
+int
+prop_courier_coalesced(prop_courier_t *pc)
+{
+  prop_lock();
+  int r = pc->pc_coalesced;
+  prop_unlock();
+  return r;
+}
+
+
 /**
  *
  */
@@ -5383,10 +5757,11 @@ void
 prop_courier_poll(prop_courier_t *pc)
 {
   struct prop_notify_queue q;
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   TAILQ_MOVE(&q, &pc->pc_queue_exp, hpn_link);
   TAILQ_MERGE(&q, &pc->pc_queue_nor, hpn_link);
-  hts_mutex_unlock(&prop_mutex);
+  pc->pc_nor_gen++;
+  prop_unlock();
   prop_notify_dispatch(&q, 0);
 }
 
@@ -5402,9 +5777,10 @@ prop_courier_poll_timed(prop_courier_t *pc, int maxtime)
 
   prop_notify_t *n, *next;
 
-  if(!hts_mutex_trylock(&prop_mutex)) {
+  if(!prop_trylock()) {
     TAILQ_MERGE(&pc->pc_dispatch_queue, &pc->pc_queue_exp, hpn_link);
     TAILQ_MERGE(&pc->pc_dispatch_queue, &pc->pc_queue_nor, hpn_link);
+    pc->pc_nor_gen++;
 
     for(n = TAILQ_FIRST(&pc->pc_free_queue); n != NULL; n = next) {
       next = TAILQ_NEXT(n, hpn_link);
@@ -5414,7 +5790,7 @@ prop_courier_poll_timed(prop_courier_t *pc, int maxtime)
     }
     TAILQ_INIT(&pc->pc_free_queue);
 
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
   }
 
   int64_t ts = arch_get_ts();
@@ -5435,9 +5811,9 @@ prop_courier_poll_timed(prop_courier_t *pc, int maxtime)
 int
 prop_courier_check(prop_courier_t *pc)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   int r = TAILQ_FIRST(&pc->pc_queue_exp) || TAILQ_FIRST(&pc->pc_queue_nor);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return r;
 
 }
@@ -5455,7 +5831,7 @@ prop_get_string(prop_t *p, ...)
 
   va_start(ap, p);
 
-  hts_mutex_lock(&prop_mutex);
+  prop_read_lock();
   p = prop_find0(p, ap);
 
   if(p != NULL) {
@@ -5482,7 +5858,7 @@ prop_get_string(prop_t *p, ...)
       break;
     }
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_read_unlock();
   va_end(ap);
   return r;
 }
@@ -5499,7 +5875,7 @@ prop_get_int(prop_t *p, ...)
 
   va_start(ap, p);
 
-  hts_mutex_lock(&prop_mutex);
+  prop_read_lock();
   p = prop_find0(p, ap);
 
   if(p != NULL) {
@@ -5524,7 +5900,7 @@ prop_get_int(prop_t *p, ...)
       break;
     }
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_read_unlock();
   va_end(ap);
   return r;
 }
@@ -5596,7 +5972,7 @@ prop_setv_ex(prop_sub_t *skipme, prop_t *p, ...)
 
   va_start(ap, p);
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(p->hp_type == PROP_ZOMBIE)
     goto bad;
@@ -5604,11 +5980,9 @@ prop_setv_ex(prop_sub_t *skipme, prop_t *p, ...)
   while((n = va_arg(ap, const char *)) != NULL) {
     if(p->hp_type == PROP_ZOMBIE)
       goto bad;
-    if(p->hp_type == PROP_DIR) {
-      TAILQ_FOREACH(c, &p->hp_childs, hp_parent_link)
-	if(c->hp_name != NULL && !strcmp(c->hp_name, n))
-	  break;
-    } else 
+    if(p->hp_type == PROP_DIR)
+      c = prop_find_child(p, n);
+    else 
       c = NULL;
     if(c == NULL)
       c = prop_create0(p, n, skipme, 0);
@@ -5618,7 +5992,7 @@ prop_setv_ex(prop_sub_t *skipme, prop_t *p, ...)
   prop_seti(skipme, p, ap);
 
  bad:
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   va_end(ap);
 }
 
@@ -5637,7 +6011,7 @@ prop_setdn(prop_sub_t *skipme, prop_t *p, const char *str, ...)
 
   va_start(ap, str);
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   while(1) {
     if(p->hp_type == PROP_ZOMBIE)
@@ -5656,11 +6030,9 @@ prop_setdn(prop_sub_t *skipme, prop_t *p, const char *str, ...)
     }
 
 
-    if(p->hp_type == PROP_DIR) {
-      TAILQ_FOREACH(c, &p->hp_childs, hp_parent_link)
-	if(c->hp_name != NULL && !strcmp(c->hp_name, str))
-	  break;
-    } else 
+    if(p->hp_type == PROP_DIR)
+      c = prop_find_child(p, str);
+    else 
       c = NULL;
     if(c == NULL)
       c = prop_create0(p, str, skipme, 0);
@@ -5671,7 +6043,7 @@ prop_setdn(prop_sub_t *skipme, prop_t *p, const char *str, ...)
   prop_seti(skipme, p, ap);
 
  bad:
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   va_end(ap);
 }
 
@@ -5688,7 +6060,7 @@ prop_set_ex(prop_t *p, const char *name, int noalloc, ...)
   if(p == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(p->hp_type != PROP_ZOMBIE) {
     p = prop_create0(p, name, NULL, noalloc);
@@ -5696,7 +6068,7 @@ prop_set_ex(prop_t *p, const char *name, int noalloc, ...)
     prop_seti(NULL, p, ap);
     va_end(ap);
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -5713,7 +6085,7 @@ prop_get_name_of_childs(prop_t *p)
   if(p->hp_type != PROP_DIR)
     return NULL;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   TAILQ_FOREACH(c, &p->hp_childs, hp_parent_link) {
     if(c->hp_type == PROP_VOID || c->hp_type == PROP_ZOMBIE)
@@ -5729,7 +6101,7 @@ prop_get_name_of_childs(prop_t *p)
     i++;
   }
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 
   return rval;
 }
@@ -5756,9 +6128,9 @@ prop_want_more_childs0(prop_sub_t *s)
 void
 prop_want_more_childs(prop_sub_t *s)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_want_more_childs0(s);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -5780,9 +6152,9 @@ prop_have_more_childs0(prop_t *p, int yes)
 void
 prop_have_more_childs(prop_t *p, int yes)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_have_more_childs0(p, yes);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -5795,12 +6167,12 @@ prop_mark_childs(prop_t *p)
   prop_t *c;
   if(p == NULL)
     return;
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   if(p->hp_type == PROP_DIR) {
     TAILQ_FOREACH(c, &p->hp_childs, hp_parent_link)
       c->hp_flags |= PROP_MARKED;
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -5812,9 +6184,9 @@ prop_unmark(prop_t *p)
 {
   if(p == NULL)
     return;
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   p->hp_flags &= ~PROP_MARKED;
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -5834,7 +6206,7 @@ prop_is_marked(prop_t *p)
 void
 prop_destroy_marked_childs(prop_t *p)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   if(p->hp_type == PROP_DIR) {
     prop_t *c, *next;
     for(c = TAILQ_FIRST(&p->hp_childs); c != NULL; c = next) {
@@ -5843,28 +6215,28 @@ prop_destroy_marked_childs(prop_t *p)
         prop_destroy0(c);
     }
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
 void *
 prop_dispatch_group_create(void)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_sub_dispatch_t *psd = pool_get(psd_pool);
   TAILQ_INIT(&psd->psd_notifications);
   TAILQ_INIT(&psd->psd_wait_queue);
   psd->psd_refcount = 1;
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return psd;
 }
 
 void
 prop_dispatch_group_destroy(void *g)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_psd_release(g);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -6000,11 +6372,11 @@ prop_print_tree0(prop_t *p, int indent, int flags)
 void
 prop_print_tree(prop_t *p, int followlinks)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   fprintf(stderr, "Print tree form %s\n",
           prop_get_DN(p, 1));
   prop_print_tree0(p, 0, followlinks);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -6021,7 +6393,7 @@ prop_report_stats(callout_t *c, void *aux)
   int num_subs = 0;
   int origin_link_hist[4] = {};
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   LIST_FOREACH(s, &all_subs, hps_all_sub_link) {
     num_subs++;
 
@@ -6042,7 +6414,7 @@ prop_report_stats(callout_t *c, void *aux)
   }
 
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   printf("%d subs: %d %d %d %d\n",
 	 num_subs, 
 	 origin_link_hist[0],
@@ -6060,6 +6432,8 @@ extern void prop_test(void);
 void
 prop_init_late(void)
 {
+  prop_lock_init_late();
+
 #ifdef PROP_SUB_STATS
   callout_arm(&prop_stats_callout, prop_report_stats, NULL, 1);
 #endif
@@ -318,13 +318,13 @@ prop_grouper_create(prop_t *dst, prop_t *src, const char *groupkey,
 
   pg->pg_groupingpath = strvec_split(groupkey, '.');
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   pg->pg_srcsub = prop_subscribe(PROP_SUB_INTERNAL | PROP_SUB_DONTLOCK,
 				 PROP_TAG_CALLBACK, src_cb, pg,
 				 PROP_TAG_ROOT, src,
 				 NULL);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return pg;
 }
 
@@ -336,7 +336,7 @@ prop_grouper_create(prop_t *dst, prop_t *src, const char *groupkey,
 void
 prop_grouper_destroy(prop_grouper_t *pg)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   pg_clear(pg);
   prop_unsubscribe0(pg->pg_srcsub);
@@ -344,7 +344,7 @@ prop_grouper_destroy(prop_grouper_t *pg)
 
   assert(LIST_FIRST(&pg->pg_nodes) == NULL);
   assert(LIST_FIRST(&pg->pg_groups) == NULL);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 
   strvec_free(pg->pg_groupingpath);
   free(pg);
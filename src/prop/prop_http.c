@@ -130,13 +130,13 @@ hc_prop(http_connection_t *hc, const char *remain, void *opaque,
     }
 
     if((s = http_arg_get_req(hc, "debug")) != NULL) {
-      hts_mutex_lock(&prop_mutex);
+      prop_lock();
       if(!strcmp(s, "on")) {
         p->hp_flags |= PROP_DEBUG_THIS;
       } else {
         p->hp_flags &= ~PROP_DEBUG_THIS;
       }
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock();
       rval = HTTP_STATUS_OK;
       break;
     }
@@ -151,7 +151,7 @@ hc_prop(http_connection_t *hc, const char *remain, void *opaque,
     htsbuf_qprintf(&out, "%s (ref:%d xref:%d) is a ", name,
                    p->hp_refcount, p->hp_xref);
 
-    hts_mutex_lock(&prop_mutex);
+    prop_lock();
 
     if(p->hp_type == PROP_DIR) {
       prop_t *c;
@@ -227,7 +227,7 @@ hc_prop(http_connection_t *hc, const char *remain, void *opaque,
       htsbuf_qprintf(&out, "%s:%d%s", s->hps_file, s->hps_line, br);
 #endif
 
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
 
     rval = http_send_reply(hc, 0,
                            html ?
@@ -32,6 +32,30 @@ extern pool_t *prop_pool;
 extern pool_t *notify_pool;
 extern pool_t *sub_pool;
 
+/**
+ * Use these instead of locking prop_mutex directly, see prop_lock.c
+ */
+void prop_lock0(const char *file, int line);
+
+int prop_trylock0(const char *file, int line);
+
+void prop_unlock(void);
+
+void prop_cond_wait(hts_cond_t *c);
+
+int prop_cond_wait_timeout(hts_cond_t *c, int delta);
+
+#define prop_lock()    prop_lock0(__FILE__, __LINE__)
+#define prop_trylock() prop_trylock0(__FILE__, __LINE__)
+
+void prop_read_lock(void);
+
+void prop_read_unlock(void);
+
+void prop_lock_profile_report(int maxsites);
+
+void prop_lock_init_late(void);
+
 
 
 TAILQ_HEAD(prop_queue, prop);
@@ -72,6 +96,14 @@ struct prop_courier {
 
   int pc_refcount;
   char *pc_name;
+
+  /**
+   * Bumped whenever notifications are taken off pc_queue_nor.
+   * Used to tell if a subscription's hps_pending_value is still queued
+   */
+  int pc_nor_gen;
+
+  int pc_coalesced;
 };
 
 
@@ -313,6 +345,11 @@ struct prop {
 #define PROP_HAVE_MORE               0x1000
 #define PROP_HAVE_MORE_YES           0x2000
 
+  /**
+   * Directory has a name index (see prop_name_index_get())
+   */
+#define PROP_NAME_INDEXED            0x4000
+
   /**
    * Tags. Protected by prop_tag_mutex
    */
@@ -538,6 +575,14 @@ struct prop_sub {
    */
   int hps_user_int;
 
+  /**
+   * Last value notification queued on the courier's pc_queue_nor.
+   * Only valid if hps_pending_gen still matches pc_nor_gen.
+   * Used for coalescing (PROP_SUB_COALESCE). Protected by global mutex
+   */
+  struct prop_notify *hps_pending_value;
+  int hps_pending_gen;
+
 
 #ifdef PROP_SUB_RECORD_SOURCE
   const char *hps_file;
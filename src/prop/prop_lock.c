@@ -0,0 +1,437 @@
+/*
+ *  Copyright (C) 2007-2015 Lonelycoder AB
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  This program is also available under a commercial proprietary license.
+ *  For more information, contact andreas@lonelycoder.com
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "main.h"
+#include "arch/arch.h"
+#include "arch/atomic.h"
+#include "misc/callout.h"
+
+#include "prop_i.h"
+
+/**
+ * Locking of the prop tree
+ *
+ * All modifications are done holding prop_mutex via prop_lock(). On top
+ * of that, functions that only read the tree (lookups, value reads,
+ * following links) may use prop_read_lock() which does not touch the
+ * mutex at all. Readers announce themselves in a sharded counter and
+ * prop_lock() waits for them to drain after grabbing the mutex. A
+ * reader that finds a writer active backs off and waits for the mutex
+ * to be released.
+ *
+ * The counter is sharded over a few cache lines so readers on different
+ * cores rarely touch the same line.
+ *
+ * Read sections must be short, must not nest and must not call
+ * anything that takes prop_lock() (such as prop_ref_dec()).
+ */
+
+#define PROP_READER_SHARDS 16
+
+typedef struct prop_reader_shard {
+  atomic_t prs_count;
+  char prs_pad[64 - sizeof(atomic_t)];
+} prop_reader_shard_t;
+
+static prop_reader_shard_t prop_readers[PROP_READER_SHARDS];
+
+static atomic_t prop_writer_active;
+
+// Set while the current thread holds prop_mutex
+static thread_local_var int prop_lock_held;
+
+static atomic_t prop_read_backoffs;
+
+
+/**
+ * Lock profiler
+ *
+ * When enabled (gconf.enable_prop_lock_profiler) time spent waiting for
+ * and holding prop_mutex is accounted per call site of prop_lock().
+ * All bookkeeping is done while holding the mutex.
+ */
+#define PROP_LOCK_SITE_HASH 256
+
+typedef struct prop_lock_site {
+  struct prop_lock_site *pls_next;
+  const char *pls_file;
+  int pls_line;
+  int pls_count;
+  int64_t pls_wait;
+  int64_t pls_hold;
+  int64_t pls_max_wait;
+  int64_t pls_max_hold;
+} prop_lock_site_t;
+
+static prop_lock_site_t *prop_lock_sites[PROP_LOCK_SITE_HASH];
+static prop_lock_site_t *prop_lock_cur_site;
+static int64_t prop_lock_cur_ts;
+
+
+/**
+ *
+ */
+static inline prop_reader_shard_t *
+prop_reader_shard(void)
+{
+  uint64_t t = (uint64_t)(uintptr_t)hts_thread_current();
+  return &prop_readers[(t * 0x9e3779b97f4a7c15ULL) >> 60];
+}
+
+
+/**
+ *
+ */
+static int
+prop_readers_active(void)
+{
+  for(int i = 0; i < PROP_READER_SHARDS; i++)
+    if(atomic_get(&prop_readers[i].prs_count))
+      return 1;
+  return 0;
+}
+
+
+/**
+ * Called with prop_mutex held
+ */
+static void
+prop_writer_enter(void)
+{
+  prop_lock_held = 1;
+  atomic_set(&prop_writer_active, 1);
+  __sync_synchronize();
+
+  int spins = 0;
+  while(prop_readers_active()) {
+    if(++spins > 100)
+      usleep(1);
+  }
+}
+
+
+/**
+ *
+ */
+static void
+prop_writer_leave(void)
+{
+  __sync_synchronize();
+  atomic_set(&prop_writer_active, 0);
+  prop_lock_held = 0;
+}
+
+
+/**
+ *
+ */
+static int
+prop_self_is_writer(void)
+{
+  return prop_lock_held;
+}
+
+
+/**
+ *
+ */
+void
+prop_read_lock(void)
+{
+  if(prop_self_is_writer())
+    return;
+
+  prop_reader_shard_t *prs = prop_reader_shard();
+
+  while(1) {
+    atomic_inc(&prs->prs_count);
+    if(!atomic_get(&prop_writer_active)) {
+      // Don't let reads of the tree pass the check above
+      __sync_synchronize();
+      return;
+    }
+    atomic_dec(&prs->prs_count);
+
+    // Writer around, wait for it to finish
+    atomic_inc(&prop_read_backoffs);
+    hts_mutex_lock(&prop_mutex);
+    hts_mutex_unlock(&prop_mutex);
+  }
+}
+
+
+/**
+ *
+ */
+void
+prop_read_unlock(void)
+{
+  if(prop_self_is_writer())
+    return;
+
+  atomic_dec(&prop_reader_shard()->prs_count);
+}
+
+
+/**
+ *
+ */
+static prop_lock_site_t *
+prop_lock_site_get(const char *file, int line)
+{
+  const unsigned int h =
+    (((uintptr_t)file >> 3) ^ line) & (PROP_LOCK_SITE_HASH - 1);
+  prop_lock_site_t *pls;
+
+  for(pls = prop_lock_sites[h]; pls != NULL; pls = pls->pls_next)
+    if(pls->pls_file == file && pls->pls_line == line)
+      return pls;
+
+  pls = calloc(1, sizeof(prop_lock_site_t));
+  pls->pls_file = file;
+  pls->pls_line = line;
+  pls->pls_next = prop_lock_sites[h];
+  prop_lock_sites[h] = pls;
+  return pls;
+}
+
+
+/**
+ *
+ */
+static void
+prop_lock_profile_acquired(const char *file, int line, int64_t ts)
+{
+  prop_lock_site_t *pls = prop_lock_site_get(file, line);
+  const int64_t now = arch_get_ts();
+  const int64_t wait = now - ts;
+
+  pls->pls_count++;
+  pls->pls_wait += wait;
+  if(wait > pls->pls_max_wait)
+    pls->pls_max_wait = wait;
+
+  prop_lock_cur_site = pls;
+  prop_lock_cur_ts = now;
+}
+
+
+/**
+ *
+ */
+static void
+prop_lock_profile_release(void)
+{
+  prop_lock_site_t *pls = prop_lock_cur_site;
+  if(pls == NULL)
+    return;
+
+  const int64_t hold = arch_get_ts() - prop_lock_cur_ts;
+  pls->pls_hold += hold;
+  if(hold > pls->pls_max_hold)
+    pls->pls_max_hold = hold;
+  prop_lock_cur_site = NULL;
+}
+
+
+/**
+ *
+ */
+void
+prop_lock0(const char *file, int line)
+{
+  if(gconf.enable_prop_lock_profiler) {
+    const int64_t ts = arch_get_ts();
+    hts_mutex_lock(&prop_mutex);
+    prop_writer_enter();
+    prop_lock_profile_acquired(file, line, ts);
+  } else {
+    hts_mutex_lock(&prop_mutex);
+    prop_writer_enter();
+  }
+}
+
+
+/**
+ *
+ */
+int
+prop_trylock0(const char *file, int line)
+{
+  const int profile = gconf.enable_prop_lock_profiler;
+  const int64_t ts = profile ? arch_get_ts() : 0;
+
+  if(hts_mutex_trylock(&prop_mutex))
+    return 1;
+
+  prop_writer_enter();
+  if(profile)
+    prop_lock_profile_acquired(file, line, ts);
+  return 0;
+}
+
+
+/**
+ *
+ */
+void
+prop_unlock(void)
+{
+  prop_lock_profile_release();
+  prop_writer_leave();
+  hts_mutex_unlock(&prop_mutex);
+}
+
+
+/**
+ * Hold time is not accounted while sleeping on the condition
+ */
+void
+prop_cond_wait(hts_cond_t *c)
+{
+  prop_lock_site_t *pls = prop_lock_cur_site;
+  prop_lock_profile_release();
+  prop_writer_leave();
+  hts_cond_wait(c, &prop_mutex);
+  prop_writer_enter();
+  if(pls != NULL) {
+    prop_lock_cur_site = pls;
+    prop_lock_cur_ts = arch_get_ts();
+  }
+}
+
+
+/**
+ *
+ */
+int
+prop_cond_wait_timeout(hts_cond_t *c, int delta)
+{
+  prop_lock_site_t *pls = prop_lock_cur_site;
+  prop_lock_profile_release();
+  prop_writer_leave();
+  int r = hts_cond_wait_timeout(c, &prop_mutex, delta);
+  prop_writer_enter();
+  if(pls != NULL) {
+    prop_lock_cur_site = pls;
+    prop_lock_cur_ts = arch_get_ts();
+  }
+  return r;
+}
+
+
+/**
+ *
+ */
+static int
+pls_cmp(const void *A, const void *B)
+{
+  const prop_lock_site_t *a = *(const prop_lock_site_t **)A;
+  const prop_lock_site_t *b = *(const prop_lock_site_t **)B;
+
+  const int64_t x = a->pls_wait + a->pls_hold;
+  const int64_t y = b->pls_wait + b->pls_hold;
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+
+/**
+ * Log the call sites with most time spent waiting for and holding the
+ * lock and reset the counters
+ */
+void
+prop_lock_profile_report(int maxsites)
+{
+  prop_lock_site_t *pls, **v = NULL;
+  int num = 0;
+
+  hts_mutex_lock(&prop_mutex);
+  prop_writer_enter();
+
+  for(int i = 0; i < PROP_LOCK_SITE_HASH; i++)
+    for(pls = prop_lock_sites[i]; pls != NULL; pls = pls->pls_next)
+      num++;
+
+  if(num > 0) {
+    v = malloc(num * sizeof(prop_lock_site_t *));
+    num = 0;
+    for(int i = 0; i < PROP_LOCK_SITE_HASH; i++)
+      for(pls = prop_lock_sites[i]; pls != NULL; pls = pls->pls_next)
+        v[num++] = pls;
+
+    qsort(v, num, sizeof(prop_lock_site_t *), pls_cmp);
+
+    TRACE(TRACE_INFO, "prop", "Lock profile, %d read backoffs",
+          atomic_get(&prop_read_backoffs));
+    for(int i = 0; i < num && i < maxsites; i++) {
+      pls = v[i];
+      TRACE(TRACE_INFO, "prop",
+            "%8d locks  wait %6d ms (max %5d us)  "
+            "hold %6d ms (max %5d us)  %s:%d",
+            pls->pls_count,
+            (int)(pls->pls_wait / 1000), (int)pls->pls_max_wait,
+            (int)(pls->pls_hold / 1000), (int)pls->pls_max_hold,
+            pls->pls_file, pls->pls_line);
+    }
+    free(v);
+  }
+
+  // Threads sleeping in prop_cond_wait() may refer to a site so they
+  // are only cleared, never freed
+  for(int i = 0; i < PROP_LOCK_SITE_HASH; i++) {
+    for(pls = prop_lock_sites[i]; pls != NULL; pls = pls->pls_next) {
+      pls->pls_count = 0;
+      pls->pls_wait = pls->pls_hold = 0;
+      pls->pls_max_wait = pls->pls_max_hold = 0;
+    }
+  }
+  atomic_set(&prop_read_backoffs, 0);
+
+  prop_writer_leave();
+  hts_mutex_unlock(&prop_mutex);
+}
+
+
+static callout_t prop_lock_profile_callout;
+
+/**
+ *
+ */
+static void
+prop_lock_profile_cb(callout_t *c, void *aux)
+{
+  if(gconf.enable_prop_lock_profiler)
+    prop_lock_profile_report(10);
+  callout_arm(&prop_lock_profile_callout, prop_lock_profile_cb, NULL, 10);
+}
+
+
+/**
+ *
+ */
+void
+prop_lock_init_late(void)
+{
+  callout_arm(&prop_lock_profile_callout, prop_lock_profile_cb, NULL, 10);
+}
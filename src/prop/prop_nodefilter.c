@@ -1160,7 +1160,7 @@ prop_nf_create(prop_t *dst, prop_t *src, prop_t *filter, int flags)
   nf->dst = flags & PROP_NF_TAKE_DST_OWNERSHIP ? dst : prop_xref_addref(dst);
   nf->src = src;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   if(filter != NULL)
     nf->filtersub = prop_subscribe(PROP_SUB_INTERNAL | PROP_SUB_DONTLOCK,
@@ -1181,7 +1181,7 @@ prop_nf_create(prop_t *dst, prop_t *src, prop_t *filter, int flags)
 			      NULL);
 
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 
   return nf;
 }
@@ -1193,9 +1193,9 @@ prop_nf_create(prop_t *dst, prop_t *src, prop_t *filter, int flags)
 void
 prop_nf_release(struct prop_nf *pnf)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_nf_release0(pnf);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -1205,9 +1205,9 @@ prop_nf_release(struct prop_nf *pnf)
 struct prop_nf *
 prop_nf_retain(struct prop_nf *pnf)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   pnf->pnf_refcount++;
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return pnf;
 }
 
@@ -1280,9 +1280,9 @@ prop_nf_pred_str_add(struct prop_nf *nf,
 {
   struct prop_nf_pred *pnp = calloc(1, sizeof(struct prop_nf_pred));
   pnp->pnp_str = strdup(str);
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   int id = prop_nf_pred_add(nf, path, cf, enable, mode, pnp);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return id;
 }
 
@@ -1298,9 +1298,9 @@ prop_nf_pred_int_add(struct prop_nf *nf,
 {
   struct prop_nf_pred *pnp = calloc(1, sizeof(struct prop_nf_pred));
   pnp->pnp_int = value;
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   int id = prop_nf_pred_add(nf, path, cf, enable, mode, pnp);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return id;
 }
 
@@ -1318,7 +1318,7 @@ prop_nf_pred_remove(struct prop_nf *nf, int id)
   if(id == 0)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   LIST_FOREACH(pnp, &nf->preds, pnp_link)
     if(pnp->pnp_id == id)
       break;
@@ -1337,7 +1337,7 @@ prop_nf_pred_remove(struct prop_nf *nf, int id)
     nf_destroy_pred(pnp);
   }
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -1364,7 +1364,7 @@ prop_nf_sort(struct prop_nf *nf, const char *path, int desc, unsigned int idx,
   nfnode_t *nfn;
   int m = desc ? -1 : 1;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   assert(idx < MAX_SORT_KEYS);
 
@@ -1408,5 +1408,5 @@ prop_nf_sort(struct prop_nf *nf, const char *path, int desc, unsigned int idx,
   TAILQ_FOREACH(nfn, &nf->in, in_link)
     nf_update_order_x(nf, nfn, idx);
  done:
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
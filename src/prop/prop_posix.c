@@ -46,9 +46,10 @@ prop_courier_poll_with_alarm(prop_courier_t *pc, int maxtime)
 {
   prop_notify_t *n, *next;
 
-  if(!hts_mutex_trylock(&prop_mutex)) {
+  if(!prop_trylock()) {
     TAILQ_MERGE(&pc->pc_dispatch_queue, &pc->pc_queue_exp, hpn_link);
     TAILQ_MERGE(&pc->pc_dispatch_queue, &pc->pc_queue_nor, hpn_link);
+    pc->pc_nor_gen++;
 
     for(n = TAILQ_FIRST(&pc->pc_free_queue); n != NULL; n = next) {
       next = TAILQ_NEXT(n, hpn_link);
@@ -58,7 +59,7 @@ prop_courier_poll_with_alarm(prop_courier_t *pc, int maxtime)
     }
     TAILQ_INIT(&pc->pc_free_queue);
 
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
   }
 
   if(TAILQ_FIRST(&pc->pc_dispatch_queue) == NULL)
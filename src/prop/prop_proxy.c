@@ -121,7 +121,7 @@ ppc_disconnect(prop_proxy_connection_t *ppc, int reconnect)
   ppc->ppc_connection = NULL;
   ppc->ppc_websocket_open = 0;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_proxy_imagereq_t *ppi;
   LIST_FOREACH(ppi, &ppc->ppc_image_requests, ppi_link) {
     ppi->ppi_done = 1;
@@ -129,7 +129,7 @@ ppc_disconnect(prop_proxy_connection_t *ppc, int reconnect)
   }
 
   hts_cond_broadcast(&ppc->ppc_image_cond);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -163,9 +163,9 @@ prop_proxy_release(prop_proxy_connection_t *ppc)
 static void
 ppc_sendq(prop_proxy_connection_t *ppc)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   asyncio_sendq(ppc->ppc_connection, &ppc->ppc_outq, 0);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -413,7 +413,7 @@ ppc_ws_input_notify(prop_proxy_connection_t *ppc, const uint8_t *data, int len)
   int setop = data[0];
   int subid = rd32_le(data + 1);
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
 
   // XXX .. this is probably quite slow
   LIST_FOREACH(s, &ppc->ppc_subs, hps_value_prop_link) {
@@ -422,7 +422,7 @@ ppc_ws_input_notify(prop_proxy_connection_t *ppc, const uint8_t *data, int len)
   }
 
   if(s == NULL) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock();
     return;
   }
 
@@ -571,7 +571,7 @@ ppc_ws_input_notify(prop_proxy_connection_t *ppc, const uint8_t *data, int len)
 
   if(n != NULL)
     prop_courier_enqueue(s, n);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 
@@ -619,7 +619,7 @@ ppc_ws_input_image_reply(prop_proxy_connection_t *ppc,
   if(len < 13)
     return -1;
   uint32_t id = rd32_le(data);
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_proxy_imagereq_t *ppi;
   LIST_FOREACH(ppi, &ppc->ppc_image_requests, ppi_link)
     if(ppi->ppi_id == id)
@@ -639,7 +639,7 @@ ppc_ws_input_image_reply(prop_proxy_connection_t *ppc,
     ppi->ppi_done = 1;
     hts_cond_broadcast(&ppc->ppc_image_cond);
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return 0;
 }
 
@@ -656,7 +656,7 @@ ppc_ws_input_image_fail(prop_proxy_connection_t *ppc,
     return -1;
 
   uint32_t id = rd32_le(data);
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   prop_proxy_imagereq_t *ppi;
   LIST_FOREACH(ppi, &ppc->ppc_image_requests, ppi_link)
     if(ppi->ppi_id == id)
@@ -667,7 +667,7 @@ ppc_ws_input_image_fail(prop_proxy_connection_t *ppc,
     ppi->ppi_done = 1;
     hts_cond_broadcast(&ppc->ppc_image_cond);
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
   return 0;
 }
 
@@ -952,7 +952,7 @@ prop_proxy_imgload_cancel(void *opaque)
 {
   prop_proxy_imagereq_t *ppi = opaque;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   ppi->ppi_done = 1;
   snprintf(ppi->ppi_errbuf, ppi->ppi_errlen, "Cancelled");
   hts_cond_broadcast(&ppi->ppi_ppc->ppc_image_cond);
@@ -962,7 +962,7 @@ prop_proxy_imgload_cancel(void *opaque)
   wr32_le(cmd + 1, ppi->ppi_id);
   prop_proxy_send_data(ppi->ppi_ppc, cmd, sizeof(cmd));
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 }
 
 /**
@@ -999,15 +999,15 @@ prop_proxy_image_loader(const char *url, const struct image_meta *im,
 
   c = cancellable_bind(c, prop_proxy_imgload_cancel, &ppi);
 
-  hts_mutex_lock(&prop_mutex);
+  prop_lock();
   LIST_INSERT_HEAD(&ppc->ppc_image_requests, &ppi, ppi_link);
   prop_proxy_send_queue(ppc, &q);
 
   while(!ppi.ppi_done) {
-    hts_cond_wait(&ppc->ppc_image_cond, &prop_mutex);
+    prop_cond_wait(&ppc->ppc_image_cond);
   }
   LIST_REMOVE(&ppi, ppi_link);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock();
 
   cancellable_unbind(c, &ppi);
 
@@ -1568,9 +1568,21 @@ init_dev_settings(void)
   add_dev_bool("Disable HTTP connection reuse",
 	       "nohttpreuse", &gconf.disable_http_reuse);
 
+  add_dev_bool("Fetch HTTP media over several connections",
+	       "httpparallel", &gconf.enable_http_parallel);
+
   add_dev_bool("Enable indexer option",
 	       "enable_indexer", &gconf.enable_indexer);
 
+  add_dev_bool("Store cached files packed in segment files",
+	       "bcsegments", &gconf.enable_blobcache_segments);
+
+  add_dev_bool("Use WAL with separate read-only database connections",
+	       "dbsplit", &gconf.enable_db_split);
+
+  add_dev_bool("Render text using a shared glyph atlas",
+	       "textatlas", &gconf.enable_text_atlas);
+
   if(gconf.arch_dev_opts)
     gconf.arch_dev_opts(&add_dev_bool);
 
@@ -1636,6 +1648,9 @@ init_dev_settings(void)
   add_dev_bool("Debug settings store/load from disk",
 	       "settingsdebug", &gconf.enable_settings_debug);
 
+  add_dev_bool("Profile prop tree locking",
+	       "proplockprofiler", &gconf.enable_prop_lock_profiler);
+
   add_dev_bool("Debug threads",
 	       "threadsdebug", &gconf.enable_thread_debug);
 
@@ -18,40 +18,94 @@
  *  For more information, contact andreas@lonelycoder.com
  */
 #include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "main.h"
+#include "arch/arch.h"
+#include "arch/atomic.h"
 #include "arch/threads.h"
 
 #include "task.h"
 #include "misc/queue.h"
+#include "misc/pool.h"
+#include "misc/minmax.h"
 
-#define MAX_TASK_THREADS 16
+/**
+ * Task scheduler
+ *
+ * Tasks are spread over a number of queues, each with its own lock.
+ * Tasks submitted from outside of the scheduler are distributed over
+ * the queues round robin. A worker thread prefers the queue it is
+ * attached to but will steal from all other queues before going to
+ * sleep. All interactive tasks are run before any background task.
+ *
+ * task_mutex is only used for sleeping and for starting new threads.
+ *
+ * A task group only has its first task enqueued. When that task has
+ * been executed the next task in the group is enqueued on the queue of
+ * the worker that just finished. This keeps tasks in a group serialized
+ * without any global bookkeeping.
+ */
+
+#define TASK_QUEUES 16
+#define MAX_TASK_THREADS 32
 #define MAX_IDLE_TASK_THREADS 2
 
 TAILQ_HEAD(task_queue, task);
-TAILQ_HEAD(task_group_queue, task_group);
 
 struct task_group {
   atomic_t tg_refcount;
+  hts_mutex_t tg_mutex;
   struct task_queue tg_tasks;
-  TAILQ_ENTRY(task_group) tg_link;
+  int tg_prio;
 };
 
 
 typedef struct task {
-  TAILQ_ENTRY(task) t_link;
+  TAILQ_ENTRY(task) t_link;        // In task_worker_queue
+  TAILQ_ENTRY(task) t_group_link;  // In task_group
   task_fn_t *t_fn;
   void *t_opaque;
   task_group_t *t_group;
+  int t_prio;
+  int64_t t_enqueued;
 } task_t;
 
 
-static struct task_queue tasks = TAILQ_HEAD_INITIALIZER(tasks);
-static struct task_group_queue task_groups =TAILQ_HEAD_INITIALIZER(task_groups);
-static unsigned int num_task_threads;
-static unsigned int num_task_threads_avail;
+typedef struct task_queue_stats {
+  int tqs_count;
+  int64_t tqs_latency;
+  int64_t tqs_max_latency;
+} task_queue_stats_t;
+
+
+typedef struct task_worker_queue {
+  hts_mutex_t twq_mutex;
+  struct task_queue twq_tasks[TASK_PRIO_num];
+  atomic_t twq_len[TASK_PRIO_num];
+  task_queue_stats_t twq_stats[TASK_PRIO_num];
+  char twq_pad[64];
+} task_worker_queue_t;
+
+
+static task_worker_queue_t task_queues[TASK_QUEUES];
+static atomic_t task_next_queue;
+static atomic_t task_pending;
+static atomic_t num_task_threads;
+static atomic_t num_task_threads_idle;
+static int task_wakeups; // Idle threads signalled but not yet awake
 static hts_mutex_t task_mutex;
 static hts_cond_t task_cond;
+static pool_t *task_pool;
+
+static void *task_thread_entry(void *aux);
+
+static const char *task_prio_names[TASK_PRIO_num] = {
+  [TASK_PRIO_INTERACTIVE] = "interactive",
+  [TASK_PRIO_BACKGROUND]  = "background",
+};
 
 
 /**
@@ -63,6 +117,7 @@ task_group_release(task_group_t *tg)
   if(atomic_dec(&tg->tg_refcount))
     return;
   assert(TAILQ_FIRST(&tg->tg_tasks) == NULL);
+  hts_mutex_destroy(&tg->tg_mutex);
   free(tg);
 }
 
@@ -70,118 +125,253 @@ task_group_release(task_group_t *tg)
 /**
  *
  */
-static void *
-task_thread(void *aux)
+static void
+task_enqueue(task_t *t, task_worker_queue_t *twq)
+{
+  t->t_enqueued = arch_get_ts();
+
+  hts_mutex_lock(&twq->twq_mutex);
+  TAILQ_INSERT_TAIL(&twq->twq_tasks[t->t_prio], t, t_link);
+  atomic_inc(&twq->twq_len[t->t_prio]);
+  // Pairs with the check in task_thread_entry() before going to sleep.
+  // Either we see the idle thread below or it will see our task
+  atomic_inc(&task_pending);
+  hts_mutex_unlock(&twq->twq_mutex);
+
+  if(atomic_get(&num_task_threads_idle) > 0) {
+    hts_mutex_lock(&task_mutex);
+    // No need to wake a thread that is already on its way up
+    if(task_wakeups < atomic_get(&num_task_threads_idle)) {
+      task_wakeups++;
+      hts_cond_signal(&task_cond);
+    }
+    hts_mutex_unlock(&task_mutex);
+  } else if(atomic_get(&num_task_threads) < MAX_TASK_THREADS) {
+    hts_mutex_lock(&task_mutex);
+    if(atomic_get(&num_task_threads) < MAX_TASK_THREADS) {
+      const int id = atomic_add_and_fetch(&num_task_threads, 1);
+      hts_thread_create_detached("tasks", task_thread_entry,
+                                 &task_queues[id % TASK_QUEUES],
+                                 THREAD_PRIO_BGTASK);
+    }
+    hts_mutex_unlock(&task_mutex);
+  }
+}
+
+
+/**
+ *
+ */
+static task_worker_queue_t *
+task_queue_pick(void)
+{
+  const unsigned int i = atomic_add_and_fetch(&task_next_queue, 1);
+  return &task_queues[i % TASK_QUEUES];
+}
+
+
+/**
+ *
+ */
+static task_t *
+task_dequeue(task_worker_queue_t *twq, int prio)
 {
   task_t *t;
-  task_group_t *tg;
 
-  hts_mutex_lock(&task_mutex);
-  while(1) {
-    t = TAILQ_FIRST(&tasks);
-    tg = TAILQ_FIRST(&task_groups);
+  if(atomic_get(&twq->twq_len[prio]) == 0)
+    return NULL;
+
+  hts_mutex_lock(&twq->twq_mutex);
+  t = TAILQ_FIRST(&twq->twq_tasks[prio]);
+  if(t != NULL) {
+    TAILQ_REMOVE(&twq->twq_tasks[prio], t, t_link);
+    atomic_dec(&twq->twq_len[prio]);
+    atomic_dec(&task_pending);
+
+    task_queue_stats_t *tqs = &twq->twq_stats[prio];
+    const int64_t latency = arch_get_ts() - t->t_enqueued;
+    tqs->tqs_count++;
+    tqs->tqs_latency += latency;
+    tqs->tqs_max_latency = MAX(tqs->tqs_max_latency, latency);
+  }
+  hts_mutex_unlock(&twq->twq_mutex);
+  return t;
+}
 
-    if(t == NULL && tg == NULL) {
-      if(num_task_threads_avail == MAX_IDLE_TASK_THREADS)
-        break;
 
-      num_task_threads_avail++;
-      hts_cond_wait(&task_cond, &task_mutex);
-      num_task_threads_avail--;
+/**
+ * Take a task from our own queue, or steal one from another queue
+ */
+static task_t *
+task_find(task_worker_queue_t *self)
+{
+  const int idx = self - task_queues;
+
+  for(int prio = 0; prio < TASK_PRIO_num; prio++) {
+    for(int i = 0; i < TASK_QUEUES; i++) {
+      task_t *t = task_dequeue(&task_queues[(idx + i) % TASK_QUEUES], prio);
+      if(t != NULL)
+        return t;
+    }
+  }
+  return NULL;
+}
+
+
+/**
+ *
+ */
+static void
+task_execute(task_t *t, task_worker_queue_t *self)
+{
+  task_group_t *tg = t->t_group;
+
+  t->t_fn(t->t_opaque);
+
+  if(tg != NULL) {
+    hts_mutex_lock(&tg->tg_mutex);
+    // Note that we remove _after_ execution because we don't want
+    // any newly inserted task in this group to cause the group
+    // to activate (ie, get enqueued)
+    TAILQ_REMOVE(&tg->tg_tasks, t, t_group_link);
+    task_t *next = TAILQ_FIRST(&tg->tg_tasks);
+    hts_mutex_unlock(&tg->tg_mutex);
+
+    // Enqueue at tail to maintain fairness between groups
+    if(next != NULL)
+      task_enqueue(next, self);
+
+    // Decrease refcount owned by task
+    task_group_release(tg);
+  }
+  pool_put(task_pool, t);
+}
+
+
+/**
+ *
+ */
+static void *
+task_thread_entry(void *aux)
+{
+  task_worker_queue_t *self = aux;
+  task_t *t;
+
+  while(1) {
+    if((t = task_find(self)) != NULL) {
+      task_execute(t, self);
       continue;
     }
 
-    if(t != NULL) {
-      TAILQ_REMOVE(&tasks, t, t_link);
+    hts_mutex_lock(&task_mutex);
+
+    if(atomic_get(&task_pending)) {
       hts_mutex_unlock(&task_mutex);
-      t->t_fn(t->t_opaque);
-      free(t);
-      hts_mutex_lock(&task_mutex);
-      // Released lock, must recheck for task groups
-      tg = TAILQ_FIRST(&task_groups);
+      continue;
     }
 
-    if(tg != NULL) {
-      // Remove task group while processing as we don't want anyone
-      // else to dispatch from this group
-      TAILQ_REMOVE(&task_groups, tg, tg_link);
+    if(atomic_get(&num_task_threads_idle) == MAX_IDLE_TASK_THREADS)
+      break;
 
-      t = TAILQ_FIRST(&tg->tg_tasks);
-      hts_mutex_unlock(&task_mutex);
-      t->t_fn(t->t_opaque);
-      hts_mutex_lock(&task_mutex);
-
-      // Note that we remove _after_ execution because we don't want
-      // any newly inserted task in this group to cause the group
-      // to activate (ie, get inserted in task_groups)
-      TAILQ_REMOVE(&tg->tg_tasks, t, t_link);
-      free(t);
-
-      if(TAILQ_FIRST(&tg->tg_tasks) != NULL) {
-        // Still more tasks to work on in this group
-        // Reinsert group at tail to maintain fairness between groups
-        TAILQ_INSERT_TAIL(&task_groups, tg, tg_link);
-      }
+    atomic_inc(&num_task_threads_idle);
 
-      // Decrease refcount owned by task
-      task_group_release(tg);
-    }
+    if(atomic_get(&task_pending) == 0)
+      hts_cond_wait(&task_cond, &task_mutex);
+
+    if(task_wakeups > 0)
+      task_wakeups--;
+    atomic_dec(&num_task_threads_idle);
+    hts_mutex_unlock(&task_mutex);
   }
 
-  num_task_threads--;
+  atomic_dec(&num_task_threads);
   hts_mutex_unlock(&task_mutex);
   return NULL;
 }
 
 
 /**
- *
+ * The pool is created on first use rather than from taskinit() as
+ * thread specific keys may not be usable from constructors (see
+ * emu_thread_specifics.c)
  */
 static void
-task_schedule()
-{
-  if(num_task_threads_avail > 0) {
-    hts_cond_signal(&task_cond);
-  } else {
-    if(num_task_threads < MAX_TASK_THREADS) {
-      num_task_threads++;
-      hts_thread_create_detached("tasks", task_thread, NULL,
-                                 THREAD_PRIO_BGTASK);
-    }
+task_pool_create(void)
+{
+  hts_mutex_lock(&task_mutex);
+  if(task_pool == NULL) {
+    pool_t *p = pool_create("tasks", sizeof(task_t), POOL_THREAD_CACHE);
+    // Make sure the pool is initialized before others can see it
+    __sync_synchronize();
+    task_pool = p;
   }
+  hts_mutex_unlock(&task_mutex);
 }
 
 
 /**
  *
  */
-void
-task_run(task_fn_t *fn, void *opaque)
+static task_t *
+task_create(task_fn_t *fn, void *opaque, int prio)
 {
-  task_t *t = calloc(1, sizeof(task_t));
+  if(unlikely(task_pool == NULL))
+    task_pool_create();
+
+  task_t *t = pool_get(task_pool);
   t->t_fn = fn;
   t->t_opaque = opaque;
-  hts_mutex_lock(&task_mutex);
-  TAILQ_INSERT_TAIL(&tasks, t, t_link);
-  task_schedule();
-  hts_mutex_unlock(&task_mutex);
+  t->t_group = NULL;
+  t->t_prio = prio;
+  return t;
 }
 
 
+/**
+ *
+ */
+void
+task_run_prio(task_fn_t *fn, void *opaque, int prio)
+{
+  task_enqueue(task_create(fn, opaque, prio), task_queue_pick());
+}
+
+
+/**
+ *
+ */
+void
+task_run(task_fn_t *fn, void *opaque)
+{
+  task_run_prio(fn, opaque, TASK_PRIO_INTERACTIVE);
+}
+
 
 /**
  *
  */
 task_group_t *
-task_group_create(void)
+task_group_create_prio(int prio)
 {
   task_group_t *tg = calloc(1, sizeof(task_group_t));
   atomic_set(&tg->tg_refcount, 1);
+  hts_mutex_init(&tg->tg_mutex);
   TAILQ_INIT(&tg->tg_tasks);
+  tg->tg_prio = prio;
   return tg;
 }
 
 
+/**
+ *
+ */
+task_group_t *
+task_group_create(void)
+{
+  return task_group_create_prio(TASK_PRIO_INTERACTIVE);
+}
+
+
 /**
  *
  */
@@ -198,18 +388,55 @@ task_group_destroy(task_group_t *tg)
 void
 task_run_in_group(task_fn_t *fn, void *opaque, task_group_t *tg)
 {
-  task_t *t = calloc(1, sizeof(task_t));
-  t->t_fn = fn;
-  t->t_opaque = opaque;
+  task_t *t = task_create(fn, opaque, tg->tg_prio);
   t->t_group = tg;
   atomic_inc(&tg->tg_refcount);
-  hts_mutex_lock(&task_mutex);
-  if(TAILQ_FIRST(&tg->tg_tasks) == NULL)
-    TAILQ_INSERT_TAIL(&task_groups, tg, tg_link);
 
-  TAILQ_INSERT_TAIL(&tg->tg_tasks, t, t_link);
-  task_schedule();
-  hts_mutex_unlock(&task_mutex);
+  hts_mutex_lock(&tg->tg_mutex);
+  const int activate = TAILQ_FIRST(&tg->tg_tasks) == NULL;
+  TAILQ_INSERT_TAIL(&tg->tg_tasks, t, t_group_link);
+  hts_mutex_unlock(&tg->tg_mutex);
+
+  if(activate)
+    task_enqueue(t, task_queue_pick());
+}
+
+
+/**
+ * Log queueing latency per queue and priority and reset the counters
+ */
+void
+task_stats_report(void)
+{
+  for(int prio = 0; prio < TASK_PRIO_num; prio++) {
+    int count = 0;
+    int64_t latency = 0, max_latency = 0;
+
+    for(int i = 0; i < TASK_QUEUES; i++) {
+      task_worker_queue_t *twq = &task_queues[i];
+      hts_mutex_lock(&twq->twq_mutex);
+      task_queue_stats_t *tqs = &twq->twq_stats[prio];
+      if(tqs->tqs_count) {
+        TRACE(TRACE_DEBUG, "task",
+              "Queue %2d %-11s %8d tasks  latency avg %6d us  max %7d us",
+              i, task_prio_names[prio], tqs->tqs_count,
+              (int)(tqs->tqs_latency / tqs->tqs_count),
+              (int)tqs->tqs_max_latency);
+        count += tqs->tqs_count;
+        latency += tqs->tqs_latency;
+        max_latency = MAX(max_latency, tqs->tqs_max_latency);
+      }
+      memset(tqs, 0, sizeof(task_queue_stats_t));
+      hts_mutex_unlock(&twq->twq_mutex);
+    }
+
+    if(count)
+      TRACE(TRACE_INFO, "task",
+            "%-11s %8d tasks  latency avg %6d us  max %7d us  "
+            "%d threads",
+            task_prio_names[prio], count, (int)(latency / count),
+            (int)max_latency, atomic_get(&num_task_threads));
+  }
 }
 
 
@@ -220,4 +447,147 @@ INITIALIZER(taskinit)
 {
   hts_mutex_init(&task_mutex);
   hts_cond_init(&task_cond, &task_mutex);
+
+  for(int i = 0; i < TASK_QUEUES; i++) {
+    hts_mutex_init(&task_queues[i].twq_mutex);
+    for(int j = 0; j < TASK_PRIO_num; j++)
+      TAILQ_INIT(&task_queues[i].twq_tasks[j]);
+  }
 }
+
+
+/**
+ * Submission throughput
+ *
+ * A number of threads submit short tasks as fast as they can, half of
+ * them as background tasks. A few task groups are fed at the same time
+ * and checked to never run more than one task at a time.
+ */
+#define TASKBENCH_TASKS 200000
+#define TASKBENCH_GROUPS 4
+#define TASKBENCH_GROUP_TASKS 10000
+#define TASKBENCH_MAX_THREADS 8
+
+static atomic_t taskbench_done;
+static atomic_t taskbench_group_errors;
+
+typedef struct taskbench_group {
+  task_group_t *tbg_group;
+  atomic_t tbg_running;
+  int tbg_next;
+} taskbench_group_t;
+
+typedef struct taskbench_group_item {
+  taskbench_group_t *tbgi_group;
+  int tbgi_seq;
+} taskbench_group_item_t;
+
+
+static void
+taskbench_task(void *aux)
+{
+  atomic_inc(&taskbench_done);
+}
+
+
+static void
+taskbench_group_task(void *aux)
+{
+  const taskbench_group_item_t *tbgi = aux;
+  taskbench_group_t *tbg = tbgi->tbgi_group;
+
+  if(atomic_add_and_fetch(&tbg->tbg_running, 1) != 1)
+    atomic_inc(&taskbench_group_errors);
+
+  if(tbg->tbg_next++ != tbgi->tbgi_seq)
+    atomic_inc(&taskbench_group_errors);
+
+  atomic_dec(&tbg->tbg_running);
+  atomic_inc(&taskbench_done);
+}
+
+
+static void *
+taskbench_submitter(void *aux)
+{
+  const int num = *(int *)aux;
+  for(int i = 0; i < num; i++)
+    task_run_prio(taskbench_task, NULL,
+                  i & 1 ? TASK_PRIO_BACKGROUND : TASK_PRIO_INTERACTIVE);
+  return NULL;
+}
+
+
+static void
+taskbench_wait(int total)
+{
+  while(atomic_get(&taskbench_done) < total)
+    usleep(1000);
+}
+
+
+static void
+task_bench(void)
+{
+  hts_thread_t tids[TASKBENCH_MAX_THREADS];
+  taskbench_group_t groups[TASKBENCH_GROUPS];
+
+  const int maxthreads = MIN(MAX(gconf.concurrency, 1),
+                             TASKBENCH_MAX_THREADS);
+
+  task_stats_report();
+
+  for(int threads = 1; threads <= maxthreads; threads *= 2) {
+    int num = TASKBENCH_TASKS / threads;
+    atomic_set(&taskbench_done, 0);
+
+    int64_t ts = arch_get_ts();
+    for(int i = 0; i < threads; i++)
+      hts_thread_create_joinable("taskbench", &tids[i], taskbench_submitter,
+                                 &num, THREAD_PRIO_BGTASK);
+    for(int i = 0; i < threads; i++)
+      hts_thread_join(&tids[i]);
+    taskbench_wait(num * threads);
+    ts = arch_get_ts() - ts;
+
+    printf("task: %d submitters, %d tasks, %.2f Mtasks/s\n",
+           threads, num * threads, (double)num * threads / MAX(ts, 1));
+  }
+
+  atomic_set(&taskbench_done, 0);
+  atomic_set(&taskbench_group_errors, 0);
+  for(int i = 0; i < TASKBENCH_GROUPS; i++) {
+    groups[i].tbg_group = task_group_create();
+    atomic_set(&groups[i].tbg_running, 0);
+    groups[i].tbg_next = 0;
+  }
+
+  taskbench_group_item_t *items =
+    malloc(sizeof(taskbench_group_item_t) *
+           TASKBENCH_GROUP_TASKS * TASKBENCH_GROUPS);
+
+  int64_t ts = arch_get_ts();
+  for(int i = 0; i < TASKBENCH_GROUP_TASKS; i++) {
+    for(int j = 0; j < TASKBENCH_GROUPS; j++) {
+      taskbench_group_item_t *tbgi = &items[i * TASKBENCH_GROUPS + j];
+      tbgi->tbgi_group = &groups[j];
+      tbgi->tbgi_seq = i;
+      task_run_in_group(taskbench_group_task, tbgi, groups[j].tbg_group);
+    }
+  }
+  taskbench_wait(TASKBENCH_GROUP_TASKS * TASKBENCH_GROUPS);
+  ts = arch_get_ts() - ts;
+
+  for(int i = 0; i < TASKBENCH_GROUPS; i++)
+    task_group_destroy(groups[i].tbg_group);
+  free(items);
+
+  printf("task: %d groups, %d tasks, %.2f Mtasks/s, %d ordering errors\n",
+         TASKBENCH_GROUPS, TASKBENCH_GROUP_TASKS * TASKBENCH_GROUPS,
+         (double)TASKBENCH_GROUP_TASKS * TASKBENCH_GROUPS / MAX(ts, 1),
+         atomic_get(&taskbench_group_errors));
+
+  task_stats_report();
+}
+
+BENCHMARK("task", task_bench);
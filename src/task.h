@@ -23,11 +23,23 @@ typedef struct task_group task_group_t;
 
 typedef void (task_fn_t)(void *opaque);
 
+/**
+ * Interactive tasks are always run before background tasks
+ */
+#define TASK_PRIO_INTERACTIVE 0
+#define TASK_PRIO_BACKGROUND  1
+#define TASK_PRIO_num         2
+
 void task_run(task_fn_t *fn, void *opaque);
 
+void task_run_prio(task_fn_t *fn, void *opaque, int prio);
+
 task_group_t *task_group_create(void);
 
+task_group_t *task_group_create_prio(int prio);
+
 void task_group_destroy(task_group_t *tg);
 
 void task_run_in_group(task_fn_t *fn, void *opaque, task_group_t *tg);
 
+void task_stats_report(void);
@@ -57,6 +57,7 @@ TAILQ_HEAD(glyph_queue, glyph);
 LIST_HEAD(glyph_list, glyph);
 LIST_HEAD(face_list, face);
 LIST_HEAD(idmap_list, idmap);
+LIST_HEAD(atlas_glyph_list, atlas_glyph);
 
 //----------------- generica name <-> id map --------------
 
@@ -83,6 +84,7 @@ typedef struct face {
   uint8_t style;
   int font_domain;
   struct glyph_list glyphs;
+  struct atlas_glyph_list atlas_glyphs;
   int prio;
   int refcount;
   buf_t *buf;  // Used when faces are loaded from memory
@@ -178,6 +180,8 @@ glyph_destroy(glyph_t *g)
 }
 
 
+static void atlas_glyph_destroy(struct atlas_glyph *ag);
+
 /**
  *
  */
@@ -188,6 +192,9 @@ face_destroy(face_t *f)
   while((g = LIST_FIRST(&f->glyphs)) != NULL)
     glyph_destroy(g);
 
+  while(LIST_FIRST(&f->atlas_glyphs) != NULL)
+    atlas_glyph_destroy(LIST_FIRST(&f->atlas_glyphs));
+
   TRACE(TRACE_DEBUG, "Freetype", "Unloading '%s' [%s] originally from %s",
 	f->face->family_name, f->face->style_name, f->url);
   LIST_REMOVE(f, link);
@@ -664,12 +671,444 @@ glyph_flush_one(void)
 }
 
 
+/**
+ * Rasterize the glyph (cached in the glyph)
+ */
+static FT_BitmapGlyph
+glyph_bitmap(glyph_t *g)
+{
+  if(g->bmp == NULL) {
+    g->bmp = g->orig_glyph;
+    if(FT_Glyph_To_Bitmap(&g->bmp, FT_RENDER_MODE_NORMAL, NULL, 0))
+      g->bmp = NULL;
+  }
+  return (FT_BitmapGlyph)g->bmp;
+}
+
+
+/**
+ * Rasterize the outline of the glyph, 'outline' is the thickness in
+ * 26.6 format. Only the most recently used thickness is cached
+ */
+static FT_BitmapGlyph
+glyph_outline_bitmap(glyph_t *g, int outline)
+{
+  if(g->outline == NULL || g->outline_amt != outline) {
+    if(g->outline)
+      FT_Done_Glyph(g->outline);
+
+    g->outline = g->orig_glyph;
+    FT_Stroker_Set(text_stroker,
+                   outline,
+                   FT_STROKER_LINECAP_ROUND,
+                   FT_STROKER_LINEJOIN_ROUND,
+                   0);
+    g->outline_amt = outline;
+    if(FT_Glyph_StrokeBorder(&g->outline, text_stroker, 0, 0))
+      g->outline = NULL;
+    else if(FT_Glyph_To_Bitmap(&g->outline, FT_RENDER_MODE_NORMAL, NULL, 1))
+      g->outline = NULL;
+  }
+  return (FT_BitmapGlyph)g->outline;
+}
+
+
+//------------------------- Glyph atlas -----------------------
+
+#define ATLAS_HASH_SIZE 256
+#define ATLAS_HASH_MASK (ATLAS_HASH_SIZE-1)
+#define ATLAS_MAX_SHELVES 128
+#define ATLAS_PADDING 1      // Keeps texture filtering from bleeding
+#define ATLAS_SHADOW_BLUR 4  // Same as used for shadows in text pixmaps
+#define ATLAS_EVICT_AGE 1000000 // Pages used more recently are never evicted
+
+#define ATLAS_GLYPH_FILL    0
+#define ATLAS_GLYPH_OUTLINE 1
+#define ATLAS_GLYPH_SHADOW  2
+
+typedef struct atlas_glyph {
+  LIST_ENTRY(atlas_glyph) ag_hash_link;
+  LIST_ENTRY(atlas_glyph) ag_face_link;
+  face_t *ag_face;
+  FT_UInt ag_gi;
+  int ag_outline;
+  int16_t ag_size;
+  uint8_t ag_style;
+  uint8_t ag_kind;
+
+  int16_t ag_left;     // Position of bitmap relative to the pen
+  int16_t ag_top;
+  uint16_t ag_width;
+  uint16_t ag_height;
+  uint16_t ag_x;       // Position in atlas page
+  uint16_t ag_y;
+  uint8_t ag_page;
+} atlas_glyph_t;
+
+
+typedef struct atlas_shelf {
+  uint16_t as_x;
+  uint16_t as_y;
+  uint16_t as_height;
+} atlas_shelf_t;
+
+
+typedef struct atlas_page {
+  pixmap_t *ap_pm;
+  int ap_version;  // atlas_version when the page was last modified
+  int ap_evicted;  // atlas_version when the page was last evicted
+  int64_t ap_last_use;
+  int ap_used_height;
+  int ap_num_shelves;
+  atlas_shelf_t ap_shelves[ATLAS_MAX_SHELVES];
+} atlas_page_t;
+
+static struct atlas_glyph_list atlas_hash[ATLAS_HASH_SIZE];
+static atlas_page_t atlas_pages[TEXT_ATLAS_PAGES];
+static_assert(TEXT_ATLAS_PAGES == IMAGE_GLYPH_PAGES, "Atlas page count");
+static int atlas_version;   // Bumped for every modification of any page
+static int64_t atlas_now;   // Time of the current text_render()
+static int atlas_full;      // Set when a glyph did not fit
+static atlas_glyph_t atlas_solid; // Opaque block used for horizontal rules
+static text_stats_t text_stats;
+
+
+/**
+ *
+ */
+static void
+atlas_glyph_destroy(atlas_glyph_t *ag)
+{
+  LIST_REMOVE(ag, ag_hash_link);
+  LIST_REMOVE(ag, ag_face_link);
+  free(ag);
+}
+
+
+/**
+ *
+ */
+static void
+atlas_page_modified(atlas_page_t *ap)
+{
+  ap->ap_version = ++atlas_version;
+  ap->ap_last_use = atlas_now;
+}
+
+
+/**
+ * Throw away all glyphs on the least recently used page and clear it.
+ * Text using those glyphs must be rendered again, see
+ * text_atlas_get_page(). Pages used by the current text or drawn
+ * (see text_atlas_touch()) during the last ATLAS_EVICT_AGE are kept.
+ * Rather than evicting text that is on screen we fail and the text is
+ * rendered to a pixmap instead
+ */
+static int
+atlas_evict(void)
+{
+  atlas_page_t *ap = NULL;
+  atlas_glyph_t *ag, *next;
+  int page = 0;
+
+  for(int i = 0; i < TEXT_ATLAS_PAGES; i++) {
+    if(atlas_pages[i].ap_pm == NULL)
+      continue;
+    if(ap == NULL || atlas_pages[i].ap_last_use < ap->ap_last_use) {
+      ap = &atlas_pages[i];
+      page = i;
+    }
+  }
+
+  if(ap == NULL || atlas_now - ap->ap_last_use < ATLAS_EVICT_AGE)
+    return -1;
+
+  for(int i = 0; i < ATLAS_HASH_SIZE; i++) {
+    for(ag = LIST_FIRST(&atlas_hash[i]); ag != NULL; ag = next) {
+      next = LIST_NEXT(ag, ag_hash_link);
+      if(ag->ag_page == page)
+        atlas_glyph_destroy(ag);
+    }
+  }
+
+  if(atlas_solid.ag_page == page)
+    atlas_solid.ag_width = 0;
+
+  memset(ap->ap_pm->pm_data, 0, ap->ap_pm->pm_linesize * TEXT_ATLAS_SIZE);
+  ap->ap_used_height = 0;
+  ap->ap_num_shelves = 0;
+  atlas_page_modified(ap);
+  ap->ap_evicted = ap->ap_version;
+  text_stats.ts_atlas_evictions++;
+  return 0;
+}
+
+
+/**
+ * Find room for a width x height bitmap using shelf packing
+ */
+static int
+atlas_alloc(int width, int height, int *pagep, int *xp, int *yp)
+{
+  width  += ATLAS_PADDING;
+  height += ATLAS_PADDING;
+
+  for(int i = 0; i < TEXT_ATLAS_PAGES; i++) {
+    atlas_page_t *ap = &atlas_pages[i];
+    atlas_shelf_t *best = NULL;
+
+    if(ap->ap_pm == NULL) {
+      ap->ap_pm = pixmap_create(TEXT_ATLAS_SIZE, TEXT_ATLAS_SIZE,
+                                PIXMAP_IA, 0);
+      if(ap->ap_pm == NULL)
+        return -1;
+      atlas_page_modified(ap);
+    }
+
+    for(int j = 0; j < ap->ap_num_shelves; j++) {
+      atlas_shelf_t *as = &ap->ap_shelves[j];
+      if(as->as_height < height || as->as_height > height + height / 4 + 2 ||
+         as->as_x + width > TEXT_ATLAS_SIZE)
+        continue;
+      if(best == NULL || as->as_height < best->as_height)
+        best = as;
+    }
+
+    if(best == NULL && ap->ap_num_shelves < ATLAS_MAX_SHELVES &&
+       ap->ap_used_height + height <= TEXT_ATLAS_SIZE) {
+      best = &ap->ap_shelves[ap->ap_num_shelves++];
+      best->as_x = 0;
+      best->as_y = ap->ap_used_height;
+      best->as_height = height;
+      ap->ap_used_height += height;
+    }
+
+    if(best == NULL)
+      continue;
+
+    *pagep = i;
+    *xp = best->as_x;
+    *yp = best->as_y;
+    best->as_x += width;
+    return 0;
+  }
+  return -1;
+}
+
+
+/**
+ * Allocate room for a glyph, evict a page if the atlas is full
+ */
+static int
+atlas_alloc_or_evict(int width, int height, int *pagep, int *xp, int *yp)
+{
+  if(width + ATLAS_PADDING > TEXT_ATLAS_SIZE ||
+     height + ATLAS_PADDING > TEXT_ATLAS_SIZE ||
+     (atlas_alloc(width, height, pagep, xp, yp) &&
+      (atlas_evict() || atlas_alloc(width, height, pagep, xp, yp)))) {
+    atlas_full = 1;
+    return -1;
+  }
+  return 0;
+}
+
+
+/**
+ * Copy coverage from an 8 bit bitmap into the atlas as white with alpha
+ */
+static void
+atlas_copy(atlas_page_t *ap, int x, int y, const uint8_t *src, int linesize,
+           int bpp, int width, int height)
+{
+  pixmap_t *pm = ap->ap_pm;
+
+  for(int i = 0; i < height; i++) {
+    uint8_t *d = pm->pm_data + (y + i) * pm->pm_linesize + x * 2;
+    const uint8_t *s = src + i * linesize;
+    for(int j = 0; j < width; j++) {
+      *d++ = 0xff;
+      *d++ = *s;
+      s += bpp;
+    }
+  }
+  atlas_page_modified(ap);
+}
+
+
+/**
+ * Return the glyph in the atlas, rasterizing it if needed. Note that
+ * this may evict another page
+ */
+static const atlas_glyph_t *
+atlas_glyph_get(glyph_t *g, int kind, int outline)
+{
+  const int hash = (g->gi ^ g->size ^ (kind << 6) ^ (outline >> 6) ^
+                    ((intptr_t)g->face >> 4)) & ATLAS_HASH_MASK;
+  atlas_glyph_t *ag;
+  FT_BitmapGlyph bmp;
+  int page, x, y;
+
+  LIST_FOREACH(ag, &atlas_hash[hash], ag_hash_link) {
+    if(ag->ag_face == g->face && ag->ag_gi == g->gi &&
+       ag->ag_size == g->size && ag->ag_style == g->style &&
+       ag->ag_kind == kind && ag->ag_outline == outline) {
+      atlas_pages[ag->ag_page].ap_last_use = atlas_now;
+      return ag;
+    }
+  }
+
+  if(outline)
+    bmp = glyph_outline_bitmap(g, outline);
+  else
+    bmp = glyph_bitmap(g);
+
+  if(bmp == NULL)
+    return NULL;
+
+  const int pad = kind == ATLAS_GLYPH_SHADOW ? ATLAS_SHADOW_BLUR : 0;
+  const int width  = bmp->bitmap.width ? bmp->bitmap.width + pad * 2 : 0;
+  const int height = bmp->bitmap.rows  ? bmp->bitmap.rows  + pad * 2 : 0;
+
+  page = x = y = 0;
+  if(width && height) {
+    if(atlas_alloc_or_evict(width, height, &page, &x, &y))
+      return NULL;
+
+    if(pad) {
+      pixmap_t *tmp = pixmap_create(width, height, PIXMAP_IA, 0);
+      if(tmp == NULL)
+        return NULL;
+
+      for(int i = 0; i < bmp->bitmap.rows; i++) {
+        uint8_t *d = tmp->pm_data + (i + pad) * tmp->pm_linesize + pad * 2;
+        const uint8_t *s = bmp->bitmap.buffer + i * bmp->bitmap.pitch;
+        for(int j = 0; j < bmp->bitmap.width; j++) {
+          d[1] = s[j];
+          d += 2;
+        }
+      }
+      pixmap_box_blur(tmp, ATLAS_SHADOW_BLUR, ATLAS_SHADOW_BLUR);
+      atlas_copy(&atlas_pages[page], x, y, tmp->pm_data + 1,
+                 tmp->pm_linesize, 2, width, height);
+      pixmap_release(tmp);
+    } else {
+      atlas_copy(&atlas_pages[page], x, y, bmp->bitmap.buffer,
+                 bmp->bitmap.pitch, 1, width, height);
+    }
+    text_stats.ts_atlas_rasterizations++;
+  }
+
+  ag = malloc(sizeof(atlas_glyph_t));
+  ag->ag_face = g->face;
+  ag->ag_gi = g->gi;
+  ag->ag_outline = outline;
+  ag->ag_size = g->size;
+  ag->ag_style = g->style;
+  ag->ag_kind = kind;
+  ag->ag_left = bmp->left - pad;
+  ag->ag_top = bmp->top + pad;
+  ag->ag_width = width;
+  ag->ag_height = height;
+  ag->ag_x = x;
+  ag->ag_y = y;
+  ag->ag_page = page;
+  LIST_INSERT_HEAD(&atlas_hash[hash], ag, ag_hash_link);
+  LIST_INSERT_HEAD(&g->face->atlas_glyphs, ag, ag_face_link);
+  return ag;
+}
+
+
+/**
+ * 4x4 opaque block used for drawing horizontal rules
+ */
+static const atlas_glyph_t *
+atlas_solid_get(void)
+{
+  int page, x, y;
+  static const uint8_t opaque[16] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  };
+
+  if(atlas_solid.ag_width) {
+    atlas_pages[atlas_solid.ag_page].ap_last_use = atlas_now;
+    return &atlas_solid;
+  }
+
+  if(atlas_alloc_or_evict(4, 4, &page, &x, &y))
+    return NULL;
+
+  atlas_copy(&atlas_pages[page], x, y, opaque, 4, 1, 4, 4);
+  atlas_solid.ag_width = atlas_solid.ag_height = 4;
+  atlas_solid.ag_x = x;
+  atlas_solid.ag_y = y;
+  atlas_solid.ag_page = page;
+  return &atlas_solid;
+}
+
+
+/**
+ * Returns a copy of the atlas page if it has been modified since
+ * '*version' (which is updated), NULL if not modified. '*evicted' is
+ * set to the version when the page was last evicted. Text that needs
+ * an older version of the page must be rendered again
+ */
+struct pixmap *
+text_atlas_get_page(int page, int *version, int *evicted)
+{
+  pixmap_t *pm = NULL;
+  hts_mutex_lock(&text_mutex);
+
+  atlas_page_t *ap = &atlas_pages[page];
+  if(ap->ap_pm != NULL && ap->ap_version != *version) {
+    pm = pixmap_create(TEXT_ATLAS_SIZE, TEXT_ATLAS_SIZE, PIXMAP_IA, 0);
+    if(pm != NULL) {
+      memcpy(pm->pm_data, ap->ap_pm->pm_data,
+             pm->pm_linesize * TEXT_ATLAS_SIZE);
+      *version = ap->ap_version;
+    }
+  }
+  *evicted = ap->ap_evicted;
+  hts_mutex_unlock(&text_mutex);
+  return pm;
+}
+
+
+/**
+ * Mark pages (bitmask) as used by text that is drawn
+ */
+void
+text_atlas_touch(int pages)
+{
+  const int64_t now = arch_get_ts();
+
+  hts_mutex_lock(&text_mutex);
+  for(int i = 0; i < TEXT_ATLAS_PAGES; i++)
+    if(pages & (1 << i))
+      atlas_pages[i].ap_last_use = now;
+  hts_mutex_unlock(&text_mutex);
+}
+
+
+/**
+ *
+ */
+void
+text_get_stats(text_stats_t *ts)
+{
+  hts_mutex_lock(&text_mutex);
+  *ts = text_stats;
+  hts_mutex_unlock(&text_mutex);
+}
+
+
 /**
  *
  */
 static void
 draw_glyph(pixmap_t *pm, int left, int top, FT_Bitmap *bmp, int color)
 {
+  text_stats.ts_glyph_draws++;
   pixmap_t src;
   src.pm_type = PIXMAP_I;
   src.pm_data = bmp->buffer;
@@ -721,6 +1160,74 @@ typedef struct item {
 } item_t;
 
 
+/**
+ * Output of TR_RENDER_GLYPHS
+ */
+typedef struct glyph_run {
+  image_glyph_t *glyphs;
+  int count;
+  int capacity;
+  int width;   // Of image, including margin
+} glyph_run_t;
+
+
+/**
+ *
+ */
+static image_glyph_t *
+glyph_run_add(glyph_run_t *run, const atlas_glyph_t *ag, uint32_t color)
+{
+  if(run->count == run->capacity) {
+    run->capacity = MAX(run->capacity * 2, 32);
+    run->glyphs = realloc(run->glyphs, run->capacity * sizeof(image_glyph_t));
+  }
+  image_glyph_t *ig = &run->glyphs[run->count++];
+  ig->ig_width    = ig->ig_s_width  = ag->ag_width;
+  ig->ig_height   = ig->ig_t_height = ag->ag_height;
+  ig->ig_s        = ag->ag_x;
+  ig->ig_t        = ag->ag_y;
+  ig->ig_page     = ag->ag_page;
+  ig->ig_color    = color;
+  return ig;
+}
+
+
+/**
+ *
+ */
+static void
+glyph_run_add_at(glyph_run_t *run, const atlas_glyph_t *ag,
+                 int x, int y, uint32_t color)
+{
+  if(ag->ag_width == 0)
+    return;
+  image_glyph_t *ig = glyph_run_add(run, ag, color);
+  ig->ig_x = x;
+  ig->ig_y = y;
+}
+
+
+/**
+ * Horizontal line, one pixel high, across the entire image
+ */
+static void
+glyph_run_add_rule(glyph_run_t *run, int y, uint32_t color)
+{
+  const atlas_glyph_t *ag = atlas_solid_get();
+  if(ag == NULL)
+    return;
+  image_glyph_t *ig = glyph_run_add(run, ag, color);
+  // Sample the center of the block so filtering does not fade the edges
+  ig->ig_s++;
+  ig->ig_t++;
+  ig->ig_s_width = ig->ig_t_height = 2;
+  ig->ig_x = 0;
+  ig->ig_y = y;
+  ig->ig_width = run->width;
+  ig->ig_height = 1;
+}
+
+
 static const float legacy_size_mult[16] = {
   0,
   0.5,
@@ -737,7 +1244,8 @@ static const float legacy_size_mult[16] = {
  *
  */
 static void
-draw_glyphs(pixmap_t *pm, struct line_queue *lq, int target_height,
+draw_glyphs(pixmap_t *pm, glyph_run_t *run,
+            struct line_queue *lq, int target_height,
 	    int siz_x, item_t *items, int start_x, int start_y,
 	    int origin_y, int margin, int pass,
             image_component_text_info_t *ti)
@@ -760,6 +1268,15 @@ draw_glyphs(pixmap_t *pm, struct line_queue *lq, int target_height,
       ypos = ypos >> 6;
       ypos = MIN(target_height, MAX(0, ypos));
 
+      if(run != NULL) {
+        if(pass == 2) {
+          const uint32_t c = li->color;
+          glyph_run_add_rule(run, ypos, c);
+          glyph_run_add_rule(run, ypos + 1,
+                             (c & 0xff000000) | ((c >> 1) & 0x7f7f7f));
+        }
+        continue;
+      }
 
       switch(pm->pm_type) {
       case PIXMAP_BGR32:
@@ -846,61 +1363,81 @@ draw_glyphs(pixmap_t *pm, struct line_queue *lq, int target_height,
       pen.x >>= 6;
       pen.y >>= 6;
 
-
-
-      if(items[i].outline > 0 && (g->outline == NULL ||
-				  g->outline_amt != items[i].outline)) {
-	if(g->outline)
-	  FT_Done_Glyph(g->outline);
-
-	g->outline = g->orig_glyph;
-	FT_Stroker_Set(text_stroker,
-		       items[i].outline,
-		       FT_STROKER_LINECAP_ROUND,
-		       FT_STROKER_LINEJOIN_ROUND,
-		       0);
-	g->outline_amt = items[i].outline;
-	if(FT_Glyph_StrokeBorder(&g->outline, text_stroker, 0, 0))
-	  g->outline = NULL;
-	else if(FT_Glyph_To_Bitmap(&g->outline, FT_RENDER_MODE_NORMAL, NULL, 1))
-	  g->outline = NULL;
-      }
-
-      if(g->bmp == NULL) {
-	g->bmp = g->orig_glyph;
-	if(FT_Glyph_To_Bitmap(&g->bmp, FT_RENDER_MODE_NORMAL, NULL, 0))
-	  g->bmp = NULL;
-      }
-      if(pass == 0 && items[i].shadow && (g->outline != NULL || g->bmp != NULL)) {
-	FT_BitmapGlyph bmp = (FT_BitmapGlyph)(g->outline ?: g->bmp);
-	draw_glyph(pm,
-		   bmp->left + items[i].shadow + margin + pen.x,
-		   target_height - bmp->top + items[i].shadow + margin - pen.y,
-		   &bmp->bitmap,
-		   items[i].shadow_color);
-      }
-
-      if(pass == 1 && items[i].outline > 0 && g->outline != NULL) {
-	FT_BitmapGlyph bmp = (FT_BitmapGlyph)g->outline;
-	draw_glyph(pm,
-		   bmp->left + margin + pen.x,
-		   target_height - bmp->top + margin - pen.y,
-		   &bmp->bitmap,
-		   items[i].outline_color);
-      }
-
-      if(pass == 2 && g->bmp != NULL) {
-	FT_BitmapGlyph bmp = (FT_BitmapGlyph)g->bmp;
-	draw_glyph(pm,
-		   bmp->left + margin + pen.x,
-		   target_height - bmp->top + margin - pen.y,
-		   &bmp->bitmap,
-		   items[i].color);
-
-	if(ti != NULL && ti->ti_charpos != NULL) {
-	  ti->ti_charpos[i * 2 + 0] = bmp->left + pen.x;
-	  ti->ti_charpos[i * 2 + 1] = bmp->left + bmp->bitmap.width + pen.x;
-	}
+      if(run != NULL) {
+        const atlas_glyph_t *ag;
+
+        if(pass == 0 && items[i].shadow) {
+          ag = atlas_glyph_get(g, ATLAS_GLYPH_SHADOW, items[i].outline);
+          if(ag != NULL)
+            glyph_run_add_at(run, ag,
+                             ag->ag_left + items[i].shadow + margin + pen.x,
+                             target_height - ag->ag_top + items[i].shadow +
+                             margin - pen.y,
+                             items[i].shadow_color);
+        }
+
+        if(pass == 1 && items[i].outline > 0) {
+          ag = atlas_glyph_get(g, ATLAS_GLYPH_OUTLINE, items[i].outline);
+          if(ag != NULL)
+            glyph_run_add_at(run, ag,
+                             ag->ag_left + margin + pen.x,
+                             target_height - ag->ag_top + margin - pen.y,
+                             items[i].outline_color);
+        }
+
+        if(pass == 2 &&
+           (ag = atlas_glyph_get(g, ATLAS_GLYPH_FILL, 0)) != NULL) {
+          glyph_run_add_at(run, ag,
+                           ag->ag_left + margin + pen.x,
+                           target_height - ag->ag_top + margin - pen.y,
+                           items[i].color);
+
+          if(ti != NULL && ti->ti_charpos != NULL) {
+            ti->ti_charpos[i * 2 + 0] = ag->ag_left + pen.x;
+            ti->ti_charpos[i * 2 + 1] = ag->ag_left + ag->ag_width + pen.x;
+          }
+        }
+
+      } else {
+
+        if(items[i].outline > 0)
+          glyph_outline_bitmap(g, items[i].outline);
+
+        glyph_bitmap(g);
+
+        if(pass == 0 && items[i].shadow &&
+           (g->outline != NULL || g->bmp != NULL)) {
+          FT_BitmapGlyph bmp = (FT_BitmapGlyph)(g->outline ?: g->bmp);
+          draw_glyph(pm,
+                     bmp->left + items[i].shadow + margin + pen.x,
+                     target_height - bmp->top + items[i].shadow + margin -
+                     pen.y,
+                     &bmp->bitmap,
+                     items[i].shadow_color);
+        }
+
+        if(pass == 1 && items[i].outline > 0 && g->outline != NULL) {
+          FT_BitmapGlyph bmp = (FT_BitmapGlyph)g->outline;
+          draw_glyph(pm,
+                     bmp->left + margin + pen.x,
+                     target_height - bmp->top + margin - pen.y,
+                     &bmp->bitmap,
+                     items[i].outline_color);
+        }
+
+        if(pass == 2 && g->bmp != NULL) {
+          FT_BitmapGlyph bmp = (FT_BitmapGlyph)g->bmp;
+          draw_glyph(pm,
+                     bmp->left + margin + pen.x,
+                     target_height - bmp->top + margin - pen.y,
+                     &bmp->bitmap,
+                     items[i].color);
+
+          if(ti != NULL && ti->ti_charpos != NULL) {
+            ti->ti_charpos[i * 2 + 0] = bmp->left + pen.x;
+            ti->ti_charpos[i * 2 + 1] = bmp->left + bmp->bitmap.width + pen.x;
+          }
+        }
       }
 
       if(ti != NULL && ti->ti_charpos != NULL && items[i].code == ' ')
@@ -1401,15 +1938,6 @@ text_render0(const uint32_t *uc, const int len,
   img->im_height = target_height + margin * 2;
   img->im_margin = margin;
 
-  pixmap_t *pm = NULL;
-
-  if(!(flags & TR_RENDER_NO_OUTPUT)) {
-    pm = pixmap_create(target_width, target_height,
-                       color_output ? PIXMAP_BGR32 : PIXMAP_IA, margin);
-
-    img->im_components[1].type = IMAGE_PIXMAP;
-    img->im_components[1].pm = pm;
-  }
   image_component_text_info_t *ti = &img->im_components[0].text_info;
   img->im_components[0].type = IMAGE_TEXT_INFO;
 
@@ -1422,6 +1950,59 @@ text_render0(const uint32_t *uc, const int len,
     ti->ti_charpos = malloc(2 * len * sizeof(int));
   }
 
+  if(!(flags & TR_RENDER_NO_OUTPUT))
+    text_stats.ts_renders++;
+
+  if(!(flags & TR_RENDER_NO_OUTPUT) &&
+     (flags & (TR_RENDER_GLYPHS | TR_RENDER_DEBUG)) == TR_RENDER_GLYPHS) {
+
+    glyph_run_t run = {.width = img->im_width};
+
+    /* Pages used by this text are never evicted while we emit glyphs
+       (see atlas_evict()). If a glyph does not fit the text is rendered
+       to a pixmap instead */
+
+    atlas_now = arch_get_ts();
+    atlas_full = 0;
+
+    if(need_shadow_pass)
+      draw_glyphs(NULL, &run, &lq, target_height, siz_x, items,
+                  start_x, start_y, origin_y, margin, 0, NULL);
+
+    if(need_outline_pass)
+      draw_glyphs(NULL, &run, &lq, target_height, siz_x, items,
+                  start_x, start_y, origin_y, margin, 1, NULL);
+
+    draw_glyphs(NULL, &run, &lq, target_height, siz_x, items,
+                start_x, start_y, origin_y, margin, 2, ti);
+
+    if(!atlas_full) {
+      image_component_glyphs_t *icg = &img->im_components[1].glyphs;
+      img->im_components[1].type = IMAGE_GLYPHS;
+      icg->icg_glyphs = run.glyphs;
+      icg->icg_count = run.count;
+      memset(icg->icg_page_version, 0, sizeof(icg->icg_page_version));
+      for(i = 0; i < run.count; i++)
+        icg->icg_page_version[run.glyphs[i].ig_page] =
+          atlas_pages[run.glyphs[i].ig_page].ap_version;
+      run.glyphs = NULL;
+    } else {
+      text_stats.ts_atlas_fallbacks++;
+    }
+    free(run.glyphs);
+  }
+
+  pixmap_t *pm = NULL;
+
+  if(!(flags & TR_RENDER_NO_OUTPUT) &&
+     img->im_components[1].type == IMAGE_component_none) {
+    pm = pixmap_create(target_width, target_height,
+                       color_output ? PIXMAP_BGR32 : PIXMAP_IA, margin);
+
+    img->im_components[1].type = IMAGE_PIXMAP;
+    img->im_components[1].pm = pm;
+  }
+
   if(pm != NULL) {
 
     if(flags & TR_RENDER_DEBUG) {
@@ -1437,18 +2018,18 @@ text_render0(const uint32_t *uc, const int len,
     }
 
     if(need_shadow_pass) {
-      draw_glyphs(pm, &lq, target_height, siz_x, items, start_x, start_y,
-                  origin_y, margin, 0, NULL);
+      draw_glyphs(pm, NULL, &lq, target_height, siz_x, items,
+                  start_x, start_y, origin_y, margin, 0, NULL);
       pixmap_box_blur(pm, 4, 4);
     }
 
     if(need_outline_pass)
-      draw_glyphs(pm, &lq, target_height, siz_x, items, start_x, start_y,
-                  origin_y, margin, 1, NULL);
+      draw_glyphs(pm, NULL, &lq, target_height, siz_x, items,
+                  start_x, start_y, origin_y, margin, 1, NULL);
 
 
-    draw_glyphs(pm, &lq, target_height, siz_x, items, start_x, start_y,
-                origin_y, margin, 2, ti);
+    draw_glyphs(pm, NULL, &lq, target_height, siz_x, items,
+                start_x, start_y, origin_y, margin, 2, ti);
   }
   free(items);
 
@@ -74,6 +74,7 @@ struct prop;
 #define TR_RENDER_OUTLINE       0x40
 #define TR_RENDER_NO_OUTPUT     0x80
 #define TR_RENDER_SUBS          0x100  // Render for subtitles
+#define TR_RENDER_GLYPHS        0x200  // Output IMAGE_GLYPHS (if possible)
 
 #define TR_ALIGN_AUTO      0
 #define TR_ALIGN_LEFT      1
@@ -88,6 +89,32 @@ text_render(const uint32_t *uc, int len, int flags, int default_size,
 	    int font_domain, int min_size);
 
 
+/**
+ * Shared glyph atlas used for TR_RENDER_GLYPHS. Each glyph is
+ * rasterized once (per size, style, outline and shadow) into one of
+ * the pages. When all pages are full the least recently used page is
+ * evicted, text using an evicted page must be rendered again. Pages
+ * that are drawn (see text_atlas_touch()) are not evicted, text that
+ * does not fit is rendered to a pixmap instead
+ */
+#define TEXT_ATLAS_SIZE  512
+#define TEXT_ATLAS_PAGES 8
+
+struct pixmap *text_atlas_get_page(int page, int *version, int *evicted);
+
+void text_atlas_touch(int pages);
+
+typedef struct text_stats {
+  int ts_renders;               // Texts rendered (excluding dimensioning)
+  int ts_glyph_draws;           // Glyphs composited into text pixmaps
+  int ts_atlas_rasterizations;  // Glyphs rasterized into the atlas
+  int ts_atlas_evictions;       // Atlas pages cleared to make room
+  int ts_atlas_fallbacks;       // Texts rendered to pixmaps, atlas full
+} text_stats_t;
+
+void text_get_stats(text_stats_t *ts);
+
+
 #if ENABLE_LIBFREETYPE
 
 struct fa_handle;
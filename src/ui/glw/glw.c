@@ -222,6 +222,10 @@ glw_init4(glw_root_t *gr,
   gr->gr_prop_dispatcher = dispatcher;
   gr->gr_courier = courier;
   gr->gr_init_flags = flags;
+
+  // Views only care about the latest value of a property, no need to
+  // replay every update to progress bars, timers, etc
+  prop_courier_set_flags(courier, PROP_COURIER_COALESCE);
   gr->gr_prop_maxtime = -1;
 
   assert(glw_settings.gs_settings != NULL);
@@ -471,8 +475,16 @@ glw_layout0(glw_t *w, const glw_rctx_t *rc)
     mask |= GLW_VIEW_EVAL_ACTIVE;
   }
 
-  if(unlikely(w->glw_dynamic_eval & mask))
-    glw_view_eval_layout(w, rc, mask);
+  if(unlikely(w->glw_dynamic_eval & mask)) {
+    if(unlikely(gr->gr_bench != NULL)) {
+      const int64_t ts = arch_get_ts();
+      glw_view_eval_layout(w, rc, mask);
+      gr->gr_bench->gbs_eval_time += arch_get_ts() - ts;
+      gr->gr_bench->gbs_eval_calls++;
+    } else {
+      glw_view_eval_layout(w, rc, mask);
+    }
+  }
 
   if(unlikely(w->glw_flags & GLW_HAVE_MARGINS)) {
     glw_rctx_t rc0 = *rc;
@@ -699,6 +711,8 @@ glw_prepare_frame(glw_root_t *gr, int flags)
   gr->gr_vertex_offset = 0;
   gr->gr_index_offset = 0;
 
+  glw_text_atlas_update(gr);
+
   prop_set_int(gr->gr_screensaver_active, glw_screensaver_is_active(gr));
   prop_set_int(gr->gr_prop_width, gr->gr_width);
   prop_set_int(gr->gr_prop_height, gr->gr_height);
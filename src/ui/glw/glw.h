@@ -36,6 +36,7 @@
 #include "main.h"
 #include "settings.h"
 #include "misc/minmax.h"
+#include "text/text.h"
 
 #ifdef DEBUG
 #define GLW_TRACE(x, ...) do {                                     \
@@ -109,6 +110,8 @@ typedef struct glw_rect {
 #include "glw_gx.h"
 #elif CONFIG_GLW_BACKEND_RSX
 #include "glw_rsx.h"
+#elif CONFIG_GLW_BACKEND_HEADLESS
+#include "glw_headless.h"
 #else
 #error No backend for glw
 #endif
@@ -389,11 +392,43 @@ typedef enum {
    */
   GLW_SIGNAL_WRAP_CHECK,
 
+  /**
+   * Sent to a widget before focus may be moved to it. Items of windowed
+   * cloners that are not instantiated yet are instantiated.
+   * If extra is not NULL (int *) the cloner also creates all items it
+   * has deferred after the widget and sets it to 1 if there were any
+   */
+  GLW_SIGNAL_MATERIALIZE,
+
+  /**
+   * Sent by lists and arrays to themselves during layout. Cloners that
+   * have deferred items (not created any widget for them yet) add them
+   * to extra (glw_deferred_childs_t *)
+   */
+  GLW_SIGNAL_DEFERRED_CHILDS,
+
+  /**
+   * Sent by lists and arrays to themselves when their layout reaches
+   * beyond the last child while there are deferred childs.
+   * extra is (int *) number of childs wanted
+   */
+  GLW_SIGNAL_WANT_DEFERRED_CHILDS,
+
   GLW_SIGNAL_num,
 
 } glw_signal_t;
 
 
+/**
+ * See GLW_SIGNAL_DEFERRED_CHILDS
+ */
+typedef struct glw_deferred_childs {
+  int count;
+  int width;   // Estimated size of each child, 0 if not known
+  int height;
+} glw_deferred_childs_t;
+
+
 typedef struct {
   float knob_size;
   float position;
@@ -773,6 +808,35 @@ const glw_class_t *glw_class_find_by_name(const char *name);
 
 typedef struct glw_program glw_program_t;
 
+/**
+ * Accounting and switches for the headless benchmark (glw-frame),
+ * see gr_bench
+ */
+typedef struct glw_bench_stats {
+  // Time spent in glw_view_eval_layout(), number of dynamic
+  // expressions evaluated (and temporary tokens they had to take from
+  // gr_token_pool) and time spent instantiating cloner items and
+  // loaded views
+  int gbs_eval_calls;
+  int gbs_eval_rpns;
+  int gbs_eval_pool_tokens;
+  int64_t gbs_eval_time;
+  int gbs_clone_calls;
+  int64_t gbs_clone_time;
+  int gbs_view_calls;
+  int64_t gbs_view_time;
+
+  int gbs_text_uploads;  // Text textures uploaded
+
+  // Make all cloners in lists and arrays windowed, see
+  // GLW2_WINDOWED_CLONING
+  int gbs_windowed_cloning;
+
+  // Don't compile dynamic expressions, see glw_view_exec_rpn()
+  int gbs_eval_treewalk;
+} glw_bench_stats_t;
+
+
 /**
  * GLW root context
  */
@@ -799,6 +863,9 @@ typedef struct glw_root {
   int gr_gem_id_tally;
   int gr_frames;
 
+  // Only set while the headless benchmark runs
+  struct glw_bench_stats *gr_bench;
+
   int gr_init_flags;
   struct glw *gr_universe;
 
@@ -885,6 +952,12 @@ typedef struct glw_root {
   rstr_t *gr_default_font;
   int gr_font_domain;
 
+  // Textures for the shared glyph atlas (see text_atlas_get_page())
+  glw_backend_texture_t gr_text_atlas[TEXT_ATLAS_PAGES];
+  int gr_text_atlas_version[TEXT_ATLAS_PAGES];  // Version in the texture
+  int gr_text_atlas_evicted[TEXT_ATLAS_PAGES];
+  int gr_text_atlas_used;  // Pages drawn during the frame (bitmask)
+
   /**
    * Image/Texture loader
    */
@@ -1263,6 +1336,9 @@ typedef struct glw {
 #define GLW2_FHP_SPILL              0x4000000
 #define GLW2_SELECT_ON_FOCUS        0x8000000
 #define GLW2_SELECT_ON_HOVER        0x10000000
+#define GLW2_WINDOWED_CLONING       0x20000000 /* Cloner only evaluates items
+                                                  close to the visible
+                                                  range */
 
   float glw_alpha;                   /* Alpha set by user */
   float glw_sharpness;               /* 1-Blur set by user */
@@ -282,6 +282,11 @@ glw_array_layout(glw_t *w, const glw_rctx_t *rc)
   ypos += grid_layout_row(a, &rc0, rowvector, &column,
                           &req_row_height, height);
 
+  ypos = glw_scroll_deferred_childs(&a->gsc, w, ypos + a->yspacing,
+                                    height * 2, a->xentries,
+                                    a->child_height_px, a->yspacing, 1) -
+    a->yspacing;
+
   if(a->gsc.total_size != ypos) {
     a->gsc.total_size = ypos;
     a->w.glw_flags |= GLW_UPDATE_METRICS;
@@ -572,16 +577,20 @@ glw_array_get_next_row(glw_t *c, int reverse)
     current_col = 0;
   if(reverse) {
     while((c = glw_get_prev_n(c, 1)) != NULL) {
-      if((glw_parent_data(c, glw_array_item_t)->col == current_col ||
-          c->glw_flags & GLW_CONSTRAINT_D) &&
-         glw_get_focusable_child(c))
-	return c;
+      if(glw_parent_data(c, glw_array_item_t)->col == current_col ||
+         c->glw_flags & GLW_CONSTRAINT_D) {
+        glw_signal0(c, GLW_SIGNAL_MATERIALIZE, NULL);
+        if(glw_get_focusable_child(c))
+          return c;
+      }
     }
   } else {
     while((c = glw_get_next_n(c, 1)) != NULL) {
-      if(glw_parent_data(c, glw_array_item_t)->col == current_col &&
-         glw_get_focusable_child(c))
-	return c;
+      if(glw_parent_data(c, glw_array_item_t)->col == current_col) {
+        glw_signal0(c, GLW_SIGNAL_MATERIALIZE, NULL);
+        if(glw_get_focusable_child(c))
+          return c;
+      }
     }
   }
 
@@ -718,6 +727,8 @@ glw_array_find_visible_child(glw_t *w)
     while(c != NULL && glw_parent_data(c, glw_array_item_t)->pos_y < top)
       c = glw_next_widget(c);
 
+    if(c != NULL)
+      glw_signal0(c, GLW_SIGNAL_MATERIALIZE, NULL);
     if(c != NULL && glw_get_focusable_child(c) == NULL)
       c = glw_next_widget(c);
 
@@ -726,6 +737,8 @@ glw_array_find_visible_child(glw_t *w)
     while(c != NULL && glw_parent_data(c, glw_array_item_t)->pos_y > bottom)
       c = glw_prev_widget(c);
 
+    if(c != NULL)
+      glw_signal0(c, GLW_SIGNAL_MATERIALIZE, NULL);
     if(c != NULL && glw_get_focusable_child(c) == NULL)
       c = glw_prev_widget(c);
 
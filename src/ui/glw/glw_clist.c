@@ -124,6 +124,13 @@ glw_clist_layout(glw_t *w, const glw_rctx_t *rc)
       continue;
     rc0.rc_height = cd->height2;
 
+    // With windowed cloning only keep items within a few pages of
+    // the visible area active
+    if(w->glw_flags2 & GLW2_WINDOWED_CLONING &&
+       (cd->pos + cd->height < -rc->rc_height ||
+        cd->pos > rc->rc_height * 2))
+      continue;
+
     glw_layout0(c, &rc0);
   }
 }
@@ -0,0 +1,757 @@
+/*
+ *  Copyright (C) 2007-2015 Lonelycoder AB
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  This program is also available under a commercial proprietary license.
+ *  For more information, contact andreas@lonelycoder.com
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "main.h"
+#include "arch/arch.h"
+#include "glw.h"
+#include "glw_renderer.h"
+#include "glw_texture.h"
+#include "navigator.h"
+#include "event.h"
+#include "backend/backend_prop.h"
+
+#include "arch/linux/linux.h"
+
+#define HEADLESS_WIDTH  1280
+#define HEADLESS_HEIGHT 720
+
+/**
+ * Backend
+ */
+
+/**
+ * Nothing is drawn, just count what would have been sent to the GPU
+ */
+static void
+headless_render_unlocked(glw_root_t *gr)
+{
+  glw_backend_root_t *gbr = &gr->gr_be;
+  const struct glw_backend_texture *t0 = NULL;
+  int blendmode = GLW_BLEND_NORMAL;
+  int frontface = GLW_CCW;
+
+  memset(gbr, 0, sizeof(glw_backend_root_t));
+
+  for(int j = 0; j < gr->gr_num_render_jobs; j++) {
+    const glw_render_order_t *ro = gr->gr_render_order + j;
+    const glw_render_job_t *rj = ro->job;
+
+    if(unlikely(rj->num_vertices == 0))
+      continue;
+
+    gbr->gbr_jobs++;
+    gbr->gbr_vertices += rj->num_vertices;
+    gbr->gbr_triangles += (rj->num_indices ?: rj->num_vertices) / 3;
+
+    if(rj->t0 != t0) {
+      t0 = rj->t0;
+      gbr->gbr_texture_switches++;
+    }
+
+    if(rj->blendmode != blendmode || rj->frontface != frontface) {
+      blendmode = rj->blendmode;
+      frontface = rj->frontface;
+      gbr->gbr_state_switches++;
+    }
+  }
+}
+
+
+/**
+ *
+ */
+int
+glw_headless_init_context(glw_root_t *gr)
+{
+  gr->gr_be_render_unlocked = headless_render_unlocked;
+  return 0;
+}
+
+
+/**
+ *
+ */
+void
+glw_rtt_init(glw_root_t *gr, glw_rtt_t *grtt, int width, int height,
+	     int alpha)
+{
+  grtt->grtt_width  = width;
+  grtt->grtt_height = height;
+  grtt->grtt_texture.width  = width;
+  grtt->grtt_texture.height = height;
+  grtt->grtt_texture.opaque = !alpha;
+  grtt->grtt_texture.inited = 1;
+}
+
+
+/**
+ *
+ */
+void
+glw_rtt_enter(glw_root_t *gr, glw_rtt_t *grtt, glw_rctx_t *rc)
+{
+  glw_rctx_init(rc, grtt->grtt_width, grtt->grtt_height, 0, NULL);
+}
+
+
+/**
+ *
+ */
+void
+glw_rtt_restore(glw_root_t *gr, glw_rtt_t *grtt)
+{
+}
+
+
+/**
+ *
+ */
+void
+glw_rtt_destroy(glw_root_t *gr, glw_rtt_t *grtt)
+{
+  grtt->grtt_texture.inited = 0;
+}
+
+
+/**
+ * Custom shaders are not supported
+ */
+struct glw_program *
+glw_make_program(struct glw_root *gr,
+		 const char *vertex_shader,
+		 const char *fragment_shader)
+{
+  return NULL;
+}
+
+void
+glw_destroy_program(struct glw_root *gr, struct glw_program *gp)
+{
+}
+
+
+/**
+ * Free texture (always invoked in main rendering thread)
+ */
+void
+glw_tex_backend_free_render_resources(glw_root_t *gr,
+				      glw_loadable_texture_t *glt)
+{
+  glt->glt_texture.inited = 0;
+}
+
+
+/**
+ * Free resources created by glw_tex_backend_load()
+ */
+void
+glw_tex_backend_free_loader_resources(glw_loadable_texture_t *glt)
+{
+  if(glt->glt_pixmap != NULL) {
+    pixmap_release(glt->glt_pixmap);
+    glt->glt_pixmap = NULL;
+  }
+}
+
+
+/**
+ * Invoked on every frame when status == VALID
+ */
+void
+glw_tex_backend_layout(glw_root_t *gr, glw_loadable_texture_t *glt)
+{
+  if(glt->glt_pixmap == NULL)
+    return;
+
+  glt->glt_texture.width  = glt->glt_xs;
+  glt->glt_texture.height = glt->glt_ys;
+  glt->glt_texture.opaque = glt->glt_opaque;
+  glt->glt_texture.inited = 1;
+
+  if(glt->glt_tex_width && glt->glt_tex_height) {
+    glt->glt_s = (float)glt->glt_xs / (float)glt->glt_tex_width;
+    glt->glt_t = (float)glt->glt_ys / (float)glt->glt_tex_height;
+  } else {
+    glt->glt_s = 1;
+    glt->glt_t = 1;
+  }
+
+  glw_tex_backend_free_loader_resources(glt);
+}
+
+
+/**
+ *
+ */
+int
+glw_tex_backend_load(glw_root_t *gr, glw_loadable_texture_t *glt, pixmap_t *pm)
+{
+  int size;
+
+  switch(pm->pm_type) {
+  default:
+    return 0;
+
+  case PIXMAP_RGB24:
+  case PIXMAP_BGR32:
+  case PIXMAP_RGBA:
+  case PIXMAP_BGRA:
+    size = pm->pm_width * pm->pm_height * 4;
+    break;
+
+  case PIXMAP_IA:
+    size = pm->pm_width * pm->pm_height * 2;
+    break;
+
+  case PIXMAP_I:
+    size = pm->pm_width * pm->pm_height;
+    break;
+  }
+
+  if(glt->glt_pixmap != NULL)
+    pixmap_release(glt->glt_pixmap);
+
+  glt->glt_pixmap = pixmap_dup(pm);
+
+  return size;
+}
+
+
+/**
+ *
+ */
+void
+glw_tex_upload(glw_root_t *gr, glw_backend_texture_t *tex,
+	       const pixmap_t *pm, int flags)
+{
+  tex->width  = pm->pm_width;
+  tex->height = pm->pm_height;
+  tex->opaque = !!(pm->pm_flags & PIXMAP_OPAQUE);
+  tex->inited = 1;
+}
+
+
+/**
+ *
+ */
+void
+glw_tex_destroy(glw_root_t *gr, glw_backend_texture_t *tex)
+{
+  tex->inited = 0;
+}
+
+
+/**
+ * Frontend
+ */
+
+typedef enum {
+  HEADLESS_PHASE_PREPARE,
+  HEADLESS_PHASE_LAYOUT,
+  HEADLESS_PHASE_EVAL,     // Part of HEADLESS_PHASE_LAYOUT
+  HEADLESS_PHASE_RENDER,
+  HEADLESS_PHASE_SUBMIT,
+  HEADLESS_PHASE_TOTAL,
+  HEADLESS_PHASE_num,
+} headless_phase_t;
+
+static const char *headless_phase_names[HEADLESS_PHASE_num] = {
+  [HEADLESS_PHASE_PREPARE] = "prepare",
+  [HEADLESS_PHASE_LAYOUT]  = "layout",
+  [HEADLESS_PHASE_EVAL]    = "  eval",
+  [HEADLESS_PHASE_RENDER]  = "render",
+  [HEADLESS_PHASE_SUBMIT]  = "submit",
+  [HEADLESS_PHASE_TOTAL]   = "total",
+};
+
+
+typedef struct glw_headless {
+  glw_root_t gr;
+  hts_thread_t thread;
+  int running;
+} glw_headless_t;
+
+
+/**
+ * Run one frame. If 'phases' is not NULL the time spent (in µs) in
+ * each phase is stored there
+ */
+static void
+headless_frame(glw_root_t *gr, int flags, int always_refresh,
+               int64_t *phases)
+{
+  int64_t ts[5];
+  glw_rctx_t rc;
+  int zmax = 0;
+
+  glw_lock(gr);
+
+  if(always_refresh)
+    gr->gr_need_refresh = GLW_REFRESH_FLAG_LAYOUT | GLW_REFRESH_FLAG_RENDER;
+
+  if(gr->gr_bench != NULL)
+    gr->gr_bench->gbs_eval_time = 0;
+
+  ts[0] = arch_get_ts();
+  glw_prepare_frame(gr, flags);
+  ts[1] = ts[2] = ts[3] = arch_get_ts();
+
+  const int refresh = gr->gr_need_refresh;
+  gr->gr_need_refresh = 0;
+
+  if(refresh) {
+    glw_rctx_init(&rc, gr->gr_width, gr->gr_height, 1, &zmax);
+    glw_layout0(gr->gr_universe, &rc);
+    ts[2] = arch_get_ts();
+
+    if(refresh & GLW_REFRESH_FLAG_RENDER)
+      glw_render0(gr->gr_universe, &rc);
+    ts[3] = arch_get_ts();
+  }
+  glw_unlock(gr);
+
+  if(refresh & GLW_REFRESH_FLAG_RENDER)
+    glw_post_scene(gr);
+  ts[4] = arch_get_ts();
+
+  if(phases == NULL)
+    return;
+
+  phases[HEADLESS_PHASE_PREPARE] = ts[1] - ts[0];
+  phases[HEADLESS_PHASE_LAYOUT]  = ts[2] - ts[1];
+  phases[HEADLESS_PHASE_EVAL]    = gr->gr_bench->gbs_eval_time;
+  phases[HEADLESS_PHASE_RENDER]  = ts[3] - ts[2];
+  phases[HEADLESS_PHASE_SUBMIT]  = ts[4] - ts[3];
+  phases[HEADLESS_PHASE_TOTAL]   = ts[4] - ts[0];
+}
+
+
+/**
+ * Create a root with the universe loaded
+ */
+static glw_root_t *
+headless_root_create(glw_root_t *gr, prop_t *nav, int width, int height)
+{
+  gr->gr_prop_ui = prop_create_root("ui");
+  gr->gr_prop_nav = nav ?: nav_spawn();
+  gr->gr_width  = width;
+  gr->gr_height = height;
+
+  if(glw_init(gr))
+    return NULL;
+
+  glw_headless_init_context(gr);
+
+  glw_lock(gr);
+  glw_load_universe(gr);
+  glw_unlock(gr);
+  return gr;
+}
+
+
+/**
+ *
+ */
+static void
+headless_root_destroy(glw_root_t *gr)
+{
+  glw_lock(gr);
+  glw_unload_universe(gr);
+  glw_unlock(gr);
+  glw_reap(gr);
+  glw_reap(gr);
+  glw_fini(gr);
+}
+
+
+/**
+ * Render at 60Hz. This is mostly useful for attaching a profiler to
+ */
+static void *
+glw_headless_thread(void *aux)
+{
+  glw_headless_t *gh = aux;
+  glw_root_t *gr = &gh->gr;
+  struct timespec req;
+  int64_t start = arch_get_ts();
+  int frame = 0;
+
+  if(headless_root_create(gr, gr->gr_prop_nav,
+                          HEADLESS_WIDTH, HEADLESS_HEIGHT) == NULL)
+    return NULL;
+
+  TRACE(TRACE_INFO, "GLW", "Headless frontend running %dx%d",
+        gr->gr_width, gr->gr_height);
+
+  while(gh->running) {
+    headless_frame(gr, 0, 0, NULL);
+
+    frame++;
+    const int64_t deadline = frame * 1000000LL / 60 + start;
+    req.tv_sec  =  deadline / 1000000;
+    req.tv_nsec = (deadline % 1000000) * 1000;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &req, NULL);
+  }
+
+  headless_root_destroy(gr);
+  return NULL;
+}
+
+
+/**
+ *
+ */
+static void *
+glw_headless_start(struct prop *nav)
+{
+  glw_headless_t *gh = calloc(1, sizeof(glw_headless_t));
+
+  gh->gr.gr_prop_nav = nav;
+  gh->running = 1;
+
+  hts_thread_create_joinable("glw", &gh->thread,
+			     glw_headless_thread, gh, 0);
+  return gh;
+}
+
+
+/**
+ *
+ */
+static prop_t *
+glw_headless_stop(void *aux)
+{
+  glw_headless_t *gh = aux;
+  glw_root_t *gr = &gh->gr;
+  prop_t *nav = gr->gr_prop_nav;
+  gh->running = 0;
+  hts_thread_join(&gh->thread);
+  prop_destroy(gr->gr_prop_ui);
+  glw_release_root(gr);
+  return nav;
+}
+
+
+const linux_ui_t ui_glw = {
+  .start = glw_headless_start,
+  .stop  = glw_headless_stop,
+};
+
+
+
+/**
+ * Benchmark
+ *
+ * Load the skin (as given by --skin, or the default one) and open a
+ * page backed by a synthetic directory model. Then replay a sequence
+ * of navigation actions, running a number of frames after each one,
+ * and report CPU time per frame split by phase.
+ *
+ * Everything is layouted and rendered on every frame and the frame
+ * rate is pinned to 60Hz so animations advance the same amount per
+ * frame regardless of how fast the machine is.
+ *
+ * Environment:
+ *   GLW_BENCH_SIZE    Resolution, default 1280x720
+ *   GLW_BENCH_ITEMS   Number of items in the model, default 500
+ *   GLW_BENCH_FRAMES  Frames to run after each action, default 6
+ *   GLW_BENCH_SCRIPT  Actions (as named in event.c), optionally
+ *                     repeated with '*', default is given below
+ *   GLW_BENCH_WINDOWED  If set to 1, cloners in lists and arrays only
+ *                     instantiate items close to the visible range
+ *   GLW_BENCH_ATLAS   If set to 1, text is drawn from the shared glyph
+ *                     atlas instead of one texture per text widget
+ *   GLW_BENCH_TREEWALK  If set to 1, dynamic expressions are evaluated
+ *                     by walking the tokens with temporaries from the
+ *                     token pool, as before they were compiled
+ *
+ * Scrolling a large model, windowed and not:
+ *
+ *   GLW_BENCH_ITEMS=100000 GLW_BENCH_SCRIPT="PageDown*100 PageUp*100"
+ *
+ * Text rasterizations and texture uploads for a scrolling list, with
+ * and without the glyph atlas:
+ *
+ *   GLW_BENCH_SCRIPT="Down*100 Up*100" GLW_BENCH_ATLAS=1
+ *
+ * Expression evaluation ("eval" phase, rpn/frame and ns/rpn), with
+ * and without compiled expressions:
+ *
+ *   GLW_BENCH_TREEWALK=1
+ */
+#define HEADLESS_BENCH_SCRIPT \
+  "Down*40 Right*10 PageDown*4 PageUp*4 Up*40 Left*10"
+
+#define HEADLESS_BENCH_WARMUP 240
+
+
+static int
+headless_bench_env(const char *name, int def)
+{
+  const char *s = getenv(name);
+  return s != NULL ? atoi(s) : def;
+}
+
+
+static int
+headless_bench_cmp(const void *A, const void *B)
+{
+  const int64_t a = *(const int64_t *)A;
+  const int64_t b = *(const int64_t *)B;
+  return a < b ? -1 : a > b;
+}
+
+
+/**
+ * Parse one "Action[*count]" from the script
+ */
+static const char *
+headless_bench_step(const char *s, char *action, int *count)
+{
+  int n = 0;
+
+  if(sscanf(s, " %63[^* ]%n", action, &n) != 1)
+    return NULL;
+  s += n;
+
+  n = 0;
+  *count = 1;
+  sscanf(s, "*%d%n", count, &n);
+  return s + n;
+}
+
+
+static prop_t *
+headless_bench_model(int items)
+{
+  static const char *types[] = {"video", "directory", "audio", "image"};
+  char title[64];
+  prop_t *model = prop_create_root(NULL);
+
+  prop_set(model, "type", PROP_SET_STRING, "directory");
+  prop_set(model, "loading", PROP_SET_INT, 0);
+  prop_setv(model, "metadata", "title", NULL,
+            PROP_SET_STRING, "GLW benchmark");
+
+  prop_t *nodes = prop_create(model, "nodes");
+
+  for(int i = 0; i < items; i++) {
+    prop_t *p = prop_create(nodes, NULL);
+    snprintf(title, sizeof(title), "Benchmark item %d", i);
+    prop_set(p, "type", PROP_SET_STRING, types[i & 3]);
+    prop_setv(p, "metadata", "title", NULL, PROP_SET_STRING, title);
+  }
+  return model;
+}
+
+
+/**
+ * Resident set size in kB
+ */
+static int
+headless_rss(void)
+{
+  long pages = 0;
+  FILE *fp = fopen("/proc/self/statm", "r");
+  if(fp == NULL)
+    return 0;
+  if(fscanf(fp, "%*d %ld", &pages) != 1)
+    pages = 0;
+  fclose(fp);
+  return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+
+static void
+headless_bench(void)
+{
+  const int items = headless_bench_env("GLW_BENCH_ITEMS", 500);
+  const int step_frames = MAX(1, headless_bench_env("GLW_BENCH_FRAMES", 6));
+  const char *script = getenv("GLW_BENCH_SCRIPT") ?: HEADLESS_BENCH_SCRIPT;
+  int width = HEADLESS_WIDTH, height = HEADLESS_HEIGHT;
+  char action[64];
+  int count;
+
+  const char *size = getenv("GLW_BENCH_SIZE");
+  if(size != NULL && sscanf(size, "%dx%d", &width, &height) != 2) {
+    printf("glw-frame: Invalid GLW_BENCH_SIZE '%s'\n", size);
+    return;
+  }
+
+  // Count frames so all samples can be kept for percentiles
+  int frames = 0;
+  for(const char *s = script;
+      (s = headless_bench_step(s, action, &count)) != NULL;)
+    frames += MAX(count, 0) * step_frames;
+
+  if(frames == 0) {
+    printf("glw-frame: Empty script\n");
+    return;
+  }
+
+  glw_root_t *gr = calloc(1, sizeof(glw_root_t));
+  if(headless_root_create(gr, NULL, width, height) == NULL) {
+    printf("glw-frame: Unable to initialize GLW\n");
+    return;
+  }
+
+  const int rss0 = headless_rss();
+  prop_t *model = headless_bench_model(items);
+  rstr_t *url = backend_prop_make(model, NULL);
+
+  glw_bench_stats_t gbs = {};
+  gbs.gbs_windowed_cloning = headless_bench_env("GLW_BENCH_WINDOWED", 0);
+  gbs.gbs_eval_treewalk = headless_bench_env("GLW_BENCH_TREEWALK", 0);
+  gr->gr_bench = &gbs;
+  gconf.enable_text_atlas = headless_bench_env("GLW_BENCH_ATLAS", 0);
+
+  prop_t *es = prop_create_r(gr->gr_prop_nav, "eventSink");
+  event_t *e = event_create_openurl(.url = rstr_get(url));
+  prop_send_ext_event(es, e);
+  event_release(e);
+  prop_ref_dec(es);
+  rstr_release(url);
+
+  // Let the page open and views, fonts and images load
+  for(int i = 0; i < HEADLESS_BENCH_WARMUP; i++) {
+    headless_frame(gr, GLW_NO_FRAMERATE_UPDATE, 1, NULL);
+    usleep(5000);
+  }
+
+  const int rss1 = headless_rss();
+  printf("glw-frame: instantiated %d cloner items in %d ms "
+         "(%d us per item), RSS %d kB -> %d kB\n",
+         gbs.gbs_clone_calls, (int)(gbs.gbs_clone_time / 1000),
+         gbs.gbs_clone_calls ?
+         (int)(gbs.gbs_clone_time / gbs.gbs_clone_calls) : 0,
+         rss0, rss1);
+  printf("glw-frame: instantiated %d views in %d ms (%d us per view)\n",
+         gbs.gbs_view_calls, (int)(gbs.gbs_view_time / 1000),
+         gbs.gbs_view_calls ?
+         (int)(gbs.gbs_view_time / gbs.gbs_view_calls) : 0);
+
+  int64_t *samples = calloc(frames * HEADLESS_PHASE_num, sizeof(int64_t));
+  int64_t jobs = 0, vertices = 0, triangles = 0, texsw = 0, evals = 0;
+  int64_t rpns = 0, evaltime = 0, pooltokens = 0;
+  int frame = 0;
+
+  gbs.gbs_clone_calls = 0;
+  gbs.gbs_clone_time = 0;
+  gbs.gbs_view_calls = 0;
+  gbs.gbs_view_time = 0;
+  gbs.gbs_text_uploads = 0;
+
+  text_stats_t ts0, ts1;
+  text_get_stats(&ts0);
+
+  for(const char *s = script;
+      (s = headless_bench_step(s, action, &count)) != NULL;) {
+
+    for(int i = 0; i < count; i++) {
+      glw_inject_event(gr, event_create_action_str(action));
+
+      for(int j = 0; j < step_frames; j++) {
+        gbs.gbs_eval_calls = 0;
+        gbs.gbs_eval_rpns = 0;
+        gbs.gbs_eval_pool_tokens = 0;
+        headless_frame(gr, GLW_NO_FRAMERATE_UPDATE, 1,
+                       samples + frame * HEADLESS_PHASE_num);
+        frame++;
+
+        jobs      += gr->gr_be.gbr_jobs;
+        vertices  += gr->gr_be.gbr_vertices;
+        triangles += gr->gr_be.gbr_triangles;
+        texsw     += gr->gr_be.gbr_texture_switches;
+        evals     += gbs.gbs_eval_calls;
+        rpns      += gbs.gbs_eval_rpns;
+        pooltokens += gbs.gbs_eval_pool_tokens;
+        evaltime  += samples[(frame - 1) * HEADLESS_PHASE_num +
+                             HEADLESS_PHASE_EVAL];
+      }
+    }
+  }
+
+  gr->gr_bench = NULL;
+  text_get_stats(&ts1);
+
+  printf("glw-frame: %s  %dx%d  %d items  %d frames%s%s%s\n",
+         gr->gr_skin, width, height, items, frames,
+         gbs.gbs_windowed_cloning ? "  windowed" : "",
+         gconf.enable_text_atlas ? "  text-atlas" : "",
+         gbs.gbs_eval_treewalk ? "  treewalk" : "");
+  printf("glw-frame: %-10s %8s %8s %8s   (us per frame)\n",
+         "", "avg", "p95", "max");
+
+  int64_t *v = malloc(frames * sizeof(int64_t));
+  for(int p = 0; p < HEADLESS_PHASE_num; p++) {
+    int64_t sum = 0;
+    for(int i = 0; i < frames; i++) {
+      v[i] = samples[i * HEADLESS_PHASE_num + p];
+      sum += v[i];
+    }
+    qsort(v, frames, sizeof(int64_t), headless_bench_cmp);
+    printf("glw-frame: %-10s %8d %8d %8d\n",
+           headless_phase_names[p],
+           (int)(sum / frames),
+           (int)v[frames * 95 / 100],
+           (int)v[frames - 1]);
+  }
+  free(v);
+  free(samples);
+
+  printf("glw-frame: per frame: %d render jobs, %d vertices, %d triangles, "
+         "%d texture switches, %d layout evaluations\n",
+         (int)(jobs / frames), (int)(vertices / frames),
+         (int)(triangles / frames), (int)(texsw / frames),
+         (int)(evals / frames));
+
+  printf("glw-frame: %d dynamic expressions per frame, %d ns per expression, "
+         "%d pooled temporary tokens per frame\n",
+         (int)(rpns / frames),
+         rpns ? (int)(evaltime * 1000 / rpns) : 0,
+         (int)(pooltokens / frames));
+
+  printf("glw-frame: %d cloner items instantiated while running, "
+         "RSS %d kB\n", gbs.gbs_clone_calls, headless_rss());
+
+  printf("glw-frame: text: %d renders, %d glyphs composited, "
+         "%d glyphs rasterized to atlas (%d page evictions, "
+         "%d pixmap fallbacks), %d texture uploads\n",
+         ts1.ts_renders - ts0.ts_renders,
+         ts1.ts_glyph_draws - ts0.ts_glyph_draws,
+         ts1.ts_atlas_rasterizations - ts0.ts_atlas_rasterizations,
+         ts1.ts_atlas_evictions - ts0.ts_atlas_evictions,
+         ts1.ts_atlas_fallbacks - ts0.ts_atlas_fallbacks,
+         gbs.gbs_text_uploads);
+
+  prop_t *nav = gr->gr_prop_nav;
+  headless_root_destroy(gr);
+  prop_destroy(gr->gr_prop_ui);
+  glw_release_root(gr);
+  prop_destroy(nav);
+  prop_destroy(model);
+}
+
+BENCHMARK("glw-frame", headless_bench);
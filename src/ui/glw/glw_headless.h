@@ -0,0 +1,91 @@
+/*
+ *  Copyright (C) 2007-2015 Lonelycoder AB
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  This program is also available under a commercial proprietary license.
+ *  For more information, contact andreas@lonelycoder.com
+ */
+#pragma once
+
+/**
+ * Headless backend. Nothing is drawn, the render jobs produced for
+ * each frame are only counted. Used to profile and benchmark the CPU
+ * side of GLW (layout, view evaluation, tesselation, etc) on machines
+ * without a GPU or display.
+ */
+
+struct glw_rctx;
+struct glw_root;
+struct glw_backend_root;
+struct glw_renderer;
+struct glw_backend_texture;
+
+#define GLW_DRAW_TRIANGLES 0
+#define GLW_DRAW_LINE_LOOP 1
+#define GLW_DRAW_LINES     2
+
+
+/**
+ * Counters from the most recent frame
+ */
+typedef struct glw_backend_root {
+  int gbr_jobs;
+  int gbr_vertices;
+  int gbr_triangles;
+  int gbr_texture_switches;
+  int gbr_state_switches;
+} glw_backend_root_t;
+
+
+/**
+ *
+ */
+typedef struct glw_backend_texture {
+  uint16_t width;
+  uint16_t height;
+  uint8_t opaque;
+  uint8_t inited;
+} glw_backend_texture_t;
+
+#define glw_tex_width(gbt) ((gbt)->width)
+#define glw_tex_height(gbt) ((gbt)->height)
+
+#define glw_is_tex_inited(n) ((n)->inited)
+
+int glw_headless_init_context(struct glw_root *gr);
+
+
+/**
+ * Render to texture support
+ */
+typedef struct {
+
+  glw_backend_texture_t grtt_texture;
+
+  int grtt_width;
+  int grtt_height;
+
+} glw_rtt_t;
+
+void glw_rtt_init(struct glw_root *gr, glw_rtt_t *grtt, int width, int height,
+		  int alpha);
+
+void glw_rtt_enter(struct glw_root *gr, glw_rtt_t *grtt, struct glw_rctx *rc0);
+
+void glw_rtt_restore(struct glw_root *gr, glw_rtt_t *grtt);
+
+void glw_rtt_destroy(struct glw_root *gr, glw_rtt_t *grtt);
+
+#define glw_rtt_texture(grtt) ((grtt)->grtt_texture)
@@ -141,6 +141,9 @@ glw_list_layout_y(glw_t *w, const glw_rctx_t *rc)
     ypos += l->spacing;
   }
 
+  ypos = glw_scroll_deferred_childs(&l->gsc, w, ypos, rc->rc_height * 2, 1,
+                                    rc0.rc_width / 10, l->spacing, 1);
+
   if(l->gsc.total_size != ypos) {
     l->gsc.total_size = ypos;
     l->w.glw_flags |= GLW_UPDATE_METRICS;
@@ -228,6 +231,9 @@ glw_list_layout_x(glw_t *w, const glw_rctx_t *rc)
     xpos += l->spacing;
   }
 
+  xpos = glw_scroll_deferred_childs(&l->gsc, w, xpos, width0 * 2, 1,
+                                    rc0.rc_height, l->spacing, 0);
+
   xpos += l->gsc.scroll_threshold_post;
 
   if(l->gsc.total_size != xpos) {
@@ -432,6 +438,8 @@ glw_list_find_visible_child(glw_t *w)
     while(c != NULL && glw_parent_data(c, glw_list_item_t)->pos < top)
       c = glw_next_widget(c);
 
+    if(c != NULL)
+      glw_signal0(c, GLW_SIGNAL_MATERIALIZE, NULL);
     if(c != NULL && glw_get_focusable_child(c) == NULL)
       c = glw_next_widget(c);
 
@@ -440,6 +448,8 @@ glw_list_find_visible_child(glw_t *w)
     while(c != NULL && glw_parent_data(c, glw_list_item_t)->pos > bottom)
       c = glw_prev_widget(c);
 
+    if(c != NULL)
+      glw_signal0(c, GLW_SIGNAL_MATERIALIZE, NULL);
     if(c != NULL && glw_get_focusable_child(c) == NULL)
       c = glw_prev_widget(c);
 
@@ -46,6 +46,7 @@ glw_navigate_first(glw_t *parent)
   glw_t *c = glw_first_widget(parent);
 
   while(c != NULL) {
+    glw_signal0(c, GLW_SIGNAL_MATERIALIZE, NULL);
     glw_t *to_focus = glw_get_focusable_child(c);
     if(to_focus != NULL && to_focus->glw_flags2 & GLW2_NAV_FOCUSABLE) {
       glw_focus_set(to_focus->glw_root, to_focus, GLW_FOCUS_SET_INTERACTIVE,
@@ -67,6 +68,13 @@ glw_navigate_last(glw_t *parent)
   glw_t *c = glw_last_widget(parent);
 
   while(c != NULL) {
+    int created = 0;
+    glw_signal0(c, GLW_SIGNAL_MATERIALIZE, &created);
+    if(created) {
+      // A windowed cloner created the items it held back, start over
+      c = glw_last_widget(parent);
+      continue;
+    }
     glw_t *to_focus = glw_get_focusable_child(c);
     if(to_focus != NULL && to_focus->glw_flags2 & GLW2_NAV_FOCUSABLE) {
       glw_focus_set(to_focus->glw_root, to_focus, GLW_FOCUS_SET_INTERACTIVE,
@@ -95,6 +103,7 @@ glw_navigate_step(glw_t *c, int count, int may_wrap)
   }
 
   while((c = glw_step_widget(c, forward)) != NULL) {
+    glw_signal0(c, GLW_SIGNAL_MATERIALIZE, NULL);
     glw_t *tentative = glw_get_focusable_child(c);
     if(tentative != NULL) {
       if(!(tentative->glw_flags2 & GLW2_NAV_FOCUSABLE))
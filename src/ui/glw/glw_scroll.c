@@ -190,6 +190,46 @@ glw_scroll_layout(glw_scroll_control_t *gsc, glw_t *w, int height)
 
 
 
+/**
+ * Account for childs that cloners have not created widgets for yet,
+ * see GLW_SIGNAL_DEFERRED_CHILDS.
+ *
+ * 'end' is where the last child ends. Deferred childs are estimated to
+ * take 'size' (unless the cloner knows better) plus 'spacing' for each
+ * row of 'per_row' childs. If the part that is laid out (up to 'window'
+ * beyond the scroll position) reaches beyond the last child, enough
+ * childs to fill it are asked for. They are laid out in the next frame.
+ *
+ * Returns where the deferred childs are estimated to end.
+ */
+int
+glw_scroll_deferred_childs(glw_scroll_control_t *gsc, glw_t *w, int end,
+                           int window, int per_row, int size, int spacing,
+                           int vertical)
+{
+  glw_deferred_childs_t gdc = {};
+
+  glw_signal0(w, GLW_SIGNAL_DEFERRED_CHILDS, &gdc);
+  if(gdc.count == 0)
+    return end;
+
+  const int est = vertical ? gdc.height : gdc.width;
+  size = GLW_MAX(1, (est > 0 ? est : size) + spacing);
+  per_row = GLW_MAX(1, per_row);
+
+  const int missing = gsc->rounded_pos + window - end;
+  if(missing > 0) {
+    int wanted = (missing / size + 1) * per_row;
+    glw_signal0(w, GLW_SIGNAL_WANT_DEFERRED_CHILDS, &wanted);
+    glw_need_refresh(w->glw_root, 0);
+
+    memset(&gdc, 0, sizeof(gdc));
+    glw_signal0(w, GLW_SIGNAL_DEFERRED_CHILDS, &gdc);
+  }
+  return end + (gdc.count + per_row - 1) / per_row * size;
+}
+
+
 /**
  *
  */
@@ -76,6 +76,10 @@ int glw_scroll_handle_event(glw_scroll_control_t *gsc,
 void glw_scroll_layout(glw_scroll_control_t *gsc, glw_t *w,
                        int height);
 
+int glw_scroll_deferred_childs(glw_scroll_control_t *gsc, glw_t *w, int end,
+                               int window, int per_row, int size,
+                               int spacing, int vertical);
+
 void glw_scroll_update_metrics(glw_scroll_control_t *gsc, glw_t *w);
 
 int glw_scroll_set_float_attributes(glw_scroll_control_t *gsc, const char *a,
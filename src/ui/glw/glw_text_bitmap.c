@@ -42,6 +42,17 @@
 
 static glw_class_t glw_text;
 
+/**
+ * Glyphs drawn from one atlas page. Consecutive glyphs on the same
+ * page are batched together so the drawing order is kept
+ */
+typedef struct gtb_glyph_batch {
+  glw_renderer_t ggb_renderer;
+  int ggb_page;
+} gtb_glyph_batch_t;
+
+#define GTB_GLYPH_BATCH_MAX_QUADS 16000 // Indices are 16 bit
+
 /**
  *
  */
@@ -67,6 +78,10 @@ typedef struct glw_text_bitmap {
   glw_renderer_t gtb_cursor_renderer;
   glw_renderer_t gtb_background_renderer;
 
+  gtb_glyph_batch_t *gtb_glyph_batches;
+  int gtb_num_glyph_batches;
+  int gtb_glyph_pages;  // Atlas pages used by the batches (bitmask)
+  int gtb_glyph_page_version[IMAGE_GLYPH_PAGES];
 
   uint32_t *gtb_uc_buffer; /* unicode buffer */
   float gtb_cursor_alpha;
@@ -122,6 +137,193 @@ static void gtb_caption_refresh(glw_text_bitmap_t *gtb);
 static glw_class_t glw_text, glw_label;
 
 
+/**
+ * Upload atlas pages that have changed since last frame. Called when
+ * preparing the frame, before layout, so all text that is done
+ * rendering finds its glyphs in the textures
+ */
+void
+glw_text_atlas_update(glw_root_t *gr)
+{
+  if(gr->gr_text_atlas_used) {
+    text_atlas_touch(gr->gr_text_atlas_used);
+    gr->gr_text_atlas_used = 0;
+  }
+
+  for(int i = 0; i < TEXT_ATLAS_PAGES; i++) {
+    pixmap_t *pm = text_atlas_get_page(i, &gr->gr_text_atlas_version[i],
+                                       &gr->gr_text_atlas_evicted[i]);
+    if(pm == NULL)
+      continue;
+    glw_tex_upload(gr, &gr->gr_text_atlas[i], pm, 0);
+    if(unlikely(gr->gr_bench != NULL))
+      gr->gr_bench->gbs_text_uploads++;
+    pixmap_release(pm);
+  }
+}
+
+
+/**
+ * Returns 1 if the glyph batches can be drawn, ie. every atlas page
+ * they use has been uploaded and not evicted since the text was
+ * rendered
+ */
+static int
+gtb_glyphs_drawable(glw_root_t *gr, const glw_text_bitmap_t *gtb)
+{
+  for(int i = 0; i < TEXT_ATLAS_PAGES; i++) {
+    if(!(gtb->gtb_glyph_pages & (1 << i)))
+      continue;
+    const int version = gtb->gtb_glyph_page_version[i];
+    if(!glw_is_tex_inited(&gr->gr_text_atlas[i]) ||
+       gr->gr_text_atlas_version[i] < version ||
+       gr->gr_text_atlas_evicted[i] > version)
+      return 0;
+  }
+  return 1;
+}
+
+
+/**
+ *
+ */
+static void
+gtb_glyphs_free(glw_text_bitmap_t *gtb)
+{
+  for(int i = 0; i < gtb->gtb_num_glyph_batches; i++)
+    glw_renderer_free(&gtb->gtb_glyph_batches[i].ggb_renderer);
+  free(gtb->gtb_glyph_batches);
+  gtb->gtb_glyph_batches = NULL;
+  gtb->gtb_num_glyph_batches = 0;
+  gtb->gtb_glyph_pages = 0;
+}
+
+
+/**
+ * Clip a glyph to the visible part of the text. Returns 0 if nothing
+ * is left. Coordinates are in pixels from the top left corner
+ */
+static int
+gtb_glyph_clip(const image_glyph_t *ig, int text_width, int text_height,
+               float *px, float *py, float *ps, float *pt)
+{
+  const float ss = ig->ig_s_width  / (float)ig->ig_width;
+  const float ts = ig->ig_t_height / (float)ig->ig_height;
+
+  px[0] = ig->ig_x;
+  px[1] = ig->ig_x + ig->ig_width;
+  py[0] = ig->ig_y;
+  py[1] = ig->ig_y + ig->ig_height;
+  ps[0] = ig->ig_s;
+  ps[1] = ig->ig_s + ig->ig_s_width;
+  pt[0] = ig->ig_t;
+  pt[1] = ig->ig_t + ig->ig_t_height;
+
+  if(px[1] <= 0 || px[0] >= text_width || py[1] <= 0 || py[0] >= text_height)
+    return 0;
+
+  if(px[0] < 0) {
+    ps[0] -= px[0] * ss;
+    px[0] = 0;
+  }
+  if(px[1] > text_width) {
+    ps[1] -= (px[1] - text_width) * ss;
+    px[1] = text_width;
+  }
+  if(py[0] < 0) {
+    pt[0] -= py[0] * ts;
+    py[0] = 0;
+  }
+  if(py[1] > text_height) {
+    pt[1] -= (py[1] - text_height) * ts;
+    py[1] = text_height;
+  }
+  return 1;
+}
+
+
+/**
+ * Build quads for glyphs in the atlas. (x1,y1)-(x2,y2) is where the
+ * visible part (text_width x text_height pixels) of the text goes
+ */
+static void
+gtb_glyphs_layout(glw_text_bitmap_t *gtb, const image_component_glyphs_t *icg,
+                  float x1, float y1, float x2, float y2,
+                  int text_width, int text_height)
+{
+  float px[2], py[2], ps[2], pt[2];
+
+  gtb_glyphs_free(gtb);
+  memcpy(gtb->gtb_glyph_page_version, icg->icg_page_version,
+         sizeof(gtb->gtb_glyph_page_version));
+
+  if(text_width <= 0 || text_height <= 0)
+    return;
+
+  const float xs = (x2 - x1) / text_width;
+  const float ys = (y2 - y1) / text_height;
+  const float is = 1.0f / TEXT_ATLAS_SIZE;
+
+  int i = 0;
+  while(i < icg->icg_count) {
+    const int page = icg->icg_glyphs[i].ig_page;
+    int end, quads = 0;
+
+    for(end = i; end < icg->icg_count && quads < GTB_GLYPH_BATCH_MAX_QUADS &&
+          icg->icg_glyphs[end].ig_page == page; end++)
+      quads += gtb_glyph_clip(&icg->icg_glyphs[end], text_width, text_height,
+                              px, py, ps, pt);
+
+    if(quads > 0) {
+      gtb->gtb_glyph_batches =
+        realloc(gtb->gtb_glyph_batches,
+                (gtb->gtb_num_glyph_batches + 1) * sizeof(gtb_glyph_batch_t));
+      gtb_glyph_batch_t *ggb =
+        &gtb->gtb_glyph_batches[gtb->gtb_num_glyph_batches++];
+      glw_renderer_t *r = &ggb->ggb_renderer;
+
+      memset(ggb, 0, sizeof(gtb_glyph_batch_t));
+      ggb->ggb_page = page;
+      gtb->gtb_glyph_pages |= 1 << page;
+      glw_renderer_init(r, quads * 4, quads * 2, NULL);
+
+      int q = 0;
+      for(; i < end; i++) {
+        const image_glyph_t *ig = &icg->icg_glyphs[i];
+        if(!gtb_glyph_clip(ig, text_width, text_height, px, py, ps, pt))
+          continue;
+
+        const float r_ = (ig->ig_color & 0xff) / 255.0f;
+        const float g_ = ((ig->ig_color >> 8) & 0xff) / 255.0f;
+        const float b_ = ((ig->ig_color >> 16) & 0xff) / 255.0f;
+        const float a_ = ((ig->ig_color >> 24) & 0xff) / 255.0f;
+        const int v = q * 4;
+
+        glw_renderer_vtx_pos(r, v + 0, x1 + px[0] * xs, y2 - py[1] * ys, 0);
+        glw_renderer_vtx_st (r, v + 0, ps[0] * is, pt[1] * is);
+
+        glw_renderer_vtx_pos(r, v + 1, x1 + px[1] * xs, y2 - py[1] * ys, 0);
+        glw_renderer_vtx_st (r, v + 1, ps[1] * is, pt[1] * is);
+
+        glw_renderer_vtx_pos(r, v + 2, x1 + px[1] * xs, y2 - py[0] * ys, 0);
+        glw_renderer_vtx_st (r, v + 2, ps[1] * is, pt[0] * is);
+
+        glw_renderer_vtx_pos(r, v + 3, x1 + px[0] * xs, y2 - py[0] * ys, 0);
+        glw_renderer_vtx_st (r, v + 3, ps[0] * is, pt[0] * is);
+
+        for(int j = 0; j < 4; j++)
+          glw_renderer_vtx_col(r, v + j, r_, g_, b_, a_);
+
+        glw_renderer_triangle(r, q * 2 + 0, v, v + 1, v + 2);
+        glw_renderer_triangle(r, q * 2 + 1, v, v + 2, v + 3);
+        q++;
+      }
+    }
+    i = end;
+  }
+}
+
+
 /**
  *
  */
@@ -156,13 +358,39 @@ glw_text_bitmap_layout(glw_t *w, const glw_rctx_t *rc)
   image_component_t *ic = image_find_component(gtb->gtb_image, IMAGE_PIXMAP);
   if(ic != NULL) {
     glw_tex_upload(gr, &gtb->gtb_texture, ic->pm, 0);
+    if(unlikely(gr->gr_bench != NULL))
+      gr->gr_bench->gbs_text_uploads++;
     gtb->gtb_margin = ic->pm->pm_margin;
     image_clear_component(ic);
     gtb->gtb_need_layout = 1;
   }
 
-  const int tex_width  = glw_tex_width(&gtb->gtb_texture);
-  const int tex_height = glw_tex_height(&gtb->gtb_texture);
+  int tex_width  = glw_tex_width(&gtb->gtb_texture);
+  int tex_height = glw_tex_height(&gtb->gtb_texture);
+
+  // Or draw glyphs from the shared atlas
+
+  ic = image_find_component(gtb->gtb_image, IMAGE_GLYPHS);
+  const image_component_glyphs_t *icg = ic ? &ic->glyphs : NULL;
+  if(icg != NULL) {
+    if(glw_is_tex_inited(&gtb->gtb_texture))
+      glw_tex_destroy(gr, &gtb->gtb_texture);
+
+    /* Render again if a page we use has been evicted. Until the new
+       image arrives the old glyphs are drawn as long as the uploaded
+       page still holds them (see gtb_glyphs_drawable()) */
+
+    for(int i = 0; i < TEXT_ATLAS_PAGES; i++) {
+      if(icg->icg_page_version[i] &&
+         gr->gr_text_atlas_evicted[i] > icg->icg_page_version[i] &&
+         gtb->gtb_state == GTB_VALID)
+        gtb->gtb_state = GTB_NEED_RENDER;
+    }
+
+    tex_width  = gtb->gtb_image->im_width;
+    tex_height = gtb->gtb_image->im_height;
+    gtb->gtb_margin = gtb->gtb_image->im_margin;
+  }
 
   ic = image_find_component(gtb->gtb_image, IMAGE_TEXT_INFO);
   image_component_text_info_t *ti = ic ? &ic->text_info : NULL;
@@ -316,6 +544,9 @@ glw_text_bitmap_layout(glw_t *w, const glw_rctx_t *rc)
     if(gtb->w.glw_flags2 & GLW2_DEBUG)
       printf("  s=%f t=%f\n", s, t);
 
+    if(icg != NULL)
+      gtb_glyphs_layout(gtb, icg, x1, y1, x2, y2, text_width, text_height);
+
     glw_renderer_vtx_pos(&gtb->gtb_text_renderer, 0, x1, y1, 0.0);
     glw_renderer_vtx_st (&gtb->gtb_text_renderer, 0, 0, t);
 
@@ -423,6 +654,17 @@ glw_text_bitmap_render(glw_t *w, const glw_rctx_t *rc)
     glw_renderer_draw(&gtb->gtb_text_renderer, w->glw_root, &rc0,
 		      &gtb->gtb_texture, NULL,
 		      &gtb->gtb_color, NULL, alpha, blur, NULL);
+  } else if(gtb->gtb_num_glyph_batches &&
+            gtb_glyphs_drawable(w->glw_root, gtb)) {
+    glw_root_t *gr = w->glw_root;
+
+    for(int i = 0; i < gtb->gtb_num_glyph_batches; i++) {
+      gtb_glyph_batch_t *ggb = &gtb->gtb_glyph_batches[i];
+      glw_renderer_draw(&ggb->ggb_renderer, gr, &rc0,
+                        &gr->gr_text_atlas[ggb->ggb_page], NULL,
+                        &gtb->gtb_color, NULL, alpha, blur, NULL);
+    }
+    gr->gr_text_atlas_used |= gtb->gtb_glyph_pages;
   }
 
   if(gtb->gtb_paint_cursor) {
@@ -460,6 +702,7 @@ glw_text_bitmap_dtor(glw_t *w)
   glw_renderer_free(&gtb->gtb_text_renderer);
   glw_renderer_free(&gtb->gtb_cursor_renderer);
   glw_renderer_free(&gtb->gtb_background_renderer);
+  gtb_glyphs_free(gtb);
 
   switch(gtb->gtb_state) {
   case GTB_IDLE:
@@ -541,6 +784,13 @@ gtb_inactive(glw_text_bitmap_t *gtb)
 {
   glw_tex_destroy(gtb->w.glw_root, &gtb->gtb_texture);
 
+  if(image_find_component(gtb->gtb_image, IMAGE_GLYPHS) != NULL) {
+    // Glyphs are kept in the atlas, just rebuild the quads when needed
+    gtb_glyphs_free(gtb);
+    gtb->gtb_need_layout = 1;
+    return;
+  }
+
   // Make sure it is rerendered once we get back to life
   if(gtb->gtb_state == GTB_VALID)
     gtb->gtb_state = GTB_NEED_RENDER;
@@ -1220,6 +1470,9 @@ do_render(glw_text_bitmap_t *gtb, glw_root_t *gr, int no_output)
   if(gtb->w.glw_class == &glw_text)
     flags |= TR_RENDER_CHARACTER_POS;
 
+  if(gconf.enable_text_atlas)
+    flags |= TR_RENDER_GLYPHS;
+
   tr_align = TR_ALIGN_JUSTIFIED;
 
   if(gtb->w.glw_flags2 & GLW2_SHADOW)
@@ -1293,6 +1546,7 @@ do_render(glw_text_bitmap_t *gtb, glw_root_t *gr, int no_output)
     image_release(gtb->gtb_image);
     gtb->gtb_image = im;
     gtb->gtb_update_cursor = 1;
+    gtb->gtb_need_layout = 1;
     if(im != NULL && gtb->gtb_maxlines > 1) {
       gtb_set_constraints(gr, gtb, im);
     }
@@ -1369,6 +1623,12 @@ glw_text_flush(glw_root_t *gr)
     gtb_inactive(gtb);
     gtb_realize(gtb);
   }
+
+  // Textures might have been lost, upload the atlas again
+  for(int i = 0; i < TEXT_ATLAS_PAGES; i++) {
+    glw_tex_destroy(gr, &gr->gr_text_atlas[i]);
+    gr->gr_text_atlas_version[i] = 0;
+  }
 }
 
 
@@ -1442,6 +1702,9 @@ glw_text_bitmap_fini(glw_root_t *gr)
   hts_mutex_unlock(&gr->gr_mutex);
   hts_thread_join(&gr->gr_font_thread);
   hts_cond_destroy(&gr->gr_gtb_work_cond);
+
+  for(int i = 0; i < TEXT_ATLAS_PAGES; i++)
+    glw_tex_destroy(gr, &gr->gr_text_atlas[i]);
 }
 
 
@@ -26,4 +26,6 @@ void glw_text_bitmap_fini(glw_root_t *gr);
 
 void glw_text_flush(glw_root_t *gr);
 
+void glw_text_atlas_update(glw_root_t *gr);
+
 #endif /* GLW_TEXT_BITMAP_H */
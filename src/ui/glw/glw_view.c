@@ -178,6 +178,7 @@ eval_loaded_view(glw_root_t *gr, glw_cached_view_t *gcv, glw_view_t *view,
     return;
   }
 
+  const int64_t ts = unlikely(gr->gr_bench != NULL) ? arch_get_ts() : 0;
   token_t *t = glw_view_clone_chain(gr, gcv->gcv_sof, NULL);
 
   glw_view_eval_context_t ec = {};
@@ -202,6 +203,11 @@ eval_loaded_view(glw_root_t *gr, glw_cached_view_t *gcv, glw_view_t *view,
   }
   glw_view_free_chain(gr, t);
 
+  if(unlikely(gr->gr_bench != NULL)) {
+    gr->gr_bench->gbs_view_time += arch_get_ts() - ts;
+    gr->gr_bench->gbs_view_calls++;
+  }
+
   if(unlikely(gr->gr_pending_focus != NULL))
     glw_focus_check_pending(ec.w->glw_parent);
 
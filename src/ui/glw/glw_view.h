@@ -224,6 +224,7 @@ typedef struct glw_view_eval_context {
   token_t *stack;
   errorinfo_t *ei;
   token_t *alloc;
+  struct glw_eval_scratch *scratch;  // See eval_alloc()
   struct glw *w;
 
   glw_scope_t *scope;
@@ -250,13 +251,17 @@ typedef struct glw_view_eval_context {
  */
 typedef struct glw_clone {
   LIST_ENTRY(glw_clone) c_link;
+  TAILQ_ENTRY(glw_clone) c_idle_link;  // Windowed cloning, see c_idle
   struct sub_cloner *c_sc;
   glw_t *c_w;
   prop_t *c_prop;
   prop_t *c_clone_root;
 
-  uint16_t c_pos;
-  char c_evaluated;
+  int c_pos;
+  char c_evaluated;  // Body has been evaluated
+  char c_active;
+  char c_idle;       // Evaluated but inactive, linked on sc_idle
+  int c_idle_frame;
 
 } glw_clone_t;
 
@@ -292,6 +297,8 @@ token_t *glw_view_token_alloc(glw_root_t *gr) attribute_malloc;
 
 void glw_view_token_free(glw_root_t *gr, token_t *t);
 
+void glw_view_token_release(glw_root_t *gr, token_t *t);
+
 token_t *glw_view_token_copy(glw_root_t *gr, token_t *src);
 
 token_t *glw_view_load1(glw_root_t *gr, rstr_t *url, errorinfo_t *ei,
@@ -328,6 +335,8 @@ int glw_view_eval_rpn(token_t *t, glw_view_eval_context_t *pec, int *copyp);
 int glw_view_preproc(glw_root_t *gr, token_t *p, errorinfo_t *ei,
                      int may_unlock);
 
+token_t *glw_view_clone_token(glw_root_t *gr, token_t *src);
+
 token_t *glw_view_clone_chain(glw_root_t *gr, token_t *src, token_t **lp);
 
 void glw_view_cache_flush(glw_root_t *gr);
@@ -40,6 +40,7 @@
 #include "glw_texture.h"
 
 LIST_HEAD(clone_list, glw_clone);
+TAILQ_HEAD(clone_queue, glw_clone);
 TAILQ_HEAD(vectorizer_element_queue, vectorizer_element);
 
 static token_t t_zero = {
@@ -121,6 +122,31 @@ typedef struct sub_cloner {
 
   struct clone_list sc_clones;
 
+  /*
+   * Windowed cloning, see clone_window_active()
+   */
+  char sc_windowed;
+  char sc_defer;         // Only create widgets close to the active items
+  char sc_have_estimate;
+  char sc_creating_deferred;
+  int sc_num_active;
+  int sc_num_idle;
+  int sc_num_hidden;
+  struct clone_queue sc_idle;
+
+  // Constraints of the most recently evaluated item
+  int sc_est_width;
+  int sc_est_height;
+  float sc_est_weight;
+  int sc_est_flags;
+
+  // Assignments to 'hidden' split from the body, see cloner_set_body()
+  token_t *sc_cloner_hidden;
+
+  // Items at the end of the model without a widget, see cloner_defer_child()
+  struct glw_prop_sub_pending_queue sc_deferred;
+  int sc_num_deferred;
+
 } sub_cloner_t;
 
 
@@ -162,6 +188,9 @@ static int subscribe_prop(glw_view_eval_context_t *ec, struct token *self,
 
 static void clone_free(glw_root_t *gr, glw_clone_t *c);
 
+static int cloner_parent_sig_handler(glw_t *w, void *opaque,
+                                     glw_signal_t signal, void *extra);
+
 
 /**
  *
@@ -170,14 +199,32 @@ static void
 cloner_cleanup(glw_root_t *gr, sub_cloner_t *sc)
 {
   glw_clone_t *c;
+  glw_prop_sub_pending_t *gpsp;
+
+  if(sc->sc_sub.gps_widget != NULL)
+    glw_signal_handler_unregister(sc->sc_sub.gps_widget,
+                                  cloner_parent_sig_handler, sc);
 
   while((c = LIST_FIRST(&sc->sc_clones)) != NULL) {
     prop_tag_clear(c->c_prop, sc);
     clone_free(gr, c);
   }
 
+  while((gpsp = TAILQ_FIRST(&sc->sc_deferred)) != NULL) {
+    TAILQ_REMOVE(&sc->sc_deferred, gpsp, gpsp_link);
+    prop_tag_clear(gpsp->gpsp_prop, &sc->sc_deferred);
+    prop_ref_dec(gpsp->gpsp_prop);
+    free(gpsp);
+  }
+  sc->sc_num_deferred = 0;
+
   if(sc->sc_cloner_body != NULL)
     glw_view_free_chain(gr, sc->sc_cloner_body);
+
+  if(sc->sc_cloner_hidden != NULL) {
+    glw_view_free_chain(gr, sc->sc_cloner_hidden);
+    sc->sc_cloner_hidden = NULL;
+  }
 }
 
 
@@ -274,6 +321,8 @@ static void eval_dynamic(glw_t *w, token_t *rpn, struct glw_rctx *rc,
 
 static int glw_view_eval_rpn0(token_t *t0, glw_view_eval_context_t *ec);
 
+static int glw_view_exec_rpn(token_t *t0, glw_view_eval_context_t *ec);
+
 /**
  *
  */
@@ -297,16 +346,42 @@ eval_pop(glw_view_eval_context_t *ec)
   return r;
 }
 
+/**
+ * Temporary tokens for dynamic expressions (run_dynamics() and
+ * eval_dynamic()) are taken from an array on the stack of the caller
+ * instead of gr_token_pool. They borrow the file name of the token they
+ * are made from, which outlives the evaluation, and are released by
+ * eval_free_temps() before the array goes out of scope. If an
+ * expression needs more than fit, the rest come from the pool.
+ */
+#define GLW_EVAL_SCRATCH_TOKENS 16
+
+typedef struct glw_eval_scratch {
+  int ges_used;
+  token_t ges_tokens[GLW_EVAL_SCRATCH_TOKENS];
+} glw_eval_scratch_t;
+
+
 /**
  *
  */
 static token_t *
 eval_alloc(token_t *src, glw_view_eval_context_t *ec, token_type_t type)
 {
-  token_t *r = glw_view_token_alloc(ec->gr);
+  glw_eval_scratch_t *ges = ec->scratch;
+  token_t *r;
 
-  if(src->file != NULL)
-    r->file = rstr_dup(src->file);
+  if(ges != NULL && ges->ges_used < GLW_EVAL_SCRATCH_TOKENS) {
+    r = &ges->ges_tokens[ges->ges_used++];
+    memset(r, 0, sizeof(token_t));
+    r->file = src->file;
+  } else {
+    r = glw_view_token_alloc(ec->gr);
+    if(src->file != NULL)
+      r->file = rstr_dup(src->file);
+    if(ges != NULL && unlikely(ec->gr->gr_bench != NULL))
+      ec->gr->gr_bench->gbs_eval_pool_tokens++;
+  }
   r->line = src->line;
 
   r->type = type;
@@ -316,6 +391,35 @@ eval_alloc(token_t *src, glw_view_eval_context_t *ec, token_type_t type)
 }
 
 
+/**
+ * Free all temporary tokens allocated with eval_alloc()
+ */
+static void
+eval_free_temps(glw_view_eval_context_t *ec)
+{
+  glw_eval_scratch_t *ges = ec->scratch;
+  token_t *t, *next;
+
+  for(t = ec->alloc; t != NULL; t = next) {
+    next = t->next;
+
+    if(t->child != NULL)
+      glw_view_free_chain(ec->gr, t->child);
+
+    if(ges != NULL && t >= ges->ges_tokens &&
+       t < ges->ges_tokens + GLW_EVAL_SCRATCH_TOKENS) {
+      t->file = NULL; // Borrowed
+      glw_view_token_release(ec->gr, t);
+    } else {
+      glw_view_token_free(ec->gr, t);
+    }
+  }
+  ec->alloc = NULL;
+  if(ges != NULL)
+    ges->ges_used = 0;
+}
+
+
 /**
  *
  */
@@ -1107,20 +1211,23 @@ static void
 eval_dynamic(glw_t *w, token_t *rpn, struct glw_rctx *rc, glw_scope_t *scope)
 {
   glw_view_eval_context_t ec;
+  glw_eval_scratch_t ges;
 
   memset(&ec, 0, sizeof(ec));
   ec.w = w;
   ec.gr = w->glw_root;
   ec.rc = rc;
   ec.scope = scope;
+  ec.scratch = &ges;
+  ges.ges_used = 0;
 
   ec.sublist = &w->glw_prop_subscriptions;
 
-  glw_view_eval_rpn0(rpn, &ec);
+  glw_view_exec_rpn(rpn, &ec);
   rpn->t_dynamic_eval = ec.dynamic_eval;
   w->glw_dynamic_eval |= ec.dynamic_eval;
 
-  glw_view_free_chain(ec.gr, ec.alloc);
+  eval_free_temps(&ec);
 }
 
 
@@ -1147,6 +1254,10 @@ static uint8_t signal_to_eval_mask[GLW_SIGNAL_num] = {
 static void
 run_dynamics(glw_t *w, glw_view_eval_context_t *ec, int mask)
 {
+  glw_eval_scratch_t ges;
+
+  ges.ges_used = 0;
+  ec->scratch = &ges;
   ec->mask = mask;
   ec->w = w;
   ec->gr = w->glw_root;
@@ -1158,14 +1269,20 @@ run_dynamics(glw_t *w, glw_view_eval_context_t *ec, int mask)
 
   while(t != NULL) {
     if(t->t_dynamic_eval & mask) {
-      glw_view_eval_rpn0(t, ec);
+      glw_view_exec_rpn(t, ec);
+      if(unlikely(ec->gr->gr_bench != NULL))
+        ec->gr->gr_bench->gbs_eval_rpns++;
       t->t_dynamic_eval = ec->dynamic_eval;
+
+      // Each expression gets all of the scratch tokens
+      eval_free_temps(ec);
+      ec->stack = NULL;
     }
     all_flags |= t->t_dynamic_eval;
     t = t->next;
   }
   w->glw_dynamic_eval = all_flags;
-  glw_view_free_chain(ec->gr, ec->alloc);
+  ec->scratch = NULL;
 }
 
 
@@ -1222,16 +1339,20 @@ glw_view_eval_dynamics(glw_t *w, int flags)
 
 static void cloner_resequence(sub_cloner_t *sc);
 
+static int cloner_create_deferred(sub_cloner_t *sc, int limit, prop_t *until);
+
+static int clone_sig_handler(glw_t *w, void *opaque, glw_signal_t signal,
+                             void *extra);
+
 /**
  *
  */
 static void
-clone_eval(glw_clone_t *c, glw_scope_t *scope)
+clone_eval_block(glw_clone_t *c, token_t *block, glw_scope_t *scope)
 {
-  sub_cloner_t *sc = c->c_sc;
   glw_view_eval_context_t n;
-  token_t *body = glw_view_clone_chain(c->c_w->glw_root, sc->sc_cloner_body,
-				       NULL);
+  glw_root_t *gr = c->c_w->glw_root;
+  token_t *body = glw_view_clone_chain(gr, block, NULL);
   const glw_class_t *gc = c->c_w->glw_class;
 
   if(gc->gc_freeze != NULL)
@@ -1252,13 +1373,264 @@ clone_eval(glw_clone_t *c, glw_scope_t *scope)
 }
 
 
+/**
+ *
+ */
+static void
+clone_eval(glw_clone_t *c, glw_scope_t *scope)
+{
+  glw_root_t *gr = c->c_w->glw_root;
+  const int64_t ts = unlikely(gr->gr_bench != NULL) ? arch_get_ts() : 0;
+
+  clone_eval_block(c, c->c_sc->sc_cloner_body, scope);
+  c->c_evaluated = 1;
+
+  if(unlikely(gr->gr_bench != NULL)) {
+    gr->gr_bench->gbs_clone_time += arch_get_ts() - ts;
+    gr->gr_bench->gbs_clone_calls++;
+  }
+}
+
+
+/**
+ *
+ */
+static void
+clone_create_widget(glw_clone_t *c, glw_t *parent, glw_t *before,
+                    glw_scope_t *scope)
+{
+  sub_cloner_t *sc = c->c_sc;
+
+  c->c_w = glw_create(parent->glw_root, sc->sc_cloner_class, parent, before,
+                      c->c_prop, scope,
+                      sc->sc_cloner_body->file,
+                      sc->sc_cloner_body->line);
+  c->c_w->glw_clone = c;
+  c->c_evaluated = 0;
+
+  glw_signal_handler_register(c->c_w, clone_sig_handler, c);
+
+  if(sc->sc_cloner_hidden != NULL)
+    clone_eval_block(c, sc->sc_cloner_hidden, scope);
+}
+
+
+/**
+ * Windowed cloning (windowedCloning attribute on the cloner's parent)
+ *
+ * Items are created as bare widgets and the cloner body is evaluated
+ * the first time the parent lays the item out. Lists and arrays only
+ * lay out items close to the visible range so only those are
+ * instantiated.
+ *
+ * Items that turn inactive are kept on the sc_idle queue so scrolling
+ * back and forth does not evaluate them over and over. When there are
+ * more idle items than active ones the least recently used idle items
+ * are recycled, ie. replaced with a bare widget again. Items that went
+ * idle during the current frame are never recycled right away. That
+ * keeps everything intact when the parent itself is hidden (all items
+ * turn inactive at once).
+ *
+ * Bare widgets keep the constraints of what they replaced, or get the
+ * constraints of the most recently evaluated item, so the parent can
+ * still position all items (and size scrollbars) for the whole model.
+ * Assignments to 'hidden' in the cloner body are evaluated for bare
+ * widgets as well (see cloner_set_body()) so filtered items do not
+ * take up space or receive focus.
+ *
+ * Widgets that focus may move to are instantiated on
+ * GLW_SIGNAL_MATERIALIZE.
+ *
+ * For parents that drive pagination (lists and arrays) no widget at
+ * all is created for items far beyond the highest active one, see
+ * cloner_defer_child(). The parent still accounts for them using the
+ * same constraints (GLW_SIGNAL_DEFERRED_CHILDS). Other parents (clist)
+ * lay out all their items and only get the deferred evaluation.
+ */
+static void
+clone_set_estimate(sub_cloner_t *sc, glw_t *w)
+{
+  glw_clone_t *c;
+  const int first = !sc->sc_have_estimate;
+
+  sc->sc_est_width  = glw_req_width(w);
+  sc->sc_est_height = glw_req_height(w);
+  sc->sc_est_weight = w->glw_req_weight;
+  sc->sc_est_flags  = glw_filter_constraints(w);
+  sc->sc_have_estimate = 1;
+
+  if(!first)
+    return;
+
+  LIST_FOREACH(c, &sc->sc_clones, c_link)
+    if(!c->c_evaluated && c->c_w != NULL)
+      glw_set_constraints(c->c_w, sc->sc_est_width, sc->sc_est_height,
+                          sc->sc_est_weight, sc->sc_est_flags);
+}
+
+
+/**
+ *
+ */
+static void
+clone_idle_remove(sub_cloner_t *sc, glw_clone_t *c)
+{
+  if(!c->c_idle)
+    return;
+  TAILQ_REMOVE(&sc->sc_idle, c, c_idle_link);
+  sc->sc_num_idle--;
+  c->c_idle = 0;
+}
+
+
+/**
+ * Replace an evaluated item with a bare widget
+ */
+static void
+clone_recycle(sub_cloner_t *sc, glw_clone_t *c)
+{
+  glw_t *old = c->c_w;
+
+  clone_idle_remove(sc, c);
+
+  clone_create_widget(c, old->glw_parent, old, old->glw_scope);
+
+  glw_set_constraints(c->c_w, glw_req_width(old), glw_req_height(old),
+                      old->glw_req_weight, glw_filter_constraints(old));
+
+  if(sc->sc_defer && old->glw_flags & GLW_HIDDEN)
+    sc->sc_num_hidden--;
+
+  old->glw_clone = NULL;
+  glw_signal_handler_unregister(old, clone_sig_handler, c);
+  glw_destroy(old);
+}
+
+
+/**
+ * Put an evaluated item on the idle queue and recycle the least
+ * recently used idle items if there are too many
+ */
+static void
+clone_idle_add(sub_cloner_t *sc, glw_clone_t *c)
+{
+  glw_root_t *gr = c->c_w->glw_root;
+  glw_t *w, *p;
+
+  TAILQ_INSERT_TAIL(&sc->sc_idle, c, c_idle_link);
+  c->c_idle = 1;
+  c->c_idle_frame = gr->gr_frames;
+  sc->sc_num_idle++;
+
+  while(sc->sc_num_idle > sc->sc_num_active) {
+    c = TAILQ_FIRST(&sc->sc_idle);
+    if(c->c_idle_frame == gr->gr_frames)
+      break;
+
+    w = c->c_w;
+    p = w->glw_parent;
+    if(p->glw_focused == w || p->glw_selected == w) {
+      // Got focus or selected while idle
+      clone_idle_remove(sc, c);
+      continue;
+    }
+    clone_recycle(sc, c);
+  }
+}
+
+
+/**
+ *
+ */
+static void
+clone_window_active(sub_cloner_t *sc, glw_clone_t *c)
+{
+  c->c_active = 1;
+  sc->sc_num_active++;
+  clone_idle_remove(sc, c);
+
+  if(sc->sc_windowed && !c->c_evaluated)
+    clone_eval(c, c->c_w->glw_scope);
+}
+
+
+/**
+ *
+ */
+static void
+clone_window_inactive(sub_cloner_t *sc, glw_clone_t *c)
+{
+  glw_t *w = c->c_w;
+  glw_t *p = w->glw_parent;
+
+  c->c_active = 0;
+  sc->sc_num_active--;
+
+  if(!sc->sc_windowed || !c->c_evaluated)
+    return;
+
+  clone_set_estimate(sc, w);
+
+  if(p->glw_focused == w || p->glw_selected == w)
+    return;
+
+  clone_idle_add(sc, c);
+}
+
+
+/**
+ * Make sure an item is evaluated before it's selected or focused
+ */
+static void
+clone_materialize(glw_clone_t *c)
+{
+  sub_cloner_t *sc = c->c_sc;
+
+  if(c->c_evaluated)
+    return;
+
+  clone_eval(c, c->c_w->glw_scope);
+
+  // Not laid out (yet), make sure it can be recycled if it never is
+  if(!c->c_active)
+    clone_idle_add(sc, c);
+}
+
+
+/**
+ * Number of items beyond the highest active one that get a widget
+ * when the cloner defers items, see cloner_defer_child()
+ */
+#define CLONER_DEFER_AHEAD 64
+
+static int
+cloner_defer_limit(const sub_cloner_t *sc)
+{
+  return sc->sc_highest_active + 1 +
+    MAX(CLONER_DEFER_AHEAD, sc->sc_num_active * 2);
+}
+
+
+/**
+ * Items with a widget that is not hidden. Hidden items never turn
+ * active so they must not count against cloner_defer_limit(), or a
+ * filter that hides the first items would keep the rest deferred
+ */
+static int
+cloner_visible_entries(const sub_cloner_t *sc)
+{
+  return sc->sc_entries - sc->sc_num_hidden;
+}
+
+
 /**
  *
  */
 static void
 cloner_pagination_check(sub_cloner_t *sc)
 {
-  if(sc->sc_pending_more || !sc->sc_have_more)
+  if(sc->sc_pending_more || !sc->sc_have_more ||
+     TAILQ_FIRST(&sc->sc_deferred) != NULL)
     return;
 
   if(sc->sc_highest_active >= sc->sc_entries * 0.95 ||
@@ -1325,6 +1697,8 @@ clone_sig_handler(glw_t *w, void *opaque, glw_signal_t signal, void *extra)
   glw_root_t *gr;
   switch(signal) {
   case GLW_SIGNAL_ACTIVE:
+    clone_window_active(sc, c);
+
     if(!(sc->sc_sub.gps_widget->glw_class->gc_flags & GLW_DRIVE_PAGINATION))
       break;
 
@@ -1337,23 +1711,28 @@ clone_sig_handler(glw_t *w, void *opaque, glw_signal_t signal, void *extra)
     if(c->c_pos > sc->sc_highest_active)
       sc->sc_highest_active = c->c_pos;
 
+    if(TAILQ_FIRST(&sc->sc_deferred) != NULL)
+      cloner_create_deferred(sc, cloner_defer_limit(sc), NULL);
+
     cloner_pagination_check(sc);
     break;
 
   case GLW_SIGNAL_INACTIVE:
-    if(!(sc->sc_sub.gps_widget->glw_class->gc_flags & GLW_DRIVE_PAGINATION))
-      break;
+    if(sc->sc_sub.gps_widget->glw_class->gc_flags & GLW_DRIVE_PAGINATION) {
 
-    if(!sc->sc_positions_valid)
-      cloner_resequence(sc);
+      if(!sc->sc_positions_valid)
+        cloner_resequence(sc);
 
-    if(c->c_pos >= sc->sc_lowest_active && c->c_pos < sc->sc_highest_active)
-      sc->sc_lowest_active = c->c_pos + 1;
+      if(c->c_pos >= sc->sc_lowest_active && c->c_pos < sc->sc_highest_active)
+        sc->sc_lowest_active = c->c_pos + 1;
 
-    if(c->c_pos <= sc->sc_highest_active && c->c_pos > sc->sc_lowest_active)
-      sc->sc_highest_active = c->c_pos - 1;
+      if(c->c_pos <= sc->sc_highest_active && c->c_pos > sc->sc_lowest_active)
+        sc->sc_highest_active = c->c_pos - 1;
 
-    cloner_pagination_check(sc);
+      cloner_pagination_check(sc);
+    }
+
+    clone_window_inactive(sc, c);
     break;
 
   case GLW_SIGNAL_MOVE:
@@ -1363,6 +1742,8 @@ clone_sig_handler(glw_t *w, void *opaque, glw_signal_t signal, void *extra)
   case GLW_SIGNAL_DESTROY:
     gr = w->glw_root;
     sc->sc_entries--;
+    if(sc->sc_defer && w->glw_flags & GLW_HIDDEN)
+      sc->sc_num_hidden--;
     if(TAILQ_NEXT(w, glw_parent_link) != NULL)
       sc->sc_positions_valid = 0;
     c->c_w = NULL;
@@ -1370,7 +1751,24 @@ clone_sig_handler(glw_t *w, void *opaque, glw_signal_t signal, void *extra)
     break;
 
   case GLW_SIGNAL_WRAP_CHECK:
-    *(int *)extra = sc->sc_have_more != 1;
+    *(int *)extra = sc->sc_have_more != 1 &&
+      TAILQ_FIRST(&sc->sc_deferred) == NULL;
+    return 0;
+
+  case GLW_SIGNAL_MATERIALIZE:
+    clone_materialize(c);
+
+    if(TAILQ_FIRST(&sc->sc_deferred) == NULL)
+      return 0;
+
+    if(extra != NULL) {
+      cloner_create_deferred(sc, INT_MAX, NULL);
+      *(int *)extra = 1;
+    } else {
+      if(!sc->sc_positions_valid)
+        cloner_resequence(sc);
+      cloner_create_deferred(sc, c->c_pos + CLONER_DEFER_AHEAD, NULL);
+    }
     return 0;
 
   default:
@@ -1446,26 +1844,164 @@ cloner_add_child0(sub_cloner_t *sc, prop_t *p, prop_t *before,
   scope->gs_roots[GLW_ROOT_CLONE].p  = prop_ref_inc(c->c_clone_root);
 
 
-  c->c_w = glw_create(gr, sc->sc_cloner_class, parent, b, p,
-                      scope,
-                      sc->sc_cloner_body->file,
-                      sc->sc_cloner_body->line);
-  c->c_w->glw_clone = c;
+  clone_create_widget(c, parent, b, scope);
 
   prop_tag_set(p, sc, c);
 
-  glw_signal_handler_register(c->c_w, clone_sig_handler, c);
-
   if(flags & PROP_ADD_SELECTED && parent->glw_class->gc_select_child != NULL)
     parent->glw_class->gc_select_child(parent, c->c_w, NULL);
 
-  clone_eval(c, scope);
+  if(!sc->sc_windowed || flags & PROP_ADD_SELECTED)
+    clone_eval(c, scope);
+  else if(sc->sc_have_estimate)
+    glw_set_constraints(c->c_w, sc->sc_est_width, sc->sc_est_height,
+                        sc->sc_est_weight, sc->sc_est_flags);
 
   glw_scope_release(scope);
 
 }
 
 
+/**
+ * Create widgets for deferred items until the cloner has 'limit' items
+ * with widgets, or if 'until' is given, until that item has one.
+ *
+ * Returns 1 if any widget was created
+ */
+static int
+cloner_create_deferred(sub_cloner_t *sc, int limit, prop_t *until)
+{
+  glw_prop_sub_pending_t *gpsp;
+  glw_t *parent = sc->sc_sub.gps_widget;
+  int created = 0;
+  prop_t *p;
+
+  if(sc->sc_creating_deferred)
+    return 0;
+
+  sc->sc_creating_deferred = 1;
+
+  while((gpsp = TAILQ_FIRST(&sc->sc_deferred)) != NULL) {
+    if(until == NULL && cloner_visible_entries(sc) >= limit)
+      break;
+
+    p = gpsp->gpsp_prop;
+    TAILQ_REMOVE(&sc->sc_deferred, gpsp, gpsp_link);
+    prop_tag_clear(p, &sc->sc_deferred);
+    free(gpsp);
+    sc->sc_num_deferred--;
+
+    cloner_add_child0(sc, p, NULL, parent, NULL, 0);
+    prop_ref_dec(p);
+    created = 1;
+
+    if(p == until)
+      break;
+  }
+  sc->sc_creating_deferred = 0;
+  return created;
+}
+
+
+/**
+ * When windowed cloning for a list or an array, items far beyond the
+ * highest active item are not given a widget at all. They are kept on
+ * sc_deferred (always the tail of the model) and created in chunks as
+ * the parent lays out items closer to them, see GLW_SIGNAL_ACTIVE in
+ * clone_sig_handler(). Hidden items do not count, and the parent asks
+ * for more if its layout reaches beyond the last widget, see
+ * cloner_parent_sig_handler().
+ *
+ * Returns 1 if the item was deferred
+ */
+static int
+cloner_defer_child(sub_cloner_t *sc, prop_t *p, prop_t *before, int flags)
+{
+  glw_prop_sub_pending_t *gpsp, *b = NULL;
+
+  if(!sc->sc_defer)
+    return 0;
+
+  if(before != NULL) {
+    if((b = prop_tag_get(before, &sc->sc_deferred)) == NULL)
+      return 0;
+  } else if(TAILQ_FIRST(&sc->sc_deferred) == NULL &&
+            cloner_visible_entries(sc) < cloner_defer_limit(sc)) {
+    return 0;
+  }
+
+  if(flags & PROP_ADD_SELECTED) {
+    // Everything in front of a selected item must exist
+    cloner_create_deferred(sc, INT_MAX, before);
+    return 0;
+  }
+
+  gpsp = malloc(sizeof(glw_prop_sub_pending_t));
+  gpsp->gpsp_prop = prop_ref_inc(p);
+
+  prop_tag_set(p, &sc->sc_deferred, gpsp);
+  sc->sc_num_deferred++;
+
+  if(b != NULL) {
+    TAILQ_INSERT_BEFORE(b, gpsp, gpsp_link);
+  } else {
+    TAILQ_INSERT_TAIL(&sc->sc_deferred, gpsp, gpsp_link);
+  }
+  return 1;
+}
+
+
+/**
+ * Signals sent to the parent of a cloner that defers items
+ */
+static int
+cloner_parent_sig_handler(glw_t *w, void *opaque, glw_signal_t signal,
+                          void *extra)
+{
+  sub_cloner_t *sc = opaque;
+  glw_deferred_childs_t *gdc;
+  glw_t *c;
+
+  switch(signal) {
+  case GLW_SIGNAL_CHILD_HIDDEN:
+    c = extra;
+    if(c->glw_clone == NULL || c->glw_clone->c_sc != sc)
+      break;
+    sc->sc_num_hidden++;
+    // Replace it with a deferred item
+    if(TAILQ_FIRST(&sc->sc_deferred) != NULL)
+      cloner_create_deferred(sc, cloner_defer_limit(sc), NULL);
+    break;
+
+  case GLW_SIGNAL_CHILD_UNHIDDEN:
+    c = extra;
+    if(c->glw_clone != NULL && c->glw_clone->c_sc == sc)
+      sc->sc_num_hidden--;
+    break;
+
+  case GLW_SIGNAL_DEFERRED_CHILDS:
+    gdc = extra;
+    gdc->count += sc->sc_num_deferred;
+    if(sc->sc_have_estimate) {
+      if(sc->sc_est_flags & GLW_CONSTRAINT_X)
+        gdc->width = sc->sc_est_width;
+      if(sc->sc_est_flags & GLW_CONSTRAINT_Y)
+        gdc->height = sc->sc_est_height;
+    }
+    break;
+
+  case GLW_SIGNAL_WANT_DEFERRED_CHILDS:
+    cloner_create_deferred(sc, cloner_visible_entries(sc) + *(int *)extra,
+                           NULL);
+    break;
+
+  default:
+    break;
+  }
+  return 0;
+}
+
+
 /**
  *
  */
@@ -1476,7 +2012,8 @@ cloner_add_child(sub_cloner_t *sc, prop_t *p, prop_t *before,
   glw_prop_sub_pending_t *gpsp, *b;
 
   if(sc->sc_cloner_body != NULL) {
-    cloner_add_child0(sc, p, before, parent, ei, flags);
+    if(!cloner_defer_child(sc, p, before, flags))
+      cloner_add_child0(sc, p, before, parent, ei, flags);
     return;
   }
 
@@ -1511,6 +2048,35 @@ static void
 cloner_move_child0(sub_cloner_t *sc, prop_t *p, prop_t *before,
 		   glw_t *parent, errorinfo_t *ei)
 {
+  glw_prop_sub_pending_t *dt =          prop_tag_get(p, &sc->sc_deferred);
+  glw_prop_sub_pending_t *db = before ? prop_tag_get(before, &sc->sc_deferred)
+    : NULL;
+
+  if(dt != NULL) {
+    TAILQ_REMOVE(&sc->sc_deferred, dt, gpsp_link);
+
+    if(db != NULL || (before == NULL && TAILQ_FIRST(&sc->sc_deferred))) {
+      // Moved within the deferred items
+      if(db != NULL) {
+        TAILQ_INSERT_BEFORE(db, dt, gpsp_link);
+      } else {
+        TAILQ_INSERT_TAIL(&sc->sc_deferred, dt, gpsp_link);
+      }
+      return;
+    }
+
+    // Moved among the items that have widgets
+    prop_tag_clear(p, &sc->sc_deferred);
+    free(dt);
+    sc->sc_num_deferred--;
+    cloner_add_child0(sc, p, before, parent, ei, 0);
+    prop_ref_dec(p);
+    return;
+  }
+
+  if(db != NULL || (before == NULL && TAILQ_FIRST(&sc->sc_deferred)))
+    cloner_create_deferred(sc, INT_MAX, before);
+
   glw_clone_t *c =          prop_tag_get(p, sc);
   glw_clone_t *b = before ? prop_tag_get(before, sc) : NULL;
 
@@ -1553,7 +2119,14 @@ static void
 clone_free(glw_root_t *gr, glw_clone_t *c)
 {
   glw_t *w = c->c_w;
+
+  if(c->c_active)
+    c->c_sc->sc_num_active--;
+  clone_idle_remove(c->c_sc, c);
+
   if(w != NULL) {
+    if(c->c_sc->sc_defer && w->glw_flags & GLW_HIDDEN)
+      c->c_sc->sc_num_hidden--;
     w->glw_clone = NULL;
     glw_signal_handler_unregister(w, clone_sig_handler, c);
     glw_retire_child(w);
@@ -1586,6 +2159,14 @@ cloner_del_child(glw_root_t *gr, sub_cloner_t *sc, prop_t *p, glw_t *parent)
     return;
   }
 
+  if((gpsp = prop_tag_clear(p, &sc->sc_deferred)) != NULL) {
+    prop_ref_dec(p);
+    TAILQ_REMOVE(&sc->sc_deferred, gpsp, gpsp_link);
+    free(gpsp);
+    sc->sc_num_deferred--;
+    return;
+  }
+
   if(sc->sc_pending_select == p)
     sc->sc_pending_select = NULL;
 
@@ -1610,7 +2191,11 @@ cloner_select_child(sub_cloner_t *sc, prop_t *p, glw_t *parent, prop_t *extra)
     return;
   }
 
+  if(prop_tag_get(p, &sc->sc_deferred) != NULL)
+    cloner_create_deferred(sc, INT_MAX, p);
+
   if((c = prop_tag_get(p, sc)) != NULL) {
+    clone_materialize(c);
     if(parent->glw_class->gc_select_child != NULL)
       parent->glw_class->gc_select_child(parent, c->c_w, extra);
     sc->sc_pending_select = NULL;
@@ -1629,7 +2214,11 @@ cloner_suggest_focus(sub_cloner_t *sc, prop_t *p, glw_t *parent)
 {
   glw_clone_t *c;
 
+  if(prop_tag_get(p, &sc->sc_deferred) != NULL)
+    cloner_create_deferred(sc, INT_MAX, p);
+
   if((c = prop_tag_get(p, sc)) != NULL) {
+    clone_materialize(c);
     if(parent->glw_class->gc_suggest_focus != NULL)
       parent->glw_class->gc_suggest_focus(parent, c->c_w);
   }
@@ -2475,6 +3064,8 @@ subscribe_prop(glw_view_eval_context_t *ec, struct token *self, int type)
         prop_ref_inc(ec->scope->gs_roots[GLW_ROOT_SELF].p);
 
       TAILQ_INIT(&sc->sc_pending);
+      TAILQ_INIT(&sc->sc_idle);
+      TAILQ_INIT(&sc->sc_deferred);
     } while(0);
     cb = prop_callback_cloner;
     f |= PROP_SUB_DIRECT_UPDATE;
@@ -2661,7 +3252,152 @@ make_vector(glw_view_eval_context_t *ec, token_t *t)
 
 
 /**
+ * Operators taking an extra argument, wrapped so all operators share
+ * the rpn_op_t signature
+ */
+static int
+eval_neq(glw_view_eval_context_t *ec, token_t *t)
+{
+  return eval_eq(ec, t, 1);
+}
+
+static int
+eval_eq0(glw_view_eval_context_t *ec, token_t *t)
+{
+  return eval_eq(ec, t, 0);
+}
+
+static int
+eval_gt(glw_view_eval_context_t *ec, token_t *t)
+{
+  return eval_lt(ec, t, 1);
+}
+
+static int
+eval_lt0(glw_view_eval_context_t *ec, token_t *t)
+{
+  return eval_lt(ec, t, 0);
+}
+
+static int
+eval_assign_set(glw_view_eval_context_t *ec, token_t *t)
+{
+  return eval_assign(ec, t, 0);
+}
+
+static int
+eval_assign_cond(glw_view_eval_context_t *ec, token_t *t)
+{
+  return eval_assign(ec, t, 1);
+}
+
+static int
+eval_assign_debug(glw_view_eval_context_t *ec, token_t *t)
+{
+  return eval_assign(ec, t, 2);
+}
+
+static int
+eval_assign_ref(glw_view_eval_context_t *ec, token_t *t)
+{
+  return eval_assign(ec, t, 3);
+}
+
+
+typedef int (rpn_op_t)(glw_view_eval_context_t *ec, token_t *t);
+
+/**
+ * Map a token in an RPN chain to the operator that executes it.
+ * Returns NULL for operands, they are just pushed on the stack.
+ *
+ * Operands may change type when evaluated (property names are turned
+ * into subscriptions, etc) but they always stay operands, and operators
+ * are never rewritten. So the mapping for a token is fixed once the
+ * view has been parsed and preprocessed.
+ */
+static rpn_op_t *
+rpn_op(token_t *t)
+{
+  switch(t->type) {
+  case TOKEN_BLOCK:
+  case TOKEN_RSTRING:
+  case TOKEN_CSTRING:
+  case TOKEN_URI:
+  case TOKEN_FLOAT:
+  case TOKEN_EM:
+  case TOKEN_INT:
+  case TOKEN_IDENTIFIER:
+  case TOKEN_RESOLVED_ATTRIBUTE:
+  case TOKEN_UNRESOLVED_ATTRIBUTE:
+  case TOKEN_VOID:
+  case TOKEN_PROPERTY_REF:
+  case TOKEN_PROPERTY_OWNER:
+  case TOKEN_PROPERTY_NAME:
+  case TOKEN_PROPERTY_SUBSCRIPTION:
+    return NULL;
+
+  case TOKEN_ADD:
+  case TOKEN_SUB:
+  case TOKEN_MULTIPLY:
+  case TOKEN_DIVIDE:
+  case TOKEN_MODULO:
+    return eval_op;
+
+  case TOKEN_BOOLEAN_OR:
+  case TOKEN_BOOLEAN_XOR:
+  case TOKEN_BOOLEAN_AND:
+    return eval_bool_op;
+
+  case TOKEN_BOOLEAN_NOT:
+    return eval_bool_not;
+
+  case TOKEN_NULL_COALESCE:
+    return eval_null_coalesce;
+
+  case TOKEN_EQ:
+    return eval_eq0;
+  case TOKEN_NEQ:
+    return eval_neq;
+
+  case TOKEN_LT:
+    return eval_lt0;
+  case TOKEN_GT:
+    return eval_gt;
+
+  case TOKEN_FUNCTION:
+    return invoke_func;
+
+  case TOKEN_LEFT_BRACKET:
+    return make_vector;
+
+  case TOKEN_ASSIGNMENT:
+    return eval_assign_set;
+  case TOKEN_COND_ASSIGNMENT:
+    return eval_assign_cond;
+  case TOKEN_DEBUG_ASSIGNMENT:
+    return eval_assign_debug;
+  case TOKEN_REF_ASSIGNMENT:
+    return eval_assign_ref;
+
+  case TOKEN_LINK_ASSIGNMENT:
+    return eval_link_assign;
+
+  case TOKEN_TENARY:
+    return eval_tenary;
+
+  default:
+    fprintf(stderr, "Can not handle token %s\n", token2name(t));
+    abort();
+  }
+}
+
+
+/**
+ * Evaluate an RPN chain by walking the tokens.
  *
+ * This is used for the first evaluation of an expression. Most
+ * expressions are only ever evaluated once so it's not worth compiling
+ * them.
  */
 static int
 glw_view_eval_rpn0(token_t *t0, glw_view_eval_context_t *ec)
@@ -2669,111 +3405,88 @@ glw_view_eval_rpn0(token_t *t0, glw_view_eval_context_t *ec)
   token_t *t;
 
   for(t = t0->child; t != NULL; t = t->next) {
-    switch(t->type) {
-    case TOKEN_BLOCK:
-    case TOKEN_RSTRING:
-    case TOKEN_CSTRING:
-    case TOKEN_URI:
-    case TOKEN_FLOAT:
-    case TOKEN_EM:
-    case TOKEN_INT:
-    case TOKEN_IDENTIFIER:
-    case TOKEN_RESOLVED_ATTRIBUTE:
-    case TOKEN_UNRESOLVED_ATTRIBUTE:
-    case TOKEN_VOID:
-    case TOKEN_PROPERTY_REF:
-    case TOKEN_PROPERTY_OWNER:
-    case TOKEN_PROPERTY_NAME:
-    case TOKEN_PROPERTY_SUBSCRIPTION:
+    rpn_op_t *op = rpn_op(t);
+    if(op == NULL)
       eval_push(ec, t);
-      break;
-
-    case TOKEN_ADD:
-    case TOKEN_SUB:
-    case TOKEN_MULTIPLY:
-    case TOKEN_DIVIDE:
-    case TOKEN_MODULO:
-      if(eval_op(ec, t))
-	return -1;
-      break;
+    else if(op(ec, t))
+      return -1;
+  }
+  return 0;
+}
 
-    case TOKEN_BOOLEAN_OR:
-    case TOKEN_BOOLEAN_XOR:
-    case TOKEN_BOOLEAN_AND:
-      if(eval_bool_op(ec, t))
-	return -1;
-      break;
 
-    case TOKEN_BOOLEAN_NOT:
-      if(eval_bool_not(ec, t))
-	return -1;
-      break;
+/**
+ * Compiled form of an RPN expression, stored in t_extra of the
+ * TOKEN_RPN / TOKEN_PURE_RPN token (freed by glw_view_token_free())
+ *
+ * It's a flat array of (operator, token) pairs so re-evaluating does
+ * not need to chase 'next' pointers across the token pool or map the
+ * token type to an operator for each step.
+ */
+typedef struct rpn_insn {
+  rpn_op_t *ri_op;  // NULL for operands
+  token_t *ri_token;
+} rpn_insn_t;
 
-    case TOKEN_NULL_COALESCE:
-      if(eval_null_coalesce(ec, t))
-	return -1;
-      break;
+typedef struct rpn_program {
+  int rp_count;
+  rpn_insn_t rp_insn[0];
+} rpn_program_t;
 
-    case TOKEN_EQ:
-    case TOKEN_NEQ:
-      if(eval_eq(ec, t, t->type == TOKEN_NEQ))
-	return -1;
-      break;
 
-    case TOKEN_LT:
-    case TOKEN_GT:
-      if(eval_lt(ec, t, t->type == TOKEN_GT))
-	return -1;
-      break;
+/**
+ *
+ */
+static rpn_program_t *
+rpn_compile(const token_t *t0)
+{
+  token_t *t;
+  int n = 0;
 
-    case TOKEN_FUNCTION:
-#if 0
-      printf("Invoking %s with %d arguments\n",
-	     t->t_func->name, t->t_num_args);
-#endif
-      if(invoke_func(ec, t))
-	return -1;
-      break;
+  for(t = t0->child; t != NULL; t = t->next)
+    n++;
 
-    case TOKEN_LEFT_BRACKET:
-      if(make_vector(ec, t))
-	return -1;
-      break;
+  rpn_program_t *rp = malloc(sizeof(rpn_program_t) + n * sizeof(rpn_insn_t));
+  rp->rp_count = n;
 
-    case TOKEN_ASSIGNMENT:
-      if(eval_assign(ec, t, 0))
-	return -1;
-      break;
+  rpn_insn_t *ri = rp->rp_insn;
+  for(t = t0->child; t != NULL; t = t->next, ri++) {
+    ri->ri_op = rpn_op(t);
+    ri->ri_token = t;
+  }
+  return rp;
+}
 
-    case TOKEN_COND_ASSIGNMENT:
-      if(eval_assign(ec, t, 1))
-	return -1;
-      break;
 
-    case TOKEN_DEBUG_ASSIGNMENT:
-      if(eval_assign(ec, t, 2))
-	return -1;
-      break;
+/**
+ * Evaluate an RPN expression that is evaluated repeatedly (dynamic
+ * expressions and expressions depending on properties). Compiles
+ * the expression the first time.
+ */
+static int
+glw_view_exec_rpn(token_t *t0, glw_view_eval_context_t *ec)
+{
+  rpn_program_t *rp = t0->t_extra;
 
-    case TOKEN_REF_ASSIGNMENT:
-      if(eval_assign(ec, t, 3))
-	return -1;
-      break;
+  if(unlikely(ec->gr->gr_bench != NULL) &&
+     ec->gr->gr_bench->gbs_eval_treewalk) {
+    // Evaluate as before expressions were compiled, for comparison
+    if(ec->scratch != NULL)
+      ec->scratch->ges_used = GLW_EVAL_SCRATCH_TOKENS;
+    return glw_view_eval_rpn0(t0, ec);
+  }
 
-    case TOKEN_LINK_ASSIGNMENT:
-      if(eval_link_assign(ec, t))
-	return -1;
-      break;
+  if(unlikely(rp == NULL))
+    rp = t0->t_extra = rpn_compile(t0);
 
-    case TOKEN_TENARY:
-      if(eval_tenary(ec, t))
-        return -1;
-      break;
+  const rpn_insn_t *ri = rp->rp_insn;
+  const rpn_insn_t *end = ri + rp->rp_count;
 
-    default:
-      fprintf(stderr, "Can not handle token %s\n", token2name(t));
-      abort();
-    }
+  for(; ri != end; ri++) {
+    if(ri->ri_op == NULL)
+      eval_push(ec, ri->ri_token);
+    else if(ri->ri_op(ec, ri->ri_token))
+      return -1;
   }
   return 0;
 }
@@ -2791,12 +3504,13 @@ glw_view_eval_rpn(token_t *t, glw_view_eval_context_t *pec, int *copyp)
   ec.rpn = t;
   ec.alloc = NULL;
   ec.stack = NULL;
+  ec.scratch = NULL;
   SLIST_INIT(&ec.sublist_rpnlocal);
 
   r = glw_view_eval_rpn0(t, &ec);
 
   *copyp = ec.dynamic_eval;
-  glw_view_free_chain(ec.gr, ec.alloc);
+  eval_free_temps(&ec);
   return r;
 }
 
@@ -3053,6 +3767,85 @@ glwf_resolve_widget_class(glw_root_t *gr, errorinfo_t *ei, token_t *t)
 }
 
 
+/**
+ *
+ */
+static int
+cloner_stmt_sets_hidden(const token_t *t)
+{
+  switch(t->type) {
+  case TOKEN_RPN:
+  case TOKEN_PURE_RPN:
+    t = t->child;
+    if(t == NULL || t->type != TOKEN_RESOLVED_ATTRIBUTE)
+      return 0;
+    break;
+
+  case TOKEN_FLOAT:
+  case TOKEN_INT:
+  case TOKEN_VOID:
+    break;
+
+  default:
+    return 0;
+  }
+  return !strcmp(t->t_attrib->name, "hidden");
+}
+
+
+/**
+ *
+ */
+static token_t *
+cloner_block_create(glw_root_t *gr, const token_t *src, token_t *chain)
+{
+  token_t *t = glw_view_token_alloc(gr);
+
+  t->type = TOKEN_BLOCK;
+  t->file = rstr_dup(src->file);
+  t->line = src->line;
+  t->child = chain;
+  return t;
+}
+
+
+/**
+ * Setup the cloner body.
+ *
+ * With windowed cloning the assignments to 'hidden' are split into
+ * sc_cloner_hidden which is evaluated for all widgets, including those
+ * that are not instantiated
+ */
+static void
+cloner_set_body(glw_root_t *gr, sub_cloner_t *sc, token_t *body)
+{
+  token_t *t, *d, *h = NULL, *r = NULL, **hp = &h, **rp = &r;
+
+  for(t = body->child; sc->sc_windowed && t != NULL; t = t->next)
+    if(cloner_stmt_sets_hidden(t))
+      break;
+
+  if(!sc->sc_windowed || t == NULL) {
+    sc->sc_cloner_body = glw_view_clone_chain(gr, body, NULL);
+    return;
+  }
+
+  for(t = body->child; t != NULL; t = t->next) {
+    d = glw_view_clone_token(gr, t);
+    if(cloner_stmt_sets_hidden(t)) {
+      *hp = d;
+      hp = &d->next;
+    } else {
+      *rp = d;
+      rp = &d->next;
+    }
+  }
+
+  sc->sc_cloner_hidden = cloner_block_create(gr, body, h);
+  sc->sc_cloner_body   = cloner_block_create(gr, body, r);
+}
+
+
 /**
  *
  */
@@ -3122,8 +3915,17 @@ glwf_cloner(glw_view_eval_context_t *ec, struct token *self,
 
     cloner_cleanup(ec->gr, sc);
 
-    sc->sc_cloner_body = glw_view_clone_chain(ec->gr, c, NULL);
     sc->sc_cloner_class = cl;
+    sc->sc_windowed = !!(parent->glw_flags2 & GLW2_WINDOWED_CLONING) ||
+      (ec->gr->gr_bench != NULL && ec->gr->gr_bench->gbs_windowed_cloning &&
+       parent->glw_class->gc_flags & GLW_DRIVE_PAGINATION);
+    sc->sc_defer = sc->sc_windowed &&
+      parent->glw_class->gc_flags & GLW_DRIVE_PAGINATION;
+
+    if(sc->sc_defer)
+      glw_signal_handler_register(parent, cloner_parent_sig_handler, sc);
+
+    cloner_set_body(ec->gr, sc, c);
 
     /* Create pending childs */
     while((gpsp = TAILQ_FIRST(&sc->sc_pending)) != NULL) {
@@ -3131,7 +3933,8 @@ glwf_cloner(glw_view_eval_context_t *ec, struct token *self,
 
       f = gpsp->gpsp_prop == sc->sc_pending_select ? PROP_ADD_SELECTED : 0;
 
-      cloner_add_child0(sc, gpsp->gpsp_prop, NULL, parent, ec->ei, f);
+      if(!cloner_defer_child(sc, gpsp->gpsp_prop, NULL, f))
+        cloner_add_child0(sc, gpsp->gpsp_prop, NULL, parent, ec->ei, f);
       prop_tag_clear(gpsp->gpsp_prop, &sc->sc_pending);
       prop_ref_dec(gpsp->gpsp_prop);
       free(gpsp);
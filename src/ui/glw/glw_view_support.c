@@ -37,11 +37,10 @@ glw_view_token_alloc(glw_root_t *gr)
 }
 
 /**
- * Free a token.
- * It must be delinked for all lists before
+ * Release what a token refers to but not the token itself
  */
 void
-glw_view_token_free(glw_root_t *gr, token_t *t)
+glw_view_token_release(glw_root_t *gr, token_t *t)
 {
   int i;
   rstr_release(t->file);
@@ -105,8 +104,6 @@ glw_view_token_free(glw_root_t *gr, token_t *t)
   case TOKEN_LT:
   case TOKEN_GT:
   case TOKEN_EXPR:
-  case TOKEN_RPN:
-  case TOKEN_PURE_RPN:
   case TOKEN_BLOCK:
   case TOKEN_NOP:
   case TOKEN_COLON:
@@ -116,6 +113,11 @@ glw_view_token_free(glw_root_t *gr, token_t *t)
   case TOKEN_MOD_FLAGS:
     break;
 
+  case TOKEN_RPN:
+  case TOKEN_PURE_RPN:
+    free(t->t_extra);  // Compiled program, see glw_view_exec_rpn()
+    break;
+
   case TOKEN_RSTRING:
   case TOKEN_IDENTIFIER:
   case TOKEN_UNRESOLVED_ATTRIBUTE:
@@ -143,6 +145,17 @@ glw_view_token_free(glw_root_t *gr, token_t *t)
     abort();
 
   }
+}
+
+
+/**
+ * Free a token.
+ * It must be delinked for all lists before
+ */
+void
+glw_view_token_free(glw_root_t *gr, token_t *t)
+{
+  glw_view_token_release(gr, t);
   pool_put(gr->gr_token_pool, t);
 }
 
@@ -311,6 +324,18 @@ glw_view_free_chain(glw_root_t *gr, token_t *t)
 }
 
 
+/**
+ * Clone a token including its childs (but not the tokens following it)
+ */
+token_t *
+glw_view_clone_token(glw_root_t *gr, token_t *src)
+{
+  token_t *d = glw_view_token_copy(gr, src);
+  d->child = glw_view_clone_chain(gr, src->child, NULL);
+  return d;
+}
+
+
 /**
  *
  */
@@ -321,12 +346,11 @@ glw_view_clone_chain(glw_root_t *gr, token_t *src, token_t **lp)
   token_t **pp = &r;
 
   for(; src != NULL; src = src->next) {
-    d = glw_view_token_copy(gr, src);
+    d = glw_view_clone_token(gr, src);
     *pp = d;
     pp = &d->next;
     if(lp)
       *lp = d;
-    d->child = glw_view_clone_chain(gr, src->child, NULL);
   }
   return r;
 }